@@ -0,0 +1,1893 @@
+#include "Bank.hpp"
+#include "Session.hpp"
+#include "BinaryProtocol.hpp"
+#include "MassUpdate.hpp"
+#include "TxnLog.hpp"
+#include "Snapshot.hpp"
+#include "Commands.hpp"
+#include "ShardedBank.hpp"
+#include "Ledger.hpp"
+#include "Stats.hpp"
+#include "Trace.hpp"
+#include "Segment.hpp"
+#include "AccountIndex.hpp"
+#include "ServerCore.hpp"
+
+#include <arpa/inet.h>  // inet_pton, htons
+#include <netinet/in.h> // sockaddr_in
+#include <netinet/tcp.h> // TCP_NODELAY
+#include <pthread.h>    // pthread_mutex_*, pthread_cond_*
+#include <sys/mman.h>   // shm_unlink
+#include <sys/socket.h> // socket, connect
+#include <sys/wait.h>   // waitpid
+#include <unistd.h>     // close, unlink, fork, pipe
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <initializer_list>
+#include <iomanip>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+ * bank_bench — бенчмарки TBANK.
+ *
+ * С --json (в любом месте командной строки) наборы bank, ops, shm и load
+ * печатают каждый результат строкой JSON вида
+ *   {"suite":"ops","benchmark":"transfer","accounts":1000,"threads":4,"value":..,"unit":".."}
+ * для сравнения прогонов; остальные наборы — таблицей, как обычно.
+ *
+ *   bank_bench [bank]
+ *     transfer_latency: среднее время одного transferFunds (нс) на случайных
+ *     парах счетов при N от 1e3 до 1e7, для плотных и разреженных ID.
+ *     Ожидаемый результат — почти постоянное время при росте N.
+ *     transfer_batch: те же переводы пакетами по 1e5 через transferBatch —
+ *     один захват полос на пакет вместо блокировки на каждый перевод.
+ *
+ *   bank_bench ops
+ *     Операции Bank в секунду на 1e3, 1e5 и 1e7 счетах при 1…8 нитях:
+ *     transferFunds, поиск счёта по ID (AccountIndex::find, плотные и
+ *     разреженные ID), getAccount, setLimits; massUpdate — мс на вызов.
+ *
+ *   bank_bench rejects
+ *     Стоимость отказанного перевода (нс): transferFunds с перехватом
+ *     BankError против tryTransfer с кодом BankStatus, на одних отказах
+ *     и на смеси с 20% отказов.
+ *
+ *   bank_bench mass_update
+ *     Время одного massUpdate (мс) на 1e6…3e7 счетов: исходный
+ *     однопроходный цикл против двухпроходного скалярного, AVX2 и
+ *     многопоточного AVX2 (по числу ядер).
+ *
+ *   bank_bench layout
+ *     Rows (Account[]) против Columns (SoA) на 1e6 и 1e7 счетов:
+ *     massUpdate, сумма балансов, подсчёт по фильтру (баланс ≥ порога и
+ *     не заморожен) и случайные переводы. Результат — ГБ/с полезных
+ *     данных для проходов и нс на перевод.
+ *
+ *   bank_bench wal [--dir=D]
+ *     Долговечные переводы в секунду с журналом (TxnLog) в каталоге D
+ *     (по умолчанию /tmp) при 1…64 нитях: fdatasync на каждую операцию
+ *     против групповой фиксации без окна и с окном 100 мкс.
+ *
+ *   bank_bench snapshot [--dir=D]
+ *     Снимок 1e7 счетов в каталог D (по умолчанию /tmp) в обеих раскладках:
+ *     через fork (пауза операций и полное время записи), прямым копированием
+ *     в отображённый файл (как для сегмента общей памяти) и время загрузки
+ *     снимка при рестарте.
+ *
+ *   bank_bench reads
+ *     Чтения счетов (getAccount, seqlock без мьютексов) в секунду при 1…8
+ *     читателях без писателей и под нагрузкой переводов из 2 нитей, и
+ *     переводы в секунду рядом с ними: читатели не должны тормозить
+ *     писателей, а писатели — читателей.
+ *
+ *   bank_bench audit
+ *     Задержка перевода (p50/p99/max, мкс) на 1e6 счетов без аудита и при
+ *     нити, непрерывно открывающей Bank::ReadView и считающей сумму
+ *     балансов, а также время одного такого аудита. Для сравнения —
+ *     аудит под lockAllStripes(), останавливающий переводы.
+ *
+ *   bank_bench protocol
+ *     CPU на запрос в Session без сокетов: конвейер из 1e5 переводов
+ *     и запросов баланса в текстовом и в бинарном протоколе.
+ *
+ *   bank_bench parse
+ *     Разбор и диспетчеризация одной команды (нс) без выполнения:
+ *     istringstream и цепочка сравнений std::string, как было в
+ *     ServerCore и Client, против Tokenizer и lookupCommand (Commands.hpp).
+ *
+ *   bank_bench listing
+ *     show_account_list на 1e6 счетов через Session в socketpair с
+ *     читающей нитью: время, мегабайты, число send() и наибольший
+ *     выходной буфер сессии. Для сравнения — та же таблица через
+ *     ostringstream/setw в одну строку, как до потокового вывода.
+ *
+ *   bank_bench shards
+ *     Переводы в секунду на 1e6 счетов от 8 нитей-клиентов за 1 с:
+ *     Bank с полосами против ShardedBank при K = 1, 2, 4, 8 шардах.
+ *     Нагрузка двух видов: случайные пары (доля межшардовых переводов
+ *     растёт как (K-1)/K) и пары внутри одного шарда.
+ *
+ *   bank_bench ledger [--dir=D]
+ *     Переводы в секунду при 1…16 нитях: Bank с полосами против единственного
+ *     писателя Ledger (кольцо MPSC и одна нить ledger без мьютексов полос).
+ *     Две нагрузки: все переводят на счёт 0 (одна горячая полоса) и случайные
+ *     пары из 1e5 счетов. Затем горячая нагрузка при 1, 8 и 64 нитях с
+ *     журналом (TxnLog, групповая фиксация) в каталоге D (по умолчанию /tmp).
+ *
+ *   bank_bench stats
+ *     Стоимость учёта одного запроса (нс) при 1…8 нитях: прежний счётчик
+ *     под stats_mutex с pthread_cond_signal ждущей нити статистики против
+ *     statsRecord (слот нити, без блокировок и общих строк кэша).
+ *     Затем цена одного интервала TraceSpan при выключенной и включённой
+ *     трассировке.
+ *
+ *   bank_bench shm
+ *     Несколько процессов над одним сегментом общей памяти (как клиенты
+ *     client): переводы в секунду при 1…8 процессах на 1e5 счетах,
+ *     случайные пары и все на счёт 0. В конце сверяется сумма балансов.
+ *
+ *   bank_bench load [--host=H] [--port=P] [--connections=C] [--seconds=S]
+ *                   [--rate=R] [--zipf=S] [--writes=PCT] [--accounts=N]
+ *     Генератор нагрузки на запущенный server: C соединений в течение S
+ *     секунд (по умолчанию 16 и 5). Без --rate — замкнутый цикл (запрос
+ *     за ответом), с --rate=R — открытый: R запросов в секунду на все
+ *     соединения по расписанию, задержка считается от запланированного
+ *     момента отправки. Счета выбираются равномерно из N (по умолчанию 100)
+ *     или по Ципфу с показателем --zipf; PCT% запросов — transfer, прочие —
+ *     show_balance (по умолчанию 20%). Результат — запросов в секунду,
+ *     p50/p99/p999 (мкс) и число отказов.
+ *
+ *   bank_bench server [--host=H] [--port=P] [--connections=C] [--requests=R]
+ *     Нагрузка на запущенный server: скорость установления соединений
+ *     (connect + приветствие + close) и задержки запрос-ответ
+ *     (p50/p99) при C параллельных соединениях. Запускается против
+ *     обеих моделей: server --mode=threads и server --mode=epoll.
+ */
+
+using Clock = std::chrono::steady_clock;
+
+// --json: строка результата — объект JSON, иначе строка таблицы
+static bool json_output = false;
+
+struct Param
+{
+    const char *name;
+    double value;
+};
+
+static void report(const char *suite, const char *benchmark, std::initializer_list<Param> params,
+                   double value, const char *unit)
+{
+    if (json_output)
+    {
+        std::printf("{\"suite\":\"%s\",\"benchmark\":\"%s\"", suite, benchmark);
+        for (const Param &p : params)
+            std::printf(",\"%s\":%.15g", p.name, p.value);
+        std::printf(",\"value\":%.6g,\"unit\":\"%s\"}\n", value, unit);
+    }
+    else
+    {
+        std::printf("%-20s", benchmark);
+        for (const Param &p : params)
+            std::printf(" %s=%-10.12g", p.name, p.value);
+        std::printf(" %14.1f %s\n", value, unit);
+    }
+    std::fflush(stdout);
+}
+
+// xorshift64: дешевле распределений <random>, чтобы не мерить генератор
+static uint64_t nextRandom(uint64_t &state)
+{
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+}
+
+static void fillAccounts(std::vector<Account> &accounts, bool sparse)
+{
+    for (size_t i = 0; i < accounts.size(); ++i)
+    {
+        accounts[i].account_id = sparse ? static_cast<int>(i * 13 + 7) : static_cast<int>(i);
+        accounts[i].balance = 1000000;
+        accounts[i].min_balance = 0;
+        accounts[i].max_balance = 2000000000;
+        accounts[i].frozen = false;
+    }
+}
+
+static double benchTransfers(size_t n, bool sparse, size_t ops, size_t batch = 0)
+{
+    std::vector<Account> accounts(n);
+    fillAccounts(accounts, sparse);
+    Bank bank(accounts.data(), n);
+
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<size_t> pick(0, n - 1);
+    std::vector<int> ids(ops * 2);
+    for (size_t i = 0; i < ids.size(); ++i)
+        ids[i] = accounts[pick(rng)].account_id;
+
+    std::vector<Transfer> items;
+    std::vector<BankStatus> results(batch);
+    if (batch)
+    {
+        items.resize(ops);
+        for (size_t i = 0; i < ops; ++i)
+            items[i] = Transfer{ids[2 * i], ids[2 * i + 1], 1};
+    }
+
+    Clock::time_point start = Clock::now();
+    if (batch)
+    {
+        for (size_t i = 0; i < ops; i += batch)
+            bank.transferBatch(&items[i], std::min(batch, ops - i), results.data());
+    }
+    else
+    {
+        for (size_t i = 0; i < ops; ++i)
+            bank.transferFunds(ids[2 * i], ids[2 * i + 1], 1);
+    }
+    Clock::time_point end = Clock::now();
+
+    return std::chrono::duration<double, std::nano>(end - start).count() / ops;
+}
+
+static int runBankSuite()
+{
+    const size_t ops = 1000000;
+    const size_t sizes[] = {1000, 10000, 100000, 1000000, 10000000};
+
+    for (size_t n : sizes)
+    {
+        const double accounts = static_cast<double>(n);
+        report("bank", "transfer_dense", {{"accounts", accounts}}, benchTransfers(n, false, ops),
+               "ns/transfer");
+        report("bank", "transfer_sparse", {{"accounts", accounts}}, benchTransfers(n, true, ops),
+               "ns/transfer");
+        report("bank", "transfer_batch", {{"accounts", accounts}},
+               benchTransfers(n, false, ops, 100000), "ns/transfer");
+    }
+    return 0;
+}
+
+// ---------------------------------------------------------------------
+// Операции Bank по отдельности: размер банка и число нитей
+// ---------------------------------------------------------------------
+
+enum class BankOp
+{
+    Transfer,
+    FindDense,
+    FindSparse,
+    Get,
+    SetLimits,
+};
+
+struct OpsFixture
+{
+    Bank &bank;
+    const AccountIndex &dense;  // Индекс ID 0…n-1, как у bank
+    const AccountIndex &sparse; // Индекс слотов с ID i * 13 + 7
+    size_t n;
+};
+
+// Операций в секунду: threads нитей по ops операций над случайными счетами
+static double benchBankOp(const OpsFixture &f, BankOp op, unsigned threads, size_t ops)
+{
+    std::atomic<unsigned> ready{0};
+    std::atomic<bool> go{false};
+    std::atomic<size_t> sink{0};
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < threads; ++t)
+    {
+        workers.emplace_back([&, t]() {
+            uint64_t rnd = 0x9E3779B97F4A7C15ull * (t + 1);
+            size_t local = 0;
+            ++ready;
+            while (!go.load(std::memory_order_acquire))
+            {
+            }
+            for (size_t i = 0; i < ops; ++i)
+            {
+                const int a = static_cast<int>(nextRandom(rnd) % f.n);
+                switch (op)
+                {
+                case BankOp::Transfer:
+                {
+                    int b = static_cast<int>(nextRandom(rnd) % f.n);
+                    if (b == a)
+                        b = static_cast<int>((b + 1) % f.n);
+                    f.bank.transferFunds(a, b, 1);
+                    break;
+                }
+                case BankOp::FindDense:
+                    local += f.dense.find(a);
+                    break;
+                case BankOp::FindSparse:
+                    local += f.sparse.find(a * 13 + 7);
+                    break;
+                case BankOp::Get:
+                    local += static_cast<size_t>(f.bank.getAccount(static_cast<size_t>(a)).balance);
+                    break;
+                case BankOp::SetLimits:
+                    f.bank.setLimits(static_cast<size_t>(a), 0, 2000000000);
+                    break;
+                }
+            }
+            sink += local;
+        });
+    }
+    while (ready.load() < threads)
+    {
+    }
+    Clock::time_point start = Clock::now();
+    go.store(true, std::memory_order_release);
+    for (auto &w : workers)
+        w.join();
+    double secs = std::chrono::duration<double>(Clock::now() - start).count();
+    if (sink.load() == 1)
+        std::printf(" "); // не даём компилятору выбросить поиск
+    return static_cast<double>(ops) * threads / secs;
+}
+
+static int runOpsSuite()
+{
+    const size_t sizes[] = {1000, 100000, 10000000};
+    const unsigned counts[] = {1, 2, 4, 8};
+    const size_t ops = 200000;
+    struct
+    {
+        const char *name;
+        BankOp op;
+    } cases[] = {
+        {"transfer", BankOp::Transfer},     {"find_dense", BankOp::FindDense},
+        {"find_sparse", BankOp::FindSparse}, {"get_account", BankOp::Get},
+        {"set_limits", BankOp::SetLimits},
+    };
+
+    for (size_t n : sizes)
+    {
+        std::vector<Account> accounts(n);
+        fillAccounts(accounts, false);
+        Bank bank(accounts.data(), n);
+        AccountIndex dense;
+        dense.build(AccountStore(accounts.data()), n);
+        std::vector<Account> sparse_accounts(n);
+        fillAccounts(sparse_accounts, true);
+        AccountIndex sparse;
+        sparse.build(AccountStore(sparse_accounts.data()), n);
+        OpsFixture fixture = {bank, dense, sparse, n};
+
+        const double accounts_param = static_cast<double>(n);
+        for (const auto &c : cases)
+        {
+            for (unsigned threads : counts)
+            {
+                report("ops", c.name, {{"accounts", accounts_param}, {"threads", double(threads)}},
+                       benchBankOp(fixture, c.op, threads, ops), "ops/s");
+            }
+        }
+
+        // massUpdate берёт все полосы сразу — нити ему не помогают
+        const int rounds = n >= 10000000 ? 4 : 20;
+        Clock::time_point start = Clock::now();
+        for (int r = 0; r < rounds; ++r)
+            bank.massUpdate(r % 2 ? -1 : 1);
+        double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        report("ops", "mass_update", {{"accounts", accounts_param}, {"threads", 1}}, ms / rounds,
+               "ms/op");
+    }
+    return 0;
+}
+
+// ---------------------------------------------------------------------
+// Отказы переводов: исключения против кодов
+// ---------------------------------------------------------------------
+
+static double benchRejects(bool use_try, unsigned reject_percent)
+{
+    const size_t n = 1000;
+    const size_t ops = 1000000;
+    std::vector<Account> accounts(n);
+    fillAccounts(accounts, false);
+    // Нечётные счета пусты: перевод с них отказывает InsufficientFunds
+    for (size_t i = 1; i < n; i += 2)
+        accounts[i].balance = 0;
+    Bank bank(accounts.data(), n);
+
+    std::mt19937 rng(7);
+    std::uniform_int_distribution<int> pick(0, static_cast<int>(n / 2 - 1));
+    std::uniform_int_distribution<unsigned> percent(0, 99);
+    std::vector<int> from(ops), to(ops);
+    for (size_t i = 0; i < ops; ++i)
+    {
+        bool reject = percent(rng) < reject_percent;
+        from[i] = 2 * pick(rng) + (reject ? 1 : 0);
+        to[i] = 2 * pick(rng);
+    }
+
+    size_t failed = 0;
+    Clock::time_point start = Clock::now();
+    for (size_t i = 0; i < ops; ++i)
+    {
+        if (use_try)
+        {
+            failed += bank.tryTransfer(from[i], to[i], 1) != BankStatus::Ok;
+            continue;
+        }
+        try
+        {
+            bank.transferFunds(from[i], to[i], 1);
+        }
+        catch (const BankError &)
+        {
+            ++failed;
+        }
+    }
+    double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / ops;
+    if (failed > ops)
+        std::printf(" ");
+    return ns;
+}
+
+static int runRejectsSuite()
+{
+    std::printf("%-20s %12s %14s\n", "benchmark", "rejected_%", "ns/transfer");
+    const unsigned mixes[] = {100, 20};
+    for (unsigned pct : mixes)
+    {
+        std::printf("%-20s %12u %14.1f\n", "reject_throw", pct, benchRejects(false, pct));
+        std::printf("%-20s %12u %14.1f\n", "reject_try", pct, benchRejects(true, pct));
+    }
+    return 0;
+}
+
+// ---------------------------------------------------------------------
+// massUpdate: прежний цикл против двухпроходных ядер
+// ---------------------------------------------------------------------
+
+// Прежняя реализация: проверка и запись в одном проходе
+static void legacyMassUpdate(Account *accounts, size_t count, int32_t amount)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        int32_t new_bal = accounts[i].balance + amount;
+        if (new_bal < accounts[i].min_balance || new_bal > accounts[i].max_balance)
+            throw std::runtime_error("massUpdate: balance would violate limits");
+        accounts[i].balance = new_bal;
+    }
+}
+
+static int runMassUpdateSuite()
+{
+    const size_t sizes[] = {1000000, 10000000, 30000000};
+    const int rounds = 10;
+    const unsigned hw = std::max(1u, std::thread::hardware_concurrency());
+
+    std::printf("%-20s %12s %14s\n", "benchmark", "accounts", "ms/update");
+    for (size_t n : sizes)
+    {
+        std::vector<Account> accounts(n);
+        fillAccounts(accounts, false);
+
+        // Чередуем знак, чтобы балансы не уходили к лимитам
+        auto measure = [&](const char *name, std::function<void(int32_t)> fn) {
+            Clock::time_point start = Clock::now();
+            for (int r = 0; r < rounds; ++r)
+                fn(r % 2 ? -1 : 1);
+            double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+            std::printf("%-20s %12zu %14.2f\n", name, n, ms / rounds);
+        };
+        Account *a = accounts.data();
+        measure("legacy_loop", [&](int32_t d) { legacyMassUpdate(a, n, d); });
+        measure("two_pass_scalar", [&](int32_t d) {
+            if (massUpdateCheckScalar(a, n, d) == n)
+                massUpdateApplyScalar(a, n, d);
+        });
+        if (massUpdateHasAvx2())
+        {
+            measure("two_pass_avx2", [&](int32_t d) {
+                if (massUpdateCheckAvx2(a, n, d) == n)
+                    massUpdateApplyAvx2(a, n, d);
+            });
+        }
+        measure("two_pass_parallel", [&](int32_t d) {
+            if (massUpdateCheck(AccountStore(a), n, d, hw) == n)
+                massUpdateApply(AccountStore(a), n, d, hw);
+        });
+    }
+    return 0;
+}
+
+// ---------------------------------------------------------------------
+// Раскладка счетов: записи против колонок
+// ---------------------------------------------------------------------
+
+static double scanMs(Clock::time_point start, int rounds)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count() / rounds;
+}
+
+static void benchLayout(AccountLayout layout, size_t n)
+{
+    const char *tag = layout == AccountLayout::Rows ? "rows" : "columns";
+    const int rounds = 10;
+    std::vector<Account> rows(layout == AccountLayout::Rows ? n : 0);
+    ColumnBuffer columns(layout == AccountLayout::Columns ? n : 0);
+    AccountStore store = layout == AccountLayout::Rows ? AccountStore(rows.data()) : columns.store();
+    for (size_t i = 0; i < n; ++i)
+    {
+        Account a = {static_cast<int>(i), static_cast<int32_t>(i % 1000), 0, 2000000000, i % 97 == 0};
+        store.store(i, a);
+    }
+    Bank bank(store, n);
+    char name[32];
+
+    // Полезный объём прохода — балансы и лимиты (12 байт на счёт)
+    Clock::time_point start = Clock::now();
+    for (int r = 0; r < rounds; ++r)
+        bank.massUpdate(r % 2 ? -1 : 1);
+    double ms = scanMs(start, rounds);
+    std::snprintf(name, sizeof(name), "mass_update_%s", tag);
+    std::printf("%-24s %12zu %10.2f ms %8.2f GB/s\n", name, n, ms, 12.0 * n / ms / 1e6);
+
+    // Столбцовые проходы читают счета напрямую, как это делал бы запрос-отчёт
+    int64_t total = 0;
+    start = Clock::now();
+    for (int r = 0; r < rounds; ++r)
+    {
+        if (layout == AccountLayout::Rows)
+        {
+            for (size_t i = 0; i < n; ++i)
+                total += rows[i].balance;
+        }
+        else
+        {
+            const int32_t *bal = columns.columns().balances;
+            for (size_t i = 0; i < n; ++i)
+                total += bal[i];
+        }
+    }
+    ms = scanMs(start, rounds);
+    std::snprintf(name, sizeof(name), "total_balance_%s", tag);
+    std::printf("%-24s %12zu %10.2f ms %8.2f GB/s\n", name, n, ms, 4.0 * n / ms / 1e6);
+
+    size_t matched = 0;
+    start = Clock::now();
+    for (int r = 0; r < rounds; ++r)
+    {
+        if (layout == AccountLayout::Rows)
+        {
+            for (size_t i = 0; i < n; ++i)
+                matched += rows[i].balance >= 500 && !rows[i].frozen;
+        }
+        else
+        {
+            const int32_t *bal = columns.columns().balances;
+            const uint64_t *frozen = columns.columns().frozen;
+            for (size_t i = 0; i < n; ++i)
+                matched += bal[i] >= 500 && !((frozen[i / 64] >> (i % 64)) & 1);
+        }
+    }
+    ms = scanMs(start, rounds);
+    std::snprintf(name, sizeof(name), "filter_count_%s", tag);
+    std::printf("%-24s %12zu %10.2f ms %8.2f GB/s\n", name, n, ms, 4.125 * n / ms / 1e6);
+
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<int> pick(0, static_cast<int>(n - 1));
+    const size_t ops = 1000000;
+    start = Clock::now();
+    for (size_t i = 0; i < ops; ++i)
+    {
+        try
+        {
+            bank.transferFunds(pick(rng), pick(rng), 1);
+        }
+        catch (const BankError &)
+        {
+        }
+    }
+    double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / ops;
+    std::snprintf(name, sizeof(name), "transfer_%s", tag);
+    std::printf("%-24s %12zu %10.1f ns/transfer\n", name, n, ns);
+
+    if (total == -1 || matched == size_t(-1))
+        std::printf("\n"); // не даём компилятору выбросить проходы
+}
+
+static int runLayoutSuite()
+{
+    const size_t sizes[] = {1000000, 10000000};
+    std::printf("%-24s %12s %13s\n", "benchmark", "accounts", "time");
+    for (size_t n : sizes)
+    {
+        benchLayout(AccountLayout::Rows, n);
+        benchLayout(AccountLayout::Columns, n);
+    }
+    return 0;
+}
+
+// ---------------------------------------------------------------------
+// Журнал упреждающей записи: fdatasync на операцию против групповой фиксации
+// ---------------------------------------------------------------------
+
+static double benchWal(const std::string &path, const TxnLogOptions &options, unsigned threads)
+{
+    const size_t n = 100000;
+    std::vector<Account> accounts(n);
+    fillAccounts(accounts, false);
+    Bank bank(accounts.data(), n);
+    unlink(path.c_str());
+    TxnLog log;
+    std::string error;
+    if (!log.open(path, bank, options, error))
+        throw std::runtime_error(error);
+
+    // Каждая нить переводит, пока не истечёт секунда; счётчик — подтверждённые переводы
+    std::atomic<bool> stop{false};
+    std::atomic<size_t> done{0};
+    std::vector<std::thread> workers;
+    Clock::time_point start = Clock::now();
+    for (unsigned t = 0; t < threads; ++t)
+    {
+        workers.emplace_back([&, t]() {
+            std::mt19937 rng(t);
+            std::uniform_int_distribution<int> pick(0, static_cast<int>(n - 1));
+            size_t local = 0;
+            while (!stop.load(std::memory_order_relaxed))
+            {
+                bank.transferFunds(pick(rng), pick(rng), 1);
+                ++local;
+            }
+            done += local;
+        });
+    }
+    std::this_thread::sleep_for(std::chrono::seconds(1));
+    stop = true;
+    for (auto &w : workers)
+        w.join();
+    double secs = std::chrono::duration<double>(Clock::now() - start).count();
+    log.close();
+    unlink(path.c_str());
+    return done.load() / secs;
+}
+
+static int runWalSuite(const std::string &dir)
+{
+    const std::string path = dir + "/bank_bench.wal";
+    const unsigned threads[] = {1, 8, 64};
+    struct Mode
+    {
+        const char *name;
+        bool group;
+        unsigned window_us;
+    } modes[] = {{"wal_fsync_per_op", false, 0},
+                 {"wal_group", true, 0},
+                 {"wal_group_100us", true, 100}};
+
+    std::printf("%-20s %12s %14s\n", "benchmark", "threads", "transfers/s");
+    for (const Mode &m : modes)
+    {
+        TxnLogOptions options;
+        options.group_commit = m.group;
+        options.window_us = m.window_us;
+        for (unsigned t : threads)
+            std::printf("%-20s %12u %14.0f\n", m.name, t, benchWal(path, options, t));
+    }
+    return 0;
+}
+
+// ---------------------------------------------------------------------
+// Снимки: запись через fork и копированием, загрузка при рестарте
+// ---------------------------------------------------------------------
+
+static int runSnapshotSuite(const std::string &dir)
+{
+    const size_t n = 10000000;
+    const std::string path = dir + "/bank_bench.snap";
+    std::printf("%-24s %12s %12s %12s\n", "benchmark", "accounts", "pause ms", "total ms");
+    for (AccountLayout layout : {AccountLayout::Rows, AccountLayout::Columns})
+    {
+        const char *tag = layout == AccountLayout::Rows ? "rows" : "columns";
+        std::vector<Account> rows(layout == AccountLayout::Rows ? n : 0);
+        ColumnBuffer columns(layout == AccountLayout::Columns ? n : 0);
+        AccountStore store = layout == AccountLayout::Rows ? AccountStore(rows.data()) : columns.store();
+        for (size_t i = 0; i < n; ++i)
+        {
+            Account a = {static_cast<int>(i), static_cast<int32_t>(i % 1000), 0, 1000000, false};
+            store.store(i, a);
+        }
+        Bank bank(store, n);
+        std::string error;
+        char name[32];
+
+        SnapshotTiming timing;
+        if (!forkSnapshot(bank, path, nullptr, error, &timing))
+            throw std::runtime_error(error);
+        std::snprintf(name, sizeof(name), "snapshot_fork_%s", tag);
+        std::printf("%-24s %12zu %12.1f %12.1f\n", name, n, timing.pause_ms, timing.total_ms);
+
+        if (!dumpSnapshot(bank, path, error, &timing))
+            throw std::runtime_error(error);
+        std::snprintf(name, sizeof(name), "snapshot_mmap_%s", tag);
+        std::printf("%-24s %12zu %12.1f %12.1f\n", name, n, timing.pause_ms, timing.total_ms);
+
+        // Рестарт: заголовок, память под счета и загрузка образа, как в server --restore
+        Clock::time_point start = Clock::now();
+        SnapshotHeader header;
+        if (!readSnapshotHeader(path, header, error))
+            throw std::runtime_error(error);
+        std::vector<Account> restored_rows(layout == AccountLayout::Rows ? n : 0);
+        ColumnBuffer restored_columns(layout == AccountLayout::Columns ? n : 0);
+        AccountStore restored = layout == AccountLayout::Rows ? AccountStore(restored_rows.data())
+                                                              : restored_columns.store();
+        if (!loadSnapshot(path, header, restored, error))
+            throw std::runtime_error(error);
+        Bank reloaded(restored, n);
+        double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        std::snprintf(name, sizeof(name), "restore_%s", tag);
+        std::printf("%-24s %12zu %12s %12.1f\n", name, n, "-", ms);
+        unlink(path.c_str());
+    }
+    return 0;
+}
+
+// ---------------------------------------------------------------------
+// Чтения без блокировок под нагрузкой переводов
+// ---------------------------------------------------------------------
+
+static void benchReads(unsigned readers, unsigned writers, double &reads_per_sec,
+                       double &transfers_per_sec)
+{
+    const size_t n = 100000;
+    std::vector<Account> accounts(n);
+    fillAccounts(accounts, false);
+    Bank bank(accounts.data(), n);
+
+    std::atomic<bool> stop{false};
+    std::atomic<size_t> reads{0}, transfers{0};
+    std::vector<std::thread> threads;
+    for (unsigned t = 0; t < readers + writers; ++t)
+    {
+        const bool writer = t >= readers;
+        threads.emplace_back([&, t, writer]() {
+            std::mt19937 rng(t);
+            std::uniform_int_distribution<int> pick(0, static_cast<int>(n - 1));
+            size_t local = 0;
+            int64_t sink = 0;
+            while (!stop.load(std::memory_order_relaxed))
+            {
+                if (writer)
+                    bank.transferFunds(pick(rng), pick(rng), 1);
+                else
+                    sink += bank.getAccount(static_cast<size_t>(pick(rng))).balance;
+                ++local;
+            }
+            (writer ? transfers : reads) += local + (sink == 42);
+        });
+    }
+    Clock::time_point start = Clock::now();
+    std::this_thread::sleep_for(std::chrono::seconds(1));
+    stop = true;
+    for (auto &t : threads)
+        t.join();
+    double secs = std::chrono::duration<double>(Clock::now() - start).count();
+    reads_per_sec = reads.load() / secs;
+    transfers_per_sec = transfers.load() / secs;
+}
+
+static int runReadsSuite()
+{
+    const unsigned readers[] = {1, 4, 8};
+    const unsigned writers[] = {0, 2};
+
+    std::printf("%-20s %8s %8s %14s %14s\n", "benchmark", "readers", "writers", "reads/s",
+                "transfers/s");
+    double r = 0, w = 0;
+    benchReads(0, 2, r, w);
+    std::printf("%-20s %8u %8u %14s %14.0f\n", "transfers_only", 0u, 2u, "-", w);
+    for (unsigned wr : writers)
+    {
+        for (unsigned rd : readers)
+        {
+            benchReads(rd, wr, r, w);
+            std::printf("%-20s %8u %8u %14.0f %14.0f\n", wr ? "reads_under_load" : "reads_idle",
+                        rd, wr, r, w);
+        }
+    }
+    return 0;
+}
+
+// ---------------------------------------------------------------------
+// Аудит на согласованном срезе против аудита под всеми полосами
+// ---------------------------------------------------------------------
+
+static double percentile(std::vector<double> &v, double p);
+
+enum class AuditMode
+{
+    None,
+    ReadView,
+    LockAll
+};
+
+static void benchAudit(AuditMode mode, double &p50, double &p99, double &max, double &audit_ms)
+{
+    const size_t n = 1000000;
+    std::vector<Account> accounts(n);
+    fillAccounts(accounts, false);
+    Bank bank(accounts.data(), n);
+
+    std::atomic<bool> stop{false};
+    std::atomic<size_t> audits{0};
+    std::thread auditor([&]() {
+        while (mode != AuditMode::None && !stop.load(std::memory_order_relaxed))
+        {
+            int64_t total = 0;
+            if (mode == AuditMode::ReadView)
+            {
+                Bank::ReadView view(bank);
+                total = view.totalBalance();
+            }
+            else
+            {
+                bank.lockAllStripes();
+                for (size_t i = 0; i < n; ++i)
+                    total += bank.store().balance(i);
+                bank.unlockAllStripes();
+            }
+            if (total != static_cast<int64_t>(n) * 1000000)
+                throw std::logic_error("audit: inconsistent total");
+            ++audits;
+        }
+    });
+
+    std::mt19937 rng(1);
+    std::uniform_int_distribution<int> pick(0, static_cast<int>(n - 1));
+    std::vector<double> lat;
+    Clock::time_point start = Clock::now();
+    while (Clock::now() - start < std::chrono::seconds(1))
+    {
+        int from = pick(rng), to = pick(rng);
+        Clock::time_point t0 = Clock::now();
+        bank.transferFunds(from, to, 1);
+        lat.push_back(std::chrono::duration<double, std::micro>(Clock::now() - t0).count());
+    }
+    stop = true;
+    auditor.join();
+    double secs = std::chrono::duration<double>(Clock::now() - start).count();
+    p50 = percentile(lat, 0.50);
+    p99 = percentile(lat, 0.99);
+    max = *std::max_element(lat.begin(), lat.end());
+    audit_ms = audits.load() ? secs * 1000 / audits.load() : 0;
+}
+
+static int runAuditSuite()
+{
+    struct
+    {
+        const char *name;
+        AuditMode mode;
+    } modes[] = {{"no_audit", AuditMode::None},
+                 {"audit_read_view", AuditMode::ReadView},
+                 {"audit_lock_all", AuditMode::LockAll}};
+
+    std::printf("%-20s %10s %10s %10s %10s\n", "benchmark", "p50_us", "p99_us", "max_us",
+                "audit_ms");
+    for (const auto &m : modes)
+    {
+        double p50 = 0, p99 = 0, max = 0, audit_ms = 0;
+        benchAudit(m.mode, p50, p99, max, audit_ms);
+        std::printf("%-20s %10.2f %10.2f %10.0f %10.1f\n", m.name, p50, p99, max, audit_ms);
+    }
+    return 0;
+}
+
+// ---------------------------------------------------------------------
+// Стоимость разбора и форматирования: текст против бинарного протокола
+// ---------------------------------------------------------------------
+
+static int runProtocolSuite()
+{
+    const size_t n = 100000;
+    const size_t accounts_n = 1000;
+    std::vector<Account> accounts(accounts_n);
+    fillAccounts(accounts, false);
+    Bank bank(accounts.data(), accounts_n);
+
+    std::string text;
+    std::string binary(1, static_cast<char>(BIN_HANDSHAKE));
+    char frame[BIN_REQUEST_SIZE];
+    for (size_t i = 0; i < n; ++i)
+    {
+        int a = static_cast<int>(i % accounts_n);
+        int b = static_cast<int>((i * 7 + 1) % accounts_n);
+        if (i % 2 == 0)
+        {
+            text += "transfer " + std::to_string(a) + " " + std::to_string(b) + " 1\n";
+            BinRequest req = {BinOp::Transfer, static_cast<uint32_t>(i), a, b, 1};
+            binEncodeRequest(req, frame);
+        }
+        else
+        {
+            text += "show_balance " + std::to_string(a) + "\n";
+            BinRequest req = {BinOp::Query, static_cast<uint32_t>(i), a, 0, 0};
+            binEncodeRequest(req, frame);
+        }
+        binary.append(frame, sizeof(frame));
+    }
+
+    auto run = [&bank](const std::string &wire) {
+        Session session(bank);
+        const size_t chunk = 16 * 1024;
+        Clock::time_point start = Clock::now();
+        for (size_t off = 0; off < wire.size(); off += chunk)
+        {
+            session.feed(wire.data() + off, std::min(chunk, wire.size() - off));
+            session.consume(session.outSize());
+        }
+        return std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+    };
+
+    std::printf("%-20s %12zu %14.1f ns/req\n", "protocol_text", n, run(text) / n);
+    std::printf("%-20s %12zu %14.1f ns/req\n", "protocol_binary", n, run(binary) / n);
+    return 0;
+}
+
+// ---------------------------------------------------------------------
+// Разбор и диспетчеризация команд
+// ---------------------------------------------------------------------
+
+// Прежний разбор: копия строки, istringstream и сравнения по очереди
+static int legacyParse(const std::string &raw, int32_t args[3])
+{
+    std::string line(raw);
+    std::istringstream iss(line);
+    std::string cmd;
+    iss >> cmd;
+    static const char *const names[] = {"help", "transfer", "transfer_batch", "freeze", "unfreeze",
+                                        "mass_update", "set_limits", "show_account_list",
+                                        "total_balance", "show_balance", "show_min", "show_max"};
+    static const int arity[] = {0, 3, 0, 1, 1, 1, 3, 0, 0, 1, 1, 1};
+    for (int i = 0; i < 12; ++i)
+    {
+        if (cmd == names[i])
+        {
+            for (int k = 0; k < arity[i]; ++k)
+                if (!(iss >> args[k]))
+                    return -1;
+            return i;
+        }
+    }
+    return -1;
+}
+
+static int tokenizerParse(const std::string &line, int32_t args[3])
+{
+    Tokenizer words(line.data(), line.data() + line.size());
+    Token name;
+    words.next(name);
+    CommandId id = lookupCommand(name);
+    int arity = 0;
+    switch (id)
+    {
+    case CommandId::Transfer:
+    case CommandId::SetLimits:
+        arity = 3;
+        break;
+    case CommandId::Freeze:
+    case CommandId::Unfreeze:
+    case CommandId::MassUpdate:
+    case CommandId::ShowBalance:
+    case CommandId::ShowMin:
+    case CommandId::ShowMax:
+        arity = 1;
+        break;
+    default:
+        break;
+    }
+    for (int k = 0; k < arity; ++k)
+        if (!words.nextInt(args[k]))
+            return -1;
+    return static_cast<int>(id);
+}
+
+static int runParseSuite()
+{
+    const std::vector<std::string> lines = {
+        "transfer 17 4242 100", "show_balance 731",   "show_min 12",     "show_max 9000",
+        "freeze 55",            "set_limits 3 -10 5000", "mass_update -1", "unfreeze 55",
+        "total_balance",        "bogus_command 1",
+    };
+    const size_t rounds = 200000;
+    const size_t ops = rounds * lines.size();
+
+    auto run = [&](int (*parse)(const std::string &, int32_t[3])) {
+        int64_t sum = 0;
+        int32_t args[3] = {0, 0, 0};
+        Clock::time_point start = Clock::now();
+        for (size_t r = 0; r < rounds; ++r)
+            for (const std::string &line : lines)
+                sum += parse(line, args) + args[0];
+        double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+        if (sum == 42)
+            std::printf(" ");
+        return ns / ops;
+    };
+
+    std::printf("%-20s %12zu %14.1f ns/op\n", "parse_istringstream", ops, run(legacyParse));
+    std::printf("%-20s %12zu %14.1f ns/op\n", "parse_tokenizer", ops, run(tokenizerParse));
+    return 0;
+}
+
+// ---------------------------------------------------------------------
+// Потоковый листинг счетов
+// ---------------------------------------------------------------------
+
+static int runListingSuite()
+{
+    const size_t n = 1000000;
+    std::vector<Account> accounts(n);
+    fillAccounts(accounts, false);
+    Bank bank(accounts.data(), n);
+
+    int sv[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) != 0)
+    {
+        std::perror("socketpair");
+        return 1;
+    }
+    std::atomic<size_t> received{0};
+    std::thread reader([&]() {
+        char buf[64 * 1024];
+        ssize_t r;
+        while ((r = read(sv[1], buf, sizeof(buf))) > 0)
+            received += static_cast<size_t>(r);
+    });
+
+    Session session(bank);
+    size_t sends = 0, peak = 0;
+    Clock::time_point start = Clock::now();
+    session.feed("show_account_list\n", 18);
+    while (session.outSize() > 0)
+    {
+        peak = std::max(peak, session.outSize());
+        ssize_t w = send(sv[0], session.outData(), session.outSize(), MSG_NOSIGNAL);
+        if (w <= 0)
+            break;
+        session.consume(static_cast<size_t>(w));
+        ++sends;
+    }
+    shutdown(sv[0], SHUT_WR);
+    reader.join();
+    double stream_ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    close(sv[0]);
+    close(sv[1]);
+
+    start = Clock::now();
+    std::string whole;
+    for (size_t i = 0; i < n; ++i)
+    {
+        const Account a = bank.getAccount(i);
+        std::ostringstream oss;
+        oss << std::setw(3) << a.account_id << " | " << std::setw(11) << a.balance << " | "
+            << std::setw(9) << a.min_balance << " | " << std::setw(9) << a.max_balance << " | "
+            << (a.frozen ? "true" : "false") << '\n';
+        whole += oss.str();
+    }
+    double ostream_ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+    std::printf("%-20s %10s %10s %10s %12s\n", "benchmark", "ms", "MB", "sends", "peak_buf_KB");
+    std::printf("%-20s %10.1f %10.1f %10zu %12zu\n", "listing_stream", stream_ms,
+                received.load() / 1e6, sends, peak / 1024);
+    std::printf("%-20s %10.1f %10.1f %10s %12zu\n", "listing_ostream", ostream_ms,
+                whole.size() / 1e6, "-", whole.capacity() / 1024);
+    return 0;
+}
+
+// ---------------------------------------------------------------------
+// Шардированный банк: масштабирование по числу шардов
+// ---------------------------------------------------------------------
+
+// Переводов в секунду; cross_pct — доля пар из разных шардов (для Bank — 0)
+template <class B, class ShardOf>
+static double benchShardTransfers(B &bank, size_t n, bool local, ShardOf shard_of, size_t shards,
+                                  double &cross_pct)
+{
+    const unsigned threads = 8;
+    const double seconds = 1.0;
+    std::atomic<bool> stop{false};
+    std::atomic<size_t> total{0}, cross{0};
+    std::vector<std::thread> clients;
+    for (unsigned t = 0; t < threads; ++t)
+    {
+        clients.emplace_back([&, t]() {
+            std::mt19937 rng(t * 7919u + 1u);
+            std::uniform_int_distribution<int> pick(0, static_cast<int>(n) - 1);
+            size_t ops = 0, remote = 0;
+            while (!stop.load(std::memory_order_relaxed))
+            {
+                int from = pick(rng), to = pick(rng);
+                // Локальная нагрузка: получатель из шарда отправителя
+                if (local)
+                    to -= static_cast<int>((shard_of(to) + shards - shard_of(from)) % shards);
+                if (to < 0)
+                    to += static_cast<int>(shards);
+                remote += shard_of(from) != shard_of(to);
+                bank.tryTransfer(from, to, 1);
+                ++ops;
+            }
+            total += ops;
+            cross += remote;
+        });
+    }
+    std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+    stop = true;
+    for (auto &c : clients)
+        c.join();
+    cross_pct = total ? 100.0 * cross / total : 0;
+    return total / seconds;
+}
+
+static int runShardsSuite()
+{
+    const size_t n = 1000000;
+    std::vector<Account> accounts(n);
+    fillAccounts(accounts, false);
+
+    std::printf("%-20s %8s %10s %14s\n", "benchmark", "shards", "cross_%", "transfers/s");
+    {
+        std::vector<Account> copy = accounts;
+        Bank bank(copy.data(), n);
+        double pct;
+        double rate = benchShardTransfers(bank, n, false, [](int) { return size_t(0); }, 1, pct);
+        std::printf("%-20s %8s %10.1f %14.0f\n", "bank_striped", "-", pct, rate);
+    }
+    const size_t counts[] = {1, 2, 4, 8};
+    for (size_t k : counts)
+    {
+        ShardedBank bank(accounts.data(), n, k);
+        auto shard_of = [&bank](int id) { return bank.shardOf(id); };
+        for (bool local : {false, true})
+        {
+            double pct;
+            double rate = benchShardTransfers(bank, n, local, shard_of, k, pct);
+            std::printf("%-20s %8zu %10.1f %14.0f\n", local ? "sharded_local" : "sharded_random", k,
+                        pct, rate);
+        }
+    }
+    return 0;
+}
+
+// ---------------------------------------------------------------------
+// Единственный писатель против полос под высокой конкуренцией
+// ---------------------------------------------------------------------
+
+// Переводов в секунду от threads нитей за 0.5 с; hot — все на счёт 0
+template <class B>
+static double benchWriters(B &bank, size_t n, unsigned threads, bool hot)
+{
+    const double seconds = 0.5;
+    std::atomic<bool> stop{false};
+    std::atomic<size_t> total{0};
+    std::vector<std::thread> clients;
+    for (unsigned t = 0; t < threads; ++t)
+    {
+        clients.emplace_back([&, t]() {
+            std::mt19937 rng(t * 7919u + 1u);
+            std::uniform_int_distribution<int> pick(1, static_cast<int>(n) - 1);
+            size_t ops = 0;
+            while (!stop.load(std::memory_order_relaxed))
+            {
+                bank.tryTransfer(pick(rng), hot ? 0 : pick(rng), 1);
+                ++ops;
+            }
+            total += ops;
+        });
+    }
+    std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+    stop = true;
+    for (auto &c : clients)
+        c.join();
+    return total / seconds;
+}
+
+static int runLedgerSuite(const std::string &dir)
+{
+    const size_t n = 100000;
+    std::vector<Account> accounts(n);
+    fillAccounts(accounts, false);
+    Bank bank(accounts.data(), n);
+
+    std::printf("%-20s %8s %14s\n", "benchmark", "threads", "transfers/s");
+    const unsigned counts[] = {1, 2, 4, 8, 16};
+    for (bool hot : {true, false})
+    {
+        for (unsigned threads : counts)
+        {
+            std::printf("%-20s %8u %14.0f\n", hot ? "locked_hot" : "locked_random", threads,
+                        benchWriters(bank, n, threads, hot));
+            Ledger ledger(bank, 4096, 0);
+            std::printf("%-20s %8u %14.0f\n", hot ? "ledger_hot" : "ledger_random", threads,
+                        benchWriters(ledger, n, threads, hot));
+        }
+    }
+
+    // С журналом: под полосами запись ждёт каждая нить, у ledger — нити соединений
+    const std::string path = dir + "/bank_bench_ledger.wal";
+    const unsigned wal_counts[] = {1, 8, 64};
+    for (unsigned threads : wal_counts)
+    {
+        for (bool use_ledger : {false, true})
+        {
+            unlink(path.c_str());
+            TxnLog log;
+            std::string error;
+            if (!log.open(path, bank, TxnLogOptions(), error))
+                throw std::runtime_error(error);
+            double rate;
+            if (use_ledger)
+            {
+                Ledger ledger(bank, 4096, 0);
+                rate = benchWriters(ledger, n, threads, true);
+            }
+            else
+            {
+                rate = benchWriters(bank, n, threads, true);
+            }
+            log.close();
+            std::printf("%-20s %8u %14.0f\n", use_ledger ? "ledger_hot_wal" : "locked_hot_wal",
+                        threads, rate);
+        }
+    }
+    unlink(path.c_str());
+    return 0;
+}
+
+// ---------------------------------------------------------------------
+// Процессы над одним сегментом общей памяти
+// ---------------------------------------------------------------------
+
+// Переводов в секунду от procs процессов, каждый подключается к сегменту name сам
+static double benchShmProcesses(const std::string &name, unsigned procs, size_t ops, bool hot)
+{
+    // Дети стартуют разом: ждут, пока родитель закроет запись в канал
+    int gate[2];
+    if (pipe(gate) != 0)
+        return 0.0;
+    std::vector<pid_t> children;
+    for (unsigned p = 0; p < procs; ++p)
+    {
+        pid_t pid = fork();
+        if (pid == 0)
+        {
+            close(gate[1]);
+            SegmentView view;
+            std::string error;
+            if (!attachShmSegment(name, view, error))
+                _exit(2);
+            int rc = 0;
+            {
+                Bank bank(view.accounts, view.accountCount(), view.locks, &view.header->account_count);
+                const size_t n = bank.getAccountCount();
+                uint64_t rnd = 0x9E3779B97F4A7C15ull * (p + 1);
+                char c;
+                if (read(gate[0], &c, 1) < 0)
+                    rc = 3;
+                for (size_t i = 0; i < ops && rc == 0; ++i)
+                {
+                    int from = static_cast<int>(nextRandom(rnd) % n);
+                    int to = hot ? 0 : static_cast<int>(nextRandom(rnd) % n);
+                    bank.tryTransfer(from, to == from ? (from + 1) % static_cast<int>(n) : to, 1);
+                }
+            }
+            detachSegment(view);
+            _exit(rc);
+        }
+        if (pid > 0)
+            children.push_back(pid);
+    }
+    close(gate[0]);
+    Clock::time_point start = Clock::now();
+    close(gate[1]);
+    bool ok = children.size() == procs;
+    for (pid_t pid : children)
+    {
+        int status = 0;
+        waitpid(pid, &status, 0);
+        ok = ok && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    }
+    double secs = std::chrono::duration<double>(Clock::now() - start).count();
+    return ok ? static_cast<double>(ops) * procs / secs : 0.0;
+}
+
+static int runShmSuite()
+{
+    const size_t n = 100000;
+    const size_t ops = 200000;
+    const int64_t initial = 1000000;
+    const std::string name = "/tbank_bench_" + std::to_string(getpid());
+
+    SegmentView seg;
+    std::string error;
+    if (!createShmSegment(name, n, n, 2000000000, seg, error))
+    {
+        std::fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+    for (size_t i = 0; i < n; ++i)
+    {
+        Account a;
+        a.account_id = static_cast<int>(i);
+        a.balance = static_cast<int32_t>(initial);
+        a.min_balance = 0;
+        a.max_balance = 2000000000;
+        a.frozen = false;
+        seg.accounts.store(i, a);
+    }
+
+    const unsigned counts[] = {1, 2, 4, 8};
+    int rc = 0;
+    for (bool hot : {false, true})
+    {
+        for (unsigned procs : counts)
+        {
+            double rate = benchShmProcesses(name, procs, ops, hot);
+            if (rate == 0.0)
+                rc = 1;
+            report("shm", hot ? "shm_hot" : "shm_random", {{"accounts", double(n)}, {"processes", double(procs)}},
+                   rate, "transfers/s");
+        }
+    }
+
+    // Переводы не создают и не теряют денег — иначе синхронизация между процессами сломана
+    {
+        Bank bank(seg.accounts, n, seg.locks, &seg.header->account_count);
+        Bank::ReadView view(bank);
+        if (view.totalBalance() != initial * static_cast<int64_t>(n))
+        {
+            std::fprintf(stderr, "shm: total balance mismatch\n");
+            rc = 1;
+        }
+    }
+    detachSegment(seg);
+    shm_unlink(name.c_str());
+    return rc;
+}
+
+// ---------------------------------------------------------------------
+// Учёт запросов: общий мьютекс и условная переменная против слотов нитей
+// ---------------------------------------------------------------------
+
+// Как было в ServerCore: счётчик под мьютексом и сигнал нити статистики
+static pthread_mutex_t legacy_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t legacy_cond = PTHREAD_COND_INITIALIZER;
+static size_t legacy_count = 0;
+static bool legacy_stop = false;
+
+static void legacyCount()
+{
+    pthread_mutex_lock(&legacy_mutex);
+    ++legacy_count;
+    pthread_cond_signal(&legacy_cond);
+    pthread_mutex_unlock(&legacy_mutex);
+}
+
+// Нс на один учтённый запрос, когда threads нитей учитывают по ops запросов
+template <class F>
+static double benchCounting(unsigned threads, size_t ops, F record)
+{
+    std::vector<std::thread> workers;
+    Clock::time_point start = Clock::now();
+    for (unsigned t = 0; t < threads; ++t)
+    {
+        workers.emplace_back([&, t]() {
+            for (size_t i = 0; i < ops; ++i)
+                record(t, i);
+        });
+    }
+    for (auto &w : workers)
+        w.join();
+    double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+    return ns / (static_cast<double>(ops) * threads);
+}
+
+static int runStatsSuite()
+{
+    const size_t ops = 1000000;
+    std::printf("%-20s %8s %14s\n", "benchmark", "threads", "ns/request");
+    const unsigned counts[] = {1, 2, 4, 8};
+    for (unsigned threads : counts)
+    {
+        legacy_stop = false;
+        std::thread waiter([]() {
+            pthread_mutex_lock(&legacy_mutex);
+            while (!legacy_stop)
+                pthread_cond_wait(&legacy_cond, &legacy_mutex);
+            pthread_mutex_unlock(&legacy_mutex);
+        });
+        double legacy = benchCounting(threads, ops, [](unsigned, size_t) { legacyCount(); });
+        pthread_mutex_lock(&legacy_mutex);
+        legacy_stop = true;
+        pthread_cond_signal(&legacy_cond);
+        pthread_mutex_unlock(&legacy_mutex);
+        waiter.join();
+        std::printf("%-20s %8u %14.1f\n", "mutex_cond", threads, legacy);
+
+        double lockfree = benchCounting(threads, ops, [](unsigned t, size_t i) {
+            statsRecord(static_cast<unsigned>(CommandId::Transfer),
+                        (i & 15) ? STATS_OK : static_cast<unsigned>(BankStatus::InsufficientFunds),
+                        200 + ((i * 2654435761u + t) & 4095));
+        });
+        std::printf("%-20s %8u %14.1f\n", "per_thread", threads, lockfree);
+    }
+    for (bool on : {false, true})
+    {
+        if (on)
+            traceEnable();
+        double span = benchCounting(1, ops, [](unsigned, size_t) { TraceSpan s(TracePhase::Apply); });
+        std::printf("%-20s %8u %14.1f\n", on ? "trace_span_on" : "trace_span_off", 1u, span);
+    }
+    trace_enabled.store(false);
+
+    StatsSummary s;
+    statsCollect(s);
+    std::printf("recorded %llu, p50 %llu ns, p99 %llu ns\n", static_cast<unsigned long long>(s.total()),
+                static_cast<unsigned long long>(s.percentile(0.5)),
+                static_cast<unsigned long long>(s.percentile(0.99)));
+    return 0;
+}
+
+// ---------------------------------------------------------------------
+// Нагрузка на TCP-сервер
+// ---------------------------------------------------------------------
+
+struct ServerTarget
+{
+    std::string host = "127.0.0.1";
+    int port = 12345;
+};
+
+static int connectTo(const ServerTarget &target)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0)
+        return -1;
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(static_cast<uint16_t>(target.port));
+    inet_pton(AF_INET, target.host.c_str(), &addr.sin_addr);
+    if (connect(fd, (sockaddr *)&addr, sizeof(addr)) < 0)
+    {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Читает, пока в buf не появится needle с последующим '\n'; съедает прочитанное
+static bool readUntil(int fd, std::string &buf, const char *needle)
+{
+    char chunk[4096];
+    while (true)
+    {
+        size_t pos = buf.find(needle);
+        if (pos != std::string::npos)
+        {
+            size_t nl = buf.find('\n', pos);
+            if (nl != std::string::npos)
+            {
+                buf.erase(0, nl + 1);
+                return true;
+            }
+        }
+        ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+        if (n <= 0)
+            return false;
+        buf.append(chunk, static_cast<size_t>(n));
+    }
+}
+
+// Последняя строка приветствия: после неё в сокете только ответы
+static std::string welcomeTail()
+{
+    std::string w;
+    appendWelcome(w);
+    w.pop_back();
+    return w.substr(w.rfind('\n') + 1);
+}
+
+static const std::string WELCOME_TAIL = welcomeTail();
+
+static double percentile(std::vector<double> &v, double p)
+{
+    if (v.empty())
+        return 0.0;
+    size_t k = static_cast<size_t>(p * (v.size() - 1));
+    std::nth_element(v.begin(), v.begin() + k, v.end());
+    return v[k];
+}
+
+static int runServerSuite(const ServerTarget &target, unsigned connections, unsigned requests)
+{
+    // 1. Скорость установления соединений
+    {
+        const unsigned per_thread = 200;
+        std::atomic<unsigned> ok{0};
+        std::vector<std::thread> threads;
+        Clock::time_point start = Clock::now();
+        for (unsigned t = 0; t < connections; ++t)
+        {
+            threads.emplace_back([&]() {
+                for (unsigned i = 0; i < per_thread; ++i)
+                {
+                    int fd = connectTo(target);
+                    if (fd < 0)
+                        continue;
+                    std::string buf;
+                    if (readUntil(fd, buf, WELCOME_TAIL.c_str()))
+                        ++ok;
+                    close(fd);
+                }
+            });
+        }
+        for (auto &t : threads)
+            t.join();
+        double secs = std::chrono::duration<double>(Clock::now() - start).count();
+        std::printf("%-20s %12u %14.0f conn/s\n", "server_connect", connections, ok.load() / secs);
+    }
+
+    // 2. Задержка запрос-ответ при параллельных соединениях
+    {
+        std::vector<std::vector<double>> lat(connections);
+        std::vector<std::thread> threads;
+        Clock::time_point start = Clock::now();
+        for (unsigned t = 0; t < connections; ++t)
+        {
+            threads.emplace_back([&, t]() {
+                int fd = connectTo(target);
+                if (fd < 0)
+                    return;
+                std::string buf;
+                if (!readUntil(fd, buf, WELCOME_TAIL.c_str()))
+                {
+                    close(fd);
+                    return;
+                }
+                std::string req = "show_balance " + std::to_string(t % 100) + "\n";
+                lat[t].reserve(requests);
+                for (unsigned i = 0; i < requests; ++i)
+                {
+                    Clock::time_point s0 = Clock::now();
+                    if (send(fd, req.data(), req.size(), 0) < 0 ||
+                        !readUntil(fd, buf, "balance:"))
+                        break;
+                    lat[t].push_back(std::chrono::duration<double, std::micro>(Clock::now() - s0).count());
+                }
+                close(fd);
+            });
+        }
+        for (auto &t : threads)
+            t.join();
+        double secs = std::chrono::duration<double>(Clock::now() - start).count();
+
+        std::vector<double> all;
+        for (auto &v : lat)
+            all.insert(all.end(), v.begin(), v.end());
+        double total = static_cast<double>(all.size());
+        double p50 = percentile(all, 0.50);
+        double p99 = percentile(all, 0.99);
+        std::printf("%-20s %12u %14.0f req/s  p50 %.1f us  p99 %.1f us\n",
+                    "server_request", connections, total / secs, p50, p99);
+    }
+    return 0;
+}
+
+// ---------------------------------------------------------------------
+// Генератор нагрузки: замкнутый и открытый цикл, перекос ключей, смесь
+// ---------------------------------------------------------------------
+
+struct LoadOptions
+{
+    ServerTarget target;
+    unsigned connections = 16;
+    double seconds = 5.0;
+    double rate = 0.0;   // Запросов в секунду на все соединения; 0 — замкнутый цикл
+    double zipf = 0.0;   // Показатель Ципфа; 0 — равномерно
+    unsigned writes = 20; // Доля transfer, %
+    size_t accounts = 100;
+};
+
+// Номер счёта: равномерно или по Ципфу (обратная функция по накопленным весам)
+class KeyChooser
+{
+public:
+    KeyChooser(size_t n, double s) : n_(n)
+    {
+        if (s <= 0.0)
+            return;
+        cdf_.resize(n);
+        double sum = 0.0;
+        for (size_t i = 0; i < n; ++i)
+        {
+            sum += 1.0 / std::pow(static_cast<double>(i + 1), s);
+            cdf_[i] = sum;
+        }
+        for (double &c : cdf_)
+            c /= sum;
+    }
+
+    int operator()(uint64_t &rnd) const
+    {
+        if (cdf_.empty())
+            return static_cast<int>(nextRandom(rnd) % n_);
+        double u = static_cast<double>(nextRandom(rnd) >> 11) / 9007199254740992.0;
+        size_t k = std::lower_bound(cdf_.begin(), cdf_.end(), u) - cdf_.begin();
+        return static_cast<int>(k < n_ ? k : n_ - 1);
+    }
+
+private:
+    size_t n_;
+    std::vector<double> cdf_;
+};
+
+// Читает одну строку ответа (без '\n') из fd с буфером buf
+static bool readLine(int fd, std::string &buf, std::string &line)
+{
+    char chunk[4096];
+    while (true)
+    {
+        size_t nl = buf.find('\n');
+        if (nl != std::string::npos)
+        {
+            line.assign(buf, 0, nl);
+            buf.erase(0, nl + 1);
+            return true;
+        }
+        ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+        if (n <= 0)
+            return false;
+        buf.append(chunk, static_cast<size_t>(n));
+    }
+}
+
+struct LoadResult
+{
+    std::vector<double> latency_us;
+    size_t rejected = 0;
+    bool failed = false;
+};
+
+static void loadConnection(const LoadOptions &o, const KeyChooser &keys, unsigned index,
+                           Clock::time_point start, Clock::time_point end, LoadResult &r)
+{
+    int fd = connectTo(o.target);
+    std::string buf, line, req;
+    if (fd < 0 || !readUntil(fd, buf, WELCOME_TAIL.c_str()))
+    {
+        r.failed = true;
+        if (fd >= 0)
+            close(fd);
+        return;
+    }
+    uint64_t rnd = 0x9E3779B97F4A7C15ull * (index + 1);
+    // Открытый цикл: соединение отправляет раз в interval, со сдвигом, чтобы не все разом
+    const std::chrono::duration<double> interval(o.rate > 0.0 ? o.connections / o.rate : 0.0);
+    Clock::time_point next = start + std::chrono::duration_cast<Clock::duration>(
+                                         interval * (static_cast<double>(index) / o.connections));
+    while (true)
+    {
+        Clock::time_point scheduled = Clock::now();
+        if (o.rate > 0.0)
+        {
+            if (next > scheduled)
+                std::this_thread::sleep_until(next);
+            scheduled = next;
+            next += std::chrono::duration_cast<Clock::duration>(interval);
+        }
+        if (scheduled >= end)
+            break;
+
+        const int a = keys(rnd);
+        req.clear();
+        if (nextRandom(rnd) % 100 < o.writes)
+        {
+            int b = keys(rnd);
+            req += "transfer ";
+            req += std::to_string(a);
+            req += ' ';
+            req += std::to_string(b == a ? (a + 1) % static_cast<int>(o.accounts) : b);
+            req += " 1\n";
+        }
+        else
+        {
+            req += "show_balance ";
+            req += std::to_string(a);
+            req += '\n';
+        }
+        if (send(fd, req.data(), req.size(), MSG_NOSIGNAL) < 0 || !readLine(fd, buf, line))
+        {
+            r.failed = true;
+            break;
+        }
+        // Задержка от запланированной отправки: опоздание отправителя тоже входит
+        r.latency_us.push_back(std::chrono::duration<double, std::micro>(Clock::now() - scheduled).count());
+        if (line.compare(0, 6, "Error:") == 0 || line.compare(0, 6, "Usage:") == 0)
+            ++r.rejected;
+    }
+    close(fd);
+}
+
+static int runLoadSuite(const LoadOptions &o)
+{
+    KeyChooser keys(o.accounts, o.zipf);
+    std::vector<LoadResult> results(o.connections);
+    std::vector<std::thread> threads;
+    Clock::time_point start = Clock::now() + std::chrono::milliseconds(100);
+    Clock::time_point end = start + std::chrono::duration_cast<Clock::duration>(
+                                        std::chrono::duration<double>(o.seconds));
+    for (unsigned c = 0; c < o.connections; ++c)
+        threads.emplace_back(loadConnection, std::cref(o), std::cref(keys), c, start, end,
+                             std::ref(results[c]));
+    for (auto &t : threads)
+        t.join();
+
+    std::vector<double> all;
+    size_t rejected = 0;
+    unsigned failed = 0;
+    for (LoadResult &r : results)
+    {
+        all.insert(all.end(), r.latency_us.begin(), r.latency_us.end());
+        rejected += r.rejected;
+        failed += r.failed;
+    }
+    const char *mode = o.rate > 0.0 ? "load_open" : "load_closed";
+    std::initializer_list<Param> params = {{"connections", double(o.connections)},
+                                           {"rate", o.rate},
+                                           {"zipf", o.zipf},
+                                           {"writes", double(o.writes)}};
+    report("load", mode, params, all.size() / o.seconds, "req/s");
+    report("load", mode, params, percentile(all, 0.50), "p50_us");
+    report("load", mode, params, percentile(all, 0.99), "p99_us");
+    report("load", mode, params, percentile(all, 0.999), "p999_us");
+    report("load", mode, params, static_cast<double>(rejected), "rejected");
+    if (failed)
+    {
+        std::fprintf(stderr, "load: %u connections failed\n", failed);
+        return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    // --json допустим в любом месте; остальные аргументы разбирают наборы
+    std::vector<char *> args;
+    for (int i = 0; i < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "--json") == 0)
+            json_output = true;
+        else
+            args.push_back(argv[i]);
+    }
+    argc = static_cast<int>(args.size());
+    argv = args.data();
+
+    std::string suite = argc >= 2 ? argv[1] : "bank";
+    if (suite == "bank")
+        return runBankSuite();
+    if (suite == "ops")
+        return runOpsSuite();
+    if (suite == "rejects")
+        return runRejectsSuite();
+    if (suite == "mass_update")
+        return runMassUpdateSuite();
+    if (suite == "layout")
+        return runLayoutSuite();
+    if (suite == "wal")
+    {
+        std::string dir = "/tmp";
+        if (argc >= 3 && std::strncmp(argv[2], "--dir=", 6) == 0)
+            dir = argv[2] + 6;
+        return runWalSuite(dir);
+    }
+    if (suite == "snapshot")
+    {
+        std::string dir = "/tmp";
+        if (argc >= 3 && std::strncmp(argv[2], "--dir=", 6) == 0)
+            dir = argv[2] + 6;
+        return runSnapshotSuite(dir);
+    }
+    if (suite == "reads")
+        return runReadsSuite();
+    if (suite == "audit")
+        return runAuditSuite();
+    if (suite == "protocol")
+        return runProtocolSuite();
+    if (suite == "parse")
+        return runParseSuite();
+    if (suite == "listing")
+        return runListingSuite();
+    if (suite == "shards")
+        return runShardsSuite();
+    if (suite == "ledger")
+    {
+        std::string dir = "/tmp";
+        if (argc >= 3 && std::strncmp(argv[2], "--dir=", 6) == 0)
+            dir = argv[2] + 6;
+        return runLedgerSuite(dir);
+    }
+    if (suite == "stats")
+        return runStatsSuite();
+    if (suite == "shm")
+        return runShmSuite();
+    if (suite == "load")
+    {
+        LoadOptions o;
+        for (int i = 2; i < argc; ++i)
+        {
+            std::string arg = argv[i];
+            if (arg.compare(0, 7, "--host=") == 0)
+                o.target.host = arg.substr(7);
+            else if (arg.compare(0, 7, "--port=") == 0)
+                o.target.port = std::stoi(arg.substr(7));
+            else if (arg.compare(0, 14, "--connections=") == 0)
+                o.connections = static_cast<unsigned>(std::stoul(arg.substr(14)));
+            else if (arg.compare(0, 10, "--seconds=") == 0)
+                o.seconds = std::stod(arg.substr(10));
+            else if (arg.compare(0, 7, "--rate=") == 0)
+                o.rate = std::stod(arg.substr(7));
+            else if (arg.compare(0, 7, "--zipf=") == 0)
+                o.zipf = std::stod(arg.substr(7));
+            else if (arg.compare(0, 9, "--writes=") == 0)
+                o.writes = static_cast<unsigned>(std::stoul(arg.substr(9)));
+            else if (arg.compare(0, 11, "--accounts=") == 0)
+                o.accounts = static_cast<size_t>(std::stoul(arg.substr(11)));
+        }
+        if (o.connections == 0 || o.accounts == 0 || o.seconds <= 0.0)
+        {
+            std::fprintf(stderr, "load: connections, accounts and seconds must be positive\n");
+            return 1;
+        }
+        return runLoadSuite(o);
+    }
+    if (suite == "server")
+    {
+        ServerTarget target;
+        unsigned connections = 64;
+        unsigned requests = 1000;
+        for (int i = 2; i < argc; ++i)
+        {
+            std::string arg = argv[i];
+            if (arg.compare(0, 7, "--host=") == 0)
+                target.host = arg.substr(7);
+            else if (arg.compare(0, 7, "--port=") == 0)
+                target.port = std::stoi(arg.substr(7));
+            else if (arg.compare(0, 14, "--connections=") == 0)
+                connections = static_cast<unsigned>(std::stoul(arg.substr(14)));
+            else if (arg.compare(0, 11, "--requests=") == 0)
+                requests = static_cast<unsigned>(std::stoul(arg.substr(11)));
+        }
+        return runServerSuite(target, connections, requests);
+    }
+    std::fprintf(stderr, "Usage: %s [bank | ops | rejects | mass_update | layout | wal [--dir=D] |\n"
+                         "          snapshot [--dir=D] | reads | audit | protocol | parse | listing |\n"
+                         "          shards | ledger [--dir=D] | stats | shm |\n"
+                         "          server [--host=H] [--port=P] [--connections=C] [--requests=R] |\n"
+                         "          load [--host=H] [--port=P] [--connections=C] [--seconds=S] [--rate=R]\n"
+                         "               [--zipf=S] [--writes=PCT] [--accounts=N]] [--json]\n", argv[0]);
+    return 1;
+}
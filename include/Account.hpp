@@ -0,0 +1,16 @@
+#ifndef ACCOUNT_HPP
+#define ACCOUNT_HPP
+
+#include <cstdint> // для int32_t
+
+// Описание счёта
+struct Account
+{
+    int account_id;      // Уникальный ID счёта
+    int32_t balance;     // Текущий баланс
+    int32_t min_balance; // Минимальный баланс
+    int32_t max_balance; // Максимальный баланс
+    bool frozen;         // true — заморожен, false — активен
+};
+
+#endif // ACCOUNT_HPP
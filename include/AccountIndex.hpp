@@ -0,0 +1,86 @@
+#ifndef ACCOUNT_INDEX_HPP
+#define ACCOUNT_INDEX_HPP
+
+#include "AccountStore.hpp"
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <atomic>
+
+/*
+ * AccountIndex
+ * ------------
+ * Отображение ID счёта → номер слота в массиве Account[].
+ *
+ * Строится один раз по счетам (в куче или в shared memory, в любой
+ * раскладке — индекс всегда локален для процесса и лишь читает ID).
+ *   - Плотные ID (id == base + slot, как у initializer и server):
+ *     поиск — одно вычитание и сравнение, памяти не требует.
+ *   - Разреженные ID: открытая адресация с линейным пробированием
+ *     по плоскому массиву пар {id, slot} (8 байт на ячейку).
+ */
+class AccountIndex
+{
+public:
+    static constexpr size_t NOT_FOUND = static_cast<size_t>(-1);
+
+    AccountIndex() = default;
+
+    // Перестроить индекс по массиву из count счетов
+    void build(const AccountStore &accounts, size_t count);
+
+    /*
+     * Расширить индекс счетами, дописанными в конец массива
+     * (слоты [old_count, new_count)). Растёт только плотный индекс,
+     * и без блокировки читателей: публикуется новое значение count.
+     * @return false, если индекс разреженный или новые ID нарушают плотность.
+     */
+    bool grow(const AccountStore &accounts, size_t new_count);
+
+    // Номер слота для id или NOT_FOUND
+    size_t find(int id) const noexcept
+    {
+        if (dense_)
+        {
+            uint64_t off = static_cast<uint64_t>(static_cast<int64_t>(id) - base_id_);
+            return off < count_.load(std::memory_order_acquire) ? static_cast<size_t>(off) : NOT_FOUND;
+        }
+        size_t pos = hash(id) & mask_;
+        while (true)
+        {
+            const Entry &e = table_[pos];
+            if (e.slot == EMPTY)
+                return NOT_FOUND;
+            if (e.id == id)
+                return e.slot;
+            pos = (pos + 1) & mask_;
+        }
+    }
+
+    bool isDense() const noexcept { return dense_; }
+
+private:
+    struct Entry
+    {
+        int32_t id;
+        uint32_t slot;
+    };
+    static constexpr uint32_t EMPTY = UINT32_MAX;
+
+    static size_t hash(int id) noexcept
+    {
+        // Мультипликативное (фибоначчиево) хеширование
+        return static_cast<size_t>((static_cast<uint64_t>(static_cast<uint32_t>(id)) *
+                                    0x9E3779B97F4A7C15ull) >> 32);
+    }
+
+    bool dense_ = true;
+    int64_t base_id_ = 0;
+    std::atomic<size_t> count_{0};
+
+    std::vector<Entry> table_;
+    size_t mask_ = 0;
+};
+
+#endif // ACCOUNT_INDEX_HPP
@@ -0,0 +1,76 @@
+#ifndef ACCOUNT_LISTING_HPP
+#define ACCOUNT_LISTING_HPP
+
+#include "Bank.hpp"
+#include "CommandParser.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class ShardedBank;
+
+/*
+ * AccountListing — потоковый вывод show_account_list по срезам Bank::ReadView.
+ *
+ *   show_account_list [offset [limit]] [frozen] [balance <lo> <hi>]
+ *
+ * offset и limit считаются по строкам, прошедшим фильтры. Строки
+ * форматируются без потоков и аллокаций прямо в выходной буфер и
+ * выдаются порциями: fill() дописывает строки, пока буфер не вырастет
+ * на budget байт, так что миллион счетов уходит несколькими большими
+ * send(), а память сессии ограничена одной порцией.
+ *
+ * Каждое окно из WINDOW слотов читается из своего короткого среза,
+ * открытого только на время fill(): медленный клиент не держит срез, и
+ * переводы не платят за него сохранением слотов. Без аргументов вывод —
+ * только таблица; с аргументами в конце идёт строка "Listed N of M
+ * accounts from O, total balance: T" с итогом на момент запуска.
+ *
+ * У ShardedBank среза нет: листинг берёт его согласованную копию
+ * (snapshot), упорядоченную по ID, и выводит её теми же порциями.
+ */
+class AccountListing
+{
+public:
+    // Размер порции по умолчанию
+    static constexpr size_t CHUNK = 256 * 1024;
+    // Слотов на один срез Bank::ReadView
+    static constexpr size_t WINDOW = 4096;
+
+    // Идёт вывод: fill() ещё допишет строки или итог
+    bool active() const noexcept { return bank_ != nullptr || copied_; }
+
+    /*
+     * Разбирает аргументы команды, запоминает число счетов (и итог) и
+     * пишет шапку таблицы.
+     * @return false (и ничего в out), если аргументы неверны.
+     */
+    bool start(Bank &bank, Tokenizer &args, std::string &out);
+    bool start(ShardedBank &bank, Tokenizer &args, std::string &out);
+
+    // Дописывает в out строки (не больше budget байт) и по окончании — итог
+    void fill(std::string &out, size_t budget = CHUNK);
+
+private:
+    Bank *bank_ = nullptr;
+    std::vector<Account> rows_; // Копия ShardedBank
+    bool copied_ = false;
+    size_t count_ = 0;    // Счетов на момент запуска
+    int64_t total_ = 0;   // Их сумма (только для итоговой строки)
+    bool footer_ = false; // Были аргументы — в конце итоговая строка
+    size_t slot_ = 0;     // Следующий слот
+    size_t skip_ = 0;     // Сколько подходящих строк ещё пропустить (offset)
+    size_t left_ = 0;     // Сколько строк ещё вывести (limit)
+    size_t listed_ = 0;
+    size_t offset_ = 0;
+    bool frozen_only_ = false;
+    int32_t lo_ = INT32_MIN;
+    int32_t hi_ = INT32_MAX;
+
+    bool parseArgs(Tokenizer &args, std::string &out);
+    // Строка счёта, если он проходит фильтры и страницу
+    void emit(const Account &a, std::string &out);
+};
+
+#endif // ACCOUNT_LISTING_HPP
@@ -0,0 +1,180 @@
+#ifndef ACCOUNT_STORE_HPP
+#define ACCOUNT_STORE_HPP
+
+#include "Account.hpp"
+
+#include <cstdint>
+#include <cstddef>
+
+/*
+ * Раскладка счетов в памяти:
+ *   Rows    — массив структур Account[] (исходный вариант);
+ *   Columns — структура массивов: отдельные выровненные колонки ID,
+ *             балансов, минимумов, максимумов и битовая карта заморозки.
+ * Колонки нужны массовым проходам (massUpdate, суммы, фильтры): они
+ * читают только нужные поля, а не тянут всю запись через кэш.
+ */
+enum class AccountLayout : uint8_t
+{
+    Rows = 0,
+    Columns = 1,
+};
+
+// Колонки SoA-раскладки; каждая начинается с границы 64 байт
+struct AccountColumns
+{
+    int32_t *ids = nullptr;
+    int32_t *balances = nullptr;
+    int32_t *min_balances = nullptr;
+    int32_t *max_balances = nullptr;
+    uint64_t *frozen = nullptr; // бит (slot % 64) слова slot / 64
+};
+
+// Байт под колонки на capacity счетов
+size_t columnsBytes(size_t capacity) noexcept;
+
+// Смещение между соседними колонками (кратно 64); битовая карта — после четырёх колонок
+size_t columnStride(size_t capacity) noexcept;
+
+// Разметить колонки в памяти mem (выровнена на 64, не меньше columnsBytes)
+AccountColumns bindColumns(void *mem, size_t capacity) noexcept;
+
+/*
+ * AccountStore
+ * ------------
+ * Доступ к полям счёта по номеру слота независимо от раскладки.
+ * Памятью не владеет — это лёгкое представление, копируется по значению.
+ *
+ * Биты заморозки соседних счетов делят одно слово, хотя счета могут
+ * охраняться разными полосами, поэтому слово меняется атомарно.
+ */
+class AccountStore
+{
+public:
+    AccountStore() : layout_(AccountLayout::Rows), rows_(nullptr) {}
+    explicit AccountStore(Account *rows) : layout_(AccountLayout::Rows), rows_(rows) {}
+    explicit AccountStore(const AccountColumns &cols)
+        : layout_(AccountLayout::Columns), rows_(nullptr), cols_(cols) {}
+
+    AccountLayout layout() const noexcept { return layout_; }
+    Account *rows() const noexcept { return rows_; }
+    const AccountColumns &columns() const noexcept { return cols_; }
+
+    bool valid() const noexcept
+    {
+        return layout_ == AccountLayout::Rows
+                   ? rows_ != nullptr
+                   : cols_.ids && cols_.balances && cols_.min_balances && cols_.max_balances && cols_.frozen;
+    }
+
+    int id(size_t slot) const noexcept
+    {
+        return layout_ == AccountLayout::Rows ? rows_[slot].account_id : cols_.ids[slot];
+    }
+
+    int32_t &balance(size_t slot) const noexcept
+    {
+        return layout_ == AccountLayout::Rows ? rows_[slot].balance : cols_.balances[slot];
+    }
+
+    int32_t &minBalance(size_t slot) const noexcept
+    {
+        return layout_ == AccountLayout::Rows ? rows_[slot].min_balance : cols_.min_balances[slot];
+    }
+
+    int32_t &maxBalance(size_t slot) const noexcept
+    {
+        return layout_ == AccountLayout::Rows ? rows_[slot].max_balance : cols_.max_balances[slot];
+    }
+
+    bool frozen(size_t slot) const noexcept
+    {
+        if (layout_ == AccountLayout::Rows)
+            return rows_[slot].frozen;
+        return (__atomic_load_n(&cols_.frozen[slot / 64], __ATOMIC_RELAXED) >> (slot % 64)) & 1;
+    }
+
+    void setFrozen(size_t slot, bool value) const noexcept
+    {
+        if (layout_ == AccountLayout::Rows)
+        {
+            rows_[slot].frozen = value;
+            return;
+        }
+        uint64_t bit = uint64_t(1) << (slot % 64);
+        if (value)
+            __atomic_fetch_or(&cols_.frozen[slot / 64], bit, __ATOMIC_RELAXED);
+        else
+            __atomic_fetch_and(&cols_.frozen[slot / 64], ~bit, __ATOMIC_RELAXED);
+    }
+
+    // Копия счёта целиком
+    Account load(size_t slot) const noexcept
+    {
+        if (layout_ == AccountLayout::Rows)
+            return rows_[slot];
+        Account a;
+        a.account_id = cols_.ids[slot];
+        a.balance = cols_.balances[slot];
+        a.min_balance = cols_.min_balances[slot];
+        a.max_balance = cols_.max_balances[slot];
+        a.frozen = frozen(slot);
+        return a;
+    }
+
+    // Записать счёт целиком (при разметке, без конкурирующих писателей)
+    void store(size_t slot, const Account &a) const noexcept
+    {
+        if (layout_ == AccountLayout::Rows)
+        {
+            rows_[slot] = a;
+            return;
+        }
+        cols_.ids[slot] = a.account_id;
+        cols_.balances[slot] = a.balance;
+        cols_.min_balances[slot] = a.min_balance;
+        cols_.max_balances[slot] = a.max_balance;
+        setFrozen(slot, a.frozen);
+    }
+
+    // Подгрузить в кэш поля, нужные переводу
+    void prefetch(size_t slot) const noexcept
+    {
+        if (layout_ == AccountLayout::Rows)
+        {
+            __builtin_prefetch(&rows_[slot], 1);
+            return;
+        }
+        __builtin_prefetch(&cols_.balances[slot], 1);
+        __builtin_prefetch(&cols_.min_balances[slot]);
+        __builtin_prefetch(&cols_.max_balances[slot]);
+    }
+
+private:
+    AccountLayout layout_;
+    Account *rows_;
+    AccountColumns cols_;
+};
+
+/*
+ * ColumnBuffer — колонки в куче для банка в одном процессе (server, тесты).
+ * Владеет памятью; счета заполняет вызывающий через store().
+ */
+class ColumnBuffer
+{
+public:
+    explicit ColumnBuffer(size_t capacity);
+    ~ColumnBuffer();
+
+    ColumnBuffer(const ColumnBuffer &) = delete;
+    ColumnBuffer &operator=(const ColumnBuffer &) = delete;
+
+    const AccountColumns &columns() const noexcept { return cols_; }
+    AccountStore store() const noexcept { return AccountStore(cols_); }
+
+private:
+    void *mem_;
+    AccountColumns cols_;
+};
+
+#endif // ACCOUNT_STORE_HPP
@@ -4,15 +4,65 @@
 #include <cstdint>   // для int32_t
 #include <cstddef>   // для size_t
 #include <stdexcept> // для исключений
+#include <atomic>    // std::atomic
 
-// Описание счёта
-struct Account
+#include "Account.hpp"
+#include "AccountStore.hpp"
+#include "AccountIndex.hpp"
+#include "LockTable.hpp"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+class TxnLog;
+
+/*
+ * BankStatus — код результата операции Bank.
+ * Числовые значения входят в бинарный протокол сервера — не менять.
+ */
+enum class BankStatus : uint8_t
+{
+    Ok = 0,
+    InvalidAmount = 1,     // Сумма перевода не положительна
+    AccountNotFound = 2,   // Нет счёта с таким ID
+    AccountFrozen = 3,     // Один из счетов заморожен
+    InsufficientFunds = 4, // Баланс источника упадёт ниже минимума
+    ExceedsMaxBalance = 5, // Баланс получателя превысит максимум
+    LimitViolation = 6,    // massUpdate выводит баланс за лимиты
+    InvalidLimits = 7,     // newMin > newMax или баланс вне новых лимитов
+    BatchAborted = 8,      // Атомарный пакет отменён из-за ошибки другого элемента
+    Unsupported = 9,       // Операция недоступна над общей таблицей полос
+};
+
+// Короткое имя статуса для ответов сервера ("InsufficientFunds", ...)
+const char *bankStatusName(BankStatus status) noexcept;
+
+// Текст ошибки для человека ("transferFunds: insufficient funds on source account")
+const char *bankStatusMessage(BankStatus status) noexcept;
+
+// Элемент пакетного перевода
+struct Transfer
+{
+    int from_id;
+    int to_id;
+    int32_t amount;
+};
+
+/*
+ * BankError — исключение операций Bank с кодом BankStatus.
+ * Наследует std::runtime_error, текст сообщения прежний.
+ */
+class BankError : public std::runtime_error
 {
-    int account_id;      // Уникальный ID счёта
-    int32_t balance;     // Текущий баланс
-    int32_t min_balance; // Минимальный баланс
-    int32_t max_balance; // Максимальный баланс
-    bool frozen;         // true — заморожен, false — активен
+public:
+    BankError(BankStatus status, const std::string &what)
+        : std::runtime_error(what), status_(status) {}
+
+    BankStatus status() const noexcept { return status_; }
+
+private:
+    BankStatus status_;
 };
 
 /*
@@ -20,39 +70,102 @@ struct Account
  * -----------
  * Инкапсулирует логику работы с массивом счетов,
  * не владеет памятью сам по себе (не вызывает delete[]),
- * а лишь оперирует внешним массивом Account*.
+ * а лишь оперирует внешним хранилищем: массивом Account* или
+ * колонками AccountColumns (см. AccountStore.hpp) — API одинаков.
+ *
+ * Потокобезопасность: каждый счёт защищён одной из полос (LockStripe).
+ * Перевод блокирует две полосы всегда в порядке возрастания их номеров,
+ * поэтому переводы между непересекающимися счетами идут параллельно,
+ * а взаимных блокировок не возникает. massUpdate берёт все полосы.
+ *
+ * Таблица полос может лежать в общей памяти рядом со счетами — тогда
+ * несколько процессов синхронизируются через одни и те же robust-мьютексы.
+ * Если процесс погиб, удерживая полосу, следующий захват получает
+ * EOWNERDEAD и откатывает его незафиксированный перевод по TxnUndo.
+ *
+ * Чтение счёта (getAccount) мьютексов не берёт: изменения счетов полосы
+ * обрамляются её seqlock (LockStripe::seq), и читатель лишь повторяет
+ * копирование, если попал на запись. Так запросы баланса не мешают
+ * переводам ни в куче, ни в общей памяти.
  */
 class Bank
 {
 public:
+    // Число полос по умолчанию (не больше числа счетов)
+    static constexpr size_t DEFAULT_LOCK_STRIPES = 1024;
+
     /*
      * Конструктор
      * @param accounts_ptr — указатель на внешний массив Account[n]
      * @param count        — число элементов в этом массиве
+     * @param stripes      — желаемое число полос блокировок (0 — по умолчанию)
      *
-     * Никакой аллокации здесь не происходит: класс просто запоминает,
-     * где лежат счета, и сколько их.
+     * Массив счетов не копируется: класс просто запоминает,
+     * где лежат счета, и сколько их. Выделяется только таблица мьютексов.
      */
-    Bank(Account *accounts_ptr, size_t count)
-        : accounts_(accounts_ptr), count_(count)
-    {
-        if (!accounts_ || count_ == 0)
-        {
-            throw std::invalid_argument("Bank: invalid accounts pointer or count");
-        }
-    }
+    Bank(Account *accounts_ptr, size_t count, size_t stripes = 0);
+
+    // То же над хранилищем любой раскладки (например, AccountStore(columns))
+    Bank(const AccountStore &accounts, size_t count, size_t stripes = 0);
+
+    /*
+     * Конструктор над внешней таблицей полос (например, в shared memory),
+     * уже инициализированной lockTableInit(). Таблицей Bank не владеет.
+     * shared_count — необязательный счётчик занятых слотов в сегменте:
+     * если другой процесс добавил счета (appendAccounts), Bank подхватит их.
+     */
+    Bank(Account *accounts_ptr, size_t count, LockTable *shared_locks,
+         const uint64_t *shared_count = nullptr);
+    Bank(const AccountStore &accounts, size_t count, LockTable *shared_locks,
+         const uint64_t *shared_count = nullptr);
+    ~Bank();
 
     // Запрещаем копирование, чтобы случайно не получить два объекта, ссылающихся на один массив
     Bank(const Bank &) = delete;
     Bank &operator=(const Bank &) = delete;
 
+    /*
+     * Операции без исключений на ошибках бизнес-логики: отказ (нет счёта,
+     * заморожен, не хватает средств, лимиты) возвращается кодом BankStatus,
+     * и счета не меняются. Исключения остаются только для сбоев системы
+     * (мьютекс полосы, журнал). Текст по коду — bankStatusMessage() на
+     * стороне ответа клиенту.
+     */
+    BankStatus tryTransfer(int from_id, int to_id, int32_t amount);
+    BankStatus tryFreeze(int id, bool frozen);
+    // violator — ID первого счёта, вышедшего бы за лимиты (при LimitViolation)
+    BankStatus tryMassUpdate(int32_t amount, int *violator = nullptr);
+    // balance — текущий баланс счёта, если он вне новых лимитов (при InvalidLimits)
+    BankStatus trySetLimits(size_t accountId, int32_t newMin, int32_t newMax,
+                            int32_t *balance = nullptr);
+    // Согласованная копия счёта по ID (getAccount — по номеру слота)
+    BankStatus tryGetAccount(int id, Account &out) const;
+
     /*
      * Перевод средств
-     * from_id, to_id — ID счетов, amount — строго положительная сумма.
-     * Возвращает 0 при успехе, в остальных случаях выбрасывает исключение.
+     * from_id, to_id — ID счетов, amount — строго положительная сумма.
+     * Возвращает 0 при успехе, в остальных случаях выбрасывает BankError
+     * (обёртка над tryTransfer).
      */
     int transferFunds(int from_id, int to_id, int32_t amount);
 
+    /*
+     * Пакетный перевод без исключений на ошибках бизнес-логики.
+     * Элементы применяются в порядке следования (каждый видит результат
+     * предыдущих); results[i] получает статус i-го элемента.
+     * Сначала за один проход находятся слоты всех счетов, затем
+     * однократно берутся все задействованные полосы (по возрастанию).
+     * atomic = true — «всё или ничего»: при первой ошибке уже
+     * применённые элементы откатываются, остальные получают BatchAborted.
+     * Над таблицей полос в общей памяти атомарный пакет не выполняется:
+     * TxnUndo откатывает только один незавершённый перевод, и гибель
+     * клиента посреди пакета оставила бы его применённым частично.
+     * Все элементы тогда получают Unsupported, ничего не меняется.
+     * @return число применённых переводов.
+     */
+    size_t transferBatch(const Transfer *items, size_t count, BankStatus *results,
+                         bool atomic = false);
+
     /*
      * Заморозка/разморозка счёта по ID.
      * Если ID некорректен — выбрасывает std::runtime_error.
@@ -62,7 +175,8 @@ public:
     /*
      * Массовое обновление балансов всех счетов.
      * Сумма может быть отрицательной (списание).
-     * Проверяет, что не выйдем за лимиты.
+     * Атомарна: если хотя бы один счёт выйдет за лимиты, не меняется
+     * ни один баланс и выбрасывается BankError(LimitViolation).
      */
     int massUpdate(int32_t amount);
 
@@ -75,24 +189,264 @@ public:
 
     size_t getAccountCount() const noexcept;
 
-    const Account &getAccount(size_t idx) const;
+    /*
+     * Согласованная копия счёта в слоте idx (в раскладке Columns записи
+     * Account нет): balance, лимиты и frozen — на один момент времени.
+     * Без блокировок; только если полосу долго меняют (или её владелец
+     * погиб посреди записи), читает под мьютексом полосы.
+     */
+    Account getAccount(size_t idx) const;
+
+    AccountLayout layout() const noexcept { return accounts_.layout(); }
+
+    // Хранилище счетов; читать его согласованно можно только под lockAllStripes()
+    const AccountStore &store() const noexcept { return accounts_; }
+
+    /*
+     * Захват всех полос по возрастанию номера — тот же порядок, что у
+     * переводов. Пока полосы захвачены, ни одна операция не меняет счета
+     * (так massUpdate и снимки получают согласованный срез); getAccount
+     * при этом не ждёт — сам захват секцию записи не открывает.
+     * Единственного писателя захват останавливает между его операциями.
+     */
+    void lockAllStripes();
+    void unlockAllStripes() noexcept;
+
+    /*
+     * Журнал упреждающей записи (TxnLog.hpp) или nullptr.
+     * С журналом каждая успешная изменяющая операция дописывает запись
+     * под своими полосами и возвращается, только когда запись долговечна.
+     * Подключается TxnLog::open() до начала обслуживания запросов.
+     */
+    void setTxnLog(TxnLog *log) noexcept { log_ = log; }
+
+    /*
+     * Единственный писатель (Ledger). Нить, держащая право писателя
+     * (writerEnter() … writerLeave()), меняет счета операциями apply* без
+     * мьютексов полос: других писателей нет, а читатели видят согласованные
+     * счета через seqlock, как и прежде. lockAllStripes() (срезы, снимки)
+     * забирает право у писателя — тот уступает его между операциями в
+     * writerYield(). apply* не ждут журнал: lsn получает номер записи
+     * (0 — записи не было), долговечности ждёт вызывающий — waitLogged().
+     * Только для банка со своей таблицей полос: в общую пишут и другие
+     * процессы (sharedLocks()).
+     */
+    bool sharedLocks() const noexcept { return !owns_locks_; }
+    void writerEnter();
+    void writerLeave() noexcept;
+    void writerYield()
+    {
+        if (__atomic_load_n(&writer_waiters_, __ATOMIC_ACQUIRE) != 0)
+            writerHandOff();
+    }
+    BankStatus applyTransfer(int from_id, int to_id, int32_t amount, uint64_t &lsn);
+    BankStatus applyFreeze(int id, bool frozen, uint64_t &lsn);
+    BankStatus applyMassUpdate(int32_t amount, int *violator, uint64_t &lsn);
+    BankStatus applySetLimits(size_t id, int32_t newMin, int32_t newMax, int32_t *balance,
+                              uint64_t &lsn);
+    size_t applyBatch(const Transfer *items, size_t count, BankStatus *results, bool atomic,
+                      uint64_t &lsn);
+
+    // Дождаться долговечности записи lsn (0 — записи не было); полосы уже отпущены
+    void waitLogged(uint64_t lsn);
+
+    // Согласованный срез всех счетов на момент создания (см. ниже)
+    class ReadView;
 
 private:
-    Account *accounts_; // Внешний массив счетов (в shared‑memory или в куче)
-    size_t count_;      // Число счетов
+    AccountStore accounts_;      // Внешние счета (в shared‑memory или в куче)
+    mutable std::atomic<size_t> count_; // Число счетов
+    const uint64_t *shared_count_; // Счётчик в заголовке сегмента (или nullptr)
 
-    // Вспомогательная функция — найти счёт по ID. Если не находятся, бросить исключение.
-    Account &findAccount(int id)
+    LockTable *locks_;     // Таблица полосовых мьютексов (своя или внешняя)
+    LockStripe *stripes_;  // Полосы таблицы
+    size_t stripe_count_;  // Число полос
+    bool owns_locks_;      // true — таблица выделена этим объектом
+    bool journal_;         // Вести TxnUndo (только для таблицы в общей памяти)
+    TxnLog *log_;          // Журнал операций (или nullptr)
+
+    // Открытые срезы: добавляются под всеми полосами и views_lock_,
+    // удаляются под views_lock_; писатели обходят их под views_lock_ на чтение
+    std::vector<ReadView *> views_;
+    size_t view_count_ = 0; // views_.size() для проверки без блокировки
+    mutable pthread_rwlock_t views_lock_;
+
+    // Право единственного писателя; lockAllStripes() забирает его через writer_waiters_
+    mutable pthread_mutex_t writer_mtx_;
+    mutable unsigned writer_waiters_ = 0;
+    mutable uint64_t writer_grants_ = 0; // Сколько раз право забрали (под writer_mtx_)
+
+    mutable AccountIndex index_; // ID → слот, строится в конструкторе
+    mutable pthread_mutex_t grow_mtx_; // Сериализует refreshCount() в процессе
+
+    size_t stripeOf(size_t slot) const noexcept { return slot % stripe_count_; }
+    void lockStripe(size_t stripe) const;
+    void unlockStripe(size_t stripe) const;
+
+    // Забрать право писателя у нити Ledger (она уступит его между операциями)
+    void writerPause() const;
+    void writerResume() const noexcept;
+    // Нить писателя: отдать право ждущему lockAllStripes() и вернуть его
+    void writerHandOff();
+
+    // Восстановление полосы, чей владелец погиб (вызывается под её мьютексом)
+    void recoverStripe(size_t stripe) const;
+
+    // Сохранить прежнее значение слота в открытых срезах (под его полосой, до изменения)
+    void preserve(size_t slot) noexcept
+    {
+        if (__atomic_load_n(&view_count_, __ATOMIC_RELAXED) != 0)
+            preserveSlow(slot, 1);
+    }
+    // То же для слотов [first, first + count)
+    void preserveSlow(size_t first, size_t count) noexcept;
+
+    // Секция записи seqlock полосы; вызывается под её мьютексом
+    void beginWrite(size_t stripe) noexcept
+    {
+        uint64_t &seq = stripes_[stripe].seq;
+        __atomic_store_n(&seq, __atomic_load_n(&seq, __ATOMIC_RELAXED) + 1, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+    }
+    void endWrite(size_t stripe) noexcept
+    {
+        uint64_t &seq = stripes_[stripe].seq;
+        __atomic_store_n(&seq, __atomic_load_n(&seq, __ATOMIC_RELAXED) + 1, __ATOMIC_RELEASE);
+    }
+
+    // Как операция получает полосы: их мьютексами или правом единственного писателя
+    enum class Access
+    {
+        Locked,
+        Writer,
+    };
+
+    // RAII-захват одной или двух полос (в порядке возрастания номеров)
+    class StripeGuard;
+
+    // Тела операций try*/apply*; запись в журнал — в lsn, без ожидания
+    BankStatus runTransfer(int from_id, int to_id, int32_t amount, Access access, uint64_t &lsn);
+    size_t runBatch(const Transfer *items, size_t count, BankStatus *results, bool atomic,
+                    Access access, uint64_t &lsn);
+    BankStatus runFreeze(int id, bool frozen, Access access, uint64_t &lsn);
+    BankStatus runMassUpdate(int32_t amount, int *violator, Access access, uint64_t &lsn);
+    BankStatus runSetLimits(size_t id, int32_t newMin, int32_t newMax, int32_t *balance,
+                            Access access, uint64_t &lsn);
+
+    // Проверки перевода над уже захваченными счетами
+    BankStatus checkTransfer(size_t from_slot, size_t to_slot, int32_t amount) const noexcept
+    {
+        if (accounts_.frozen(from_slot) || accounts_.frozen(to_slot))
+            return BankStatus::AccountFrozen;
+        if (accounts_.balance(from_slot) - amount < accounts_.minBalance(from_slot))
+            return BankStatus::InsufficientFunds;
+        if (accounts_.balance(to_slot) + amount > accounts_.maxBalance(to_slot))
+            return BankStatus::ExceedsMaxBalance;
+        return BankStatus::Ok;
+    }
+
+    // Перенос суммы между слотами; полосы обоих слотов должны быть захвачены
+    void applyTransferLocked(size_t from_slot, size_t to_slot, int32_t amount) noexcept;
+
+    // Согласованное чтение слота через seqlock полосы (с учётом среза view, если задан)
+    Account readSlot(size_t idx, const ReadView *view) const;
+
+    // Подхватить счета, добавленные в сегмент другими процессами
+    size_t refreshCount() const noexcept;
+
+    // Найти слот счёта по ID без исключений (AccountIndex::NOT_FOUND, если нет)
+    size_t lookupSlot(int id) const noexcept
     {
-        for (size_t i = 0; i < count_; ++i)
+        size_t slot = index_.find(id);
+        if (slot == AccountIndex::NOT_FOUND && shared_count_ && refreshCount())
         {
-            if (accounts_[i].account_id == id)
-            {
-                return accounts_[i];
-            }
+            slot = index_.find(id);
         }
-        throw std::runtime_error("Bank: account ID not found");
+        return slot;
     }
+
+    // Вспомогательная функция — найти слот счёта по ID за O(1). Если не находится, бросить исключение.
+    size_t findSlot(int id) const
+    {
+        size_t slot = lookupSlot(id);
+        if (slot == AccountIndex::NOT_FOUND)
+        {
+            throw BankError(BankStatus::AccountNotFound, "Bank: account ID not found");
+        }
+        return slot;
+    }
+};
+
+/*
+ * Bank::ReadView — согласованный срез счетов (MVCC) для аудита и
+ * листинга: сумма балансов среза равна сумме на момент его создания.
+ * Срез покрывает все счета или диапазон слотов [first, first + count).
+ *
+ * Создание захватывает все полосы лишь на время регистрации среза, без
+ * копирования счетов. Дальше писатели перед первым изменением слота
+ * сохраняют его прежнее значение в срез (копия одного счёта), а срез
+ * читает нетронутые слоты прямо из хранилища через seqlock полосы.
+ * Память под сохранённые значения выделяется страницами по PAGE слотов
+ * при первом изменении слота страницы, так что срез без изменений стоит
+ * O(count / PAGE). Пока срез открыт, каждое первое изменение слота
+ * платит копией счёта — держать срез стоит не дольше одного прохода
+ * (листинг берёт новый срез на каждое окно слотов).
+ *
+ * Если таблица полос общая (сегмент в shared memory или файле), счета
+ * могут менять другие процессы, которые о срезе не знают: тогда срез
+ * копирует свои счета сразу под всеми полосами.
+ *
+ * Счета, добавленные после создания среза, в него не входят.
+ */
+class Bank::ReadView
+{
+public:
+    // Слотов на страницу сохранённых значений
+    static constexpr size_t PAGE = 1024;
+
+    explicit ReadView(Bank &bank, size_t first = 0, size_t count = SIZE_MAX);
+    // Снятие с регистрации не берёт полос и не бросает
+    ~ReadView();
+
+    ReadView(const ReadView &) = delete;
+    ReadView &operator=(const ReadView &) = delete;
+
+    // Первый слот и число счетов в срезе
+    size_t first() const noexcept { return first_; }
+    size_t count() const noexcept { return count_; }
+
+    /*
+     * Счёт в слоте idx на момент среза; std::out_of_range вне
+     * [first(), first() + count()), std::bad_alloc, если писателю не
+     * хватило памяти сохранить прежнее значение.
+     */
+    Account get(size_t idx) const;
+
+    /*
+     * Дописать в out до limit счетов среза, начиная со слота offset.
+     * @return сколько счетов дописано (0, если offset вне среза).
+     */
+    size_t page(size_t offset, size_t limit, std::vector<Account> &out) const;
+
+    // Сумма балансов всех счетов среза
+    int64_t totalBalance() const;
+
+private:
+    friend class Bank;
+    struct Page; // Биты сохранённых слотов и их значения
+
+    Bank &bank_;
+    size_t first_;
+    size_t count_;
+    bool full_copy_;                 // Все счета скопированы при создании
+    bool lost_ = false;              // Писатель не смог выделить страницу
+    std::unique_ptr<Page *[]> pages_; // count_ / PAGE страниц, nullptr — не выделена
+
+    // Сохранённое значение слота или nullptr
+    const Account *preserved(size_t idx) const noexcept;
+    // Сохранить прежнее значение слота (писатель, под полосой слота)
+    void save(size_t idx, const AccountStore &store) noexcept;
+    void freePages() noexcept;
 };
 
 #endif // BANK_HPP
@@ -0,0 +1,141 @@
+#ifndef BINARY_PROTOCOL_HPP
+#define BINARY_PROTOCOL_HPP
+
+#include "Bank.hpp"
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <string>
+
+class Ledger;
+class ShardedBank;
+
+/*
+ * Бинарный протокол TCP-сервера для межмашинного трафика.
+ *
+ * Клиент выбирает протокол первым байтом соединения: BIN_HANDSHAKE
+ * переключает сессию в бинарный режим, любой другой — текстовый.
+ * Текстовое приветствие сервер шлёт сразу при подключении, поэтому
+ * бинарный клиент пропускает входящие байты до BIN_ACK_MAGIC.
+ *
+ * Все кадры начинаются с заголовка (целые — little-endian):
+ *   uint16 length  — полная длина кадра вместе с заголовком
+ *   uint8  op      — BinOp
+ *   uint8  status  — в ответе BankStatus / BinError, в запросе 0
+ *   uint32 seq     — номер запроса, эхом возвращается в ответе
+ *
+ * Запрос:  заголовок + int32 a, b, c        (BIN_REQUEST_SIZE байт)
+ * Ответ:   заголовок + int32 balance, min, max, frozen (BIN_RESPONSE_SIZE)
+ *
+ * Пакетный перевод (BinOp::TransferBatch) — кадр переменной длины:
+ *   запрос: заголовок + uint32 count + uint32 flags + count × {int32 from, to, amount}
+ *   ответ:  заголовок + uint32 applied + uint32 count + count × uint8 BankStatus
+ */
+static constexpr uint8_t BIN_HANDSHAKE = 0xB1;
+static constexpr char BIN_ACK_MAGIC[4] = {'T', 'B', 'N', 0x01};
+static constexpr size_t BIN_ACK_SIZE = 8; // magic + uint16 version + uint16 reserved
+static constexpr uint16_t BIN_VERSION = 1;
+
+static constexpr size_t BIN_HEADER_SIZE = 8;
+static constexpr size_t BIN_REQUEST_SIZE = BIN_HEADER_SIZE + 12;
+static constexpr size_t BIN_RESPONSE_SIZE = BIN_HEADER_SIZE + 16;
+static constexpr size_t BIN_MAX_FRAME = 65535; // предел uint16 length
+
+static constexpr uint32_t BIN_BATCH_ATOMIC = 1u << 0; // флаг «всё или ничего»
+static constexpr size_t BIN_BATCH_HEADER_SIZE = BIN_HEADER_SIZE + 8;
+static constexpr size_t BIN_BATCH_MAX_ITEMS = (BIN_MAX_FRAME - BIN_BATCH_HEADER_SIZE) / 12;
+
+enum class BinOp : uint8_t
+{
+    Ping = 0,
+    Transfer = 1,   // a = from, b = to, c = amount
+    Freeze = 2,     // a = id
+    Unfreeze = 3,   // a = id
+    MassUpdate = 4, // a = amount
+    SetLimits = 5,  // a = id, b = min, c = max
+    Query = 6,      // a = id → balance, min, max, frozen
+    TransferBatch = 7, // кадр переменной длины, см. выше
+};
+
+// Ошибки уровня протокола; не пересекаются с BankStatus
+enum BinError : uint8_t
+{
+    BIN_BAD_FRAME = 100,   // Неверная длина кадра
+    BIN_UNKNOWN_OP = 101,  // Неизвестная операция
+    BIN_INTERNAL = 102,    // Непредвиденная ошибка сервера
+};
+
+struct BinRequest
+{
+    BinOp op;
+    uint32_t seq;
+    int32_t a, b, c;
+};
+
+struct BinResponse
+{
+    BinOp op;
+    uint8_t status;
+    uint32_t seq;
+    int32_t balance, min_balance, max_balance, frozen;
+};
+
+inline void binPut16(char *p, uint16_t v)
+{
+    p[0] = static_cast<char>(v);
+    p[1] = static_cast<char>(v >> 8);
+}
+
+inline void binPut32(char *p, uint32_t v)
+{
+    for (int i = 0; i < 4; ++i)
+        p[i] = static_cast<char>(v >> (8 * i));
+}
+
+inline uint16_t binGet16(const char *p)
+{
+    return static_cast<uint16_t>(static_cast<uint8_t>(p[0]) |
+                                 (static_cast<uint8_t>(p[1]) << 8));
+}
+
+inline uint32_t binGet32(const char *p)
+{
+    uint32_t v = 0;
+    for (int i = 3; i >= 0; --i)
+        v = (v << 8) | static_cast<uint8_t>(p[i]);
+    return v;
+}
+
+// Кодирование/разбор кадров фиксированного размера
+void binEncodeRequest(const BinRequest &req, char *out);
+void binDecodeRequest(const char *in, BinRequest &req);
+void binEncodeResponse(const BinResponse &resp, char *out);
+void binDecodeResponse(const char *in, BinResponse &resp);
+
+// Кодирует пакетный перевод (count ≤ BIN_BATCH_MAX_ITEMS) в конец out
+void binEncodeBatch(uint32_t seq, const Transfer *items, size_t count, bool atomic,
+                    std::string &out);
+
+/*
+ * Выполняет кадр TransferBatch длиной len и дописывает ответ в out.
+ * Кадр с неверной длиной получает ответ BIN_BAD_FRAME без элементов.
+ */
+void binExecuteBatch(Bank &bank, const char *frame, size_t len, std::string &out);
+void binExecuteBatch(ShardedBank &bank, const char *frame, size_t len, std::string &out);
+void binExecuteBatch(Ledger &ledger, const char *frame, size_t len, std::string &out);
+
+// Дописывает подтверждение рукопожатия
+void binAppendAck(std::string &out);
+
+/*
+ * Выполняет один запрос над банком. Исключения Bank превращаются
+ * в числовой статус ответа; текст ошибки не формируется.
+ */
+void binExecute(Bank &bank, const BinRequest &req, BinResponse &resp);
+
+// Над ShardedBank Query адресует счёт по ID
+void binExecute(ShardedBank &bank, const BinRequest &req, BinResponse &resp);
+void binExecute(Ledger &ledger, const BinRequest &req, BinResponse &resp);
+
+#endif // BINARY_PROTOCOL_HPP
@@ -2,6 +2,7 @@
 #define CLIENT_HPP
 
 #include "Bank.hpp"
+#include "Commands.hpp"
 #include <string>
 #include <iostream>
 #include <colorprint.hpp>
@@ -21,16 +22,16 @@ private:
     Bank& bank_;  // ссылка на логику банка
 
     // Печатает справку (через Painter)
-    void displayHelp(Painter& p) const;
+    void displayHelp(Painter& p);
 
     // Обрабатывает одну введённую строку. Возвращает false, чтобы выйти.
     bool processCommand(const std::string& line, Painter& p);
 
-    //команды:
-    void showAccountList(Painter& p) const;
-    void showBalance(int id, Painter& p) const;
-    void showMin(int id, Painter& p) const;
-    void showMax(int id, Painter& p) const;
+    // Печатает накопленные в out_ строки через Painter
+    void printOutput(Painter& p);
+
+    std::string out_;          // ответ команды (реестр Commands.hpp)
+    AccountListing listing_;   // идущий show_account_list
 };
 
 #endif // CLIENT_HPP
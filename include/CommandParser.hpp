@@ -0,0 +1,95 @@
+#ifndef COMMAND_PARSER_HPP
+#define COMMAND_PARSER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+/*
+ * Разбор строки текстового протокола без аллокаций.
+ *
+ * Token — слово строки: указатель прямо в буфер приёма и длина.
+ * Tokenizer режет строку на слова по пробелам и табуляциям (и '\r'
+ * в конце строки), числа разбираются на месте (как from_chars:
+ * слово целиком, без пробелов и хвоста, с контролем переполнения).
+ */
+struct Token
+{
+    const char *data = nullptr;
+    size_t size = 0;
+
+    bool empty() const noexcept { return size == 0; }
+
+    bool operator==(const char *word) const noexcept
+    {
+        return std::strlen(word) == size && std::memcmp(data, word, size) == 0;
+    }
+    bool operator!=(const char *word) const noexcept { return !(*this == word); }
+};
+
+// Целое со знаком в [min, max]; false — не число, хвост или переполнение
+bool parseInt64(Token tok, int64_t min, int64_t max, int64_t &value) noexcept;
+
+inline bool parseInt32(Token tok, int32_t &value) noexcept
+{
+    int64_t v;
+    if (!parseInt64(tok, INT32_MIN, INT32_MAX, v))
+        return false;
+    value = static_cast<int32_t>(v);
+    return true;
+}
+
+// Неотрицательное число без знака
+bool parseCount(Token tok, size_t &value) noexcept;
+
+class Tokenizer
+{
+public:
+    Tokenizer(const char *begin, const char *end) noexcept : p_(begin), end_(end) {}
+
+    // Следующее слово; false — строка кончилась
+    bool next(Token &tok) noexcept
+    {
+        while (p_ < end_ && isSpace(*p_))
+            ++p_;
+        if (p_ == end_)
+            return false;
+        tok.data = p_;
+        while (p_ < end_ && !isSpace(*p_))
+            ++p_;
+        tok.size = static_cast<size_t>(p_ - tok.data);
+        return true;
+    }
+
+    // Следующее слово как int32; false — слова нет или это не число
+    bool nextInt(int32_t &value) noexcept
+    {
+        Token tok;
+        return next(tok) && parseInt32(tok, value);
+    }
+
+private:
+    const char *p_;
+    const char *end_;
+
+    static bool isSpace(char c) noexcept
+    {
+        return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+    }
+};
+
+/*
+ * Число v справа в поле width (как std::setw) в row; возвращает конец
+ * записи. В row должно быть место на max(width, 20) символов.
+ */
+char *formatInt(char *row, int64_t v, int width = 0) noexcept;
+
+// Дописать число в out без временных строк
+inline void appendInt(std::string &out, int64_t v)
+{
+    char digits[24];
+    out.append(digits, static_cast<size_t>(formatInt(digits, v) - digits));
+}
+
+#endif // COMMAND_PARSER_HPP
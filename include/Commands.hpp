@@ -0,0 +1,102 @@
+#ifndef COMMANDS_HPP
+#define COMMANDS_HPP
+
+#include "Bank.hpp"
+#include "AccountListing.hpp"
+#include "CommandParser.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+class Ledger;
+class ShardedBank;
+
+/*
+ * Реестр команд текстового протокола — общий для TCP-сервера
+ * (ServerCore/Session) и локального CLI (Client), чтобы набор команд,
+ * их разбор и ответы не расходились.
+ *
+ * Имя команды ищется переключателем по длине и одним memcmp, аргументы
+ * разбираются Tokenizer прямо в строке, ответы дописываются в out без
+ * временных строк.
+ */
+
+enum class CommandId : uint8_t
+{
+    Unknown = 0,
+    Help,
+    Shutdown,
+    Exit,
+    Transfer,
+    TransferBatch,
+    Freeze,
+    Unfreeze,
+    MassUpdate,
+    SetLimits,
+    ShowAccountList,
+    TotalBalance,
+    ShowMin,
+    ShowMax,
+    ShowBalance,
+    Stats,
+};
+
+// Где команда доступна (битовая маска)
+enum CommandScope : unsigned
+{
+    SCOPE_SERVER = 1, // TCP-сервер
+    SCOPE_CLI = 2,    // Локальный client над общей памятью
+    SCOPE_ALL = SCOPE_SERVER | SCOPE_CLI,
+};
+
+struct CommandInfo
+{
+    CommandId id;
+    const char *name;
+    const char *args; // Аргументы для справки и строки Usage
+    const char *help;
+    unsigned scopes;
+};
+
+// Все команды в порядке справки; индекс — CommandId
+extern const CommandInfo COMMANDS[];
+extern const size_t COMMAND_COUNT;
+
+// Команда по имени; CommandId::Unknown, если такой нет
+CommandId lookupCommand(Token name) noexcept;
+
+// Дописывает "Available commands:" и по строке на каждую команду scope
+void appendHelp(std::string &out, unsigned scope);
+
+// Счёт по ID в любом режиме (show_* и бинарный Query); AccountNotFound, если нет
+BankStatus queryAccount(Bank &bank, int32_t id, Account &acc);
+BankStatus queryAccount(ShardedBank &bank, int32_t id, Account &acc);
+BankStatus queryAccount(Ledger &ledger, int32_t id, Account &acc);
+
+enum class CommandResult
+{
+    Continue,
+    Shutdown, // shutdown (сервер)
+    Exit,     // exit (CLI)
+};
+
+/*
+ * Выполняет одну строку [begin, end) над bank и дописывает ответ в out
+ * (строки с '\n'). Команды вне scope считаются неизвестными. Если задан
+ * listing, show_account_list только запускается в нём, и остальное
+ * вызывающий дописывает через listing->fill(); иначе листинг выводится
+ * целиком. Исключения Bank превращаются в строку "Error: ...".
+ */
+CommandResult executeCommand(Bank &bank, const char *begin, const char *end, unsigned scope,
+                             std::string &out, AccountListing *listing = nullptr);
+
+// То же над шардированным банком
+CommandResult executeCommand(ShardedBank &bank, const char *begin, const char *end, unsigned scope,
+                             std::string &out, AccountListing *listing = nullptr);
+
+// Изменения — через очередь единственного писателя, чтения — прямо из его Bank
+CommandResult executeCommand(Ledger &ledger, const char *begin, const char *end, unsigned scope,
+                             std::string &out, AccountListing *listing = nullptr);
+
+#endif // COMMANDS_HPP
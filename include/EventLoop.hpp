@@ -0,0 +1,27 @@
+#ifndef EVENT_LOOP_HPP
+#define EVENT_LOOP_HPP
+
+#include "Bank.hpp"
+#include "Server.hpp"
+
+/*
+ * runEpollServer
+ * --------------
+ * Сервер на epoll-реакторах: reactors нитей, у каждой свой
+ * слушающий сокет с SO_REUSEPORT (ядро распределяет входящие
+ * соединения между ними) и свой edge-triggered epoll.
+ * Сокеты неблокирующие; протокол тот же текстовый, что и у
+ * режима threads.
+ *
+ * Из options берутся port, reactors (0 — по числу ядер),
+ * max_connections (общий для реакторов предел открытых соединений;
+ * сверх него — «server busy»), idle_timeout и drain_timeout.
+ * При остановке реакторы перестают читать, досылают ответы на уже
+ * принятые команды до срока drain_timeout и закрывают соединения.
+ *
+ * @param bank     — логика банка
+ * @return 0 при нормальном завершении, 1 при ошибке запуска.
+ */
+int runEpollServer(const ServerOptions &options, Bank &bank);
+
+#endif // EVENT_LOOP_HPP
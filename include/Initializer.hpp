@@ -13,8 +13,12 @@
  * @param shm_name    - имя сегмента shared memory
  * @param N           - количество счетов
  * @param max_balance - максимальный баланс для каждого счета
+ * @param capacity    - число слотов в сегменте (0 — ровно N); запас
+ *                      позволяет добавлять счета без пересоздания сегмента
+ * @param layout      - раскладка счетов: Rows (Account[]) или Columns (SoA)
  * @return Указатель на созданный объект Bank или nullptr при ошибке.
  */
-Bank* initializeBankShared(const std::string& shm_name, size_t N, int32_t max_balance);
+Bank* initializeBankShared(const std::string& shm_name, size_t N, int32_t max_balance,
+                           size_t capacity = 0, AccountLayout layout = AccountLayout::Rows);
 
 #endif // INITIALIZER_HPP
\ No newline at end of file
@@ -0,0 +1,101 @@
+#ifndef LEDGER_HPP
+#define LEDGER_HPP
+
+#include "Bank.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <pthread.h>
+#include <semaphore.h>
+
+/*
+ * Ledger
+ * ------
+ * Единственный писатель Bank: изменяющие операции всех соединений
+ * выстраиваются в одну очередь и применяются одной нитью («ledger»,
+ * привязанной к ядру) строго по порядку, как в LMAX.
+ *
+ * Очередь — кольцо фиксированного размера без блокировок для многих
+ * производителей и одного потребителя: производитель занимает ячейку
+ * одним CAS по номеру позиции и публикует в ней заявку; нить ledger
+ * читает ячейки подряд без атомарных RMW. Заявка живёт на стеке
+ * вызывающего, ответ (код, нарушитель, баланс) возвращается в ней же,
+ * готовность — семафором заявки. Полное кольцо тормозит производителей
+ * (sched_yield), пустое — усыпляет нить ledger до первой публикации.
+ *
+ * Нить ledger меняет счета через Bank::apply* без мьютексов полос:
+ * других писателей нет, а срезы и снимки останавливают её между заявками
+ * (право писателя Bank). Записи журнала она дописывает в порядке
+ * применения (applied()) и возвращает LSN в заявке; fdatasync ждёт уже
+ * нить соединения, так что пока одна пачка уходит на диск, ledger
+ * применяет следующую. Чтения (show_*, листинг, сумма) идут мимо
+ * очереди — через seqlock и срезы Bank, как и без ledger.
+ *
+ * Банк с общей таблицей полос (файл или shared memory) ledger не
+ * принимает: в такую таблицу пишут и другие процессы.
+ */
+class Ledger
+{
+public:
+    /*
+     * @param bank     — банк, который меняет только нить ledger
+     * @param capacity — ячеек в кольце (округляется вверх до степени двойки)
+     * @param cpu      — ядро нити ledger (-1 — без привязки)
+     * Бросает std::invalid_argument, если таблица полос банка общая.
+     */
+    explicit Ledger(Bank &bank, size_t capacity = 4096, int cpu = -1);
+    ~Ledger(); // Дожидается применения всех поставленных заявок
+
+    Ledger(const Ledger &) = delete;
+    Ledger &operator=(const Ledger &) = delete;
+
+    Bank &bank() noexcept { return bank_; }
+
+    // Те же операции, что у Bank; выполняются в нити ledger
+    BankStatus tryTransfer(int from_id, int to_id, int32_t amount);
+    BankStatus tryFreeze(int id, bool frozen);
+    BankStatus tryMassUpdate(int32_t amount, int *violator = nullptr);
+    BankStatus trySetLimits(size_t id, int32_t newMin, int32_t newMax, int32_t *balance = nullptr);
+    size_t transferBatch(const Transfer *items, size_t count, BankStatus *results, bool atomic = false);
+
+    // Сколько заявок применено (номер последней по порядку ledger)
+    uint64_t applied() const noexcept { return applied_.load(std::memory_order_acquire); }
+
+    // Заявок в кольце и в работе (для метрик; приблизительно)
+    size_t depth() const noexcept
+    {
+        const uint64_t done = applied();
+        const size_t head = head_.load(std::memory_order_relaxed);
+        return head > done ? static_cast<size_t>(head - done) : 0;
+    }
+
+    struct Op;
+
+private:
+    struct Cell
+    {
+        std::atomic<size_t> seq; // == позиции: свободна, позиция + 1: заявка опубликована
+        Op *op;
+    };
+
+    Bank &bank_;
+    std::unique_ptr<Cell[]> cells_;
+    size_t mask_;
+    alignas(64) std::atomic<size_t> head_{0}; // Следующая позиция производителей
+    alignas(64) size_t tail_ = 0;             // Следующая позиция нити ledger
+    std::atomic<uint64_t> applied_{0};
+    std::atomic<bool> sleeping_{false}; // Нить ledger уснула (или собирается) на wake_
+    std::atomic<bool> stop_{false};
+    sem_t wake_;
+    pthread_t thread_;
+    int cpu_;
+
+    void submit(Op &op); // Поставить заявку и дождаться её применения
+    Op *pop() noexcept;
+    void apply(Op &op);
+    static void *threadMain(void *arg);
+};
+
+#endif // LEDGER_HPP
@@ -0,0 +1,77 @@
+#ifndef LOCK_TABLE_HPP
+#define LOCK_TABLE_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <pthread.h> // pthread_mutex_t
+
+/*
+ * TxnUndo — журнал отката незавершённого перевода.
+ * Пишется в обе полосы перевода до изменения балансов.
+ * Точка фиксации — перевод записи младшей полосы в COMMITTED.
+ * Если владелец погиб раньше, следующий захвативший полосу
+ * процесс восстанавливает старые балансы обоих счетов.
+ */
+struct TxnUndo
+{
+    enum : uint32_t
+    {
+        IDLE = 0,
+        PENDING = 1,
+        COMMITTED = 2
+    };
+
+    uint32_t state;       // IDLE / PENDING / COMMITTED
+    uint32_t lo_stripe;   // Полоса, чья запись — точка фиксации
+    uint64_t txn;         // Номер транзакции в пределах lo_stripe
+    uint64_t slot[2];     // Слоты счетов перевода
+    int32_t old_balance[2];
+};
+
+/*
+ * LockStripe — одна полоса блокировок.
+ * Счёт в слоте i защищается полосой i % stripe_count.
+ * Размер кратен кэш-линии, чтобы соседние полосы не делили её.
+ *
+ * seq — seqlock для читателей без мьютекса: писатель под mtx делает его
+ * нечётным на время изменения счетов полосы и чётным после. Читатель
+ * копирует счёт и повторяет чтение, если seq был нечётным или изменился.
+ */
+struct LockStripe
+{
+    pthread_mutex_t mtx;
+    uint64_t txn_seq;     // Счётчик транзакций, где эта полоса младшая
+    TxnUndo undo;
+    uint64_t seq;         // Нечётный — счета полосы сейчас меняются
+    char pad[64 - (sizeof(pthread_mutex_t) + 2 * sizeof(uint64_t) + sizeof(TxnUndo)) % 64];
+};
+
+/*
+ * LockTable — заголовок таблицы полос; сами полосы лежат сразу за ним.
+ * Может размещаться в куче (процессная таблица Bank) или в сегменте
+ * общей памяти — тогда мьютексы PTHREAD_PROCESS_SHARED и robust.
+ */
+struct LockTable
+{
+    pthread_mutex_t recovery_mtx; // Сериализует восстановление после EOWNERDEAD
+    uint32_t stripe_count;
+    uint32_t process_shared;      // 1 — таблица в общей памяти
+    char pad[64 - (sizeof(pthread_mutex_t) + 2 * sizeof(uint32_t)) % 64];
+
+    LockStripe *stripes() noexcept { return reinterpret_cast<LockStripe *>(this + 1); }
+};
+
+// Размер таблицы в байтах для заданного числа полос
+size_t lockTableBytes(size_t stripe_count) noexcept;
+
+/*
+ * Инициализирует таблицу в уже выделенной памяти размером lockTableBytes().
+ * Все мьютексы robust; при process_shared — ещё и PTHREAD_PROCESS_SHARED.
+ * @return 0 при успехе, код ошибки pthread при неудаче.
+ */
+int lockTableInit(LockTable *table, size_t stripe_count, bool process_shared);
+
+// Уничтожает мьютексы таблицы (память не освобождает)
+void lockTableDestroy(LockTable *table) noexcept;
+
+#endif // LOCK_TABLE_HPP
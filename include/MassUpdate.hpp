@@ -0,0 +1,50 @@
+#ifndef MASS_UPDATE_HPP
+#define MASS_UPDATE_HPP
+
+#include "AccountStore.hpp"
+
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * MassUpdate
+ * ----------
+ * Ядро Bank::massUpdate в два прохода над счетами любой раскладки:
+ *   1. проверка — для каждого счёта balance + amount ∈ [min, max]
+ *      (без переполнения int32);
+ *   2. применение — balance += amount всем счетам.
+ * Второй проход не может завершиться ошибкой, поэтому обновление
+ * атомарно: либо изменены все балансы, либо ни один.
+ *
+ * Оба прохода векторизованы под AVX2 (выбор во время выполнения по
+ * __builtin_cpu_supports, иначе скалярный цикл) и на десятках миллионов
+ * счетов делятся на куски между нитями. Для Rows поля собираются
+ * gather'ом с шагом записи, для Columns читаются подряд из колонок.
+ * Вызывающий обязан держать все полосы банка.
+ */
+
+// Счетов на нить, ниже которых параллелить невыгодно
+static constexpr size_t MASS_UPDATE_CHUNK = size_t(1) << 20;
+
+// Индекс первого счёта, нарушающего лимиты, или count
+size_t massUpdateCheck(const AccountStore &accounts, size_t count, int32_t amount,
+                       unsigned threads = 0) noexcept;
+
+// Прибавить amount ко всем балансам (после успешной massUpdateCheck)
+void massUpdateApply(const AccountStore &accounts, size_t count, int32_t amount,
+                     unsigned threads = 0) noexcept;
+
+// Однопоточные реализации — для тестов и бенчмарка
+size_t massUpdateCheckScalar(const AccountColumns &cols, size_t count, int32_t amount) noexcept;
+void massUpdateApplyScalar(const AccountColumns &cols, size_t count, int32_t amount) noexcept;
+size_t massUpdateCheckAvx2(const AccountColumns &cols, size_t count, int32_t amount) noexcept;
+void massUpdateApplyAvx2(const AccountColumns &cols, size_t count, int32_t amount) noexcept;
+size_t massUpdateCheckScalar(const Account *accounts, size_t count, int32_t amount) noexcept;
+void massUpdateApplyScalar(Account *accounts, size_t count, int32_t amount) noexcept;
+size_t massUpdateCheckAvx2(const Account *accounts, size_t count, int32_t amount) noexcept;
+void massUpdateApplyAvx2(Account *accounts, size_t count, int32_t amount) noexcept;
+
+// true, если процессор поддерживает AVX2-путь
+bool massUpdateHasAvx2() noexcept;
+
+#endif // MASS_UPDATE_HPP
@@ -0,0 +1,39 @@
+#ifndef METRICS_HPP
+#define METRICS_HPP
+
+#include <string>
+
+class Ledger;
+class ShardedBank;
+
+/*
+ * Страница метрик в текстовом формате Prometheus (0.0.4) на отдельном
+ * порту сервера (--metrics-port).
+ *
+ * Метрики строятся из Stats при каждом запросе страницы: запросы по
+ * командам и исходам, отказы по причинам, гистограмма задержек,
+ * соединения, байты, глубина очередей Ledger и шардов. Слушатель —
+ * одна нить с блокирующим accept: страницу опрашивает сборщик раз в
+ * несколько секунд, и нити соединений банка она не касается.
+ *
+ *   GET /metrics — страница метрик (и GET /)
+ *   GET /trace   — дамп Trace в формате Chrome trace JSON (при --trace)
+ */
+
+// Чьи очереди показывать (оба nullptr — у Bank очередей нет)
+struct MetricsSources
+{
+    ShardedBank *sharded = nullptr;
+    Ledger *ledger = nullptr;
+};
+
+// Дописывает в out страницу метрик
+void appendMetrics(std::string &out, const MetricsSources &sources);
+
+// Запускает нить слушателя метрик на port; false — ошибка в error
+bool startMetricsServer(int port, const MetricsSources &sources, std::string &error);
+
+// Закрывает слушатель и дожидается его нити (если он был запущен)
+void stopMetricsServer();
+
+#endif // METRICS_HPP
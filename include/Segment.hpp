@@ -0,0 +1,130 @@
+#ifndef SEGMENT_HPP
+#define SEGMENT_HPP
+
+#include "AccountStore.hpp"
+#include "LockTable.hpp"
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <pthread.h>
+
+/*
+ * Самоописывающий сегмент банка в общей памяти:
+ *
+ *   [ SegmentHeader ][ LockTable | LockStripe[S] ][ Account[capacity] ]
+ *
+ * или, с флагом SEGMENT_COLUMNAR, вместо массива записей — колонки
+ * AccountColumns (ids, balances, mins, maxes, битовая карта frozen).
+ *
+ * Заголовок хранит magic, версию раскладки, число счетов, ёмкость,
+ * шаг записи и флаги возможностей, поэтому клиенту не нужно знать N
+ * заранее, а несовместимый сегмент отклоняется при подключении.
+ * Счета сверх account_count (до capacity) — резерв для appendAccounts().
+ */
+static constexpr uint64_t SEGMENT_MAGIC = 0x31474553424E4254ull; // "TBNBSEG1"
+static constexpr uint32_t SEGMENT_VERSION = 1;
+
+// Флаги возможностей сегмента
+enum SegmentFeature : uint32_t
+{
+    SEGMENT_ROBUST_LOCKS = 1u << 0, // Таблица robust-мьютексов PTHREAD_PROCESS_SHARED
+    SEGMENT_UNDO_JOURNAL = 1u << 1, // Журнал отката переводов в полосах
+    SEGMENT_COLUMNAR = 1u << 2,     // Счета в раскладке Columns
+};
+static constexpr uint32_t SEGMENT_KNOWN_FEATURES =
+    SEGMENT_ROBUST_LOCKS | SEGMENT_UNDO_JOURNAL | SEGMENT_COLUMNAR;
+
+static constexpr size_t SEGMENT_LOCK_STRIPES = 1024;
+
+struct SegmentHeader
+{
+    uint64_t magic;
+    uint32_t version;
+    uint32_t header_bytes;   // sizeof(SegmentHeader) на момент создания
+    uint32_t record_stride;  // sizeof(Account); 0 для SEGMENT_COLUMNAR
+    uint32_t flags;          // SegmentFeature
+    uint32_t stripe_count;
+    uint32_t reserved;
+    uint64_t capacity;       // Число слотов под счета
+    uint64_t account_count;  // Число занятых слотов (читать атомарно)
+    uint64_t locks_offset;
+    uint64_t accounts_offset;
+    uint64_t segment_bytes;
+    pthread_mutex_t grow_mtx; // Сериализует appendAccounts между процессами
+};
+
+/*
+ * SegmentView — отображённый в память сегмент и указатели на его части.
+ */
+struct SegmentView
+{
+    void *base = nullptr;
+    size_t bytes = 0;
+    SegmentHeader *header = nullptr;
+    LockTable *locks = nullptr;
+    AccountStore accounts;   // Счета в раскладке сегмента
+    int fd = -1;             // Открытый файл сегмента (только для файлового режима)
+
+    size_t accountCount() const noexcept
+    {
+        return static_cast<size_t>(__atomic_load_n(&header->account_count, __ATOMIC_ACQUIRE));
+    }
+};
+
+// Полный размер сегмента с заданной ёмкостью
+size_t segmentBytes(size_t capacity, AccountLayout layout = AccountLayout::Rows) noexcept;
+
+/*
+ * Размечает память mem (не меньше segmentBytes(capacity)):
+ * заголовок, таблица блокировок и count счетов с ID 0..count-1.
+ * magic пишется последним, поэтому наполовину созданный сегмент не подключится.
+ */
+bool formatSegment(void *mem, size_t bytes, size_t count, size_t capacity,
+                   int32_t max_balance, std::string &error,
+                   AccountLayout layout = AccountLayout::Rows);
+
+// Проверяет заголовок и заполняет view для уже отображённой памяти
+bool bindSegment(void *mem, size_t bytes, SegmentView &view, std::string &error);
+
+// Создаёт (или пересоздаёт) сегмент shm_name и отображает его
+bool createShmSegment(const std::string &shm_name, size_t count, size_t capacity,
+                      int32_t max_balance, SegmentView &view, std::string &error,
+                      AccountLayout layout = AccountLayout::Rows);
+
+// Подключается к существующему сегменту, читая размеры из заголовка
+bool attachShmSegment(const std::string &shm_name, SegmentView &view, std::string &error);
+
+/*
+ * Файловый режим: тот же сегмент в обычном файле, отображённом MAP_SHARED.
+ * Данные переживают перезагрузку, размер не ограничен /dev/shm и может
+ * превышать объём памяти — страницы подгружаются при первом обращении.
+ *
+ * Каждый подключённый процесс держит разделяемую fcntl-блокировку файла.
+ * Первый подключившийся (никто больше не держит её) считает мьютексы в
+ * файле устаревшими — их владельцы погибли вместе с системой: откатывает
+ * незавершённые переводы по TxnUndo и заново инициализирует таблицу полос.
+ */
+
+// Создаёт (или пересоздаёт, если файл никем не используется) файловый сегмент
+bool createFileSegment(const std::string &path, size_t count, size_t capacity,
+                       int32_t max_balance, SegmentView &view, std::string &error,
+                       AccountLayout layout = AccountLayout::Rows);
+
+// Подключается к существующему файловому сегменту
+bool attachFileSegment(const std::string &path, SegmentView &view, std::string &error);
+
+// Точка сброса: записать изменённые страницы сегмента на диск (msync)
+bool syncSegment(const SegmentView &view, std::string &error);
+
+// Снимает отображение (и закрывает файл файлового сегмента)
+void detachSegment(SegmentView &view) noexcept;
+
+/*
+ * Добавляет k счетов в резерв сегмента без его пересоздания.
+ * Новые счета получают следующие по порядку ID; подключённые процессы
+ * видят их через Bank при следующем обращении.
+ */
+bool appendAccounts(SegmentView &view, size_t k, int32_t max_balance, std::string &error);
+
+#endif // SEGMENT_HPP
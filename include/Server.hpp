@@ -2,13 +2,56 @@
 #define SERVER_HPP
 
 #include "Bank.hpp"
+#include "ShardedBank.hpp"
+#include "Ledger.hpp"
 #include <cstdint>
+#include <string>
 
 /*
  * DEFAULT_PORT — порт по умолчанию, на котором сервер слушает входящие подключения.
  */
 static constexpr int DEFAULT_PORT = 12345;
 
+/*
+ * ServerOptions — параметры запуска сервера.
+ *   mode     — модель обработки соединений:
+ *              Threads — пул нитей-обработчиков с очередью соединений;
+ *              Epoll   — фиксированный набор epoll-реакторов.
+ *   reactors — число реакторов в режиме Epoll (0 — по числу ядер).
+ *   workers  — нитей-обработчиков соединений в режиме Threads: каждая
+ *              обслуживает одно соединение за раз.
+ *   max_connections — сколько соединений сервер держит одновременно
+ *              (обслуживаемые и ждущие обработчика); сверх этого новое
+ *              соединение получает «server busy» и закрывается.
+ *   idle_timeout — секунд без данных от клиента до закрытия соединения
+ *              (0 — не закрывать); столько же соединение может ждать
+ *              обработчика в очереди.
+ *   drain_timeout — при остановке: секунд, за которые открытые соединения
+ *              дорабатывают принятые команды и досылают ответы; затем
+ *              оставшиеся соединения рвутся (после текущей команды).
+ *   metrics_port — порт страницы метрик Prometheus (0 — не открывать).
+ *   trace_path   — включить трассировку фаз запросов (Trace.hpp) и записать
+ *                  её в этот файл при остановке (пусто — выключена).
+ */
+struct ServerOptions
+{
+    enum class Mode
+    {
+        Threads,
+        Epoll
+    };
+
+    int port = DEFAULT_PORT;
+    Mode mode = Mode::Threads;
+    unsigned reactors = 0;
+    unsigned workers = 64;
+    unsigned max_connections = 1024;
+    unsigned idle_timeout = 300;
+    unsigned drain_timeout = 10;
+    int metrics_port = 0;
+    std::string trace_path;
+};
+
 /*
  * startServer
  * -----------
@@ -20,4 +63,13 @@ static constexpr int DEFAULT_PORT = 12345;
  */
 int startServer(int port, Bank& bank);
 
+// То же, с выбором модели обработки соединений
+int startServer(const ServerOptions& options, Bank& bank);
+
+// Сервер над шардированным банком (только Mode::Threads)
+int startServer(const ServerOptions& options, ShardedBank& bank);
+
+// Изменения — через очередь единственного писателя Ledger (только Mode::Threads)
+int startServer(const ServerOptions& options, Ledger& ledger);
+
 #endif // SERVER_HPP
@@ -0,0 +1,63 @@
+#ifndef SERVER_CORE_HPP
+#define SERVER_CORE_HPP
+
+#include "Bank.hpp"
+#include "Commands.hpp"
+
+#include <string>
+
+/*
+ * Общая часть TCP-сервера, не зависящая от модели обработки соединений
+ * (поток на соединение или epoll-реакторы): выполнение текстовых команд,
+ * приветствие, статистика и флаг остановки.
+ */
+
+// Итог выполнения одной строки протокола
+enum class LineResult
+{
+    Continue, // продолжаем обслуживать соединение
+    Shutdown  // клиент запросил остановку сервера — соединение закрывается
+};
+
+/*
+ * Выполняет одну строку текстового протокола [begin, end) — команду
+ * реестра Commands.hpp для сервера — и дописывает ответ в out.
+ * Если задан listing, show_account_list только запускается в нём
+ * (с первой порцией строк), и вызывающий дописывает остальное через
+ * listing->fill() по мере отправки; иначе листинг выводится целиком.
+ */
+LineResult executeLine(Bank &bank, const char *begin, const char *end, std::string &out,
+                       AccountListing *listing = nullptr);
+LineResult executeLine(ShardedBank &bank, const char *begin, const char *end, std::string &out,
+                       AccountListing *listing = nullptr);
+LineResult executeLine(Ledger &ledger, const char *begin, const char *end, std::string &out,
+                       AccountListing *listing = nullptr);
+
+// Дописывает приветствие и список команд, отправляемые при подключении
+void appendWelcome(std::string &out);
+
+// Отказ при переполнении: строка BUSY_REPLY без ожидания, затем close(fd)
+void rejectBusy(int fd);
+
+extern const char BUSY_REPLY[];
+
+// Запускает фоновую нить, раз в 5 секунд печатающую сводку Stats
+void startStatsThread();
+
+// Поднимает флаг остановки и дожидается выхода нити статистики
+void stopStatsThread();
+
+// Итоговая сводка Stats при остановке (с соединениями), со сбросом cout
+void printStats();
+
+/*
+ * Флаг остановки сервера. requestShutdown() безопасна для обработчика
+ * сигналов: поднимает флаг и будит всех ожидающих через wakeFd().
+ */
+bool shutdownRequested();
+void requestShutdown();
+
+// eventfd, становящийся читаемым при остановке (для epoll-реакторов)
+int wakeFd();
+
+#endif // SERVER_CORE_HPP
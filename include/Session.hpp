@@ -0,0 +1,109 @@
+#ifndef SESSION_HPP
+#define SESSION_HPP
+
+#include "Bank.hpp"
+#include "AccountListing.hpp"
+
+#include <string>
+
+class Ledger;
+class ShardedBank;
+
+/*
+ * Session — состояние одного TCP-соединения, общее для обеих моделей
+ * сервера (поток на соединение и epoll-реакторы).
+ *
+ * Входящий поток байт копится в буфере и режется по '\n': одна порция
+ * может содержать много команд (конвейер) или кусок команды, которая
+ * дочитается следующим recv(). Ответы на все команды порции копятся
+ * в одном выходном буфере и уходят одним send().
+ *
+ * show_account_list выдаётся потоково (AccountListing): в буфер кладётся
+ * одна порция строк, следующая — когда consume() опустошит буфер. Пока
+ * листинг идёт, следующие команды конвейера ждут во входном буфере.
+ *
+ * Память сессии ограничена: пока идёт листинг или неотправленного
+ * больше MAX_PENDING_OUT, wantsInput() ложно и сервер не читает сокет;
+ * входной буфер сверх MAX_INPUT (клиент шлёт, не читая ответов) —
+ * ошибка и закрытие.
+ *
+ * Если первый байт соединения — BIN_HANDSHAKE, сессия переходит на
+ * бинарный протокол (BinaryProtocol.hpp) и режет поток на кадры по
+ * их длине вместо '\n'.
+ *
+ * Сессия над ShardedBank выполняет те же команды через очереди шардов,
+ * над Ledger — изменения через очередь его единственного писателя.
+ */
+class Session
+{
+public:
+    // Максимальная длина строки без '\n'; длиннее — ошибка и закрытие
+    // (с запасом под длинный transfer_batch)
+    static constexpr size_t MAX_LINE = 1024 * 1024;
+    // Предел входного буфера с ждущими командами конвейера (и во время листинга)
+    static constexpr size_t MAX_INPUT = 4 * MAX_LINE;
+    // Неотправленных байт, сверх которых сессия не принимает ввод
+    static constexpr size_t MAX_PENDING_OUT = MAX_LINE;
+
+    explicit Session(Bank &bank);
+    explicit Session(ShardedBank &bank);
+    explicit Session(Ledger &ledger);
+
+    // Дописывает приветствие в выходной буфер
+    void start();
+
+    // Принимает порцию байт и выполняет все полные строки в ней
+    void feed(const char *data, size_t n);
+
+    // Клиент закрыл соединение: выполнить недописанный хвост как команду
+    void finish();
+
+    // Сервер останавливается: дочитанные строки выполняются (и листинг
+    // досылается), недописанный хвост отбрасывается — команда без '\n'
+    // могла быть оборвана на полуслове
+    void drain();
+
+    // Соединение нужно закрыть, как только выходной буфер опустеет
+    bool closing() const noexcept { return closing_; }
+
+    // Сессия готова к новому вводу: листинг закончен, ответы почти отправлены
+    bool wantsInput() const noexcept
+    {
+        return !closing_ && !listing_.active() && outSize() <= MAX_PENDING_OUT;
+    }
+
+    // Неотправленная часть выходного буфера
+    const char *outData() const noexcept { return out_.data() + out_off_; }
+    size_t outSize() const noexcept { return out_.size() - out_off_; }
+
+    // Отметить n байт как отправленные (опустевший буфер пополняется листингом)
+    void consume(size_t n);
+
+private:
+    enum class Protocol
+    {
+        Undecided, // ещё не получено ни одного байта
+        Text,
+        Binary
+    };
+
+    Bank *bank_; // Ровно один из трёх
+    ShardedBank *sharded_;
+    Ledger *ledger_;
+    Protocol protocol_ = Protocol::Undecided;
+    std::string in_;
+    std::string out_;
+    size_t out_off_ = 0;
+    bool closing_ = false;
+    bool finished_ = false;   // Клиент закрыл поток, хвост ждёт конца листинга
+    bool draining_ = false;   // Хвост не выполнять (drain)
+    AccountListing listing_;
+
+    void executeBuffered(const char *begin, const char *end);
+    // Выполнить полные строки входного буфера (и хвост после finish)
+    void resumeText();
+    void feedText(const char *data, size_t n);
+    void feedBinary(const char *data, size_t n);
+};
+
+#endif // SESSION_HPP
@@ -0,0 +1,98 @@
+#ifndef SHARDED_BANK_HPP
+#define SHARDED_BANK_HPP
+
+#include "Bank.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <pthread.h>
+#include <vector>
+
+/*
+ * ShardedBank
+ * -----------
+ * Счета, разбитые по ID на K шардов (шард счёта — id mod K).
+ *
+ * Шард владеет своими счетами и одной нитью-исполнителем, привязанной
+ * к своему ядру. Счета шарда выделяет и заполняет его нить (страницы
+ * ложатся на узел памяти этого ядра), и только она их меняет: вызывающий
+ * кладёт заявку в очередь шарда-владельца и ждёт ответа. Блокировок
+ * счетов внутри шарда нет вовсе.
+ *
+ * Перевод между шардами — в две фазы, и ни одна нить шарда не ждёт
+ * другую, поэтому взаимных блокировок нет:
+ *   1. резерв — шарды обеих сторон по возрастанию номера проверяют свою
+ *      половину (заморозка, лимиты с учётом чужих резервов) и откладывают
+ *      сумму; отказ второго шарда снимает резерв первого;
+ *   2. фиксация — оба шарда применяют свои половины; они уже проверены
+ *      и отказать не могут.
+ *
+ * massUpdate, атомарный пакет и согласованные чтения (срез, сумма)
+ * останавливают все шарды барьером. Барьер и фиксации переводов
+ * разделены rwlock: срез не увидит сумму, уже списанную с одного
+ * шарда и ещё не зачисленную на другой.
+ *
+ * Счета задаются при создании и живут в куче процесса: журнал, снимки
+ * и общая память остаются за Bank.
+ */
+class ShardedBank
+{
+public:
+    /*
+     * @param accounts — начальные счета; копируются в шарды по ID
+     * @param shards   — число шардов (0 — по числу ядер)
+     * @param pin      — привязать нить шарда k к ядру k mod (число ядер)
+     */
+    ShardedBank(const Account *accounts, size_t count, size_t shards = 0, bool pin = true);
+    ~ShardedBank();
+
+    ShardedBank(const ShardedBank &) = delete;
+    ShardedBank &operator=(const ShardedBank &) = delete;
+
+    size_t shardCount() const noexcept { return shards_.size(); }
+    size_t shardOf(int id) const noexcept { return static_cast<uint32_t>(id) % shards_.size(); }
+    size_t getAccountCount() const noexcept { return count_; }
+
+    // Операции и коды отказа — как у Bank
+    BankStatus tryTransfer(int from_id, int to_id, int32_t amount);
+    BankStatus tryFreeze(int id, bool frozen);
+    BankStatus tryMassUpdate(int32_t amount, int *violator = nullptr);
+    BankStatus trySetLimits(size_t id, int32_t newMin, int32_t newMax, int32_t *balance = nullptr);
+
+    /*
+     * Пакет переводов. Неатомарный — переводы по одному (между шардами
+     * в две фазы); атомарный — весь пакет под барьером, с откатом при
+     * первом отказе. @return число применённых переводов.
+     */
+    size_t transferBatch(const Transfer *items, size_t count, BankStatus *results, bool atomic = false);
+
+    // Счёт по ID (не по номеру слота, как Bank::getAccount)
+    BankStatus getAccount(int id, Account &out);
+
+    // Согласованная копия всех счетов (шард за шардом); возвращает сумму балансов
+    int64_t snapshot(std::vector<Account> &out);
+    int64_t totalBalance();
+
+    // Заявок, ждущих в очереди шарда (для метрик)
+    size_t queueDepth(size_t shard);
+
+    struct Shard;
+    struct Op;
+
+private:
+    std::vector<std::unique_ptr<Shard>> shards_;
+    size_t count_;
+    pthread_mutex_t barrier_mtx_;  // Барьеры по одному
+    pthread_rwlock_t commit_lock_; // Фиксации переводов (чтение) против барьеров (запись)
+
+    void post(size_t shard, Op &op);
+    void run(size_t shard, Op &op); // post и ожидание ответа
+
+    // Остановить все шарды: каждая нить выполняет ops[k].phase1 и ждёт
+    void parkAll(Op *ops);
+    // Отпустить шарды; при commit нити перед продолжением выполняют phase2
+    void releaseAll(Op *ops, bool commit);
+};
+
+#endif // SHARDED_BANK_HPP
@@ -0,0 +1,81 @@
+#ifndef SNAPSHOT_HPP
+#define SNAPSHOT_HPP
+
+#include "Bank.hpp"
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+class TxnLog;
+
+/*
+ * Снимок счетов — двоичная копия хранилища Bank на момент времени.
+ *
+ * Файл: [ SnapshotHeader ][ образ счетов ]
+ *
+ * Образ повторяет раскладку в памяти: для Rows — Account[count], для
+ * Columns — колонки bindColumns(count). Поэтому восстановление — одно
+ * отображение файла и копирование без разбора записей.
+ *
+ * Файл пишется во временный path + ".tmp" и атомарно переименовывается:
+ * на диске всегда лежит целый предыдущий или целый новый снимок.
+ */
+
+static constexpr uint64_t SNAPSHOT_MAGIC = 0x504e534b4e414254ull; // "TBANKSNP"
+static constexpr uint32_t SNAPSHOT_VERSION = 1;
+
+struct SnapshotHeader
+{
+    uint64_t magic;
+    uint32_t version;
+    uint32_t layout;         // AccountLayout
+    uint32_t record_stride;  // sizeof(Account); 0 для Columns
+    uint32_t reserved;
+    uint64_t account_count;
+    uint64_t log_lsn;        // Последняя запись TxnLog, отражённая в снимке (0 — без журнала)
+    uint64_t payload_bytes;  // Размер образа после заголовка
+    char pad[16];
+};
+static_assert(sizeof(SnapshotHeader) == 64, "SnapshotHeader layout is part of the file format");
+
+// Время снятия снимка: сколько операции стояли и сколько всего шла запись
+struct SnapshotTiming
+{
+    double pause_ms = 0;
+    double total_ms = 0;
+};
+
+// Размер образа count счетов в раскладке layout
+size_t snapshotPayloadBytes(AccountLayout layout, size_t count) noexcept;
+
+/*
+ * Неблокирующий снимок банка в куче (server): под всеми полосами
+ * запоминается LSN журнала и делается fork(); дочерний процесс пишет
+ * свою копию счетов (copy-on-write), а операции продолжаются сразу
+ * после fork. Вызывающий ждёт окончания записи; если задан log,
+ * снимок публикуется только когда долговечны все вошедшие в него записи.
+ */
+bool forkSnapshot(Bank &bank, const std::string &path, TxnLog *log, std::string &error,
+                  SnapshotTiming *timing = nullptr);
+
+/*
+ * Снимок счетов в общей памяти (сегмент initializer): файл снимка
+ * отображается в память, и счета копируются в него прямо из сегмента
+ * под всеми полосами. fork здесь не помогает — сегмент MAP_SHARED.
+ */
+bool dumpSnapshot(Bank &bank, const std::string &path, std::string &error,
+                  SnapshotTiming *timing = nullptr);
+
+// Прочитать и проверить заголовок снимка (в том числе размер файла)
+bool readSnapshotHeader(const std::string &path, SnapshotHeader &header, std::string &error);
+
+/*
+ * Загрузить образ снимка в хранилище dst той же раскладки,
+ * рассчитанное не меньше чем на header.account_count счетов.
+ * Bank поверх dst строится после загрузки.
+ */
+bool loadSnapshot(const std::string &path, const SnapshotHeader &header,
+                  const AccountStore &dst, std::string &error);
+
+#endif // SNAPSHOT_HPP
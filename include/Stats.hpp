@@ -0,0 +1,94 @@
+#ifndef STATS_HPP
+#define STATS_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/*
+ * Статистика запросов сервера без общих блокировок.
+ *
+ * Каждая нить пишет только в свой слот (выровнен по строке кэша): счётчики
+ * ok/отказов по командам и гистограмму задержек — обычные инкременты без
+ * атомарных RMW и без разделяемых строк кэша. Слот нити, завершившейся
+ * вместе с соединением, достаётся следующей новой нити, так что слотов не
+ * больше, чем нитей одновременно. Суммирует слоты только читатель: таймер
+ * статистики и команда stats.
+ *
+ * Гистограмма — логарифмические корзины в духе HDR: по 8 корзин на каждую
+ * степень двойки наносекунд (погрешность перцентиля не больше 12.5%).
+ *
+ * Там же — байты через сокеты и отказы по причинам; число соединений
+ * меняется редко и ведётся одним общим счётчиком.
+ */
+
+// Видов запросов: индекс — CommandId (0 — неизвестная команда)
+static constexpr size_t STATS_KINDS = 32;
+
+// Корзин гистограммы: 16 точных (0…15 нс) и по 8 на каждую степень двойки выше
+static constexpr size_t STATS_BUCKETS = 16 + (64 - 4) * 8;
+
+// Исход запроса: 0 — успех, 1…15 — код BankStatus, дальше — отказы вне Bank
+enum StatsReason : unsigned
+{
+    STATS_OK = 0,
+    STATS_USAGE = 16,    // Неверные аргументы или кадр
+    STATS_UNKNOWN = 17,  // Неизвестная команда
+    STATS_INTERNAL = 18, // Исключение, не связанное с отказом Bank
+    STATS_REASONS = 19,
+};
+
+struct StatsSummary
+{
+    uint64_t ok[STATS_KINDS];
+    uint64_t rejected[STATS_KINDS];
+    uint64_t buckets[STATS_BUCKETS];
+    uint64_t reasons[STATS_REASONS]; // reasons[0] не используется
+    uint64_t latency_ns;             // Сумма задержек
+    uint64_t bytes_in, bytes_out;
+    uint64_t connections, connections_active;
+    uint64_t connections_busy; // Отклонены: очередь соединений полна
+    uint64_t connections_idle; // Закрыты по таймауту простоя
+
+    uint64_t total() const noexcept;
+    uint64_t totalRejected() const noexcept;
+    // Задержка (нс), не меньше которой доля q запросов (0 < q ≤ 1); 0 — запросов не было
+    uint64_t percentile(double q) const noexcept;
+};
+
+// Учесть запрос вида kind с исходом reason (StatsReason), выполненный за ns наносекунд
+void statsRecord(unsigned kind, unsigned reason, uint64_t ns) noexcept;
+
+// Байты, принятые из сокета и отправленные в него
+void statsBytes(uint64_t in, uint64_t out) noexcept;
+
+// Соединение открыто (opened) или закрыто
+void statsConnection(bool opened) noexcept;
+
+// Соединение отклонено ответом «server busy» (в открытые не входит)
+void statsConnectionBusy() noexcept;
+
+// Соединение закрыто сервером по таймауту простоя (закрытие учитывается и в statsConnection)
+void statsConnectionIdle() noexcept;
+
+// Имя причины отказа ("InsufficientFunds", "Usage", ...)
+const char *statsReasonName(unsigned reason) noexcept;
+
+// Сумма всех слотов на данный момент
+void statsCollect(StatsSummary &out);
+
+/*
+ * Дописывает в out ответ команды stats:
+ *   Requests: N (ok X, rejected Y)
+ *   Latency ns: p50 A, p99 B, p999 C
+ *     <команда>: N (ok X, rejected Y)   — для каждой встречавшейся
+ *     rejected <причина>: N              — для каждой встречавшейся
+ *   Connections: active A, total T, busy B, idle I; bytes in I, out O
+ */
+void appendStats(std::string &out);
+
+// Номер корзины гистограммы для задержки ns и верхняя граница корзины
+size_t statsBucket(uint64_t ns) noexcept;
+uint64_t statsBucketLimit(size_t bucket) noexcept;
+
+#endif // STATS_HPP
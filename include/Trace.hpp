@@ -0,0 +1,79 @@
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/*
+ * Трассировка фаз запросов (включается явно, --trace на сервере).
+ *
+ * Каждая нить пишет интервалы (начало, длительность, фаза, команда,
+ * номер запроса нити) в своё кольцо фиксированного размера: без
+ * блокировок и аллокаций, старые события затираются новыми. Пока
+ * трассировка выключена, TraceSpan — одна проверка флага.
+ *
+ * traceDump собирает кольца всех нитей в JSON формата Chrome trace
+ * (chrome://tracing, Perfetto): событие "X" на интервал, нить — tid.
+ * Кольцо читается на ходу, поэтому событие, которое нить переписывает
+ * в этот момент, может попасть в дамп смешанным.
+ */
+
+enum class TracePhase : uint8_t
+{
+    Parse, // Разбор строки и поиск команды
+    Lock,  // Захват полос счетов
+    Queue, // Ожидание в очереди Ledger или шарда
+    Apply, // Выполнение команды целиком
+    Send,  // send() ответа
+};
+
+extern std::atomic<bool> trace_enabled;
+
+inline bool traceEnabled() noexcept
+{
+    return trace_enabled.load(std::memory_order_relaxed);
+}
+
+// Включить запись; events — ёмкость кольца одной нити (округляется до степени двойки)
+void traceEnable(size_t events = 8192);
+
+// Начало очередного запроса нити: следующие интервалы помечаются им и командой kind
+void traceBeginRequest(unsigned kind) noexcept;
+
+// Текущее время в наносекундах (steady_clock)
+uint64_t traceNow() noexcept;
+
+// Записать интервал [start, start + ns) фазы phase текущего запроса нити
+void traceRecord(TracePhase phase, uint64_t start, uint64_t ns) noexcept;
+
+// Интервал от создания до разрушения объекта (если трассировка включена)
+class TraceSpan
+{
+public:
+    explicit TraceSpan(TracePhase phase) noexcept
+        : phase_(phase), start_(traceEnabled() ? traceNow() : 0)
+    {
+    }
+    ~TraceSpan()
+    {
+        if (start_)
+            traceRecord(phase_, start_, traceNow() - start_);
+    }
+
+    TraceSpan(const TraceSpan &) = delete;
+    TraceSpan &operator=(const TraceSpan &) = delete;
+
+private:
+    TracePhase phase_;
+    uint64_t start_;
+};
+
+// Дописывает в out все события колец в формате Chrome trace JSON
+void traceDump(std::string &out);
+
+// Записывает дамп в файл path
+bool traceWrite(const std::string &path, std::string &error);
+
+#endif // TRACE_HPP
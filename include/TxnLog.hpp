@@ -0,0 +1,145 @@
+#ifndef TXN_LOG_HPP
+#define TXN_LOG_HPP
+
+#include "Bank.hpp"
+
+#include <cstdint>
+#include <cstddef>
+#include <pthread.h> // pthread_*
+#include <string>
+
+/*
+ * Журнал упреждающей записи (WAL) изменяющих операций Bank.
+ *
+ * Файл: [ TxnLogHeader ][ TxnRecord ][ TxnRecord ] ...
+ *
+ * Записи фиксированного размера с номером (LSN) и CRC32. Bank дописывает
+ * запись под полосами счетов операции, поэтому порядок записей о
+ * конфликтующих операциях совпадает с порядком их применения. Перед
+ * ответом клиенту Bank ждёт, пока запись станет долговечной.
+ *
+ * Групповая фиксация: отдельная нить пишет всё накопленное одним write()
+ * и одним fdatasync(); операции, пришедшие во время fdatasync, уходят
+ * следующей пачкой. window_us — дополнительное ожидание попутчиков
+ * перед каждой пачкой (больше пропускная способность, выше задержка).
+ *
+ * При открытии существующего журнала записи воспроизводятся в Bank,
+ * а недописанный хвост (обрыв посреди записи, неверный CRC) отрезается.
+ */
+
+enum class TxnOp : uint8_t
+{
+    Transfer = 1,   // a → b, сумма c
+    Freeze = 2,     // счёт a
+    Unfreeze = 3,   // счёт a
+    MassUpdate = 4, // сумма a
+    SetLimits = 5,  // счёт a, min b, max c
+};
+
+struct TxnRecord
+{
+    uint64_t lsn;     // Номер записи, с 1 без пропусков
+    uint8_t op;       // TxnOp
+    uint8_t pad[3];
+    int32_t a;
+    int32_t b;
+    int32_t c;
+    uint32_t reserved;
+    uint32_t crc;     // CRC32 всех предыдущих полей
+};
+static_assert(sizeof(TxnRecord) == 32, "TxnRecord layout is part of the log format");
+
+static constexpr uint64_t TXN_LOG_MAGIC = 0x4c41574b4e414254ull; // "TBANKWAL"
+static constexpr uint32_t TXN_LOG_VERSION = 1;
+
+struct TxnLogHeader
+{
+    uint64_t magic;
+    uint32_t version;
+    uint32_t record_bytes;  // sizeof(TxnRecord)
+    uint64_t account_count; // Число счетов банка, для которого ведётся журнал
+    char pad[40];
+};
+static_assert(sizeof(TxnLogHeader) == 64, "TxnLogHeader layout is part of the log format");
+
+struct TxnLogOptions
+{
+    bool group_commit = true; // false — fdatasync на каждую операцию
+    unsigned window_us = 0;   // Ожидание попутчиков перед fdatasync пачки
+};
+
+class TxnLog
+{
+public:
+    TxnLog();
+    ~TxnLog();
+
+    TxnLog(const TxnLog &) = delete;
+    TxnLog &operator=(const TxnLog &) = delete;
+
+    /*
+     * Открывает (или создаёт) журнал path, воспроизводит его записи в bank
+     * и подключает журнал к bank. bank должен быть в начальном состоянии —
+     * том же, с которого журнал начинался, — либо восстановлен из снимка,
+     * уже содержащего записи до applied_lsn включительно (они пропускаются).
+     * @return false и текст в error, если журнал несовместим, не читается,
+     *         короче снимка или его записи не применяются к bank.
+     */
+    bool open(const std::string &path, Bank &bank, const TxnLogOptions &options,
+              std::string &error, uint64_t applied_lsn = 0);
+
+    /*
+     * Дожидается записи всех операций, отключает журнал от Bank и
+     * закрывает файл. Вызывать, когда операции над Bank уже не идут.
+     */
+    void close();
+
+    // Число записей, воспроизведённых при open()
+    uint64_t replayed() const noexcept { return replayed_; }
+
+    /*
+     * LSN последней выданной записи. Под Bank::lockAllStripes() это
+     * ровно последняя операция, уже отражённая в счетах.
+     */
+    uint64_t lastLsn();
+
+    /*
+     * Дописать запись; возвращает её LSN. В режиме group_commit только
+     * кладёт запись в буфер, иначе сразу пишет и делает fdatasync.
+     */
+    uint64_t append(TxnOp op, int32_t a, int32_t b = 0, int32_t c = 0);
+
+    // Дописать применённые переводы пакета (results[i] == Ok); LSN последнего или 0
+    uint64_t appendTransfers(const Transfer *items, const BankStatus *results, size_t count);
+
+    /*
+     * Ждать, пока записи до lsn включительно станут долговечными.
+     * Бросает std::runtime_error, если запись в файл не удалась.
+     */
+    void waitDurable(uint64_t lsn);
+
+private:
+    int fd_;
+    Bank *bank_;
+    TxnLogOptions options_;
+    uint64_t replayed_;
+
+    pthread_mutex_t mtx_;
+    pthread_cond_t work_cond_;    // В буфере появились записи
+    pthread_cond_t durable_cond_; // durable_lsn_ продвинулся
+    std::string buf_;             // Ещё не записанные записи
+    uint64_t next_lsn_;           // LSN последней выданной записи
+    uint64_t durable_lsn_;        // LSN последней записи на диске
+    bool stop_;
+    bool failed_;
+    std::string failure_;
+    pthread_t writer_;
+    bool writer_started_;
+
+    void appendLocked(TxnOp op, int32_t a, int32_t b, int32_t c);
+    bool flushLocked();
+    void writerLoop();
+    static void *writerMain(void *arg);
+};
+
+#endif // TXN_LOG_HPP
@@ -0,0 +1,65 @@
+#include "AccountIndex.hpp"
+
+#include <stdexcept>
+
+constexpr size_t AccountIndex::NOT_FOUND;
+constexpr uint32_t AccountIndex::EMPTY;
+
+void AccountIndex::build(const AccountStore &accounts, size_t count)
+{
+    count_.store(count, std::memory_order_release);
+    table_.clear();
+    mask_ = 0;
+
+    base_id_ = count ? accounts.id(0) : 0;
+    dense_ = true;
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (accounts.id(i) != base_id_ + static_cast<int64_t>(i))
+        {
+            dense_ = false;
+            break;
+        }
+    }
+    if (dense_)
+        return;
+
+    if (count >= EMPTY)
+        throw std::length_error("AccountIndex: too many accounts for sparse index");
+
+    // Загрузка не выше 50%: короткие цепочки пробирования
+    size_t capacity = 16;
+    while (capacity < count * 2)
+        capacity <<= 1;
+    table_.assign(capacity, Entry{0, EMPTY});
+    mask_ = capacity - 1;
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        int id = accounts.id(i);
+        size_t pos = hash(id) & mask_;
+        while (table_[pos].slot != EMPTY && table_[pos].id != id)
+            pos = (pos + 1) & mask_;
+        // При дубликатах ID выигрывает первый слот — как при линейном поиске
+        if (table_[pos].slot == EMPTY)
+            table_[pos] = Entry{id, static_cast<uint32_t>(i)};
+    }
+}
+
+bool AccountIndex::grow(const AccountStore &accounts, size_t new_count)
+{
+    size_t old_count = count_.load(std::memory_order_relaxed);
+    if (new_count <= old_count)
+        return true;
+    if (dense_)
+    {
+        for (size_t i = old_count; i < new_count; ++i)
+        {
+            if (accounts.id(i) != base_id_ + static_cast<int64_t>(i))
+                return false;
+        }
+        count_.store(new_count, std::memory_order_release);
+        return true;
+    }
+    return false;
+}
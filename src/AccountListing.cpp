@@ -0,0 +1,150 @@
+#include "AccountListing.hpp"
+#include "ShardedBank.hpp"
+
+#include <algorithm> // std::sort
+#include <cstring>   // memcpy
+
+// Строка таблицы show_account_list; возвращает её длину вместе с '\n'
+static size_t formatAccountRow(char *row, const Account &a)
+{
+    char *p = formatInt(row, a.account_id, 3);
+    std::memcpy(p, " | ", 3);
+    p = formatInt(p + 3, a.balance, 11);
+    std::memcpy(p, " | ", 3);
+    p = formatInt(p + 3, a.min_balance, 9);
+    std::memcpy(p, " | ", 3);
+    p = formatInt(p + 3, a.max_balance, 9);
+    std::memcpy(p, a.frozen ? " | true\n" : " | false\n", a.frozen ? 8 : 9);
+    return static_cast<size_t>(p - row) + (a.frozen ? 8 : 9);
+}
+
+constexpr size_t AccountListing::CHUNK;
+constexpr size_t AccountListing::WINDOW;
+
+// Фильтры и страница; при успехе — шапка таблицы в out
+bool AccountListing::parseArgs(Tokenizer &args, std::string &out)
+{
+    frozen_only_ = false;
+    footer_ = false;
+    lo_ = INT32_MIN;
+    hi_ = INT32_MAX;
+    offset_ = 0;
+    size_t limit = SIZE_MAX;
+    int numbers = 0;
+    bool bad = false;
+    Token tok;
+    while (!bad && args.next(tok))
+    {
+        footer_ = true;
+        if (tok == "frozen")
+            frozen_only_ = true;
+        else if (tok == "balance")
+            bad = !args.nextInt(lo_) || !args.nextInt(hi_) || lo_ > hi_;
+        else if (numbers < 2 && parseCount(tok, numbers == 0 ? offset_ : limit))
+            ++numbers;
+        else
+            bad = true;
+    }
+    if (bad)
+        return false;
+
+    slot_ = 0;
+    skip_ = offset_;
+    left_ = limit;
+    listed_ = 0;
+    out += " ID |   Balance   |    Min    |    Max    | Frozen\n"
+           "----+-------------+-----------+-----------+--------\n";
+    return true;
+}
+
+bool AccountListing::start(Bank &bank, Tokenizer &args, std::string &out)
+{
+    if (!parseArgs(args, out))
+        return false;
+    if (footer_)
+    {
+        // Итог — по одному срезу всех счетов, открытому только на время суммы
+        Bank::ReadView view(bank);
+        count_ = view.count();
+        total_ = view.totalBalance();
+    }
+    else
+    {
+        count_ = bank.getAccountCount();
+    }
+    bank_ = &bank;
+    return true;
+}
+
+bool AccountListing::start(ShardedBank &bank, Tokenizer &args, std::string &out)
+{
+    if (!parseArgs(args, out))
+        return false;
+    total_ = bank.snapshot(rows_);
+    count_ = rows_.size();
+    std::sort(rows_.begin(), rows_.end(),
+              [](const Account &l, const Account &r) { return l.account_id < r.account_id; });
+    copied_ = true;
+    return true;
+}
+
+void AccountListing::emit(const Account &a, std::string &out)
+{
+    if ((frozen_only_ && !a.frozen) || a.balance < lo_ || a.balance > hi_)
+        return;
+    if (skip_ > 0)
+    {
+        --skip_;
+        return;
+    }
+    char row[96];
+    out.append(row, formatAccountRow(row, a));
+    ++listed_;
+    --left_;
+}
+
+void AccountListing::fill(std::string &out, size_t budget)
+{
+    if (!active())
+        return;
+    try
+    {
+        const size_t stop = out.size() + budget;
+        while (slot_ < count_ && left_ > 0 && out.size() < stop)
+        {
+            if (copied_)
+            {
+                emit(rows_[slot_++], out);
+                continue;
+            }
+            Bank::ReadView view(*bank_, slot_, WINDOW);
+            const size_t end = std::min(count_, view.first() + view.count());
+            while (slot_ < end && left_ > 0 && out.size() < stop)
+                emit(view.get(slot_++), out);
+        }
+        if (slot_ < count_ && left_ > 0)
+            return;
+        if (footer_)
+        {
+            out += "Listed ";
+            appendInt(out, static_cast<int64_t>(listed_));
+            out += " of ";
+            appendInt(out, static_cast<int64_t>(count_));
+            out += " accounts from ";
+            appendInt(out, static_cast<int64_t>(offset_));
+            out += ", total balance: ";
+            appendInt(out, total_);
+            out += '\n';
+        }
+    }
+    catch (const std::exception &ex)
+    {
+        out += "Error: ";
+        out += ex.what();
+        out += '\n';
+    }
+    bank_ = nullptr;
+    // Копия на миллион счетов не должна жить в сессии между листингами
+    std::vector<Account>().swap(rows_);
+    copied_ = false;
+}
@@ -0,0 +1,54 @@
+#include "AccountStore.hpp"
+
+#include <cstdlib> // posix_memalign, free
+#include <cstring> // memset
+#include <new>     // std::bad_alloc
+
+static size_t alignUp(size_t v) noexcept
+{
+    return (v + 63) & ~static_cast<size_t>(63);
+}
+
+size_t columnStride(size_t capacity) noexcept
+{
+    return alignUp(capacity * sizeof(int32_t));
+}
+
+static size_t bitmapBytes(size_t capacity) noexcept
+{
+    return alignUp((capacity + 63) / 64 * sizeof(uint64_t));
+}
+
+size_t columnsBytes(size_t capacity) noexcept
+{
+    return 4 * columnStride(capacity) + bitmapBytes(capacity);
+}
+
+AccountColumns bindColumns(void *mem, size_t capacity) noexcept
+{
+    char *p = static_cast<char *>(mem);
+    const size_t step = columnStride(capacity);
+    AccountColumns cols;
+    cols.ids = reinterpret_cast<int32_t *>(p);
+    cols.balances = reinterpret_cast<int32_t *>(p + step);
+    cols.min_balances = reinterpret_cast<int32_t *>(p + 2 * step);
+    cols.max_balances = reinterpret_cast<int32_t *>(p + 3 * step);
+    cols.frozen = reinterpret_cast<uint64_t *>(p + 4 * step);
+    return cols;
+}
+
+ColumnBuffer::ColumnBuffer(size_t capacity) : mem_(nullptr)
+{
+    const size_t bytes = columnsBytes(capacity);
+    if (posix_memalign(&mem_, 64, bytes ? bytes : 64) != 0)
+    {
+        throw std::bad_alloc();
+    }
+    std::memset(mem_, 0, bytes);
+    cols_ = bindColumns(mem_, capacity);
+}
+
+ColumnBuffer::~ColumnBuffer()
+{
+    free(mem_);
+}
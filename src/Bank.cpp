@@ -1,86 +1,1018 @@
 #include "Bank.hpp"
+#include "MassUpdate.hpp"
+#include "TxnLog.hpp"
+#include "Trace.hpp"
 
-int Bank::transferFunds(int from_id, int to_id, int32_t amount)
+#include <algorithm> // std::find
+#include <cerrno>  // EOWNERDEAD
+#include <cstdlib> // posix_memalign, free
+#include <new>     // std::bad_alloc
+#include <sched.h> // sched_yield
+#include <string>  // std::to_string
+#include <vector>  // std::vector
+
+/*
+ * StripeGuard — захватывает полосы для одного или двух слотов.
+ * Порядок захвата всегда по возрастанию номера полосы, одна и та же
+ * полоса берётся один раз. Освобождение — в деструкторе, поэтому
+ * исключения внутри операций не оставляют мьютексы захваченными.
+ * Пока полосы захвачены, они в секции записи seqlock. Единственному
+ * писателю (Access::Writer) мьютексы не нужны — только секции записи.
+ */
+class Bank::StripeGuard
 {
-    if (amount <= 0)
+public:
+    StripeGuard(Bank &bank, Access access, size_t slot)
+        : bank_(bank), lock_(access == Access::Locked), first_(bank.stripeOf(slot)),
+          second_(first_)
+    {
+        TraceSpan span(TracePhase::Lock);
+        if (lock_)
+            bank_.lockStripe(first_);
+        bank_.beginWrite(first_);
+    }
+
+    StripeGuard(Bank &bank, Access access, size_t slot_a, size_t slot_b)
+        : bank_(bank), lock_(access == Access::Locked), first_(bank.stripeOf(slot_a)),
+          second_(bank.stripeOf(slot_b))
+    {
+        if (second_ < first_)
+        {
+            size_t tmp = first_;
+            first_ = second_;
+            second_ = tmp;
+        }
+        TraceSpan span(TracePhase::Lock);
+        if (lock_)
+            bank_.lockStripe(first_);
+        if (second_ != first_)
+        {
+            if (lock_)
+                bank_.lockStripe(second_);
+            bank_.beginWrite(second_);
+        }
+        bank_.beginWrite(first_);
+    }
+
+    ~StripeGuard()
+    {
+        bank_.endWrite(first_);
+        if (second_ != first_)
+        {
+            bank_.endWrite(second_);
+            if (lock_)
+                bank_.unlockStripe(second_);
+        }
+        if (lock_)
+            bank_.unlockStripe(first_);
+    }
+
+    StripeGuard(const StripeGuard &) = delete;
+    StripeGuard &operator=(const StripeGuard &) = delete;
+
+private:
+    Bank &bank_;
+    bool lock_;
+    size_t first_;
+    size_t second_;
+};
+
+const char *bankStatusName(BankStatus status) noexcept
+{
+    switch (status)
+    {
+    case BankStatus::Ok:
+        return "Ok";
+    case BankStatus::InvalidAmount:
+        return "InvalidAmount";
+    case BankStatus::AccountNotFound:
+        return "AccountNotFound";
+    case BankStatus::AccountFrozen:
+        return "AccountFrozen";
+    case BankStatus::InsufficientFunds:
+        return "InsufficientFunds";
+    case BankStatus::ExceedsMaxBalance:
+        return "ExceedsMaxBalance";
+    case BankStatus::LimitViolation:
+        return "LimitViolation";
+    case BankStatus::InvalidLimits:
+        return "InvalidLimits";
+    case BankStatus::BatchAborted:
+        return "BatchAborted";
+    case BankStatus::Unsupported:
+        return "Unsupported";
+    }
+    return "Unknown";
+}
+
+const char *bankStatusMessage(BankStatus status) noexcept
+{
+    switch (status)
+    {
+    case BankStatus::Ok:
+        return "ok";
+    case BankStatus::InvalidAmount:
+        return "transferFunds: amount must be positive";
+    case BankStatus::AccountNotFound:
+        return "Bank: account ID not found";
+    case BankStatus::AccountFrozen:
+        return "transferFunds: one of the accounts is frozen";
+    case BankStatus::InsufficientFunds:
+        return "transferFunds: insufficient funds on source account";
+    case BankStatus::ExceedsMaxBalance:
+        return "transferFunds: would exceed max balance on destination";
+    case BankStatus::LimitViolation:
+        return "massUpdate: balance would violate limits";
+    case BankStatus::InvalidLimits:
+        return "setLimits: newMin > newMax or balance outside the new limits";
+    case BankStatus::BatchAborted:
+        return "transferBatch: atomic batch aborted";
+    case BankStatus::Unsupported:
+        return "transferBatch: atomic batches are not supported over a shared lock table";
+    }
+    return "unknown error";
+}
+
+// Снятие среза с регистрации не должно ждать непрерывного потока писателей
+static void initViewsLock(pthread_rwlock_t *lock)
+{
+    pthread_rwlockattr_t attr;
+    pthread_rwlockattr_init(&attr);
+    pthread_rwlockattr_setkind_np(&attr, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+    pthread_rwlock_init(lock, &attr);
+    pthread_rwlockattr_destroy(&attr);
+}
+
+Bank::Bank(Account *accounts_ptr, size_t count, size_t stripes)
+    : Bank(AccountStore(accounts_ptr), count, stripes)
+{
+}
+
+Bank::Bank(const AccountStore &accounts, size_t count, size_t stripes)
+    : accounts_(accounts), count_(count), shared_count_(nullptr), locks_(nullptr),
+      stripes_(nullptr), stripe_count_(0), owns_locks_(true), journal_(false),
+      log_(nullptr)
+{
+    if (!accounts_.valid() || count == 0)
     {
-        throw std::invalid_argument("transferFunds: amount must be positive");
+        throw std::invalid_argument("Bank: invalid accounts pointer or count");
     }
 
-    Account &src = findAccount(from_id);
-    Account &dst = findAccount(to_id);
+    index_.build(accounts_, count);
+
+    stripe_count_ = stripes ? stripes : DEFAULT_LOCK_STRIPES;
+    if (stripe_count_ > count)
+    {
+        stripe_count_ = count;
+    }
+
+    void *mem = nullptr;
+    if (posix_memalign(&mem, 64, lockTableBytes(stripe_count_)) != 0)
+    {
+        throw std::bad_alloc();
+    }
+    locks_ = static_cast<LockTable *>(mem);
+    if (lockTableInit(locks_, stripe_count_, false) != 0)
+    {
+        free(mem);
+        throw std::runtime_error("Bank: failed to initialize lock table");
+    }
+    stripes_ = locks_->stripes();
+    pthread_mutex_init(&grow_mtx_, nullptr);
+    pthread_mutex_init(&writer_mtx_, nullptr);
+    initViewsLock(&views_lock_);
+}
+
+Bank::Bank(Account *accounts_ptr, size_t count, LockTable *shared_locks,
+           const uint64_t *shared_count)
+    : Bank(AccountStore(accounts_ptr), count, shared_locks, shared_count)
+{
+}
+
+Bank::Bank(const AccountStore &accounts, size_t count, LockTable *shared_locks,
+           const uint64_t *shared_count)
+    : accounts_(accounts), count_(count), shared_count_(shared_count), locks_(shared_locks),
+      stripes_(nullptr), stripe_count_(0), owns_locks_(false), journal_(false),
+      log_(nullptr)
+{
+    if (!accounts_.valid() || count == 0 || !locks_ || locks_->stripe_count == 0)
+    {
+        throw std::invalid_argument("Bank: invalid accounts pointer, count or lock table");
+    }
+
+    index_.build(accounts_, count);
+
+    stripes_ = locks_->stripes();
+    stripe_count_ = locks_->stripe_count;
+    journal_ = locks_->process_shared != 0;
+    pthread_mutex_init(&grow_mtx_, nullptr);
+    pthread_mutex_init(&writer_mtx_, nullptr);
+    initViewsLock(&views_lock_);
+}
+
+Bank::~Bank()
+{
+    pthread_mutex_destroy(&grow_mtx_);
+    pthread_mutex_destroy(&writer_mtx_);
+    pthread_rwlock_destroy(&views_lock_);
+    if (owns_locks_)
+    {
+        lockTableDestroy(locks_);
+        free(locks_);
+    }
+}
+
+void Bank::lockStripe(size_t stripe) const
+{
+    int rc = pthread_mutex_lock(&stripes_[stripe].mtx);
+    if (rc == EOWNERDEAD)
+    {
+        // Предыдущий владелец погиб внутри критической секции
+        recoverStripe(stripe);
+        // Его секция записи seqlock закрывается здесь: счета уже согласованы
+        uint64_t &seq = stripes_[stripe].seq;
+        if (__atomic_load_n(&seq, __ATOMIC_RELAXED) & 1)
+            __atomic_store_n(&seq, seq + 1, __ATOMIC_RELEASE);
+        pthread_mutex_consistent(&stripes_[stripe].mtx);
+    }
+    else if (rc != 0)
+    {
+        throw std::runtime_error("Bank: failed to lock account stripe");
+    }
+}
+
+void Bank::unlockStripe(size_t stripe) const
+{
+    pthread_mutex_unlock(&stripes_[stripe].mtx);
+}
+
+void Bank::writerPause() const
+{
+    __atomic_add_fetch(&writer_waiters_, 1, __ATOMIC_SEQ_CST);
+    pthread_mutex_lock(&writer_mtx_);
+    __atomic_add_fetch(&writer_grants_, 1, __ATOMIC_RELEASE);
+}
+
+void Bank::writerResume() const noexcept
+{
+    __atomic_sub_fetch(&writer_waiters_, 1, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&writer_mtx_);
+}
+
+void Bank::writerEnter()
+{
+    pthread_mutex_lock(&writer_mtx_);
+}
+
+void Bank::writerLeave() noexcept
+{
+    pthread_mutex_unlock(&writer_mtx_);
+}
 
-    if (src.frozen || dst.frozen)
+void Bank::writerHandOff()
+{
+    const uint64_t grants = writer_grants_;
+    pthread_mutex_unlock(&writer_mtx_);
+    // Мьютекс не честный: без ожидания писатель тут же захватил бы его снова
+    while (__atomic_load_n(&writer_grants_, __ATOMIC_ACQUIRE) == grants &&
+           __atomic_load_n(&writer_waiters_, __ATOMIC_ACQUIRE) != 0)
     {
-        throw std::runtime_error("transferFunds: one of the accounts is frozen");
+        sched_yield();
     }
-    if (src.balance - amount < src.min_balance)
+    pthread_mutex_lock(&writer_mtx_);
+}
+
+void Bank::recoverStripe(size_t stripe) const
+{
+    // Восстановители сериализуются: одна транзакция затрагивает две полосы,
+    // и разбирать её должен ровно один процесс
+    int rc = pthread_mutex_lock(&locks_->recovery_mtx);
+    if (rc == EOWNERDEAD)
     {
-        throw std::runtime_error("transferFunds: insufficient funds on source account");
+        // Восстановление идемпотентно — просто повторяем его
+        pthread_mutex_consistent(&locks_->recovery_mtx);
     }
-    if (dst.balance + amount > dst.max_balance)
+    else if (rc != 0)
     {
-        throw std::runtime_error("transferFunds: would exceed max balance on destination");
+        throw std::runtime_error("Bank: failed to lock recovery mutex");
     }
 
-    src.balance -= amount;
-    dst.balance += amount;
+    TxnUndo &undo = stripes_[stripe].undo;
+    if (undo.state != TxnUndo::IDLE)
+    {
+        const uint32_t lo = undo.lo_stripe;
+        const uint64_t txn = undo.txn;
+        const TxnUndo &commit = stripes_[lo].undo;
+        bool rollback = commit.txn == txn && commit.state == TxnUndo::PENDING;
+
+        if (rollback)
+        {
+            // Порядок важен, если оба слота совпадают: первым восстанавливаем
+            // источник, затем получатель с тем же старым значением
+            accounts_.balance(undo.slot[0]) = undo.old_balance[0];
+            accounts_.balance(undo.slot[1]) = undo.old_balance[1];
+        }
+
+        for (int k = 0; k < 2; ++k)
+        {
+            TxnUndo &rec = stripes_[stripeOf(undo.slot[k])].undo;
+            if (&rec != &undo && rec.state != TxnUndo::IDLE &&
+                rec.lo_stripe == lo && rec.txn == txn)
+            {
+                __atomic_store_n(&rec.state, TxnUndo::IDLE, __ATOMIC_RELEASE);
+            }
+        }
+        __atomic_store_n(&undo.state, TxnUndo::IDLE, __ATOMIC_RELEASE);
+    }
+
+    pthread_mutex_unlock(&locks_->recovery_mtx);
+}
+
+BankStatus Bank::tryTransfer(int from_id, int to_id, int32_t amount)
+{
+    uint64_t lsn = 0;
+    BankStatus st = runTransfer(from_id, to_id, amount, Access::Locked, lsn);
+    waitLogged(lsn);
+    return st;
+}
+
+BankStatus Bank::applyTransfer(int from_id, int to_id, int32_t amount, uint64_t &lsn)
+{
+    return runTransfer(from_id, to_id, amount, Access::Writer, lsn);
+}
+
+BankStatus Bank::runTransfer(int from_id, int to_id, int32_t amount, Access access, uint64_t &lsn)
+{
+    if (amount <= 0)
+        return BankStatus::InvalidAmount;
+
+    size_t from_slot = lookupSlot(from_id);
+    size_t to_slot = lookupSlot(to_id);
+    if (from_slot == AccountIndex::NOT_FOUND || to_slot == AccountIndex::NOT_FOUND)
+        return BankStatus::AccountNotFound;
+
+    StripeGuard guard(*this, access, from_slot, to_slot);
+    BankStatus st = checkTransfer(from_slot, to_slot, amount);
+    if (st != BankStatus::Ok)
+        return st;
+
+    applyTransferLocked(from_slot, to_slot, amount);
+    if (log_)
+        lsn = log_->append(TxnOp::Transfer, from_id, to_id, amount);
+    return BankStatus::Ok;
+}
+
+int Bank::transferFunds(int from_id, int to_id, int32_t amount)
+{
+    BankStatus st = tryTransfer(from_id, to_id, amount);
+    if (st != BankStatus::Ok)
+        throw BankError(st, bankStatusMessage(st));
     return 0;
 }
 
+void Bank::waitLogged(uint64_t lsn)
+{
+    // Ждём без полос: пока идёт fdatasync, другие операции копят следующую пачку
+    if (lsn && log_)
+        log_->waitDurable(lsn);
+}
+
+void Bank::applyTransferLocked(size_t from_slot, size_t to_slot, int32_t amount) noexcept
+{
+    preserve(from_slot);
+    preserve(to_slot);
+    int32_t &src = accounts_.balance(from_slot);
+    int32_t &dst = accounts_.balance(to_slot);
+
+    if (!journal_)
+    {
+        src -= amount;
+        dst += amount;
+        return;
+    }
+
+    // Таблица в общей памяти: сначала журнал отката в обеих полосах,
+    // затем балансы, затем фиксация записью младшей полосы
+    size_t lo = stripeOf(from_slot);
+    size_t hi = stripeOf(to_slot);
+    if (hi < lo)
+    {
+        size_t tmp = lo;
+        lo = hi;
+        hi = tmp;
+    }
+    TxnUndo &commit = stripes_[lo].undo;
+    TxnUndo rec;
+    rec.state = TxnUndo::IDLE; // поле state публикуется последним
+    rec.lo_stripe = static_cast<uint32_t>(lo);
+    rec.txn = ++stripes_[lo].txn_seq;
+    rec.slot[0] = from_slot;
+    rec.slot[1] = to_slot;
+    rec.old_balance[0] = src;
+    rec.old_balance[1] = dst;
+    commit = rec;
+    if (hi != lo)
+    {
+        stripes_[hi].undo = rec;
+        __atomic_store_n(&stripes_[hi].undo.state, TxnUndo::PENDING, __ATOMIC_RELEASE);
+    }
+    __atomic_store_n(&commit.state, TxnUndo::PENDING, __ATOMIC_RELEASE);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    src -= amount;
+    dst += amount;
+
+    __atomic_store_n(&commit.state, TxnUndo::COMMITTED, __ATOMIC_RELEASE);
+    if (hi != lo)
+    {
+        __atomic_store_n(&stripes_[hi].undo.state, TxnUndo::IDLE, __ATOMIC_RELEASE);
+    }
+    __atomic_store_n(&commit.state, TxnUndo::IDLE, __ATOMIC_RELEASE);
+}
+
+size_t Bank::transferBatch(const Transfer *items, size_t count, BankStatus *results, bool atomic)
+{
+    uint64_t lsn = 0;
+    size_t applied = runBatch(items, count, results, atomic, Access::Locked, lsn);
+    waitLogged(lsn);
+    return applied;
+}
+
+size_t Bank::applyBatch(const Transfer *items, size_t count, BankStatus *results, bool atomic,
+                        uint64_t &lsn)
+{
+    return runBatch(items, count, results, atomic, Access::Writer, lsn);
+}
+
+size_t Bank::runBatch(const Transfer *items, size_t count, BankStatus *results, bool atomic,
+                      Access access, uint64_t &lsn)
+{
+    if (count == 0)
+        return 0;
+    if (atomic && journal_)
+    {
+        // Откат пакета целиком TxnUndo не покрывает — не начинаем его вовсе
+        for (size_t i = 0; i < count; ++i)
+            results[i] = BankStatus::Unsupported;
+        return 0;
+    }
+
+    // 1. Разрешаем ID в слоты и отмечаем нужные полосы в битовой карте
+    std::vector<size_t> slots(2 * count);
+    std::vector<uint64_t> stripe_bits((stripe_count_ + 63) / 64, 0);
+    bool rejected = false;
+    for (size_t i = 0; i < count; ++i)
+    {
+        const Transfer &t = items[i];
+        size_t from = lookupSlot(t.from_id);
+        size_t to = lookupSlot(t.to_id);
+        slots[2 * i] = from;
+        slots[2 * i + 1] = to;
+        if (t.amount <= 0)
+            results[i] = BankStatus::InvalidAmount;
+        else if (from == AccountIndex::NOT_FOUND || to == AccountIndex::NOT_FOUND)
+            results[i] = BankStatus::AccountNotFound;
+        else
+        {
+            results[i] = BankStatus::Ok;
+            size_t sf = stripeOf(from), st = stripeOf(to);
+            stripe_bits[sf / 64] |= 1ull << (sf % 64);
+            stripe_bits[st / 64] |= 1ull << (st % 64);
+            continue;
+        }
+        rejected = true;
+    }
+
+    if (atomic && rejected)
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            if (results[i] == BankStatus::Ok)
+                results[i] = BankStatus::BatchAborted;
+        }
+        return 0;
+    }
+
+    size_t applied = 0;
+    {
+        // 2. Захватываем все задействованные полосы по возрастанию номера
+        // lockStripe может бросить посреди слова: захваченное учитывается до бита
+        struct HeldStripes
+        {
+            Bank &bank;
+            const std::vector<uint64_t> &bits;
+            bool lock;           // false — единственный писатель, без мьютексов
+            size_t locked_words; // Слова, захваченные целиком
+            uint64_t partial;    // Захваченные биты слова locked_words
+
+            void lockAll()
+            {
+                for (; locked_words < bits.size(); ++locked_words, partial = 0)
+                {
+                    for (uint64_t w = bits[locked_words]; w; w &= w - 1)
+                    {
+                        const size_t stripe = locked_words * 64 + __builtin_ctzll(w);
+                        if (lock)
+                            bank.lockStripe(stripe);
+                        bank.beginWrite(stripe);
+                        partial |= w & (~w + 1);
+                    }
+                }
+            }
+            void release(size_t word, uint64_t w)
+            {
+                for (; w; w &= w - 1)
+                {
+                    bank.endWrite(word * 64 + __builtin_ctzll(w));
+                    if (lock)
+                        bank.unlockStripe(word * 64 + __builtin_ctzll(w));
+                }
+            }
+            ~HeldStripes()
+            {
+                for (size_t k = 0; k < locked_words; ++k)
+                    release(k, bits[k]);
+                if (locked_words < bits.size())
+                    release(locked_words, partial);
+            }
+        } held = {*this, stripe_bits, access == Access::Locked, 0, 0};
+        held.lockAll();
+
+        // 3. Применяем по порядку; счета следующих элементов подгружаем заранее
+        const size_t PREFETCH = 8;
+        for (size_t i = 0; i < count; ++i)
+        {
+            if (i + PREFETCH < count && results[i + PREFETCH] == BankStatus::Ok)
+            {
+                accounts_.prefetch(slots[2 * (i + PREFETCH)]);
+                accounts_.prefetch(slots[2 * (i + PREFETCH) + 1]);
+            }
+            if (results[i] != BankStatus::Ok)
+                continue;
+
+            size_t from = slots[2 * i], to = slots[2 * i + 1];
+            BankStatus st = checkTransfer(from, to, items[i].amount);
+            if (st == BankStatus::Ok)
+            {
+                applyTransferLocked(from, to, items[i].amount);
+                ++applied;
+                continue;
+            }
+            results[i] = st;
+
+            if (atomic)
+            {
+                // Откат в обратном порядке возвращает в точности прежние балансы
+                for (size_t j = i; j-- > 0;)
+                {
+                    applyTransferLocked(slots[2 * j + 1], slots[2 * j], items[j].amount);
+                    results[j] = BankStatus::BatchAborted;
+                }
+                for (size_t j = i + 1; j < count; ++j)
+                    results[j] = BankStatus::BatchAborted;
+                return 0;
+            }
+        }
+
+        // 4. В журнал — только применённые переводы, пока полосы ещё у нас
+        if (log_ && applied)
+            lsn = log_->appendTransfers(items, results, count);
+    }
+    return applied;
+}
+
+BankStatus Bank::tryFreeze(int id, bool frozen)
+{
+    uint64_t lsn = 0;
+    BankStatus st = runFreeze(id, frozen, Access::Locked, lsn);
+    waitLogged(lsn);
+    return st;
+}
+
+BankStatus Bank::applyFreeze(int id, bool frozen, uint64_t &lsn)
+{
+    return runFreeze(id, frozen, Access::Writer, lsn);
+}
+
+BankStatus Bank::runFreeze(int id, bool frozen, Access access, uint64_t &lsn)
+{
+    size_t slot = lookupSlot(id);
+    if (slot == AccountIndex::NOT_FOUND)
+        return BankStatus::AccountNotFound;
+    StripeGuard guard(*this, access, slot);
+    preserve(slot);
+    accounts_.setFrozen(slot, frozen);
+    if (log_)
+        lsn = log_->append(frozen ? TxnOp::Freeze : TxnOp::Unfreeze, id);
+    return BankStatus::Ok;
+}
+
 void Bank::freezeAccount(int id)
 {
-    Account &acc = findAccount(id);
-    acc.frozen = true;
+    BankStatus st = tryFreeze(id, true);
+    if (st != BankStatus::Ok)
+        throw BankError(st, bankStatusMessage(st));
 }
 
 void Bank::unfreezeAccount(int id)
 {
-    Account &acc = findAccount(id);
-    acc.frozen = false;
+    BankStatus st = tryFreeze(id, false);
+    if (st != BankStatus::Ok)
+        throw BankError(st, bankStatusMessage(st));
+}
+
+size_t Bank::refreshCount() const noexcept
+{
+    size_t shared = static_cast<size_t>(__atomic_load_n(shared_count_, __ATOMIC_ACQUIRE));
+    if (shared <= count_.load(std::memory_order_acquire))
+        return 0;
+
+    pthread_mutex_lock(&grow_mtx_);
+    size_t added = 0;
+    size_t current = count_.load(std::memory_order_relaxed);
+    // Разреженный индекс не растёт — новые счета в таком банке не видны
+    if (shared > current && index_.grow(accounts_, shared))
+    {
+        added = shared - current;
+        count_.store(shared, std::memory_order_release);
+    }
+    pthread_mutex_unlock(&grow_mtx_);
+    return added;
 }
 
 size_t Bank::getAccountCount() const noexcept
 {
-    return count_;
+    if (shared_count_)
+    {
+        refreshCount();
+    }
+    return count_.load(std::memory_order_acquire);
+}
+
+Account Bank::getAccount(size_t idx) const
+{
+    if (idx >= count_.load(std::memory_order_acquire))
+    {
+        if (shared_count_)
+            refreshCount();
+        if (idx >= count_.load(std::memory_order_acquire))
+            throw std::out_of_range("Account index");
+    }
+    return readSlot(idx, nullptr);
+}
+
+BankStatus Bank::tryGetAccount(int id, Account &out) const
+{
+    size_t slot = lookupSlot(id);
+    if (slot == AccountIndex::NOT_FOUND)
+        return BankStatus::AccountNotFound;
+    out = readSlot(slot, nullptr);
+    return BankStatus::Ok;
+}
+
+Account Bank::readSlot(size_t idx, const ReadView *view) const
+{
+    // Сохранённое срезом значение больше не меняется; иначе читаем хранилище
+    auto load = [&]() -> Account {
+        const Account *old = view ? view->preserved(idx) : nullptr;
+        return old ? *old : accounts_.load(idx);
+    };
+
+    // Seqlock: копия годится, если за время чтения полосу никто не менял
+    const uint64_t *seq = &stripes_[stripeOf(idx)].seq;
+    for (int attempt = 0; attempt < 64; ++attempt)
+    {
+        uint64_t before = __atomic_load_n(seq, __ATOMIC_ACQUIRE);
+        if ((before & 1) == 0)
+        {
+            Account a = load();
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+            if (__atomic_load_n(seq, __ATOMIC_RELAXED) == before)
+                return a;
+        }
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#endif
+    }
+
+    // Полосу меняют непрерывно или её писатель погиб — ждём мьютекс
+    // (и право единственного писателя, который мьютексов не берёт)
+    writerPause();
+    try
+    {
+        lockStripe(stripeOf(idx));
+    }
+    catch (...)
+    {
+        writerResume();
+        throw;
+    }
+    Account a = load();
+    unlockStripe(stripeOf(idx));
+    writerResume();
+    return a;
+}
+
+void Bank::preserveSlow(size_t first, size_t count) noexcept
+{
+    pthread_rwlock_rdlock(&views_lock_);
+    for (ReadView *view : views_)
+    {
+        const size_t lo = std::max(first, view->first_);
+        const size_t hi = std::min(first + count, view->first_ + view->count_);
+        for (size_t slot = lo; slot < hi; ++slot)
+            view->save(slot, accounts_);
+    }
+    pthread_rwlock_unlock(&views_lock_);
+}
+
+struct Bank::ReadView::Page
+{
+    uint64_t saved[PAGE / 64]; // Бит на слот: значение лежит в rows
+    Account rows[PAGE];
+};
+
+constexpr size_t Bank::ReadView::PAGE;
+
+Bank::ReadView::ReadView(Bank &bank, size_t first, size_t count)
+    : bank_(bank), first_(0), count_(0), full_copy_(!bank.owns_locks_)
+{
+    const size_t total = bank.getAccountCount();
+    first_ = std::min(first, total);
+    count_ = std::min(count, total - first_);
+    const size_t pages = (count_ + PAGE - 1) / PAGE;
+    pages_.reset(new Page *[pages]());
+
+    try
+    {
+        // Память выделена заранее: под всеми полосами — только регистрация или копия
+        if (full_copy_)
+        {
+            for (size_t p = 0; p < pages; ++p)
+                pages_[p] = new Page;
+        }
+        else
+        {
+            bank_.views_.reserve(bank_.views_.size() + 1);
+        }
+        bank_.lockAllStripes();
+    }
+    catch (...)
+    {
+        freePages();
+        throw;
+    }
+    if (full_copy_)
+    {
+        for (size_t i = 0; i < count_; ++i)
+            pages_[i / PAGE]->rows[i % PAGE] = bank_.accounts_.load(first_ + i);
+    }
+    else
+    {
+        pthread_rwlock_wrlock(&bank_.views_lock_);
+        bank_.views_.push_back(this);
+        __atomic_store_n(&bank_.view_count_, bank_.views_.size(), __ATOMIC_RELAXED);
+        pthread_rwlock_unlock(&bank_.views_lock_);
+    }
+    bank_.unlockAllStripes();
+}
+
+Bank::ReadView::~ReadView()
+{
+    if (!full_copy_)
+    {
+        // Писатели, которые сейчас сохраняют слоты в срез, держат views_lock_ на чтение
+        pthread_rwlock_wrlock(&bank_.views_lock_);
+        bank_.views_.erase(std::find(bank_.views_.begin(), bank_.views_.end(), this));
+        __atomic_store_n(&bank_.view_count_, bank_.views_.size(), __ATOMIC_RELAXED);
+        pthread_rwlock_unlock(&bank_.views_lock_);
+    }
+    freePages();
 }
 
-const Account &Bank::getAccount(size_t idx) const
+void Bank::ReadView::freePages() noexcept
 {
-    if (idx >= count_)
+    for (size_t p = 0; p < (count_ + PAGE - 1) / PAGE; ++p)
+        delete pages_[p];
+}
+
+const Account *Bank::ReadView::preserved(size_t idx) const noexcept
+{
+    const size_t rel = idx - first_;
+    const Page *page = __atomic_load_n(&pages_[rel / PAGE], __ATOMIC_ACQUIRE);
+    if (!page)
+        return nullptr;
+    const size_t i = rel % PAGE;
+    if (__atomic_load_n(&page->saved[i / 64], __ATOMIC_ACQUIRE) & (uint64_t(1) << (i % 64)))
+        return &page->rows[i];
+    return nullptr;
+}
+
+void Bank::ReadView::save(size_t idx, const AccountStore &store) noexcept
+{
+    const size_t rel = idx - first_;
+    Page *page = __atomic_load_n(&pages_[rel / PAGE], __ATOMIC_ACQUIRE);
+    if (!page)
+    {
+        // Писатели разных полос могут выделять одну страницу одновременно
+        Page *fresh = new (std::nothrow) Page();
+        if (!fresh)
+        {
+            __atomic_store_n(&lost_, true, __ATOMIC_RELEASE);
+            return;
+        }
+        page = nullptr;
+        if (__atomic_compare_exchange_n(&pages_[rel / PAGE], &page, fresh, false,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+            page = fresh;
+        else
+            delete fresh;
+    }
+    const size_t i = rel % PAGE;
+    const uint64_t bit = uint64_t(1) << (i % 64);
+    if (__atomic_load_n(&page->saved[i / 64], __ATOMIC_RELAXED) & bit)
+        return;
+    page->rows[i] = store.load(idx);
+    __atomic_fetch_or(&page->saved[i / 64], bit, __ATOMIC_RELEASE);
+}
+
+Account Bank::ReadView::get(size_t idx) const
+{
+    if (idx < first_ || idx - first_ >= count_)
         throw std::out_of_range("Account index");
-    return accounts_[idx];
+    if (full_copy_)
+        return pages_[(idx - first_) / PAGE]->rows[(idx - first_) % PAGE];
+    Account a = bank_.readSlot(idx, this);
+    // Писатель отмечает потерю до изменения слота, а seqlock упорядочивает чтение после него
+    if (__atomic_load_n(&lost_, __ATOMIC_ACQUIRE))
+        throw std::bad_alloc();
+    return a;
 }
 
-int Bank::massUpdate(int32_t amount)
+size_t Bank::ReadView::page(size_t offset, size_t limit, std::vector<Account> &out) const
+{
+    if (offset < first_ || offset - first_ >= count_)
+        return 0;
+    const size_t n = std::min(limit, first_ + count_ - offset);
+    out.reserve(out.size() + n);
+    for (size_t i = offset; i < offset + n; ++i)
+        out.push_back(get(i));
+    return n;
+}
+
+int64_t Bank::ReadView::totalBalance() const
 {
-    for (size_t i = 0; i < count_; ++i)
+    int64_t total = 0;
+    for (size_t i = first_; i < first_ + count_; ++i)
+        total += get(i).balance;
+    return total;
+}
+
+void Bank::lockAllStripes()
+{
+    writerPause();
+    size_t s = 0;
+    try
     {
-        int32_t new_bal = accounts_[i].balance + amount;
-        if (new_bal < accounts_[i].min_balance || new_bal > accounts_[i].max_balance)
+        for (; s < stripe_count_; ++s)
         {
-            throw std::runtime_error("massUpdate: balance would violate limits");
+            lockStripe(s);
         }
-        accounts_[i].balance = new_bal;
+    }
+    catch (...)
+    {
+        while (s-- > 0)
+            unlockStripe(s);
+        writerResume();
+        throw;
+    }
+}
+
+void Bank::unlockAllStripes() noexcept
+{
+    for (size_t s = stripe_count_; s-- > 0;)
+    {
+        unlockStripe(s);
+    }
+    writerResume();
+}
+
+BankStatus Bank::tryMassUpdate(int32_t amount, int *violator)
+{
+    uint64_t lsn = 0;
+    BankStatus st = runMassUpdate(amount, violator, Access::Locked, lsn);
+    waitLogged(lsn);
+    return st;
+}
+
+BankStatus Bank::applyMassUpdate(int32_t amount, int *violator, uint64_t &lsn)
+{
+    return runMassUpdate(amount, violator, Access::Writer, lsn);
+}
+
+BankStatus Bank::runMassUpdate(int32_t amount, int *violator, Access access, uint64_t &lsn)
+{
+    const bool lock = access == Access::Locked;
+    if (lock)
+        lockAllStripes();
+    struct AllStripes
+    {
+        Bank &bank;
+        bool lock;
+        ~AllStripes()
+        {
+            for (size_t s = 0; s < bank.stripe_count_; ++s)
+                bank.endWrite(s);
+            if (lock)
+                bank.unlockAllStripes();
+        }
+    } unlock_all{*this, lock};
+    for (size_t s = 0; s < stripe_count_; ++s)
+        beginWrite(s);
+
+    // Сначала проверяем все счета, затем применяем — без частичных обновлений
+    const size_t count = count_.load(std::memory_order_acquire);
+    size_t bad = massUpdateCheck(accounts_, count, amount);
+    if (bad < count)
+    {
+        if (violator)
+            *violator = accounts_.id(bad);
+        return BankStatus::LimitViolation;
+    }
+    if (__atomic_load_n(&view_count_, __ATOMIC_RELAXED) != 0)
+        preserveSlow(0, count);
+    massUpdateApply(accounts_, count, amount);
+    if (log_)
+        lsn = log_->append(TxnOp::MassUpdate, amount);
+    return BankStatus::Ok;
+}
+
+int Bank::massUpdate(int32_t amount)
+{
+    int violator = 0;
+    if (tryMassUpdate(amount, &violator) != BankStatus::Ok)
+    {
+        throw BankError(BankStatus::LimitViolation,
+            "massUpdate: balance of account " + std::to_string(violator) +
+            " would violate limits");
     }
     return 0;
 }
 
+BankStatus Bank::trySetLimits(size_t id, int32_t newMin, int32_t newMax, int32_t *balance)
+{
+    uint64_t lsn = 0;
+    BankStatus st = runSetLimits(id, newMin, newMax, balance, Access::Locked, lsn);
+    waitLogged(lsn);
+    return st;
+}
+
+BankStatus Bank::applySetLimits(size_t id, int32_t newMin, int32_t newMax, int32_t *balance,
+                                uint64_t &lsn)
+{
+    return runSetLimits(id, newMin, newMax, balance, Access::Writer, lsn);
+}
+
+BankStatus Bank::runSetLimits(size_t id, int32_t newMin, int32_t newMax, int32_t *balance,
+                              Access access, uint64_t &lsn)
+{
+    if (newMin > newMax)
+        return BankStatus::InvalidLimits;
+    size_t slot = lookupSlot(static_cast<int>(id));
+    if (slot == AccountIndex::NOT_FOUND)
+        return BankStatus::AccountNotFound;
+    StripeGuard guard(*this, access, slot);
+    int32_t current = accounts_.balance(slot);
+    if (current < newMin || current > newMax)
+    {
+        if (balance)
+            *balance = current;
+        return BankStatus::InvalidLimits;
+    }
+    preserve(slot);
+    accounts_.minBalance(slot) = newMin;
+    accounts_.maxBalance(slot) = newMax;
+    if (log_)
+        lsn = log_->append(TxnOp::SetLimits, static_cast<int32_t>(id), newMin, newMax);
+    return BankStatus::Ok;
+}
+
 void Bank::setLimits(size_t id, int32_t newMin, int32_t newMax) {
+    int32_t balance = 0;
+    BankStatus st = trySetLimits(id, newMin, newMax, &balance);
+    if (st == BankStatus::Ok)
+        return;
+    if (st != BankStatus::InvalidLimits)
+        throw BankError(st, bankStatusMessage(st));
     if (newMin > newMax) {
-        throw std::runtime_error(
+        throw BankError(BankStatus::InvalidLimits,
             "setLimits: newMin (" + std::to_string(newMin) +
             ") cannot be greater than newMax (" + std::to_string(newMax) + ")"
         );
     }
-    Account& acc = accounts_[id];
-    if (acc.balance < newMin || acc.balance > newMax) {
-        throw std::runtime_error(
-            "setLimits: current balance (" + std::to_string(acc.balance) +
-            ") is outside the new limits [" + std::to_string(newMin) +
-            "," + std::to_string(newMax) + "]"
-        );
-    }
-    acc.min_balance = newMin;
-    acc.max_balance = newMax;
-}
\ No newline at end of file
+    throw BankError(BankStatus::InvalidLimits,
+        "setLimits: current balance (" + std::to_string(balance) +
+        ") is outside the new limits [" + std::to_string(newMin) +
+        "," + std::to_string(newMax) + "]"
+    );
+}
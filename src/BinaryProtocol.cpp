@@ -0,0 +1,301 @@
+#include "BinaryProtocol.hpp"
+#include "Ledger.hpp"
+#include "ShardedBank.hpp"
+#include "Commands.hpp"
+#include "Stats.hpp"
+#include "Trace.hpp"
+
+#include <chrono> // steady_clock
+#include <vector>
+
+void binEncodeRequest(const BinRequest &req, char *out)
+{
+    binPut16(out, static_cast<uint16_t>(BIN_REQUEST_SIZE));
+    out[2] = static_cast<char>(req.op);
+    out[3] = 0;
+    binPut32(out + 4, req.seq);
+    binPut32(out + 8, static_cast<uint32_t>(req.a));
+    binPut32(out + 12, static_cast<uint32_t>(req.b));
+    binPut32(out + 16, static_cast<uint32_t>(req.c));
+}
+
+void binDecodeRequest(const char *in, BinRequest &req)
+{
+    req.op = static_cast<BinOp>(in[2]);
+    req.seq = binGet32(in + 4);
+    req.a = static_cast<int32_t>(binGet32(in + 8));
+    req.b = static_cast<int32_t>(binGet32(in + 12));
+    req.c = static_cast<int32_t>(binGet32(in + 16));
+}
+
+void binEncodeResponse(const BinResponse &resp, char *out)
+{
+    binPut16(out, static_cast<uint16_t>(BIN_RESPONSE_SIZE));
+    out[2] = static_cast<char>(resp.op);
+    out[3] = static_cast<char>(resp.status);
+    binPut32(out + 4, resp.seq);
+    binPut32(out + 8, static_cast<uint32_t>(resp.balance));
+    binPut32(out + 12, static_cast<uint32_t>(resp.min_balance));
+    binPut32(out + 16, static_cast<uint32_t>(resp.max_balance));
+    binPut32(out + 20, static_cast<uint32_t>(resp.frozen));
+}
+
+void binDecodeResponse(const char *in, BinResponse &resp)
+{
+    resp.op = static_cast<BinOp>(in[2]);
+    resp.status = static_cast<uint8_t>(in[3]);
+    resp.seq = binGet32(in + 4);
+    resp.balance = static_cast<int32_t>(binGet32(in + 8));
+    resp.min_balance = static_cast<int32_t>(binGet32(in + 12));
+    resp.max_balance = static_cast<int32_t>(binGet32(in + 16));
+    resp.frozen = static_cast<int32_t>(binGet32(in + 20));
+}
+
+void binAppendAck(std::string &out)
+{
+    char ack[BIN_ACK_SIZE];
+    std::memcpy(ack, BIN_ACK_MAGIC, 4);
+    binPut16(ack + 4, BIN_VERSION);
+    binPut16(ack + 6, 0);
+    out.append(ack, sizeof(ack));
+}
+
+template <class B>
+static void execute(B &bank, const BinRequest &req, BinResponse &resp)
+{
+    resp.op = req.op;
+    resp.status = static_cast<uint8_t>(BankStatus::Ok);
+    resp.seq = req.seq;
+    resp.balance = resp.min_balance = resp.max_balance = resp.frozen = 0;
+
+    BankStatus st = BankStatus::Ok;
+
+    try
+    {
+        switch (req.op)
+        {
+        case BinOp::Ping:
+            break;
+        // Отказы Bank приходят кодом, без исключений — он и уходит в ответ
+        case BinOp::Transfer:
+            st = bank.tryTransfer(req.a, req.b, req.c);
+            break;
+        case BinOp::Freeze:
+            st = bank.tryFreeze(req.a, true);
+            break;
+        case BinOp::Unfreeze:
+            st = bank.tryFreeze(req.a, false);
+            break;
+        case BinOp::MassUpdate:
+            st = bank.tryMassUpdate(req.a);
+            break;
+        case BinOp::SetLimits:
+            st = bank.trySetLimits(static_cast<size_t>(req.a), req.b, req.c);
+            break;
+        case BinOp::Query:
+        {
+            Account a;
+            if ((st = queryAccount(bank, req.a, a)) != BankStatus::Ok)
+                break;
+            resp.balance = a.balance;
+            resp.min_balance = a.min_balance;
+            resp.max_balance = a.max_balance;
+            resp.frozen = a.frozen ? 1 : 0;
+            break;
+        }
+        default:
+            resp.status = BIN_UNKNOWN_OP;
+            return;
+        }
+        resp.status = static_cast<uint8_t>(st);
+    }
+    catch (const BankError &ex)
+    {
+        resp.status = static_cast<uint8_t>(ex.status());
+    }
+    catch (const std::out_of_range &)
+    {
+        resp.status = static_cast<uint8_t>(BankStatus::AccountNotFound);
+    }
+    catch (const std::exception &)
+    {
+        resp.status = BIN_INTERNAL;
+    }
+}
+
+void binEncodeBatch(uint32_t seq, const Transfer *items, size_t count, bool atomic,
+                    std::string &out)
+{
+    size_t len = BIN_BATCH_HEADER_SIZE + 12 * count;
+    size_t base = out.size();
+    out.resize(base + len);
+    char *p = &out[base];
+    binPut16(p, static_cast<uint16_t>(len));
+    p[2] = static_cast<char>(BinOp::TransferBatch);
+    p[3] = 0;
+    binPut32(p + 4, seq);
+    binPut32(p + 8, static_cast<uint32_t>(count));
+    binPut32(p + 12, atomic ? BIN_BATCH_ATOMIC : 0);
+    p += BIN_BATCH_HEADER_SIZE;
+    for (size_t i = 0; i < count; ++i, p += 12)
+    {
+        binPut32(p, static_cast<uint32_t>(items[i].from_id));
+        binPut32(p + 4, static_cast<uint32_t>(items[i].to_id));
+        binPut32(p + 8, static_cast<uint32_t>(items[i].amount));
+    }
+}
+
+template <class B>
+static void executeBatch(B &bank, const char *frame, size_t len, std::string &out)
+{
+    uint32_t seq = binGet32(frame + 4);
+    size_t count = len >= BIN_BATCH_HEADER_SIZE ? binGet32(frame + 8) : 0;
+    bool valid = len >= BIN_BATCH_HEADER_SIZE && len == BIN_BATCH_HEADER_SIZE + 12 * count;
+    if (!valid)
+        count = 0;
+
+    std::vector<Transfer> items(count);
+    std::vector<BankStatus> results(count);
+    const char *p = frame + BIN_BATCH_HEADER_SIZE;
+    for (size_t i = 0; i < count; ++i, p += 12)
+    {
+        items[i].from_id = static_cast<int32_t>(binGet32(p));
+        items[i].to_id = static_cast<int32_t>(binGet32(p + 4));
+        items[i].amount = static_cast<int32_t>(binGet32(p + 8));
+    }
+
+    size_t applied = 0;
+    uint8_t status = valid ? static_cast<uint8_t>(BankStatus::Ok) : static_cast<uint8_t>(BIN_BAD_FRAME);
+    if (valid && count > 0)
+    {
+        bool atomic = (binGet32(frame + 12) & BIN_BATCH_ATOMIC) != 0;
+        try
+        {
+            applied = bank.transferBatch(items.data(), count, results.data(), atomic);
+        }
+        catch (const std::exception &)
+        {
+            status = BIN_INTERNAL;
+            count = 0;
+        }
+    }
+
+    size_t rlen = BIN_BATCH_HEADER_SIZE + count;
+    size_t base = out.size();
+    out.resize(base + rlen);
+    char *r = &out[base];
+    binPut16(r, static_cast<uint16_t>(rlen));
+    r[2] = static_cast<char>(BinOp::TransferBatch);
+    r[3] = static_cast<char>(status);
+    binPut32(r + 4, seq);
+    binPut32(r + 8, static_cast<uint32_t>(applied));
+    binPut32(r + 12, static_cast<uint32_t>(count));
+    for (size_t i = 0; i < count; ++i)
+        r[BIN_BATCH_HEADER_SIZE + i] = static_cast<char>(results[i]);
+}
+
+// Вид запроса в Stats — как у текстовой команды с тем же действием
+static CommandId statsKind(BinOp op) noexcept
+{
+    switch (op)
+    {
+    case BinOp::Transfer:
+        return CommandId::Transfer;
+    case BinOp::Freeze:
+        return CommandId::Freeze;
+    case BinOp::Unfreeze:
+        return CommandId::Unfreeze;
+    case BinOp::MassUpdate:
+        return CommandId::MassUpdate;
+    case BinOp::SetLimits:
+        return CommandId::SetLimits;
+    case BinOp::Query:
+        return CommandId::ShowBalance;
+    case BinOp::TransferBatch:
+        return CommandId::TransferBatch;
+    default:
+        return CommandId::Unknown;
+    }
+}
+
+// Исход для Stats: коды Bank как есть, ошибки протокола — отдельными причинами
+static unsigned statsReason(uint8_t status) noexcept
+{
+    if (status < STATS_USAGE)
+        return status;
+    return status == BIN_UNKNOWN_OP ? STATS_UNKNOWN
+           : status == BIN_BAD_FRAME ? STATS_USAGE
+                                     : STATS_INTERNAL;
+}
+
+static uint64_t elapsedNs(std::chrono::steady_clock::time_point t0) noexcept
+{
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                     std::chrono::steady_clock::now() - t0)
+                                     .count());
+}
+
+// Ping — проверка связи, в статистику запросов не входит
+template <class B>
+static void timed(B &bank, const BinRequest &req, BinResponse &resp)
+{
+    if (req.op == BinOp::Ping)
+    {
+        execute(bank, req, resp);
+        return;
+    }
+    const unsigned kind = static_cast<unsigned>(statsKind(req.op));
+    if (traceEnabled())
+        traceBeginRequest(kind);
+    const auto t0 = std::chrono::steady_clock::now();
+    {
+        TraceSpan span(TracePhase::Apply);
+        execute(bank, req, resp);
+    }
+    statsRecord(kind, statsReason(resp.status), elapsedNs(t0));
+}
+
+template <class B>
+static void timedBatch(B &bank, const char *frame, size_t len, std::string &out)
+{
+    const unsigned kind = static_cast<unsigned>(CommandId::TransferBatch);
+    if (traceEnabled())
+        traceBeginRequest(kind);
+    const size_t base = out.size();
+    const auto t0 = std::chrono::steady_clock::now();
+    {
+        TraceSpan span(TracePhase::Apply);
+        executeBatch(bank, frame, len, out);
+    }
+    statsRecord(kind, statsReason(static_cast<uint8_t>(out[base + 3])), elapsedNs(t0));
+}
+
+void binExecute(Bank &bank, const BinRequest &req, BinResponse &resp)
+{
+    timed(bank, req, resp);
+}
+
+void binExecute(ShardedBank &bank, const BinRequest &req, BinResponse &resp)
+{
+    timed(bank, req, resp);
+}
+
+void binExecuteBatch(Bank &bank, const char *frame, size_t len, std::string &out)
+{
+    timedBatch(bank, frame, len, out);
+}
+
+void binExecuteBatch(ShardedBank &bank, const char *frame, size_t len, std::string &out)
+{
+    timedBatch(bank, frame, len, out);
+}
+
+void binExecute(Ledger &ledger, const BinRequest &req, BinResponse &resp)
+{
+    timed(ledger, req, resp);
+}
+
+void binExecuteBatch(Ledger &ledger, const char *frame, size_t len, std::string &out)
+{
+    timedBatch(ledger, frame, len, out);
+}
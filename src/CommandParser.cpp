@@ -0,0 +1,60 @@
+#include "CommandParser.hpp"
+
+bool parseInt64(Token tok, int64_t min, int64_t max, int64_t &value) noexcept
+{
+    const char *p = tok.data;
+    const char *end = tok.data + tok.size;
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+'))
+        negative = *p++ == '-';
+    if (p == end)
+        return false;
+
+    // Модуль копится в uint64 и не превышает предел своего знака
+    if (negative ? min > 0 : max < 0)
+        return false;
+    const uint64_t limit = negative ? 0 - static_cast<uint64_t>(min) : static_cast<uint64_t>(max);
+    uint64_t u = 0;
+    for (; p < end; ++p)
+    {
+        const unsigned d = static_cast<unsigned>(*p - '0');
+        if (d > 9 || d > limit || u > (limit - d) / 10)
+            return false;
+        u = u * 10 + d;
+    }
+    const int64_t v = negative ? static_cast<int64_t>(0 - u) : static_cast<int64_t>(u);
+    if (v < min || v > max)
+        return false;
+    value = v;
+    return true;
+}
+
+bool parseCount(Token tok, size_t &value) noexcept
+{
+    if (tok.empty() || tok.data[0] == '-' || tok.data[0] == '+')
+        return false;
+    int64_t v;
+    if (!parseInt64(tok, 0, INT64_MAX, v))
+        return false;
+    value = static_cast<size_t>(v);
+    return true;
+}
+
+char *formatInt(char *row, int64_t v, int width) noexcept
+{
+    char digits[24];
+    char *d = digits + sizeof(digits);
+    uint64_t u = v < 0 ? 0 - static_cast<uint64_t>(v) : static_cast<uint64_t>(v);
+    do
+    {
+        *--d = static_cast<char>('0' + u % 10);
+        u /= 10;
+    } while (u);
+    if (v < 0)
+        *--d = '-';
+    const int len = static_cast<int>(digits + sizeof(digits) - d);
+    for (int i = len; i < width; ++i)
+        *row++ = ' ';
+    std::memcpy(row, d, len);
+    return row + len;
+}
@@ -0,0 +1,462 @@
+#include "Commands.hpp"
+#include "Ledger.hpp"
+#include "ShardedBank.hpp"
+#include "Stats.hpp"
+#include "Trace.hpp"
+
+#include <chrono>    // steady_clock
+#include <cstring>   // std::memcmp
+#include <exception> // std::exception
+#include <stdexcept> // std::out_of_range
+#include <vector>    // std::vector
+
+const CommandInfo COMMANDS[] = {
+    {CommandId::Help, "help", "", "show help", SCOPE_ALL},
+    {CommandId::Shutdown, "shutdown", "", "stop server", SCOPE_SERVER},
+    {CommandId::Exit, "exit", "", "exit the program", SCOPE_CLI},
+    {CommandId::Transfer, "transfer", "<from> <to> <amount>", "transfer funds", SCOPE_ALL},
+    {CommandId::TransferBatch, "transfer_batch", "[atomic] <from> <to> <amount> [<from> <to> <amount> ...]",
+     "batch transfer", SCOPE_ALL},
+    {CommandId::Freeze, "freeze", "<id>", "freeze account", SCOPE_ALL},
+    {CommandId::Unfreeze, "unfreeze", "<id>", "unfreeze account", SCOPE_ALL},
+    {CommandId::MassUpdate, "mass_update", "<amount>", "mass update balances", SCOPE_ALL},
+    {CommandId::SetLimits, "set_limits", "<id> <min> <max>", "set account limits", SCOPE_ALL},
+    {CommandId::ShowAccountList, "show_account_list", "[offset [limit]] [frozen] [balance <lo> <hi>]",
+     "accounts list", SCOPE_ALL},
+    {CommandId::TotalBalance, "total_balance", "", "sum of all balances", SCOPE_ALL},
+    {CommandId::ShowMin, "show_min", "<id>", "showing min balance for account <id>", SCOPE_ALL},
+    {CommandId::ShowMax, "show_max", "<id>", "showing max balance for account <id>", SCOPE_ALL},
+    {CommandId::ShowBalance, "show_balance", "<id>", "showing balance for account <id>", SCOPE_ALL},
+    {CommandId::Stats, "stats", "", "request statistics", SCOPE_SERVER},
+};
+const size_t COMMAND_COUNT = sizeof(COMMANDS) / sizeof(COMMANDS[0]);
+
+// COMMANDS идут в порядке CommandId начиная с Help
+static const CommandInfo &info(CommandId id) noexcept
+{
+    return COMMANDS[static_cast<size_t>(id) - 1];
+}
+
+static bool is(Token name, CommandId id) noexcept
+{
+    return std::memcmp(name.data, info(id).name, name.size) == 0;
+}
+
+CommandId lookupCommand(Token name) noexcept
+{
+    // Длина отсеивает почти все имена, остаётся не больше одного-двух memcmp
+    switch (name.size)
+    {
+    case 4:
+        return is(name, CommandId::Help)   ? CommandId::Help
+               : is(name, CommandId::Exit) ? CommandId::Exit
+                                           : CommandId::Unknown;
+    case 5:
+        return is(name, CommandId::Stats) ? CommandId::Stats : CommandId::Unknown;
+    case 6:
+        return is(name, CommandId::Freeze) ? CommandId::Freeze : CommandId::Unknown;
+    case 8:
+        // shutdown, transfer, unfreeze, show_min, show_max
+        switch (name.data[0])
+        {
+        case 's':
+            if (is(name, CommandId::Shutdown))
+                return CommandId::Shutdown;
+            return is(name, CommandId::ShowMin)   ? CommandId::ShowMin
+                   : is(name, CommandId::ShowMax) ? CommandId::ShowMax
+                                                  : CommandId::Unknown;
+        case 't':
+            return is(name, CommandId::Transfer) ? CommandId::Transfer : CommandId::Unknown;
+        case 'u':
+            return is(name, CommandId::Unfreeze) ? CommandId::Unfreeze : CommandId::Unknown;
+        }
+        return CommandId::Unknown;
+    case 10:
+        return is(name, CommandId::SetLimits) ? CommandId::SetLimits : CommandId::Unknown;
+    case 11:
+        return is(name, CommandId::MassUpdate) ? CommandId::MassUpdate : CommandId::Unknown;
+    case 12:
+        return is(name, CommandId::ShowBalance) ? CommandId::ShowBalance : CommandId::Unknown;
+    case 13:
+        return is(name, CommandId::TotalBalance) ? CommandId::TotalBalance : CommandId::Unknown;
+    case 14:
+        return is(name, CommandId::TransferBatch) ? CommandId::TransferBatch : CommandId::Unknown;
+    case 17:
+        return is(name, CommandId::ShowAccountList) ? CommandId::ShowAccountList
+                                                    : CommandId::Unknown;
+    }
+    return CommandId::Unknown;
+}
+
+void appendHelp(std::string &out, unsigned scope)
+{
+    out += "Available commands:\n";
+    for (size_t i = 0; i < COMMAND_COUNT; ++i)
+    {
+        const CommandInfo &c = COMMANDS[i];
+        if (!(c.scopes & scope))
+            continue;
+        // "  имя аргументы" в колонке шириной 29, затем "- описание"
+        const size_t start = out.size();
+        out += "  ";
+        out += c.name;
+        if (*c.args)
+        {
+            out += ' ';
+            out += c.args;
+        }
+        const size_t width = out.size() - start;
+        out.append(width < 31 ? 31 - width : 1, ' ');
+        out += "- ";
+        out += c.help;
+        out += '\n';
+    }
+}
+
+// Причина отказа последней команды нити (StatsReason) для Stats
+static thread_local unsigned reject_reason = STATS_OK;
+
+static void appendUsage(std::string &out, CommandId id)
+{
+    reject_reason = STATS_USAGE;
+    out += "Usage: ";
+    out += info(id).name;
+    out += ' ';
+    out += info(id).args;
+    out += '\n';
+}
+
+// "<prefix><v><suffix>\n"
+static void appendResult(std::string &out, const char *prefix, int64_t v, const char *suffix = "")
+{
+    out += prefix;
+    appendInt(out, v);
+    out += suffix;
+    out += '\n';
+}
+
+// Отказ Bank переводится в текст только здесь, на краю протокола
+static void appendStatus(std::string &out, BankStatus st)
+{
+    reject_reason = static_cast<unsigned>(st);
+    out += "Error: ";
+    out += bankStatusMessage(st);
+    out += '\n';
+}
+
+template <class B>
+static void transferBatch(B &bank, Tokenizer &args, std::string &out)
+{
+    // Буферы пакета живут в нити: в установившемся режиме без аллокаций
+    static thread_local std::vector<Transfer> items;
+    static thread_local std::vector<BankStatus> results;
+    items.clear();
+
+    bool atomic = false;
+    Token tok;
+    while (args.next(tok))
+    {
+        if (items.empty() && !atomic && tok == "atomic")
+        {
+            atomic = true;
+            continue;
+        }
+        Transfer t;
+        if (!parseInt32(tok, t.from_id) || !args.nextInt(t.to_id) || !args.nextInt(t.amount))
+        {
+            items.clear();
+            break;
+        }
+        items.push_back(t);
+    }
+    if (items.empty())
+    {
+        appendUsage(out, CommandId::TransferBatch);
+        return;
+    }
+
+    results.resize(items.size());
+    size_t applied = bank.transferBatch(items.data(), items.size(), results.data(), atomic);
+    out += "OK: batch applied ";
+    appendInt(out, static_cast<int64_t>(applied));
+    appendResult(out, " of ", static_cast<int64_t>(items.size()));
+    for (size_t i = 0; i < items.size(); ++i)
+    {
+        if (results[i] != BankStatus::Ok)
+        {
+            out += "  #";
+            appendInt(out, static_cast<int64_t>(i));
+            out += ": ";
+            out += bankStatusName(results[i]);
+            out += '\n';
+        }
+    }
+}
+
+BankStatus queryAccount(Bank &bank, int32_t id, Account &acc)
+{
+    return bank.tryGetAccount(id, acc);
+}
+
+BankStatus queryAccount(ShardedBank &bank, int32_t id, Account &acc)
+{
+    return bank.getAccount(id, acc);
+}
+
+static void appendTotal(std::string &out, int64_t total, size_t count)
+{
+    out += "Total balance: ";
+    appendInt(out, total);
+    appendResult(out, " (", static_cast<int64_t>(count), " accounts)");
+}
+
+static void appendTotal(Bank &bank, std::string &out)
+{
+    Bank::ReadView view(bank);
+    appendTotal(out, view.totalBalance(), view.count());
+}
+
+static void appendTotal(ShardedBank &bank, std::string &out)
+{
+    appendTotal(out, bank.totalBalance(), bank.getAccountCount());
+}
+
+// Ledger ставит в очередь только изменения; чтения идут прямо в Bank
+BankStatus queryAccount(Ledger &ledger, int32_t id, Account &acc)
+{
+    return queryAccount(ledger.bank(), id, acc);
+}
+
+static void appendTotal(Ledger &ledger, std::string &out)
+{
+    appendTotal(ledger.bank(), out);
+}
+
+// Текст отказа set_limits — тот же, что у бросающей Bank::setLimits
+static void appendLimitsError(std::string &out, int32_t newMin, int32_t newMax, int32_t balance)
+{
+    reject_reason = static_cast<unsigned>(BankStatus::InvalidLimits);
+    out += "Error: setLimits: ";
+    if (newMin > newMax)
+    {
+        out += "newMin (";
+        appendInt(out, newMin);
+        appendResult(out, ") cannot be greater than newMax (", newMax, ")");
+        return;
+    }
+    out += "current balance (";
+    appendInt(out, balance);
+    out += ") is outside the new limits [";
+    appendInt(out, newMin);
+    appendResult(out, ",", newMax, "]");
+}
+
+template <class B>
+static bool startListing(AccountListing &l, B &bank, Tokenizer &args, std::string &out)
+{
+    return l.start(bank, args, out);
+}
+
+static bool startListing(AccountListing &l, Ledger &ledger, Tokenizer &args, std::string &out)
+{
+    return l.start(ledger.bank(), args, out);
+}
+
+static void appendError(std::string &out, const std::exception &ex, unsigned reason)
+{
+    reject_reason = reason;
+    out += "Error: ";
+    out += ex.what();
+    out += '\n';
+}
+
+template <class B>
+static CommandResult execute(B &bank, CommandId id, Token name, Tokenizer &args, unsigned scope,
+                             std::string &out, AccountListing *listing)
+{
+    try
+    {
+        int32_t a, b, c;
+        BankStatus st;
+        switch (id)
+        {
+        case CommandId::Unknown:
+            reject_reason = STATS_UNKNOWN;
+            out += "Unknown command: ";
+            out.append(name.data, name.size);
+            out += '\n';
+            break;
+        case CommandId::Help:
+            appendHelp(out, scope);
+            break;
+        case CommandId::Shutdown:
+            out += "Server shutting down...\n";
+            return CommandResult::Shutdown;
+        case CommandId::Exit:
+            return CommandResult::Exit;
+        case CommandId::Transfer:
+            if (!args.nextInt(a) || !args.nextInt(b) || !args.nextInt(c))
+                appendUsage(out, id);
+            else if ((st = bank.tryTransfer(a, b, c)) != BankStatus::Ok)
+                appendStatus(out, st);
+            else
+                appendResult(out, "OK: transferred ", c);
+            break;
+        case CommandId::TransferBatch:
+            transferBatch(bank, args, out);
+            break;
+        case CommandId::Freeze:
+            if (!args.nextInt(a))
+                appendUsage(out, id);
+            else if ((st = bank.tryFreeze(a, true)) != BankStatus::Ok)
+                appendStatus(out, st);
+            else
+                appendResult(out, "OK: account ", a, " frozen");
+            break;
+        case CommandId::Unfreeze:
+            if (!args.nextInt(a))
+                appendUsage(out, id);
+            else if ((st = bank.tryFreeze(a, false)) != BankStatus::Ok)
+                appendStatus(out, st);
+            else
+                appendResult(out, "OK: account ", a, " unfrozen");
+            break;
+        case CommandId::MassUpdate:
+            if (!args.nextInt(a))
+                appendUsage(out, id);
+            else if (bank.tryMassUpdate(a, &b) == BankStatus::LimitViolation)
+            {
+                reject_reason = static_cast<unsigned>(BankStatus::LimitViolation);
+                appendResult(out, "Error: massUpdate: balance of account ", b,
+                             " would violate limits");
+            }
+            else
+                appendResult(out, "OK: balances updated by ", a);
+            break;
+        case CommandId::SetLimits:
+            if (!args.nextInt(a) || !args.nextInt(b) || !args.nextInt(c))
+                appendUsage(out, id);
+            else
+            {
+                int32_t balance = 0;
+                st = bank.trySetLimits(static_cast<size_t>(a), b, c, &balance);
+                if (st == BankStatus::InvalidLimits)
+                    appendLimitsError(out, b, c, balance);
+                else if (st != BankStatus::Ok)
+                    appendStatus(out, st);
+                else
+                    appendResult(out, "OK: limits set for account ", a);
+            }
+            break;
+        case CommandId::ShowAccountList:
+        {
+            // Без listing вызывающего — выводим целиком
+            AccountListing whole;
+            AccountListing &l = listing ? *listing : whole;
+            if (!startListing(l, bank, args, out))
+                appendUsage(out, id);
+            else
+            {
+                do
+                {
+                    l.fill(out);
+                } while (!listing && l.active());
+            }
+            break;
+        }
+        case CommandId::TotalBalance:
+            appendTotal(bank, out);
+            break;
+        case CommandId::ShowMin:
+        case CommandId::ShowMax:
+        case CommandId::ShowBalance:
+            if (!args.nextInt(a))
+                appendUsage(out, id);
+            else
+            {
+                Account acc;
+                if ((st = queryAccount(bank, a, acc)) != BankStatus::Ok)
+                {
+                    appendStatus(out, st);
+                    break;
+                }
+                out += "Account ";
+                appendInt(out, a);
+                if (id == CommandId::ShowMin)
+                    appendResult(out, " min balance: ", acc.min_balance);
+                else if (id == CommandId::ShowMax)
+                    appendResult(out, " max balance: ", acc.max_balance);
+                else
+                    appendResult(out, " balance: ", acc.balance);
+            }
+            break;
+        case CommandId::Stats:
+            appendStats(out);
+            break;
+        }
+    }
+    catch (const BankError &ex)
+    {
+        appendError(out, ex, static_cast<unsigned>(ex.status()));
+    }
+    catch (const std::out_of_range &ex)
+    {
+        appendError(out, ex, static_cast<unsigned>(BankStatus::AccountNotFound));
+    }
+    catch (const std::exception &ex)
+    {
+        appendError(out, ex, STATS_INTERNAL);
+    }
+    return CommandResult::Continue;
+}
+
+// Разбирает имя команды; запросы сервера учитываются в Stats (и Trace) вместе с задержкой
+template <class B>
+static CommandResult dispatch(B &bank, const char *begin, const char *end, unsigned scope,
+                              std::string &out, AccountListing *listing)
+{
+    const uint64_t parse_start = traceEnabled() ? traceNow() : 0;
+    Tokenizer args(begin, end);
+    Token name;
+    args.next(name);
+    CommandId id = lookupCommand(name);
+    if (id != CommandId::Unknown && !(info(id).scopes & scope))
+        id = CommandId::Unknown;
+    if (!(scope & SCOPE_SERVER))
+        return execute(bank, id, name, args, scope, out, listing);
+
+    if (parse_start)
+    {
+        traceBeginRequest(static_cast<unsigned>(id));
+        traceRecord(TracePhase::Parse, parse_start, traceNow() - parse_start);
+    }
+    reject_reason = STATS_OK;
+    const auto t0 = std::chrono::steady_clock::now();
+    CommandResult r;
+    {
+        TraceSpan span(TracePhase::Apply);
+        r = execute(bank, id, name, args, scope, out, listing);
+    }
+    const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - t0);
+    statsRecord(static_cast<unsigned>(id), reject_reason, static_cast<uint64_t>(ns.count()));
+    return r;
+}
+
+CommandResult executeCommand(Bank &bank, const char *begin, const char *end, unsigned scope,
+                             std::string &out, AccountListing *listing)
+{
+    return dispatch(bank, begin, end, scope, out, listing);
+}
+
+CommandResult executeCommand(ShardedBank &bank, const char *begin, const char *end, unsigned scope,
+                             std::string &out, AccountListing *listing)
+{
+    return dispatch(bank, begin, end, scope, out, listing);
+}
+
+CommandResult executeCommand(Ledger &ledger, const char *begin, const char *end, unsigned scope,
+                             std::string &out, AccountListing *listing)
+{
+    return dispatch(ledger, begin, end, scope, out, listing);
+}
@@ -0,0 +1,411 @@
+#include "EventLoop.hpp"
+#include "ServerCore.hpp"
+#include "Session.hpp"
+#include "Stats.hpp"
+#include "Trace.hpp"
+
+#include <arpa/inet.h>  // htons
+#include <atomic>       // std::atomic
+#include <chrono>       // steady_clock
+#include <netinet/in.h> // sockaddr_in
+#include <sys/epoll.h>  // epoll_*
+#include <sys/socket.h> // socket, bind, listen, accept4
+#include <unistd.h>     // close, read, write
+#include <cerrno>
+#include <cstdio>       // perror
+#include <iostream>     // cout
+#include <string>
+#include <thread>       // std::thread
+#include <tuple>        // std::forward_as_tuple
+#include <unordered_map>
+#include <vector>
+
+namespace
+{
+
+using Clock = std::chrono::steady_clock;
+
+// Состояние одного соединения внутри реактора
+struct Connection
+{
+    Connection(int fd_, Bank &bank) : fd(fd_), session(bank) { statsConnection(true); }
+    ~Connection() { statsConnection(false); }
+    Connection(const Connection &) = delete;
+    Connection &operator=(const Connection &) = delete;
+
+    int fd;
+    Session session;
+    Clock::time_point last_active = Clock::now();
+    bool reading = true; // EPOLLIN взведён
+};
+
+// Общие для реакторов предел соединений и сроки
+struct Limits
+{
+    unsigned max_connections;
+    unsigned idle_timeout;
+    unsigned drain_timeout;
+    std::atomic<unsigned> open{0};
+};
+
+int openListener(int port)
+{
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+    {
+        perror("socket");
+        return -1;
+    }
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    // Каждый реактор слушает свой сокет; ядро распределяет соединения
+    if (setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) < 0)
+    {
+        perror("setsockopt(SO_REUSEPORT)");
+        close(fd);
+        return -1;
+    }
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = INADDR_ANY;
+    addr.sin_port = htons(port);
+    if (bind(fd, (sockaddr *)&addr, sizeof(addr)) < 0)
+    {
+        perror("bind");
+        close(fd);
+        return -1;
+    }
+    if (listen(fd, SOMAXCONN) < 0)
+    {
+        perror("listen");
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+class Reactor
+{
+public:
+    Reactor(int listen_fd, Bank &bank, Limits &limits)
+        : listen_fd_(listen_fd), bank_(bank), limits_(limits)
+    {
+    }
+
+    void run()
+    {
+        epfd_ = epoll_create1(EPOLL_CLOEXEC);
+        if (epfd_ < 0)
+        {
+            perror("epoll_create1");
+            return;
+        }
+        add(listen_fd_, EPOLLIN);
+        // Уровневый режим: eventfd не вычитывается и будит все реакторы
+        add(wakeFd(), EPOLLIN);
+
+        std::vector<epoll_event> events(256);
+        // С таймаутом простоя реактор просыпается раз в секунду проверить соединения
+        const int wait_ms = limits_.idle_timeout > 0 ? 1000 : -1;
+        Clock::time_point next_sweep = Clock::now() + std::chrono::seconds(1);
+        while (!shutdownRequested())
+        {
+            int n = epoll_wait(epfd_, events.data(), static_cast<int>(events.size()), wait_ms);
+            if (n < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                perror("epoll_wait");
+                break;
+            }
+            for (int i = 0; i < n; ++i)
+            {
+                int fd = events[i].data.fd;
+                if (fd == listen_fd_)
+                    acceptAll();
+                else if (fd != wakeFd())
+                    onConnectionEvent(fd, events[i].events);
+            }
+            if (limits_.idle_timeout > 0 && Clock::now() >= next_sweep)
+            {
+                dropIdle();
+                next_sweep = Clock::now() + std::chrono::seconds(1);
+            }
+        }
+
+        drain();
+        for (auto &kv : conns_)
+            close(kv.first);
+        limits_.open -= static_cast<unsigned>(conns_.size());
+        conns_.clear();
+        close(epfd_);
+    }
+
+private:
+    int listen_fd_;
+    Bank &bank_;
+    Limits &limits_;
+    int epfd_ = -1;
+    std::unordered_map<int, Connection> conns_;
+
+    void add(int fd, uint32_t events)
+    {
+        epoll_event ev{};
+        ev.events = events;
+        ev.data.fd = fd;
+        epoll_ctl(epfd_, EPOLL_CTL_ADD, fd, &ev);
+    }
+
+    void acceptAll()
+    {
+        while (true)
+        {
+            int fd = accept4(listen_fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                if (errno != EAGAIN && errno != EWOULDBLOCK)
+                    perror("accept4");
+                return;
+            }
+            if (limits_.open.fetch_add(1) >= limits_.max_connections)
+            {
+                limits_.open.fetch_sub(1);
+                rejectBusy(fd);
+                continue;
+            }
+            Connection &c = conns_.emplace(std::piecewise_construct,
+                                           std::forward_as_tuple(fd),
+                                           std::forward_as_tuple(fd, bank_))
+                                .first->second;
+            add(fd, EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET);
+            c.session.start();
+            if (!flush(c))
+                drop(fd);
+        }
+    }
+
+    void onConnectionEvent(int fd, uint32_t events)
+    {
+        auto it = conns_.find(fd);
+        if (it == conns_.end())
+            return;
+        Connection &c = it->second;
+        c.last_active = Clock::now();
+
+        if (events & (EPOLLERR | EPOLLHUP))
+        {
+            drop(fd);
+            return;
+        }
+        // Чтение, прерванное ради отправки, продолжается, если отправка
+        // освободила сессию: иначе непрочитанное в сокете не даст нового фронта
+        bool unread = (events & (EPOLLIN | EPOLLRDHUP)) && !c.session.closing();
+        while (true)
+        {
+            if (unread)
+                unread = !readAll(c);
+            if (!flush(c) || (c.session.closing() && c.session.outSize() == 0))
+            {
+                drop(fd);
+                return;
+            }
+            if (!unread || !c.session.wantsInput())
+                break;
+        }
+        updateInterest(c);
+    }
+
+    /*
+     * Пока сессия не принимает ввод (идёт листинг, клиент не забирает
+     * ответы), EPOLLIN снят: данные остаются в сокете, и его окно
+     * тормозит клиента. Взведённый снова через EPOLL_CTL_MOD, EPOLLIN
+     * сработает сразу, если данные уже ждут.
+     */
+    void updateInterest(Connection &c)
+    {
+        const bool want = c.session.wantsInput();
+        if (want == c.reading)
+            return;
+        epoll_event ev{};
+        ev.events = EPOLLOUT | EPOLLET | (want ? EPOLLIN | EPOLLRDHUP : 0);
+        ev.data.fd = c.fd;
+        epoll_ctl(epfd_, EPOLL_CTL_MOD, c.fd, &ev);
+        c.reading = want;
+    }
+
+    // Читает до EAGAIN (edge-triggered) или пока сессия принимает ввод.
+    // false — остановлено сессией, в сокете могут остаться данные.
+    bool readAll(Connection &c)
+    {
+        char buf[16 * 1024];
+        while (c.session.wantsInput())
+        {
+            ssize_t n = read(c.fd, buf, sizeof(buf));
+            if (n > 0)
+            {
+                c.session.feed(buf, static_cast<size_t>(n));
+                continue;
+            }
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n == 0)
+            {
+                // Конец потока: отвечаем на уже принятое и закрываем
+                c.session.finish();
+            }
+            else if (errno != EAGAIN && errno != EWOULDBLOCK)
+            {
+                c.session.finish();
+            }
+            return true;
+        }
+        return c.session.closing();
+    }
+
+    // Пишет накопленные ответы до EAGAIN. false — ошибка сокета.
+    bool flush(Connection &c)
+    {
+        while (c.session.outSize() > 0)
+        {
+            ssize_t n;
+            {
+                TraceSpan span(TracePhase::Send);
+                n = send(c.fd, c.session.outData(), c.session.outSize(), MSG_NOSIGNAL);
+            }
+            if (n > 0)
+            {
+                c.session.consume(static_cast<size_t>(n));
+                continue;
+            }
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+                return true; // допишем по EPOLLOUT
+            return false;
+        }
+        return true;
+    }
+
+    void drop(int fd)
+    {
+        epoll_ctl(epfd_, EPOLL_CTL_DEL, fd, nullptr);
+        close(fd);
+        conns_.erase(fd);
+        limits_.open.fetch_sub(1);
+    }
+
+    /*
+     * Остановка: новых соединений и нового ввода нет, принятые строки
+     * выполняются, ответы досылаются по EPOLLOUT до срока drain_timeout.
+     * Что не успело — закрывает run().
+     */
+    void drain()
+    {
+        // eventfd остановки читаем уровнем — иначе epoll_wait не уснёт
+        epoll_ctl(epfd_, EPOLL_CTL_DEL, listen_fd_, nullptr);
+        epoll_ctl(epfd_, EPOLL_CTL_DEL, wakeFd(), nullptr);
+
+        std::vector<int> fds;
+        for (const auto &kv : conns_)
+            fds.push_back(kv.first);
+        for (int fd : fds)
+        {
+            Connection &c = conns_.at(fd);
+            c.session.drain();
+            if (!flush(c) || (c.session.closing() && c.session.outSize() == 0))
+                drop(fd);
+        }
+
+        const Clock::time_point deadline = Clock::now() + std::chrono::seconds(limits_.drain_timeout);
+        std::vector<epoll_event> events(256);
+        while (!conns_.empty())
+        {
+            const auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - Clock::now());
+            if (left.count() <= 0)
+                break;
+            int n = epoll_wait(epfd_, events.data(), static_cast<int>(events.size()),
+                               static_cast<int>(left.count()));
+            if (n < 0 && errno != EINTR)
+                break;
+            for (int i = 0; i < n; ++i)
+            {
+                auto it = conns_.find(events[i].data.fd);
+                if (it == conns_.end())
+                    continue;
+                Connection &c = it->second;
+                if ((events[i].events & (EPOLLERR | EPOLLHUP)) || !flush(c) ||
+                    (c.session.closing() && c.session.outSize() == 0))
+                    drop(c.fd);
+            }
+        }
+        if (!conns_.empty())
+            std::cout << "Drain timeout: closing " << conns_.size() << " connections\n";
+    }
+
+    // Закрывает соединения без событий дольше idle_timeout
+    void dropIdle()
+    {
+        const Clock::time_point deadline = Clock::now() - std::chrono::seconds(limits_.idle_timeout);
+        std::vector<int> idle;
+        for (const auto &kv : conns_)
+        {
+            if (kv.second.last_active < deadline)
+                idle.push_back(kv.first);
+        }
+        for (int fd : idle)
+        {
+            statsConnectionIdle();
+            drop(fd);
+        }
+    }
+};
+
+} // namespace
+
+int runEpollServer(const ServerOptions &options, Bank &bank)
+{
+    const int port = options.port;
+    unsigned reactors = options.reactors;
+    if (reactors == 0)
+        reactors = std::thread::hardware_concurrency();
+    if (reactors == 0)
+        reactors = 1;
+
+    std::vector<int> listeners;
+    for (unsigned i = 0; i < reactors; ++i)
+    {
+        int fd = openListener(port);
+        if (fd < 0)
+        {
+            for (int l : listeners)
+                close(l);
+            return 1;
+        }
+        listeners.push_back(fd);
+    }
+
+    std::cout << "Server listening on port " << port << " (epoll, "
+              << reactors << " reactors, up to " << options.max_connections << " connections)...\n";
+
+    Limits limits;
+    limits.max_connections = options.max_connections;
+    limits.idle_timeout = options.idle_timeout;
+    limits.drain_timeout = options.drain_timeout;
+    std::vector<std::thread> threads;
+    for (int fd : listeners)
+    {
+        threads.emplace_back([fd, &bank, &limits]() {
+            Reactor reactor(fd, bank, limits);
+            reactor.run();
+        });
+    }
+    for (auto &t : threads)
+        t.join();
+
+    for (int fd : listeners)
+        close(fd);
+    return 0;
+}
@@ -12,54 +12,178 @@
  * @param shm_name    - имя сегмента shared memory
  * @param N           - количество счетов
  * @param max_balance - максимальный баланс для каждого счета
+ * @param capacity    - число слотов в сегменте (0 — ровно N); запас
+ *                      позволяет добавлять счета без пересоздания сегмента
+ * @param layout      - раскладка счетов: Rows (Account[]) или Columns (SoA)
  * @return Указатель на созданный объект Bank или nullptr при ошибке.
  */
-Bank* initializeBankShared(const std::string& shm_name, size_t N, int32_t max_balance);
+Bank* initializeBankShared(const std::string& shm_name, size_t N, int32_t max_balance,
+                           size_t capacity = 0, AccountLayout layout = AccountLayout::Rows);
 
 #endif 
 
 
 #include "Initializer.hpp"
-#include <sys/mman.h>
-#include <fcntl.h>
-#include <unistd.h>
+#include "Segment.hpp"
+#include "Snapshot.hpp"
+#include <chrono>
 #include <cstring>
 #include <iostream>
 
-Bank* initializeBankShared(const std::string& shm_name, size_t N, int32_t max_balance) {
-    int shm_fd = shm_open(shm_name.c_str(), O_CREAT | O_RDWR, 0666);
-    if (shm_fd < 0) { perror("shm_open"); return nullptr; }
+Bank* initializeBankShared(const std::string& shm_name, size_t N, int32_t max_balance,
+                           size_t capacity, AccountLayout layout) {
+    SegmentView seg;
+    std::string error;
+    if (!createShmSegment(shm_name, N, capacity, max_balance, seg, error, layout)) {
+        std::cerr << error << "\n";
+        return nullptr;
+    }
+    return new Bank(seg.accounts, seg.accountCount(), seg.locks, &seg.header->account_count);
+}
 
-    if (ftruncate(shm_fd, N * sizeof(Account)) < 0) {
-        perror("ftruncate"); close(shm_fd); return nullptr;
+// Банк в файле (--file): тот же сегмент, отображённый из обычного файла
+static int initializeBankFile(const std::string& path, size_t N, int32_t max_balance,
+                              size_t capacity, AccountLayout layout) {
+    SegmentView seg;
+    std::string error;
+    if (!createFileSegment(path, N, capacity, max_balance, seg, error, layout) ||
+        !syncSegment(seg, error)) {
+        std::cerr << error << "\n";
+        detachSegment(seg);
+        return 1;
     }
+    detachSegment(seg);
+    std::cout << "Bank initialized in file: " << path << "\n";
+    return 0;
+}
 
-    void* ptr = mmap(nullptr, N * sizeof(Account), PROT_READ | PROT_WRITE, MAP_SHARED, shm_fd, 0);
-    close(shm_fd); 
-    if (ptr == MAP_FAILED) { perror("mmap"); return nullptr; }
+static bool attachSegment(const std::string& name, bool file, SegmentView& seg, std::string& error) {
+    return file ? attachFileSegment(name, seg, error) : attachShmSegment(name, seg, error);
+}
 
-    Account* accounts = static_cast<Account*>(ptr);
-    for (size_t i = 0; i < N; ++i) {
-        accounts[i].account_id = static_cast<int>(i);
-        accounts[i].balance    = 0;
-        accounts[i].min_balance= 0;
-        accounts[i].max_balance= max_balance;
-        accounts[i].frozen     = false;
+static int appendToShared(const std::string& shm_name, bool file, size_t k, int32_t max_balance) {
+    SegmentView seg;
+    std::string error;
+    if (!attachSegment(shm_name, file, seg, error) ||
+        !appendAccounts(seg, k, max_balance, error) ||
+        (file && !syncSegment(seg, error))) {
+        std::cerr << error << "\n";
+        detachSegment(seg);
+        return 1;
+    }
+    std::cout << "Accounts in " << shm_name << ": " << seg.accountCount()
+              << " of " << seg.header->capacity << "\n";
+    detachSegment(seg);
+    return 0;
+}
+
+static int snapshotShared(const std::string& shm_name, bool file, const std::string& path) {
+    SegmentView seg;
+    std::string error;
+    if (!attachSegment(shm_name, file, seg, error)) {
+        std::cerr << error << "\n";
+        return 1;
+    }
+    bool ok;
+    SnapshotTiming timing;
+    {
+        Bank bank(seg.accounts, seg.accountCount(), seg.locks, &seg.header->account_count);
+        ok = dumpSnapshot(bank, path, error, &timing);
     }
+    detachSegment(seg);
+    if (!ok) {
+        std::cerr << error << "\n";
+        return 1;
+    }
+    std::cout << "Snapshot of " << shm_name << " written to " << path << ": clients paused "
+              << timing.pause_ms << " ms, total " << timing.total_ms << " ms\n";
+    return 0;
+}
 
-    return new Bank(accounts, N);
+static int restoreShared(const std::string& shm_name, bool file, const std::string& path,
+                         size_t capacity) {
+    SnapshotHeader header;
+    SegmentView seg;
+    std::string error;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    if (!readSnapshotHeader(path, header, error) ||
+        !(file ? createFileSegment(shm_name, header.account_count, capacity, 0, seg, error,
+                                   static_cast<AccountLayout>(header.layout))
+               : createShmSegment(shm_name, header.account_count, capacity, 0, seg, error,
+                                  static_cast<AccountLayout>(header.layout))) ||
+        !loadSnapshot(path, header, seg.accounts, error) ||
+        (file && !syncSegment(seg, error))) {
+        std::cerr << error << "\n";
+        detachSegment(seg);
+        return 1;
+    }
+    std::cout << "Restored " << header.account_count << " accounts into " << shm_name << " in "
+              << std::chrono::duration<double, std::milli>(
+                     std::chrono::steady_clock::now() - start).count()
+              << " ms\n";
+    detachSegment(seg);
+    return 0;
 }
 
 int main(int argc, char** argv) {
+    // --file: вместо имени сегмента shared memory — путь к файлу банка
+    bool file = false;
+    if (argc >= 2 && std::strcmp(argv[1], "--file") == 0) {
+        file = true;
+        --argc;
+        ++argv;
+    }
+    if (argc >= 2 && std::strcmp(argv[1], "--snapshot") == 0) {
+        if (argc < 4) {
+            std::cerr << "Usage: initializer [--file] --snapshot <shm_name|path> <file>\n";
+            return 1;
+        }
+        return snapshotShared(argv[2], file, argv[3]);
+    }
+    if (argc >= 2 && std::strcmp(argv[1], "--restore") == 0) {
+        if (argc < 4) {
+            std::cerr << "Usage: initializer [--file] --restore <shm_name|path> <file> [capacity]\n";
+            return 1;
+        }
+        return restoreShared(argv[2], file, argv[3],
+                             argc >= 5 ? static_cast<size_t>(std::stoul(argv[4])) : 0);
+    }
+    if (argc >= 2 && std::strcmp(argv[1], "--append") == 0) {
+        if (argc < 5) {
+            std::cerr << "Usage: initializer [--file] --append <shm_name|path> <count> <max_balance>\n";
+            return 1;
+        }
+        return appendToShared(argv[2], file,
+                              static_cast<size_t>(std::stoul(argv[3])),
+                              static_cast<int32_t>(std::stoi(argv[4])));
+    }
+    AccountLayout layout = AccountLayout::Rows;
+    if (argc >= 2 && std::strncmp(argv[1], "--layout=", 9) == 0) {
+        if (std::strcmp(argv[1] + 9, "columns") == 0) {
+            layout = AccountLayout::Columns;
+        } else if (std::strcmp(argv[1] + 9, "rows") != 0) {
+            std::cerr << "Unknown layout: " << argv[1] + 9 << "\n";
+            return 1;
+        }
+        --argc;
+        ++argv;
+    }
     if (argc < 4) {
-        std::cerr << "Usage: initializer <shm_name> <count> <max_balance>\n";
+        std::cerr << "Usage: initializer [--file] [--layout=rows|columns] <shm_name|path> <count> <max_balance> [capacity]\n"
+                  << "       initializer [--file] --append <shm_name|path> <count> <max_balance>\n"
+                  << "       initializer [--file] --snapshot <shm_name|path> <file>\n"
+                  << "       initializer [--file] --restore <shm_name|path> <file> [capacity]\n";
         return 1;
     }
     std::string shm_name = argv[1];
     size_t N            = static_cast<size_t>(std::stoul(argv[2]));
     int32_t max_balance = static_cast<int32_t>(std::stoi(argv[3]));
+    size_t capacity     = argc >= 5 ? static_cast<size_t>(std::stoul(argv[4])) : 0;
+
+    if (file)
+        return initializeBankFile(shm_name, N, max_balance, capacity, layout);
 
-    Bank* bank = initializeBankShared(shm_name, N, max_balance);
+    Bank* bank = initializeBankShared(shm_name, N, max_balance, capacity, layout);
     if (!bank) {
         std::cerr << "Failed to initialize bank\n";
         return 1;
@@ -0,0 +1,285 @@
+#include "Ledger.hpp"
+#include "Trace.hpp"
+
+#include <cerrno>    // errno, EINTR
+#include <cstring>   // strerror
+#include <exception> // std::exception_ptr
+#include <sched.h>   // sched_yield, cpu_set_t
+#include <stdexcept> // std::runtime_error
+
+// Попыток опросить очередь или семафор, прежде чем уснуть
+static const int SPIN = 64;
+
+struct Ledger::Op
+{
+    enum Kind : uint8_t
+    {
+        Transfer,
+        Freeze,
+        MassUpdate,
+        SetLimits,
+        Batch,
+    };
+
+    Kind kind = Transfer;
+    BankStatus status = BankStatus::Ok;
+    int32_t a = 0, b = 0, c = 0;
+    int32_t out = 0; // Нарушитель massUpdate или баланс при отказе setLimits
+    const ::Transfer *items = nullptr;
+    BankStatus *results = nullptr;
+    size_t count = 0; // Batch: элементов, в ответе — применено
+    uint64_t lsn = 0; // Запись журнала; долговечности ждёт вызывающий
+    std::exception_ptr error; // Исключение Bank — пробрасывается вызывающему
+    sem_t done;
+
+    Op() { sem_init(&done, 0, 0); }
+    ~Op() { sem_destroy(&done); }
+    Op(const Op &) = delete;
+    Op &operator=(const Op &) = delete;
+};
+
+static void cpuRelax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+}
+
+static void waitSem(sem_t &sem)
+{
+    while (sem_wait(&sem) != 0 && errno == EINTR)
+    {
+    }
+}
+
+Ledger::Ledger(Bank &bank, size_t capacity, int cpu) : bank_(bank), cpu_(cpu)
+{
+    if (bank.sharedLocks())
+        throw std::invalid_argument("Ledger: bank shares its lock table with other processes");
+    size_t n = 2;
+    while (n < capacity)
+        n <<= 1;
+    cells_.reset(new Cell[n]);
+    mask_ = n - 1;
+    for (size_t i = 0; i < n; ++i)
+    {
+        cells_[i].seq.store(i, std::memory_order_relaxed);
+        cells_[i].op = nullptr;
+    }
+    sem_init(&wake_, 0, 0);
+    int rc = pthread_create(&thread_, nullptr, threadMain, this);
+    if (rc != 0)
+    {
+        sem_destroy(&wake_);
+        throw std::runtime_error(std::string("Ledger: pthread_create: ") + std::strerror(rc));
+    }
+}
+
+Ledger::~Ledger()
+{
+    stop_.store(true, std::memory_order_release);
+    sem_post(&wake_);
+    pthread_join(thread_, nullptr);
+    sem_destroy(&wake_);
+}
+
+void Ledger::submit(Op &op)
+{
+    TraceSpan span(TracePhase::Queue);
+    // Занять позицию: ячейка свободна, когда её seq равен номеру позиции
+    size_t pos = head_.load(std::memory_order_relaxed);
+    Cell *cell;
+    while (true)
+    {
+        cell = &cells_[pos & mask_];
+        const size_t seq = cell->seq.load(std::memory_order_acquire);
+        const intptr_t dif = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+        if (dif == 0)
+        {
+            if (head_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                break;
+        }
+        else if (dif < 0)
+        {
+            // Кольцо полно: ledger отстаёт, уступаем ему процессор
+            sched_yield();
+            pos = head_.load(std::memory_order_relaxed);
+        }
+        else
+        {
+            pos = head_.load(std::memory_order_relaxed);
+        }
+    }
+    cell->op = &op;
+    cell->seq.store(pos + 1, std::memory_order_release);
+
+    // Публикация и проверка sleeping_ упорядочены с парой в threadMain:
+    // либо ledger увидит заявку, либо мы увидим, что он уснул
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (sleeping_.load(std::memory_order_relaxed) && sleeping_.exchange(false))
+        sem_post(&wake_);
+
+    bool done = false;
+    for (int i = 0; i < SPIN && !done; ++i)
+    {
+        done = sem_trywait(&op.done) == 0;
+        cpuRelax();
+    }
+    if (!done)
+        waitSem(op.done);
+    if (op.error)
+        std::rethrow_exception(op.error);
+    // fdatasync ждёт нить соединения: ledger тем временем применяет следующие
+    // заявки, и их записи уходят на диск одной пачкой
+    bank_.waitLogged(op.lsn);
+}
+
+Ledger::Op *Ledger::pop() noexcept
+{
+    Cell &cell = cells_[tail_ & mask_];
+    if (cell.seq.load(std::memory_order_acquire) != tail_ + 1)
+        return nullptr;
+    Op *op = cell.op;
+    // Ячейка снова свободна для позиции на круг дальше
+    cell.seq.store(tail_ + mask_ + 1, std::memory_order_release);
+    ++tail_;
+    return op;
+}
+
+void Ledger::apply(Op &op)
+{
+    try
+    {
+        switch (op.kind)
+        {
+        case Op::Transfer:
+            op.status = bank_.applyTransfer(op.a, op.b, op.c, op.lsn);
+            break;
+        case Op::Freeze:
+            op.status = bank_.applyFreeze(op.a, op.b != 0, op.lsn);
+            break;
+        case Op::MassUpdate:
+            op.status = bank_.applyMassUpdate(op.a, &op.out, op.lsn);
+            break;
+        case Op::SetLimits:
+            op.status = bank_.applySetLimits(static_cast<size_t>(op.a), op.b, op.c, &op.out, op.lsn);
+            break;
+        case Op::Batch:
+            op.count = bank_.applyBatch(op.items, op.count, op.results, op.b != 0, op.lsn);
+            break;
+        }
+    }
+    catch (...)
+    {
+        // Сбой журнала или памяти: нить ledger не должна погибнуть из-за одной заявки
+        op.error = std::current_exception();
+    }
+    applied_.fetch_add(1, std::memory_order_release);
+    // После этого op может быть уже уничтожена вызывающим
+    sem_post(&op.done);
+}
+
+void *Ledger::threadMain(void *arg)
+{
+    Ledger &l = *static_cast<Ledger *>(arg);
+    if (l.cpu_ >= 0)
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(l.cpu_, &set);
+        pthread_setaffinity_np(pthread_self(), sizeof(set), &set); // Не вышло — работаем без привязки
+    }
+
+    // Право писателя нить держит, пока не спит; срезы и снимки забирают
+    // его между заявками (writerYield)
+    l.bank_.writerEnter();
+    while (true)
+    {
+        l.bank_.writerYield();
+        Op *op = l.pop();
+        for (int i = 0; !op && i < SPIN; ++i)
+        {
+            cpuRelax();
+            op = l.pop();
+        }
+        if (op)
+        {
+            l.apply(*op);
+            continue;
+        }
+        if (l.stop_.load(std::memory_order_acquire))
+            break;
+
+        l.sleeping_.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if ((op = l.pop()) != nullptr)
+        {
+            // Заявка успела появиться: не спим (лишний sem_post лишь разбудит впустую)
+            l.sleeping_.store(false, std::memory_order_relaxed);
+            l.apply(*op);
+            continue;
+        }
+        l.bank_.writerLeave();
+        waitSem(l.wake_);
+        l.bank_.writerEnter();
+    }
+    l.bank_.writerLeave();
+    return nullptr;
+}
+
+BankStatus Ledger::tryTransfer(int from_id, int to_id, int32_t amount)
+{
+    Op op;
+    op.kind = Op::Transfer;
+    op.a = from_id;
+    op.b = to_id;
+    op.c = amount;
+    submit(op);
+    return op.status;
+}
+
+BankStatus Ledger::tryFreeze(int id, bool frozen)
+{
+    Op op;
+    op.kind = Op::Freeze;
+    op.a = id;
+    op.b = frozen;
+    submit(op);
+    return op.status;
+}
+
+BankStatus Ledger::tryMassUpdate(int32_t amount, int *violator)
+{
+    Op op;
+    op.kind = Op::MassUpdate;
+    op.a = amount;
+    submit(op);
+    if (op.status == BankStatus::LimitViolation && violator)
+        *violator = op.out;
+    return op.status;
+}
+
+BankStatus Ledger::trySetLimits(size_t id, int32_t newMin, int32_t newMax, int32_t *balance)
+{
+    Op op;
+    op.kind = Op::SetLimits;
+    op.a = static_cast<int32_t>(id);
+    op.b = newMin;
+    op.c = newMax;
+    submit(op);
+    if (op.status == BankStatus::InvalidLimits && balance)
+        *balance = op.out;
+    return op.status;
+}
+
+size_t Ledger::transferBatch(const Transfer *items, size_t count, BankStatus *results, bool atomic)
+{
+    Op op;
+    op.kind = Op::Batch;
+    op.items = items;
+    op.results = results;
+    op.count = count;
+    op.b = atomic;
+    submit(op);
+    return op.count;
+}
@@ -0,0 +1,40 @@
+#include "LockTable.hpp"
+
+#include <cstring> // memset
+
+size_t lockTableBytes(size_t stripe_count) noexcept
+{
+    return sizeof(LockTable) + stripe_count * sizeof(LockStripe);
+}
+
+int lockTableInit(LockTable *table, size_t stripe_count, bool process_shared)
+{
+    std::memset(static_cast<void *>(table), 0, lockTableBytes(stripe_count));
+    table->stripe_count = static_cast<uint32_t>(stripe_count);
+    table->process_shared = process_shared ? 1 : 0;
+
+    pthread_mutexattr_t attr;
+    int rc = pthread_mutexattr_init(&attr);
+    if (rc != 0)
+        return rc;
+    rc = pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+    if (rc == 0 && process_shared)
+        rc = pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+
+    if (rc == 0)
+        rc = pthread_mutex_init(&table->recovery_mtx, &attr);
+    LockStripe *stripes = table->stripes();
+    for (size_t i = 0; rc == 0 && i < stripe_count; ++i)
+        rc = pthread_mutex_init(&stripes[i].mtx, &attr);
+
+    pthread_mutexattr_destroy(&attr);
+    return rc;
+}
+
+void lockTableDestroy(LockTable *table) noexcept
+{
+    LockStripe *stripes = table->stripes();
+    for (size_t i = 0; i < table->stripe_count; ++i)
+        pthread_mutex_destroy(&stripes[i].mtx);
+    pthread_mutex_destroy(&table->recovery_mtx);
+}
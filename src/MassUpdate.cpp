@@ -0,0 +1,283 @@
+#include "MassUpdate.hpp"
+
+#include <immintrin.h>
+#include <algorithm>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+// AVX2-путь читает Account[] как плотный массив int32 по 5 на запись
+static_assert(sizeof(Account) == 5 * sizeof(int32_t), "Account layout changed");
+
+static bool violates(const Account &a, int32_t amount) noexcept
+{
+    int64_t bal = static_cast<int64_t>(a.balance) + amount;
+    return bal < a.min_balance || bal > a.max_balance;
+}
+
+size_t massUpdateCheckScalar(const Account *accounts, size_t count, int32_t amount) noexcept
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (violates(accounts[i], amount))
+            return i;
+    }
+    return count;
+}
+
+void massUpdateApplyScalar(Account *accounts, size_t count, int32_t amount) noexcept
+{
+    for (size_t i = 0; i < count; ++i)
+        accounts[i].balance += amount;
+}
+
+// Колонки: сдвигаем указатели на начало куска
+static AccountColumns sliceColumns(const AccountColumns &cols, size_t begin) noexcept
+{
+    AccountColumns part = cols;
+    part.ids += begin;
+    part.balances += begin;
+    part.min_balances += begin;
+    part.max_balances += begin;
+    return part; // frozen не сдвигается — проходы его не читают
+}
+
+static bool violates(int32_t balance, int32_t lo, int32_t hi, int32_t amount) noexcept
+{
+    int64_t bal = static_cast<int64_t>(balance) + amount;
+    return bal < lo || bal > hi;
+}
+
+size_t massUpdateCheckScalar(const AccountColumns &cols, size_t count, int32_t amount) noexcept
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (violates(cols.balances[i], cols.min_balances[i], cols.max_balances[i], amount))
+            return i;
+    }
+    return count;
+}
+
+void massUpdateApplyScalar(const AccountColumns &cols, size_t count, int32_t amount) noexcept
+{
+    int32_t *bal = cols.balances;
+    for (size_t i = 0; i < count; ++i)
+        bal[i] += amount;
+}
+
+bool massUpdateHasAvx2() noexcept
+{
+    return __builtin_cpu_supports("avx2");
+}
+
+/*
+ * Маска нарушителей среди восьми счетов. Запас до нужной границы
+ * считается без знака: при min ≤ bal ≤ max разность точна, а
+ * нарушенный инвариант ловят знаковые сравнения.
+ */
+__attribute__((target("avx2")))
+static inline bool anyViolation(__m256i bal, __m256i lo, __m256i hi, bool up, __m256i vneed) noexcept
+{
+    __m256i room = up ? _mm256_sub_epi32(hi, bal) : _mm256_sub_epi32(bal, lo);
+    __m256i bad = _mm256_or_si256(_mm256_cmpgt_epi32(lo, bal), _mm256_cmpgt_epi32(bal, hi));
+    __m256i fits = _mm256_cmpeq_epi32(_mm256_max_epu32(room, vneed), room);
+    bad = _mm256_or_si256(bad, _mm256_xor_si256(fits, _mm256_set1_epi32(-1)));
+    return !_mm256_testz_si256(bad, bad);
+}
+
+// Требуемый запас |amount| без переполнения
+static uint32_t requiredRoom(int32_t amount) noexcept
+{
+    return amount >= 0 ? static_cast<uint32_t>(amount)
+                       : static_cast<uint32_t>(-static_cast<int64_t>(amount));
+}
+
+// Rows: восемь счетов — 40 int32, поля собираются gather'ом с шагом 5
+__attribute__((target("avx2")))
+size_t massUpdateCheckAvx2(const Account *accounts, size_t count, int32_t amount) noexcept
+{
+    const __m256i idx = _mm256_setr_epi32(0, 5, 10, 15, 20, 25, 30, 35);
+    const bool up = amount >= 0;
+    const __m256i vneed = _mm256_set1_epi32(static_cast<int32_t>(requiredRoom(amount)));
+    const int *base = reinterpret_cast<const int *>(accounts);
+
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        const int *p = base + 5 * i;
+        __m256i bal = _mm256_i32gather_epi32(p + 1, idx, 4);
+        __m256i lo = _mm256_i32gather_epi32(p + 2, idx, 4);
+        __m256i hi = _mm256_i32gather_epi32(p + 3, idx, 4);
+        // Маска грубее скалярной проверки (баланс вне лимитов, который
+        // amount возвращает в них) — решает скалярный пересчёт куска
+        if (anyViolation(bal, lo, hi, up, vneed))
+        {
+            const size_t r = massUpdateCheckScalar(accounts + i, 8, amount);
+            if (r < 8)
+                return i + r;
+        }
+    }
+    return i + massUpdateCheckScalar(accounts + i, count - i, amount);
+}
+
+// Columns: balance/min/max читаются подряд, без gather
+__attribute__((target("avx2")))
+size_t massUpdateCheckAvx2(const AccountColumns &cols, size_t count, int32_t amount) noexcept
+{
+    const bool up = amount >= 0;
+    const __m256i vneed = _mm256_set1_epi32(static_cast<int32_t>(requiredRoom(amount)));
+
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256i bal = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(cols.balances + i));
+        __m256i lo = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(cols.min_balances + i));
+        __m256i hi = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(cols.max_balances + i));
+        if (anyViolation(bal, lo, hi, up, vneed))
+        {
+            const size_t r = massUpdateCheckScalar(sliceColumns(cols, i), 8, amount);
+            if (r < 8)
+                return i + r;
+        }
+    }
+    return i + massUpdateCheckScalar(sliceColumns(cols, i), count - i, amount);
+}
+
+/*
+ * Восемь счетов — пять 256-битных слов; amount прибавляется к каждой
+ * пятой дорожке (поле balance), остальные поля получают +0.
+ */
+__attribute__((target("avx2")))
+void massUpdateApplyAvx2(Account *accounts, size_t count, int32_t amount) noexcept
+{
+    int32_t lanes[40] = {};
+    for (size_t k = 1; k < 40; k += 5)
+        lanes[k] = amount;
+    __m256i add[5];
+    for (size_t w = 0; w < 5; ++w)
+        add[w] = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(lanes + 8 * w));
+
+    char *base = reinterpret_cast<char *>(accounts);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256i *p = reinterpret_cast<__m256i *>(base + i * sizeof(Account));
+        for (size_t w = 0; w < 5; ++w)
+            _mm256_storeu_si256(p + w, _mm256_add_epi32(_mm256_loadu_si256(p + w), add[w]));
+    }
+    massUpdateApplyScalar(accounts + i, count - i, amount);
+}
+
+static constexpr unsigned MAX_THREADS = 64;
+
+__attribute__((target("avx2")))
+void massUpdateApplyAvx2(const AccountColumns &cols, size_t count, int32_t amount) noexcept
+{
+    const __m256i add = _mm256_set1_epi32(amount);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256i *p = reinterpret_cast<__m256i *>(cols.balances + i);
+        _mm256_storeu_si256(p, _mm256_add_epi32(_mm256_loadu_si256(p), add));
+    }
+    massUpdateApplyScalar(sliceColumns(cols, i), count - i, amount);
+}
+
+// Число нитей для count счетов (threads = 0 — по числу ядер)
+static unsigned resolveThreads(size_t count, unsigned threads) noexcept
+{
+    if (threads == 0)
+    {
+        unsigned hw = std::max(1u, std::thread::hardware_concurrency());
+        threads = static_cast<unsigned>(std::min<size_t>(hw, count / MASS_UPDATE_CHUNK));
+    }
+    threads = std::min(threads, MAX_THREADS);
+    return static_cast<unsigned>(std::max<size_t>(1, std::min<size_t>(threads, count / 8)));
+}
+
+// Разбиение [0, count) на threads кусков, кратных 8 (шаг AVX2)
+template <typename Fn>
+static void forEachChunk(size_t count, unsigned threads, Fn fn) noexcept
+{
+    size_t step = (count / threads + 7) & ~size_t(7);
+    std::vector<std::thread> workers;
+    try
+    {
+        workers.reserve(threads);
+    }
+    catch (const std::bad_alloc &)
+    {
+        step = count;
+    }
+    for (unsigned t = 1; t < threads && t * step < count; ++t)
+    {
+        size_t begin = t * step;
+        size_t end = std::min(count, begin + step);
+        try
+        {
+            workers.emplace_back(fn, t, begin, end);
+        }
+        catch (const std::system_error &)
+        {
+            // Нить не создалась — выполняем кусок сами, отказ не допускается
+            fn(t, begin, end);
+        }
+    }
+    fn(0u, size_t(0), std::min(count, step));
+    for (std::thread &w : workers)
+        w.join();
+}
+
+size_t massUpdateCheck(const AccountStore &accounts, size_t count, int32_t amount,
+                       unsigned threads) noexcept
+{
+    threads = resolveThreads(count, threads);
+    const bool simd = massUpdateHasAvx2();
+    const bool rows = accounts.layout() == AccountLayout::Rows;
+    size_t first[MAX_THREADS];
+    std::fill(first, first + threads, count);
+    forEachChunk(count, threads, [&](unsigned t, size_t begin, size_t end) {
+        size_t n = end - begin;
+        size_t off;
+        if (rows)
+        {
+            const Account *part = accounts.rows() + begin;
+            off = simd ? massUpdateCheckAvx2(part, n, amount) : massUpdateCheckScalar(part, n, amount);
+        }
+        else
+        {
+            AccountColumns part = sliceColumns(accounts.columns(), begin);
+            off = simd ? massUpdateCheckAvx2(part, n, amount) : massUpdateCheckScalar(part, n, amount);
+        }
+        if (off < n)
+            first[t] = begin + off;
+    });
+    return *std::min_element(first, first + threads);
+}
+
+void massUpdateApply(const AccountStore &accounts, size_t count, int32_t amount,
+                     unsigned threads) noexcept
+{
+    threads = resolveThreads(count, threads);
+    const bool simd = massUpdateHasAvx2();
+    const bool rows = accounts.layout() == AccountLayout::Rows;
+    forEachChunk(count, threads, [&](unsigned, size_t begin, size_t end) {
+        size_t n = end - begin;
+        if (rows)
+        {
+            Account *part = accounts.rows() + begin;
+            if (simd)
+                massUpdateApplyAvx2(part, n, amount);
+            else
+                massUpdateApplyScalar(part, n, amount);
+        }
+        else
+        {
+            AccountColumns part = sliceColumns(accounts.columns(), begin);
+            if (simd)
+                massUpdateApplyAvx2(part, n, amount);
+            else
+                massUpdateApplyScalar(part, n, amount);
+        }
+    });
+}
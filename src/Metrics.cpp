@@ -0,0 +1,311 @@
+#include "Metrics.hpp"
+#include "Commands.hpp"
+#include "Ledger.hpp"
+#include "ShardedBank.hpp"
+#include "Stats.hpp"
+#include "Trace.hpp"
+
+#include <atomic>       // std::atomic
+#include <cerrno>       // errno, EINTR
+#include <cstdio>       // snprintf
+#include <cstring>      // strerror
+#include <netinet/in.h> // sockaddr_in
+#include <pthread.h>    // pthread_*
+#include <sys/socket.h> // socket, bind, listen, accept
+#include <sys/time.h>   // timeval
+#include <unistd.h>     // close
+
+// Степени двойки наносекунд для границ гистограммы: от ~1 мкс до ~8.6 с
+static const unsigned HISTOGRAM_FIRST_EXP = 10;
+static const unsigned HISTOGRAM_LAST_EXP = 33;
+
+static void appendHeader(std::string &out, const char *name, const char *type, const char *help)
+{
+    out += "# HELP ";
+    out += name;
+    out += ' ';
+    out += help;
+    out += "\n# TYPE ";
+    out += name;
+    out += ' ';
+    out += type;
+    out += '\n';
+}
+
+// "<name>{<labels>} <value>\n"; labels без фигурных скобок, может быть пустым
+static void appendSample(std::string &out, const char *name, const std::string &labels, uint64_t value)
+{
+    out += name;
+    if (!labels.empty())
+    {
+        out += '{';
+        out += labels;
+        out += '}';
+    }
+    out += ' ';
+    appendInt(out, static_cast<int64_t>(value));
+    out += '\n';
+}
+
+static std::string label(const char *key, const char *value)
+{
+    std::string s = key;
+    s += "=\"";
+    s += value;
+    s += '"';
+    return s;
+}
+
+static void appendSeconds(std::string &out, double seconds)
+{
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%.9g", seconds);
+    out += buf;
+}
+
+static const char *commandName(size_t kind)
+{
+    return kind == 0 || kind > COMMAND_COUNT ? "unknown" : COMMANDS[kind - 1].name;
+}
+
+static void appendHistogram(std::string &out, const StatsSummary &s)
+{
+    const char *name = "tbank_request_duration_seconds";
+    appendHeader(out, name, "histogram", "Request execution time.");
+    uint64_t count = 0;
+    size_t bucket = 0;
+    for (unsigned e = HISTOGRAM_FIRST_EXP; e <= HISTOGRAM_LAST_EXP; ++e)
+    {
+        // Корзины до 2^e нс включительно: последняя корзина степени e - 1
+        const size_t last = 16 + (e - 5) * 8 + 7;
+        for (; bucket <= last; ++bucket)
+            count += s.buckets[bucket];
+        out += name;
+        out += "_bucket{le=\"";
+        appendSeconds(out, static_cast<double>(uint64_t(1) << e) / 1e9);
+        out += "\"} ";
+        appendInt(out, static_cast<int64_t>(count));
+        out += '\n';
+    }
+    for (; bucket < STATS_BUCKETS; ++bucket)
+        count += s.buckets[bucket];
+    out += name;
+    out += "_bucket{le=\"+Inf\"} ";
+    appendInt(out, static_cast<int64_t>(count));
+    out += '\n';
+    out += name;
+    out += "_sum ";
+    appendSeconds(out, static_cast<double>(s.latency_ns) / 1e9);
+    out += '\n';
+    appendSample(out, "tbank_request_duration_seconds_count", std::string(), count);
+}
+
+void appendMetrics(std::string &out, const MetricsSources &sources)
+{
+    StatsSummary s;
+    statsCollect(s);
+
+    appendHeader(out, "tbank_requests_total", "counter", "Requests by command and result.");
+    for (size_t k = 0; k < STATS_KINDS; ++k)
+    {
+        if (s.ok[k] + s.rejected[k] == 0)
+            continue;
+        const std::string command = label("command", commandName(k));
+        appendSample(out, "tbank_requests_total", command + ",result=\"ok\"", s.ok[k]);
+        appendSample(out, "tbank_requests_total", command + ",result=\"rejected\"", s.rejected[k]);
+    }
+
+    appendHeader(out, "tbank_rejections_total", "counter", "Rejected requests by reason.");
+    for (size_t r = 1; r < STATS_REASONS; ++r)
+    {
+        if (s.reasons[r])
+            appendSample(out, "tbank_rejections_total",
+                         label("reason", statsReasonName(static_cast<unsigned>(r))), s.reasons[r]);
+    }
+
+    appendHistogram(out, s);
+
+    appendHeader(out, "tbank_connections_active", "gauge", "Open client connections.");
+    appendSample(out, "tbank_connections_active", std::string(), s.connections_active);
+    appendHeader(out, "tbank_connections_total", "counter", "Accepted client connections.");
+    appendSample(out, "tbank_connections_total", std::string(), s.connections);
+    appendHeader(out, "tbank_connections_rejected_total", "counter",
+                 "Connections refused or closed by the server.");
+    appendSample(out, "tbank_connections_rejected_total", label("reason", "busy"), s.connections_busy);
+    appendSample(out, "tbank_connections_rejected_total", label("reason", "idle"), s.connections_idle);
+    appendHeader(out, "tbank_received_bytes_total", "counter", "Bytes received from clients.");
+    appendSample(out, "tbank_received_bytes_total", std::string(), s.bytes_in);
+    appendHeader(out, "tbank_sent_bytes_total", "counter", "Bytes sent to clients.");
+    appendSample(out, "tbank_sent_bytes_total", std::string(), s.bytes_out);
+
+    if (sources.ledger || sources.sharded)
+    {
+        appendHeader(out, "tbank_queue_depth", "gauge", "Operations waiting in the writer queues.");
+        if (sources.ledger)
+            appendSample(out, "tbank_queue_depth", label("queue", "ledger"), sources.ledger->depth());
+        if (sources.sharded)
+        {
+            for (size_t k = 0; k < sources.sharded->shardCount(); ++k)
+            {
+                std::string shard = label("queue", "shard") + ",shard=\"";
+                appendInt(shard, static_cast<int64_t>(k));
+                shard += '"';
+                appendSample(out, "tbank_queue_depth", shard, sources.sharded->queueDepth(k));
+            }
+        }
+    }
+    if (sources.ledger)
+    {
+        appendHeader(out, "tbank_ledger_applied_total", "counter", "Operations applied by the ledger.");
+        appendSample(out, "tbank_ledger_applied_total", std::string(), sources.ledger->applied());
+    }
+}
+
+// ---------------------------------------------------------------------
+// Слушатель HTTP
+// ---------------------------------------------------------------------
+
+static int metrics_fd = -1;
+static pthread_t metrics_tid;
+static bool metrics_running = false;
+static std::atomic<bool> metrics_stopping{false};
+static MetricsSources metrics_sources;
+
+static void sendAll(int fd, const std::string &data)
+{
+    size_t off = 0;
+    while (off < data.size())
+    {
+        ssize_t n = send(fd, data.data() + off, data.size() - off, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return;
+        off += static_cast<size_t>(n);
+    }
+}
+
+static void reply(int fd, const char *status, const char *type, const std::string &body)
+{
+    std::string head = "HTTP/1.1 ";
+    head += status;
+    head += "\r\nContent-Type: ";
+    head += type;
+    head += "\r\nContent-Length: ";
+    appendInt(head, static_cast<int64_t>(body.size()));
+    head += "\r\nConnection: close\r\n\r\n";
+    sendAll(fd, head);
+    sendAll(fd, body);
+}
+
+// Читает заголовок запроса и отвечает; тело запроса не нужно
+static void serve(int fd)
+{
+    // Молчащий клиент не держит слушатель: каждое чтение ждёт не дольше секунды
+    timeval tv{1, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    std::string request;
+    char buf[1024];
+    while (request.find("\r\n\r\n") == std::string::npos && request.size() < 8192)
+    {
+        ssize_t n = recv(fd, buf, sizeof(buf), 0);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            break;
+        request.append(buf, static_cast<size_t>(n));
+    }
+
+    const size_t sp = request.find(' ');
+    const size_t end = sp == std::string::npos ? sp : request.find_first_of(" ?", sp + 1);
+    if (request.compare(0, 4, "GET ") != 0 || end == std::string::npos)
+    {
+        reply(fd, "400 Bad Request", "text/plain", "bad request\n");
+        return;
+    }
+    const std::string path = request.substr(sp + 1, end - sp - 1);
+    std::string body;
+    if (path == "/metrics" || path == "/")
+    {
+        appendMetrics(body, metrics_sources);
+        reply(fd, "200 OK", "text/plain; version=0.0.4; charset=utf-8", body);
+    }
+    else if (path == "/trace" && traceEnabled())
+    {
+        traceDump(body);
+        reply(fd, "200 OK", "application/json", body);
+    }
+    else
+    {
+        reply(fd, "404 Not Found", "text/plain",
+              path == "/trace" ? "tracing is off (start server with --trace=PATH)\n" : "not found\n");
+    }
+}
+
+static void *metricsThread(void * /*arg*/)
+{
+    while (!metrics_stopping)
+    {
+        int fd = accept(metrics_fd, nullptr, nullptr);
+        if (fd < 0)
+        {
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            break; // Слушатель закрыт stopMetricsServer
+        }
+        serve(fd);
+        close(fd);
+    }
+    return nullptr;
+}
+
+bool startMetricsServer(int port, const MetricsSources &sources, std::string &error)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0)
+    {
+        error = std::string("metrics: socket: ") + std::strerror(errno);
+        return false;
+    }
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = INADDR_ANY;
+    addr.sin_port = htons(static_cast<uint16_t>(port));
+    if (bind(fd, (sockaddr *)&addr, sizeof(addr)) < 0 || listen(fd, 16) < 0)
+    {
+        error = "metrics: port " + std::to_string(port) + ": " + std::strerror(errno);
+        close(fd);
+        return false;
+    }
+
+    metrics_fd = fd;
+    metrics_sources = sources;
+    metrics_stopping = false;
+    int rc = pthread_create(&metrics_tid, nullptr, metricsThread, nullptr);
+    if (rc != 0)
+    {
+        error = std::string("metrics: pthread_create: ") + std::strerror(rc);
+        close(fd);
+        metrics_fd = -1;
+        return false;
+    }
+    metrics_running = true;
+    return true;
+}
+
+void stopMetricsServer()
+{
+    if (!metrics_running)
+        return;
+    metrics_stopping = true;
+    // shutdown() будит нить в accept()
+    shutdown(metrics_fd, SHUT_RDWR);
+    pthread_join(metrics_tid, nullptr);
+    close(metrics_fd);
+    metrics_fd = -1;
+    metrics_running = false;
+}
@@ -0,0 +1,469 @@
+#include "Segment.hpp"
+
+#include <sys/mman.h> // mmap, munmap
+#include <sys/stat.h> // fstat
+#include <fcntl.h>    // shm_open, fcntl, O_*
+#include <unistd.h>   // ftruncate, close
+#include <cerrno>
+#include <cstring>    // memset, strerror
+
+static size_t alignUp(size_t v) noexcept
+{
+    return (v + 63) & ~static_cast<size_t>(63);
+}
+
+static size_t stripesFor(size_t capacity) noexcept
+{
+    return capacity < SEGMENT_LOCK_STRIPES ? capacity : SEGMENT_LOCK_STRIPES;
+}
+
+static size_t locksOffset() noexcept
+{
+    return alignUp(sizeof(SegmentHeader));
+}
+
+static size_t accountsOffset(size_t capacity) noexcept
+{
+    return alignUp(locksOffset() + lockTableBytes(stripesFor(capacity)));
+}
+
+static std::string sysError(const char *what)
+{
+    return std::string(what) + ": " + std::strerror(errno);
+}
+
+static void fillAccounts(const AccountStore &accounts, size_t from, size_t to, int32_t max_balance)
+{
+    Account a;
+    a.balance = 0;
+    a.min_balance = 0;
+    a.max_balance = max_balance;
+    a.frozen = false;
+    for (size_t i = from; i < to; ++i)
+    {
+        a.account_id = static_cast<int>(i);
+        accounts.store(i, a);
+    }
+}
+
+static size_t accountsBytes(size_t capacity, AccountLayout layout) noexcept
+{
+    return layout == AccountLayout::Columns ? columnsBytes(capacity) : capacity * sizeof(Account);
+}
+
+static AccountStore accountsAt(void *mem, const SegmentHeader *h) noexcept
+{
+    char *p = static_cast<char *>(mem) + h->accounts_offset;
+    if (h->flags & SEGMENT_COLUMNAR)
+        return AccountStore(bindColumns(p, h->capacity));
+    return AccountStore(reinterpret_cast<Account *>(p));
+}
+
+// Мьютекс роста и таблица полос (process-shared, robust)
+static int initLocks(void *mem, SegmentHeader *h)
+{
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+    pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+    int rc = pthread_mutex_init(&h->grow_mtx, &attr);
+    pthread_mutexattr_destroy(&attr);
+    if (rc == 0)
+    {
+        LockTable *locks = reinterpret_cast<LockTable *>(static_cast<char *>(mem) + h->locks_offset);
+        rc = lockTableInit(locks, h->stripe_count, true);
+    }
+    return rc;
+}
+
+size_t segmentBytes(size_t capacity, AccountLayout layout) noexcept
+{
+    return accountsOffset(capacity) + accountsBytes(capacity, layout);
+}
+
+bool formatSegment(void *mem, size_t bytes, size_t count, size_t capacity,
+                   int32_t max_balance, std::string &error, AccountLayout layout)
+{
+    const bool columnar = layout == AccountLayout::Columns;
+    if (count == 0 || capacity < count)
+    {
+        error = "formatSegment: need 0 < count <= capacity";
+        return false;
+    }
+    if (bytes < segmentBytes(capacity, layout))
+    {
+        error = "formatSegment: memory too small for capacity";
+        return false;
+    }
+
+    SegmentHeader *h = static_cast<SegmentHeader *>(mem);
+    std::memset(static_cast<void *>(h), 0, sizeof(SegmentHeader));
+    h->version = SEGMENT_VERSION;
+    h->header_bytes = sizeof(SegmentHeader);
+    h->record_stride = columnar ? 0 : sizeof(Account);
+    h->flags = SEGMENT_ROBUST_LOCKS | SEGMENT_UNDO_JOURNAL | (columnar ? uint32_t(SEGMENT_COLUMNAR) : 0u);
+    h->stripe_count = static_cast<uint32_t>(stripesFor(capacity));
+    h->capacity = capacity;
+    h->account_count = count;
+    h->locks_offset = locksOffset();
+    h->accounts_offset = accountsOffset(capacity);
+    h->segment_bytes = segmentBytes(capacity, layout);
+
+    int rc = initLocks(mem, h);
+    if (rc != 0)
+    {
+        error = std::string("formatSegment: mutex init: ") + std::strerror(rc);
+        return false;
+    }
+
+    if (columnar)
+    {
+        // Битовая карта заморозки читается словами — обнуляем её целиком
+        std::memset(static_cast<char *>(mem) + h->accounts_offset, 0, columnsBytes(capacity));
+    }
+    fillAccounts(accountsAt(mem, h), 0, count, max_balance);
+
+    __atomic_store_n(&h->magic, SEGMENT_MAGIC, __ATOMIC_RELEASE);
+    return true;
+}
+
+bool bindSegment(void *mem, size_t bytes, SegmentView &view, std::string &error)
+{
+    if (bytes < sizeof(SegmentHeader))
+    {
+        error = "segment is smaller than its header";
+        return false;
+    }
+    SegmentHeader *h = static_cast<SegmentHeader *>(mem);
+    if (__atomic_load_n(&h->magic, __ATOMIC_ACQUIRE) != SEGMENT_MAGIC)
+    {
+        error = "not a TBANK segment (bad magic)";
+        return false;
+    }
+    if (h->version != SEGMENT_VERSION || h->header_bytes != sizeof(SegmentHeader))
+    {
+        error = "unsupported segment layout version " + std::to_string(h->version);
+        return false;
+    }
+    const bool columnar = (h->flags & SEGMENT_COLUMNAR) != 0;
+    if (h->record_stride != (columnar ? 0 : sizeof(Account)))
+    {
+        error = "incompatible account record stride " + std::to_string(h->record_stride);
+        return false;
+    }
+    if (h->flags & ~SEGMENT_KNOWN_FEATURES)
+    {
+        error = "segment requires unknown features";
+        return false;
+    }
+    if (h->segment_bytes > bytes || h->account_count == 0 || h->account_count > h->capacity ||
+        h->accounts_offset +
+                accountsBytes(h->capacity, columnar ? AccountLayout::Columns : AccountLayout::Rows) >
+            h->segment_bytes ||
+        h->locks_offset + lockTableBytes(h->stripe_count) > h->accounts_offset)
+    {
+        error = "corrupted segment header";
+        return false;
+    }
+
+    view.base = mem;
+    view.bytes = bytes;
+    view.header = h;
+    view.locks = reinterpret_cast<LockTable *>(static_cast<char *>(mem) + h->locks_offset);
+    view.accounts = accountsAt(mem, h);
+    return true;
+}
+
+bool createShmSegment(const std::string &shm_name, size_t count, size_t capacity,
+                      int32_t max_balance, SegmentView &view, std::string &error,
+                      AccountLayout layout)
+{
+    if (capacity < count)
+        capacity = count;
+    const size_t bytes = segmentBytes(capacity, layout);
+
+    int fd = shm_open(shm_name.c_str(), O_CREAT | O_RDWR, 0666);
+    if (fd < 0)
+    {
+        error = sysError("shm_open");
+        return false;
+    }
+    if (ftruncate(fd, bytes) < 0)
+    {
+        error = sysError("ftruncate");
+        close(fd);
+        return false;
+    }
+    void *mem = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mem == MAP_FAILED)
+    {
+        error = sysError("mmap");
+        return false;
+    }
+
+    if (!formatSegment(mem, bytes, count, capacity, max_balance, error, layout) ||
+        !bindSegment(mem, bytes, view, error))
+    {
+        munmap(mem, bytes);
+        return false;
+    }
+    return true;
+}
+
+bool attachShmSegment(const std::string &shm_name, SegmentView &view, std::string &error)
+{
+    int fd = shm_open(shm_name.c_str(), O_RDWR, 0666);
+    if (fd < 0)
+    {
+        error = sysError("shm_open");
+        return false;
+    }
+
+    // Размер берём у объекта, а не из командной строки
+    struct stat st;
+    if (fstat(fd, &st) < 0)
+    {
+        error = sysError("fstat");
+        close(fd);
+        return false;
+    }
+    const size_t bytes = static_cast<size_t>(st.st_size);
+    if (bytes < sizeof(SegmentHeader))
+    {
+        error = "segment is smaller than its header";
+        close(fd);
+        return false;
+    }
+
+    void *mem = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mem == MAP_FAILED)
+    {
+        error = sysError("mmap");
+        return false;
+    }
+    if (!bindSegment(mem, bytes, view, error))
+    {
+        munmap(mem, bytes);
+        return false;
+    }
+    return true;
+}
+
+/*
+ * fcntl-блокировки файлового сегмента:
+ *   байт 0 — подключение (исключительная, на время create/attach);
+ *   байт 1 — пользователи (разделяемая у каждого подключённого процесса).
+ * Смена исключительной блокировки на разделяемую у fcntl атомарна.
+ */
+static bool lockByte(int fd, short type, off_t byte, bool wait)
+{
+    struct flock fl;
+    std::memset(&fl, 0, sizeof(fl));
+    fl.l_type = type;
+    fl.l_whence = SEEK_SET;
+    fl.l_start = byte;
+    fl.l_len = 1;
+    while (fcntl(fd, wait ? F_SETLKW : F_SETLK, &fl) < 0)
+    {
+        if (errno != EINTR)
+            return false;
+    }
+    return true;
+}
+
+// Подсказки ядру: заголовок и полосы горячие, счета — крупными страницами, если можно
+static void adviseFileSegment(const SegmentView &view) noexcept
+{
+    char *base = static_cast<char *>(view.base);
+    madvise(base, view.header->accounts_offset, MADV_WILLNEED);
+    const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    const size_t start = view.header->accounts_offset / page * page;
+#ifdef MADV_HUGEPAGE
+    madvise(base + start, view.bytes - start, MADV_HUGEPAGE); // не поддерживается — не беда
+#endif
+}
+
+/*
+ * Холодный старт: процессы, державшие мьютексы файла, мертвы (перезагрузка
+ * или падение всех). Незафиксированные переводы откатываются по тому же
+ * правилу, что и в Bank::recoverStripe, затем мьютексы создаются заново.
+ */
+static bool recoverColdSegment(SegmentView &view, std::string &error)
+{
+    LockStripe *stripes = view.locks->stripes();
+    const uint32_t stripe_count = view.header->stripe_count;
+    for (uint32_t s = 0; s < stripe_count; ++s)
+    {
+        const TxnUndo &undo = stripes[s].undo;
+        if (undo.state == TxnUndo::IDLE || undo.lo_stripe >= stripe_count)
+            continue;
+        const TxnUndo &commit = stripes[undo.lo_stripe].undo;
+        if (commit.txn == undo.txn && commit.state == TxnUndo::PENDING &&
+            undo.slot[0] < view.header->capacity && undo.slot[1] < view.header->capacity)
+        {
+            view.accounts.balance(undo.slot[0]) = undo.old_balance[0];
+            view.accounts.balance(undo.slot[1]) = undo.old_balance[1];
+        }
+    }
+    int rc = initLocks(view.base, view.header);
+    if (rc != 0)
+    {
+        error = std::string("file segment: mutex init: ") + std::strerror(rc);
+        return false;
+    }
+    return true;
+}
+
+bool createFileSegment(const std::string &path, size_t count, size_t capacity,
+                       int32_t max_balance, SegmentView &view, std::string &error,
+                       AccountLayout layout)
+{
+    if (capacity < count)
+        capacity = count;
+    const size_t bytes = segmentBytes(capacity, layout);
+
+    int fd = open(path.c_str(), O_CREAT | O_RDWR | O_CLOEXEC, 0666);
+    if (fd < 0)
+    {
+        error = sysError(path.c_str());
+        return false;
+    }
+    if (!lockByte(fd, F_WRLCK, 0, true) || !lockByte(fd, F_WRLCK, 1, false))
+    {
+        error = path + ": file segment is in use by another process";
+        close(fd);
+        return false;
+    }
+
+    // Место под весь сегмент резервируем сразу: иначе нехватка диска
+    // проявилась бы SIGBUS при первой записи в страницу
+    int rc = ftruncate(fd, 0) == 0 ? posix_fallocate(fd, 0, bytes) : errno;
+    if (rc == EOPNOTSUPP || rc == EINVAL)
+        rc = ftruncate(fd, bytes) == 0 ? 0 : errno;
+    if (rc != 0)
+    {
+        error = path + ": cannot allocate " + std::to_string(bytes) + " bytes: " + std::strerror(rc);
+        close(fd);
+        return false;
+    }
+
+    void *mem = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (mem == MAP_FAILED)
+    {
+        error = sysError("mmap");
+        close(fd);
+        return false;
+    }
+    if (!formatSegment(mem, bytes, count, capacity, max_balance, error, layout) ||
+        !bindSegment(mem, bytes, view, error))
+    {
+        munmap(mem, bytes);
+        close(fd);
+        return false;
+    }
+    adviseFileSegment(view);
+
+    lockByte(fd, F_RDLCK, 1, true);
+    lockByte(fd, F_UNLCK, 0, true);
+    view.fd = fd;
+    return true;
+}
+
+bool attachFileSegment(const std::string &path, SegmentView &view, std::string &error)
+{
+    int fd = open(path.c_str(), O_RDWR | O_CLOEXEC);
+    if (fd < 0)
+    {
+        error = sysError(path.c_str());
+        return false;
+    }
+    if (!lockByte(fd, F_WRLCK, 0, true))
+    {
+        error = sysError("fcntl");
+        close(fd);
+        return false;
+    }
+    const bool cold = lockByte(fd, F_WRLCK, 1, false);
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || static_cast<size_t>(st.st_size) < sizeof(SegmentHeader))
+    {
+        error = path + ": not a bank segment";
+        close(fd);
+        return false;
+    }
+    const size_t bytes = static_cast<size_t>(st.st_size);
+    void *mem = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (mem == MAP_FAILED)
+    {
+        error = sysError("mmap");
+        close(fd);
+        return false;
+    }
+    if (!bindSegment(mem, bytes, view, error) || (cold && !recoverColdSegment(view, error)))
+    {
+        munmap(mem, bytes);
+        view = SegmentView();
+        close(fd);
+        return false;
+    }
+    adviseFileSegment(view);
+
+    lockByte(fd, F_RDLCK, 1, true);
+    lockByte(fd, F_UNLCK, 0, true);
+    view.fd = fd;
+    return true;
+}
+
+bool syncSegment(const SegmentView &view, std::string &error)
+{
+    if (msync(view.base, view.bytes, MS_SYNC) != 0)
+    {
+        error = sysError("msync");
+        return false;
+    }
+    return true;
+}
+
+void detachSegment(SegmentView &view) noexcept
+{
+    if (view.base)
+        munmap(view.base, view.bytes);
+    if (view.fd >= 0)
+        close(view.fd); // вместе с файлом снимаются и fcntl-блокировки
+    view = SegmentView();
+}
+
+bool appendAccounts(SegmentView &view, size_t k, int32_t max_balance, std::string &error)
+{
+    SegmentHeader *h = view.header;
+    int rc = pthread_mutex_lock(&h->grow_mtx);
+    if (rc == EOWNERDEAD)
+    {
+        // account_count публикуется одной записью — состояние всегда целостно
+        pthread_mutex_consistent(&h->grow_mtx);
+    }
+    else if (rc != 0)
+    {
+        error = std::string("appendAccounts: lock: ") + std::strerror(rc);
+        return false;
+    }
+
+    size_t count = view.accountCount();
+    bool ok = count + k <= h->capacity;
+    if (ok)
+    {
+        fillAccounts(view.accounts, count, count + k, max_balance);
+        __atomic_store_n(&h->account_count, static_cast<uint64_t>(count + k), __ATOMIC_RELEASE);
+    }
+    else
+    {
+        error = "appendAccounts: segment capacity " + std::to_string(h->capacity) +
+                " exceeded (" + std::to_string(count) + " in use)";
+    }
+
+    pthread_mutex_unlock(&h->grow_mtx);
+    return ok;
+}
@@ -1,283 +1,327 @@
 #include "Server.hpp"
+#include "ServerCore.hpp"
+#include "EventLoop.hpp"
+#include "Session.hpp"
 #include "Bank.hpp"
+#include "TxnLog.hpp"
+#include "Snapshot.hpp"
+#include "Segment.hpp"
+#include "ShardedBank.hpp"
+#include "Ledger.hpp"
+#include "Stats.hpp"
+#include "Trace.hpp"
+#include "Metrics.hpp"
 
 #include <arpa/inet.h>  // inet_ntoa, htons
+#include <cerrno>       // errno, EINTR
 #include <csignal>      // signal, SIGINT, SIGTERM
 #include <cstring>      // memset
 #include <iostream>     // cout, cerr
 #include <netinet/in.h> // sockaddr_in
 #include <pthread.h>    // pthread_*
 #include <sys/socket.h> // socket, bind, listen, accept
-#include <unistd.h>     // close
+#include <sys/time.h>   // timeval
+#include <time.h>       // clock_gettime
+#include <unistd.h>     // close, usleep
+#include <chrono>       // std::chrono::steady_clock
 #include <atomic>       // std::atomic
-#include <sstream>      // std::istringstream
-#include <utility>      // std::pair
+#include <deque>        // std::deque
+#include <memory>       // std::unique_ptr
 #include <string>       // std::string
-#include <iomanip>      // for std::setw
-#include <mutex>
+#include <vector>       // std::vector
 
 static std::atomic<int> listen_fd{-1};
-static std::atomic<bool> shutdownFlag(false);
-static std::mutex cout_mutex;
-static pthread_mutex_t stats_mutex = PTHREAD_MUTEX_INITIALIZER;
-static pthread_cond_t stats_cond = PTHREAD_COND_INITIALIZER;
-static size_t request_count = 0;
 
-static void handleSignal(int /*sig*/)
+static void closeListener()
 {
-    shutdownFlag.store(true);
-    if (listen_fd >= 0)
+    int fd = listen_fd.exchange(-1);
+    if (fd >= 0)
     {
-        close(listen_fd);
-        listen_fd = -1;
+        // shutdown() будит нить, заблокированную в accept(); один close() — нет
+        shutdown(fd, SHUT_RDWR);
+        close(fd);
     }
 }
 
-static void *statsThread(void * /*arg*/)
+static void handleSignal(int /*sig*/)
+{
+    requestShutdown();
+    closeListener();
+}
+
+// Отправляет всё накопленное в сессии одним вызовом send() (плюс дозапись при частичной отправке)
+static bool sendPending(int sock, Session &session)
 {
-    pthread_mutex_lock(&stats_mutex);
-    while (true)
+    while (session.outSize() > 0)
     {
-        pthread_cond_wait(&stats_cond, &stats_mutex);
-        if (request_count % 5 == 0)
+        ssize_t n;
         {
-            std::cout << "[Stats] Processed " << request_count << " requests\n";
+            TraceSpan span(TracePhase::Send);
+            n = send(sock, session.outData(), session.outSize(), MSG_NOSIGNAL);
         }
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        session.consume(static_cast<size_t>(n));
     }
-    return nullptr;
+    return true;
 }
 
-static void sendLine(int sock, const std::string &line)
+// Соединение и банк, над которым выполняются его команды (ровно один из трёх)
+struct ClientArgs
 {
-    std::string msg = line + "\n";
-    send(sock, msg.c_str(), msg.size(), 0);
-}
+    int sock;
+    Bank *bank;
+    ShardedBank *sharded;
+    Ledger *ledger;
+};
 
-static void *handleClient(void *arg)
+/*
+ * Обслуживает соединение args.sock, пока клиент его не закроет; сокет
+ * закрывает вызывающий. idle_timeout — секунд ожидания recv/send.
+ * При остановке сервера соединение дорабатывает уже принятые строки,
+ * досылает ответы и завершается (Session::drain).
+ */
+static void serveClient(const ClientArgs &args, unsigned idle_timeout)
 {
-    auto *args = static_cast<std::pair<int, Bank *> *>(arg);
-    int sock = args->first;
-    Bank *bank = args->second;
-    delete args;
-
-    char buffer[1024];
-    std::string line;
-    sendLine(sock, "Welcome To TBANK");
-    sendLine(sock, "Available commands:");
-    sendLine(sock, "  help                         - show help");
-    sendLine(sock, "  shutdown                     - stop server");
-    sendLine(sock, "  transfer <from> <to> <amt>   - transfer funds");
-    sendLine(sock, "  freeze <id>                  - freeze account");
-    sendLine(sock, "  unfreeze <id>                - unfreeze account");
-    sendLine(sock, "  mass_update <amt>            - mass update balances");
-    sendLine(sock, "  set_limits <id> <min> <max>  - set account limits");
-    sendLine(sock, "  show_account_list            - showing min list");
-    sendLine(sock, "  show_min <id>                - showing min balance for account <id>");
-    sendLine(sock, "  show_max <id>                - showing max balance for account <id>");
-    sendLine(sock, "  show_balance <id>            - showing balance for account <id>");
-
-    while (true)
-    {
-        ssize_t n = recv(sock, buffer, sizeof(buffer) - 1, 0);
+    int sock = args.sock;
+    if (idle_timeout > 0)
+    {
+        timeval tv{static_cast<time_t>(idle_timeout), 0};
+        setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+    }
+    // Над ShardedBank команды уходят в очереди шардов-владельцев счетов
+    std::unique_ptr<Session> owner(args.sharded  ? new Session(*args.sharded)
+                                   : args.ledger ? new Session(*args.ledger)
+                                                 : new Session(*args.bank));
+
+    statsConnection(true);
+    char buffer[16 * 1024];
+    Session &session = *owner;
+    session.start();
+    bool ok = sendPending(sock, session);
+
+    while (ok && !session.closing())
+    {
+        // sendPending досылает и листинг, так что сюда сессия приходит готовой
+        // к вводу; проверка — страховка от чтения в неограниченный буфер
+        if (!session.wantsInput())
+        {
+            ok = sendPending(sock, session);
+            continue;
+        }
+        ssize_t n = recv(sock, buffer, sizeof(buffer), 0);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        {
+            // Клиент молчит дольше idle_timeout: обработчик нужнее другим
+            statsConnectionIdle();
+            break;
+        }
         if (n <= 0)
+        {
+            // При остановке recv будит shutdown(SHUT_RD) сервера, а не клиент
+            if (shutdownRequested())
+                session.drain();
+            else
+                session.finish();
+            sendPending(sock, session);
             break;
-        buffer[n] = '\0';
-        line.assign(buffer);
-        if (!line.empty() && (line.back() == '\r' || line.back() == '\n'))
-            line.pop_back();
+        }
+        // Все команды из порции выполняются, ответы уходят одним send()
+        session.feed(buffer, static_cast<size_t>(n));
+        ok = sendPending(sock, session);
+        if (ok && shutdownRequested())
+        {
+            session.drain();
+            sendPending(sock, session);
+            break;
+        }
+    }
 
-        pthread_mutex_lock(&stats_mutex);
-        ++request_count;
-        pthread_cond_signal(&stats_cond);
-        pthread_mutex_unlock(&stats_mutex);
+    if (shutdownRequested())
+    {
+        closeListener();
+    }
+    statsConnection(false);
+}
 
-        try
+/*
+ * Соединения режима threads: ждущие свободного обработчика и
+ * обслуживаемые. Соединение принимается, только если после него
+ * одновременно открытых (у обработчиков и в очереди) будет не больше
+ * limit: свободные обработчики заберут его сразу, остальное ждёт здесь.
+ *
+ * Остановка: close() отказывает ждущим и будит обслуживаемых через
+ * shutdown(SHUT_RD), waitWorkers() ждёт выхода обработчиков до срока,
+ * abort() рвёт соединения тех, кто не успел.
+ */
+class ConnectionPool
+{
+public:
+    void configure(size_t workers, size_t limit)
+    {
+        pthread_mutex_lock(&mtx_);
+        running_ = workers;
+        limit_ = limit < workers ? workers : limit;
+        pthread_mutex_unlock(&mtx_);
+    }
+
+    // false — мест нет, fd остаётся вызывающему
+    bool tryPush(int fd)
+    {
+        pthread_mutex_lock(&mtx_);
+        // Занятые обработчики и очередь вместе не больше limit_
+        const bool ok = !closed_ && running_ - idle_ + pending_.size() < limit_;
+        if (ok)
         {
-            if (!line.empty() && (line.back() == '\r' || line.back() == '\n'))
-            {
-                line.pop_back();
-            }
+            pending_.push_back(Pending{fd, std::chrono::steady_clock::now()});
+            pthread_cond_signal(&cv_);
+        }
+        pthread_mutex_unlock(&mtx_);
+        return ok;
+    }
+
+    // Ждёт соединение и отмечает его обслуживаемым; false — пул закрыт
+    bool pop(int &fd, std::chrono::steady_clock::time_point &since)
+    {
+        pthread_mutex_lock(&mtx_);
+        ++idle_;
+        while (pending_.empty() && !closed_)
+            pthread_cond_wait(&cv_, &mtx_);
+        --idle_;
+        const bool ok = !pending_.empty();
+        if (ok)
+        {
+            fd = pending_.front().fd;
+            since = pending_.front().since;
+            pending_.pop_front();
+            active_.push_back(fd);
+        }
+        pthread_mutex_unlock(&mtx_);
+        return ok;
+    }
 
-            if (line == "shutdown")
+    // Обработчик закончил с fd; вызывается до close(fd), чтобы номер не достался чужому сокету
+    void release(int fd)
+    {
+        pthread_mutex_lock(&mtx_);
+        for (size_t i = 0; i < active_.size(); ++i)
+        {
+            if (active_[i] == fd)
             {
-                sendLine(sock, "Server shutting down...");
-                shutdownFlag.store(true);
-                if (listen_fd >= 0)
-                {
-                    close(listen_fd);
-                    listen_fd = -1;
-                }
+                active_[i] = active_.back();
+                active_.pop_back();
                 break;
             }
+        }
+        pthread_mutex_unlock(&mtx_);
+    }
 
-            std::istringstream iss(line);
-            std::string cmd;
-            iss >> cmd;
+    // Нить-обработчик завершается
+    void workerExited()
+    {
+        pthread_mutex_lock(&mtx_);
+        if (--running_ == 0)
+            pthread_cond_broadcast(&done_);
+        pthread_mutex_unlock(&mtx_);
+    }
 
-            if (cmd == "help")
-            {
-                sendLine(sock, "Available commands:");
-                sendLine(sock, "  help                         - show help");
-                sendLine(sock, "  shutdown                     - stop server");
-                sendLine(sock, "  transfer <from> <to> <amt>   - transfer funds");
-                sendLine(sock, "  freeze <id>                  - freeze account");
-                sendLine(sock, "  unfreeze <id>                - unfreeze account");
-                sendLine(sock, "  mass_update <amt>            - mass update balances");
-                sendLine(sock, "  set_limits <id> <min> <max>  - set account limits");
-                sendLine(sock, "  show_account_list            - showing accounts list");
-                sendLine(sock, "  show_min <id>                - showing min balance for account <id>");
-                sendLine(sock, "  show_max <id>                - showing max balance for account <id>");
-                sendLine(sock, "  show_balance <id>            - showing balance for account <id>");
-            }
-            else if (cmd == "transfer")
-            {
-                int from, to;
-                int32_t amt;
-                if (!(iss >> from >> to >> amt))
-                {
-                    sendLine(sock, "Usage: transfer <from> <to> <amount>");
-                }
-                else
-                {
-                    bank->transferFunds(from, to, amt);
-                    sendLine(sock, "OK: transferred " + std::to_string(amt));
-                }
-            }
-            else if (cmd == "freeze")
-            {
-                int id;
-                if (!(iss >> id))
-                {
-                    sendLine(sock, "Usage: freeze <id>");
-                }
-                else
-                {
-                    bank->freezeAccount(id);
-                    sendLine(sock, "OK: account " + std::to_string(id) + " frozen");
-                }
-            }
-            else if (cmd == "unfreeze")
-            {
-                int id;
-                if (!(iss >> id))
-                {
-                    sendLine(sock, "Usage: unfreeze <id>");
-                }
-                else
-                {
-                    bank->unfreezeAccount(id);
-                    sendLine(sock, "OK: account " + std::to_string(id) + " unfrozen");
-                }
-            }
-            else if (cmd == "mass_update")
-            {
-                int32_t amt;
-                if (!(iss >> amt))
-                {
-                    sendLine(sock, "Usage: mass_update <amount>");
-                }
-                else
-                {
-                    bank->massUpdate(amt);
-                    sendLine(sock, "OK: balances updated by " + std::to_string(amt));
-                }
-            }
-            else if (cmd == "set_limits")
-            {
-                int id;
-                int32_t mn, mx;
-                if (!(iss >> id >> mn >> mx))
-                {
-                    sendLine(sock, "Usage: set_limits <id> <min> <max>");
-                }
-                else
-                {
-                    bank->setLimits(id, mn, mx);
-                    sendLine(sock, "OK: limits set for account " + std::to_string(id));
-                }
-            }
-            else if (cmd == "show_account_list")
-            {
-                sendLine(sock, " ID |   Balance   |    Min    |    Max    | Frozen");
-                sendLine(sock, "----+-------------+-----------+-----------+--------");
-                size_t N = bank->getAccountCount();
-                for (size_t i = 0; i < N; ++i)
-                {
-                    const Account &a = bank->getAccount(i);
-                    std::ostringstream oss;
-                    oss << std::setw(3) << a.account_id << " | "
-                        << std::setw(11) << a.balance << " | "
-                        << std::setw(9) << a.min_balance << " | "
-                        << std::setw(9) << a.max_balance << " | "
-                        << (a.frozen ? "true" : "false");
-                    sendLine(sock, oss.str());
-                }
-            }
-            else if (cmd == "show_balance")
-            {
-                int id;
-                if (!(iss >> id))
-                {
-                    sendLine(sock, "Usage: show_balance <id>");
-                }
-                else
-                {
-                    const Account &a = bank->getAccount(static_cast<size_t>(id));
-                    sendLine(sock,
-                             "Account " + std::to_string(id) +
-                                 " balance: " + std::to_string(a.balance));
-                }
-            }
-            else if (cmd == "show_min")
-            {
-                int id;
-                if (!(iss >> id))
-                {
-                    sendLine(sock, "Usage: show_min <id>");
-                }
-                else
-                {
-                    const Account &a = bank->getAccount(static_cast<size_t>(id));
-                    sendLine(sock,
-                             "Account " + std::to_string(id) +
-                                 " min balance: " + std::to_string(a.min_balance));
-                }
-            }
-            else if (cmd == "show_max")
-            {
-                int id;
-                if (!(iss >> id))
-                {
-                    sendLine(sock, "Usage: show_max <id>");
-                }
-                else
-                {
-                    const Account &a = bank->getAccount(static_cast<size_t>(id));
-                    sendLine(sock,
-                             "Account " + std::to_string(id) +
-                                 " max balance: " + std::to_string(a.max_balance));
-                }
-            }
-            else
-            {
-                sendLine(sock, "Unknown command: " + cmd);
-            }
-        }
-        catch (const std::exception &ex)
+    // Больше не принимать: ждущим в очереди — отказ, обслуживаемым — конец ввода
+    size_t close()
+    {
+        pthread_mutex_lock(&mtx_);
+        closed_ = true;
+        std::deque<Pending> rest;
+        rest.swap(pending_);
+        for (int fd : active_)
+            shutdown(fd, SHUT_RD);
+        const size_t active = active_.size();
+        pthread_cond_broadcast(&cv_);
+        pthread_mutex_unlock(&mtx_);
+        for (const Pending &p : rest)
+            rejectBusy(p.fd);
+        return active;
+    }
+
+    // Ждёт выхода всех обработчиков не дольше seconds; false — не дождались
+    bool waitWorkers(unsigned seconds)
+    {
+        timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += seconds;
+        pthread_mutex_lock(&mtx_);
+        while (running_ > 0 && pthread_cond_timedwait(&done_, &mtx_, &deadline) != ETIMEDOUT)
         {
-            sendLine(sock, std::string("Error: ") + ex.what());
         }
+        const bool ok = running_ == 0;
+        pthread_mutex_unlock(&mtx_);
+        return ok;
     }
 
-    close(sock);
+    // Рвёт соединения в обе стороны: обработчики выходят после текущей команды
+    size_t abort()
+    {
+        pthread_mutex_lock(&mtx_);
+        for (int fd : active_)
+            shutdown(fd, SHUT_RDWR);
+        const size_t n = active_.size();
+        pthread_mutex_unlock(&mtx_);
+        return n;
+    }
+
+private:
+    struct Pending
+    {
+        int fd;
+        std::chrono::steady_clock::time_point since;
+    };
+
+    pthread_mutex_t mtx_ = PTHREAD_MUTEX_INITIALIZER;
+    pthread_cond_t cv_ = PTHREAD_COND_INITIALIZER;   // Появилось соединение или пул закрыт
+    pthread_cond_t done_ = PTHREAD_COND_INITIALIZER; // Вышел последний обработчик
+    std::deque<Pending> pending_;
+    std::vector<int> active_;
+    size_t limit_ = 0;
+    size_t idle_ = 0;    // Обработчиков в pop()
+    size_t running_ = 0; // Нитей-обработчиков, ещё не вышедших
+    bool closed_ = false;
+};
+
+static ConnectionPool pool;
+static ClientArgs pool_target;
+static unsigned pool_idle_timeout = 0;
+
+static void *connectionWorker(void * /*arg*/)
+{
+    int fd;
+    std::chrono::steady_clock::time_point since;
+    while (pool.pop(fd, since))
+    {
+        // Прождавший обработчика дольше таймаута клиент, скорее всего, уже сдался
+        if (pool_idle_timeout > 0 &&
+            std::chrono::steady_clock::now() - since > std::chrono::seconds(pool_idle_timeout))
+        {
+            pool.release(fd);
+            rejectBusy(fd);
+            continue;
+        }
+        ClientArgs args = pool_target;
+        args.sock = fd;
+        serveClient(args, pool_idle_timeout);
+        pool.release(fd);
+        close(fd);
+    }
+    pool.workerExited();
     return nullptr;
 }
 
-int startServer(int port, Bank &bank)
+static int runThreadServer(const ServerOptions &options, const ClientArgs &target)
 {
-    std::signal(SIGINT, handleSignal);
-    std::signal(SIGTERM, handleSignal);
-
+    const int port = options.port;
     listen_fd = socket(AF_INET, SOCK_STREAM, 0);
     if (listen_fd < 0)
     {
@@ -285,6 +329,9 @@ int startServer(int port, Bank &bank)
         return 1;
     }
 
+    int one = 1;
+    setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
     sockaddr_in addr{};
     addr.sin_family = AF_INET;
     addr.sin_addr.s_addr = INADDR_ANY;
@@ -293,79 +340,565 @@ int startServer(int port, Bank &bank)
     if (bind(listen_fd, (sockaddr *)&addr, sizeof(addr)) < 0)
     {
         perror("bind");
-        close(listen_fd);
+        closeListener();
         return 1;
     }
     if (listen(listen_fd, SOMAXCONN) < 0)
     {
         perror("listen");
-        close(listen_fd);
+        closeListener();
         return 1;
     }
 
-    std::cout << "Server listening on port " << port << "...\n";
+    pool_target = target;
+    pool_idle_timeout = options.idle_timeout;
+    // Счётчик нитей выставляется до их запуска: обработчик может выйти сразу
+    pool.configure(options.workers, options.max_connections);
+    std::vector<pthread_t> workers;
+    for (unsigned i = 0; i < options.workers; ++i)
+    {
+        pthread_t tid;
+        if (pthread_create(&tid, nullptr, connectionWorker, nullptr) != 0)
+            break;
+        workers.push_back(tid);
+    }
+    // Не запустившиеся нити не числятся среди обработчиков
+    for (size_t i = workers.size(); i < options.workers; ++i)
+        pool.workerExited();
+    if (workers.empty())
+    {
+        std::cerr << "cannot start connection workers\n";
+        closeListener();
+        return 1;
+    }
 
-    pthread_t stats_tid;
-    pthread_create(&stats_tid, nullptr, statsThread, nullptr);
-    pthread_detach(stats_tid);
+    std::cout << "Server listening on port " << port << " (" << workers.size() << " workers, up to "
+              << (options.max_connections < workers.size() ? workers.size() : options.max_connections)
+              << " connections)...\n";
 
-    while (!shutdownFlag.load())
+    while (!shutdownRequested())
     {
         sockaddr_in client_addr{};
         socklen_t client_len = sizeof(client_addr);
         int client_fd = accept(listen_fd, (sockaddr *)&client_addr, &client_len);
         if (client_fd < 0)
         {
-            if (shutdownFlag.load())
+            if (shutdownRequested())
                 break;
             perror("accept");
             continue;
         }
+        // Сверх предела — явный отказ сразу, а не ожидание в backlog ядра
+        if (!pool.tryPush(client_fd))
+        {
+            rejectBusy(client_fd);
+            continue;
+        }
 
         std::cout << "New connection from "
                   << inet_ntoa(client_addr.sin_addr)
                   << ":" << ntohs(client_addr.sin_port) << "\n";
-
-        auto *args = new std::pair<int, Bank *>(client_fd, &bank);
-        pthread_t tid;
-        pthread_create(&tid, nullptr, handleClient, args);
-        pthread_detach(tid);
     }
 
-    if (listen_fd >= 0)
-        close(listen_fd);
-    std::cout << "Server shutdown complete.\n";
+    // Новых соединений нет; обслуживаемые дорабатывают принятые команды до срока
+    closeListener();
+    const size_t active = pool.close();
+    if (active > 0)
+        std::cout << "Draining " << active << " connections (up to " << options.drain_timeout
+                  << " s)...\n";
+    if (!pool.waitWorkers(options.drain_timeout))
+        std::cout << "Drain timeout: closing " << pool.abort() << " connections\n";
+    // Bank и очереди живут, пока последний обработчик не вышел
+    for (pthread_t tid : workers)
+        pthread_join(tid, nullptr);
     return 0;
 }
+
+static bool prepareServer(const ServerOptions &options, const MetricsSources &sources)
+{
+    std::signal(SIGINT, handleSignal);
+    std::signal(SIGTERM, handleSignal);
+    std::signal(SIGPIPE, SIG_IGN);
+
+    if (!options.trace_path.empty())
+        traceEnable();
+    if (options.metrics_port > 0)
+    {
+        std::string error;
+        if (!startMetricsServer(options.metrics_port, sources, error))
+        {
+            std::cerr << error << "\n";
+            return false;
+        }
+        std::cout << "Metrics on port " << options.metrics_port << " (/metrics, /trace)\n";
+    }
+    startStatsThread();
+    return true;
+}
+
+static int finishServer(const ServerOptions &options, int rc)
+{
+    // Нити соединений уже вышли: счётчики окончательные, и в cout больше никто не пишет
+    stopStatsThread();
+    stopMetricsServer();
+    if (rc == 0)
+        printStats();
+    if (!options.trace_path.empty())
+    {
+        std::string error;
+        if (traceWrite(options.trace_path, error))
+            std::cout << "Trace written to " << options.trace_path << "\n";
+        else
+            std::cerr << error << "\n";
+    }
+    if (rc == 0)
+        std::cout << "Server shutdown complete.\n";
+    return rc;
+}
+
+int startServer(const ServerOptions &options, Bank &bank)
+{
+    if (!prepareServer(options, MetricsSources()))
+        return 1;
+    int rc = options.mode == ServerOptions::Mode::Epoll
+                 ? runEpollServer(options, bank)
+                 : runThreadServer(options, ClientArgs{-1, &bank, nullptr, nullptr});
+    return finishServer(options, rc);
+}
+
+int startServer(const ServerOptions &options, ShardedBank &bank)
+{
+    if (options.mode != ServerOptions::Mode::Threads)
+    {
+        std::cerr << "sharded bank is served in --mode=threads only\n";
+        return 1;
+    }
+    MetricsSources sources;
+    sources.sharded = &bank;
+    if (!prepareServer(options, sources))
+        return 1;
+    int rc = runThreadServer(options, ClientArgs{-1, nullptr, &bank, nullptr});
+    return finishServer(options, rc);
+}
+
+int startServer(const ServerOptions &options, Ledger &ledger)
+{
+    if (options.mode != ServerOptions::Mode::Threads)
+    {
+        std::cerr << "ledger is served in --mode=threads only\n";
+        return 1;
+    }
+    MetricsSources sources;
+    sources.ledger = &ledger;
+    if (!prepareServer(options, sources))
+        return 1;
+    int rc = runThreadServer(options, ClientArgs{-1, nullptr, nullptr, &ledger});
+    return finishServer(options, rc);
+}
+
+int startServer(int port, Bank &bank)
+{
+    ServerOptions options;
+    options.port = port;
+    return startServer(options, bank);
+}
+
+// Периодические снимки счетов
+struct SnapshotJob
+{
+    Bank *bank;
+    TxnLog *log;
+    std::string path;
+    bool shared; // Банк в файле MAP_SHARED: fork не даёт копии, пишем под полосами
+};
+
+static void takeSnapshot(const SnapshotJob &job)
+{
+    std::string error;
+    SnapshotTiming timing;
+    bool ok = job.shared ? dumpSnapshot(*job.bank, job.path, error, &timing)
+                         : forkSnapshot(*job.bank, job.path, job.log, error, &timing);
+    if (ok)
+    {
+        std::cout << "[Snapshot] " << job.path << ": operations paused " << timing.pause_ms
+                  << " ms, written in " << timing.total_ms << " ms\n";
+    }
+    else
+    {
+        std::cerr << "[Snapshot] " << error << "\n";
+    }
+}
+
+static void runSnapshot(const void *ctx)
+{
+    takeSnapshot(*static_cast<const SnapshotJob *>(ctx));
+}
+
+// Сброс файла банка (--file) на диск
+static void flushSegment(const void *ctx)
+{
+    std::string error;
+    if (!syncSegment(*static_cast<const SegmentView *>(ctx), error))
+    {
+        std::cerr << "[Flush] " << error << "\n";
+    }
+}
+
+// Работа, выполняемая раз в interval_sec секунд в отдельной нити (0 — не запускать)
+struct PeriodicJob
+{
+    unsigned interval_sec;
+    void (*run)(const void *ctx);
+    const void *ctx;
+    pthread_t tid;
+    bool started;
+};
+
+static void *periodicThread(void *arg)
+{
+    const PeriodicJob &job = *static_cast<PeriodicJob *>(arg);
+    while (!shutdownRequested())
+    {
+        // Спим короткими шагами, чтобы не задерживать остановку сервера
+        for (unsigned t = 0; t < job.interval_sec * 10 && !shutdownRequested(); ++t)
+        {
+            usleep(100000);
+        }
+        if (!shutdownRequested())
+        {
+            job.run(job.ctx);
+        }
+    }
+    return nullptr;
+}
+
+static void startPeriodic(PeriodicJob &job)
+{
+    job.started = job.interval_sec > 0 &&
+                  pthread_create(&job.tid, nullptr, periodicThread, &job) == 0;
+}
+
+static void stopPeriodic(PeriodicJob &job)
+{
+    if (job.started)
+    {
+        pthread_join(job.tid, nullptr);
+    }
+}
+
+static void printUsage(const char *prog)
+{
+    std::cerr << "Usage: " << prog
+              << " [N] [max_balance] [port] [--mode=threads|epoll] [--reactors=K]"
+                 " [--layout=rows|columns]\n"
+                 "       [--workers=W] [--max-connections=M] [--idle-timeout=SEC] [--drain-timeout=SEC]\n"
+                 "       [--shards=K | --ledger] [--metrics-port=P] [--trace=PATH]\n"
+                 "       [--wal=PATH] [--wal-sync=group|op] [--wal-window=US]\n"
+                 "       [--restore=FILE] [--snapshot=FILE] [--snapshot-interval=SEC]\n"
+                 "       [--file=PATH] [--flush-interval=SEC]\n"
+                 "Defaults: port 12345, --mode=threads, --workers=64, --max-connections=1024,\n"
+                 "  --idle-timeout=300 (0 disables), --drain-timeout=10.\n"
+                 "  Over the connection limit a client gets \"Error: server busy, try again later\";\n"
+                 "  a client idle longer than the timeout is disconnected without a message.\n";
+}
+
 int main(int argc, char **argv)
 {
     size_t N = 100;               
     int32_t max_balance = 100000; 
-    int port = DEFAULT_PORT;     
+    ServerOptions options;
+    AccountLayout layout = AccountLayout::Rows;
+    std::string wal_path;
+    TxnLogOptions wal_options;
+    std::string restore_path;
+    std::string snapshot_path;
+    unsigned snapshot_interval = 60;
+    std::string file_path;
+    unsigned flush_interval = 5;
+    size_t shards = 0;
+    bool ledger = false;
+
+    int positional = 0;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--mode=threads")
+        {
+            options.mode = ServerOptions::Mode::Threads;
+        }
+        else if (arg == "--mode=epoll")
+        {
+            options.mode = ServerOptions::Mode::Epoll;
+        }
+        else if (arg.compare(0, 11, "--reactors=") == 0)
+        {
+            options.reactors = static_cast<unsigned>(std::stoul(arg.substr(11)));
+        }
+        else if (arg.compare(0, 10, "--workers=") == 0)
+        {
+            options.workers = static_cast<unsigned>(std::stoul(arg.substr(10)));
+        }
+        else if (arg.compare(0, 18, "--max-connections=") == 0)
+        {
+            options.max_connections = static_cast<unsigned>(std::stoul(arg.substr(18)));
+        }
+        else if (arg.compare(0, 15, "--idle-timeout=") == 0)
+        {
+            options.idle_timeout = static_cast<unsigned>(std::stoul(arg.substr(15)));
+        }
+        else if (arg.compare(0, 16, "--drain-timeout=") == 0)
+        {
+            options.drain_timeout = static_cast<unsigned>(std::stoul(arg.substr(16)));
+        }
+        else if (arg == "--layout=rows")
+        {
+            layout = AccountLayout::Rows;
+        }
+        else if (arg == "--layout=columns")
+        {
+            layout = AccountLayout::Columns;
+        }
+        else if (arg.compare(0, 6, "--wal=") == 0)
+        {
+            wal_path = arg.substr(6);
+        }
+        else if (arg == "--wal-sync=group")
+        {
+            wal_options.group_commit = true;
+        }
+        else if (arg == "--wal-sync=op")
+        {
+            wal_options.group_commit = false;
+        }
+        else if (arg.compare(0, 13, "--wal-window=") == 0)
+        {
+            wal_options.window_us = static_cast<unsigned>(std::stoul(arg.substr(13)));
+        }
+        else if (arg.compare(0, 10, "--restore=") == 0)
+        {
+            restore_path = arg.substr(10);
+        }
+        else if (arg.compare(0, 11, "--snapshot=") == 0)
+        {
+            snapshot_path = arg.substr(11);
+        }
+        else if (arg.compare(0, 20, "--snapshot-interval=") == 0)
+        {
+            snapshot_interval = static_cast<unsigned>(std::stoul(arg.substr(20)));
+        }
+        else if (arg.compare(0, 7, "--file=") == 0)
+        {
+            file_path = arg.substr(7);
+        }
+        else if (arg.compare(0, 17, "--flush-interval=") == 0)
+        {
+            flush_interval = static_cast<unsigned>(std::stoul(arg.substr(17)));
+        }
+        else if (arg.compare(0, 9, "--shards=") == 0)
+        {
+            shards = static_cast<size_t>(std::stoul(arg.substr(9)));
+        }
+        else if (arg == "--ledger")
+        {
+            ledger = true;
+        }
+        else if (arg.compare(0, 15, "--metrics-port=") == 0)
+        {
+            options.metrics_port = std::stoi(arg.substr(15));
+        }
+        else if (arg.compare(0, 8, "--trace=") == 0)
+        {
+            options.trace_path = arg.substr(8);
+        }
+        else if (arg == "--help")
+        {
+            printUsage(argv[0]);
+            return 0;
+        }
+        else if (arg.compare(0, 2, "--") == 0)
+        {
+            printUsage(argv[0]);
+            return 1;
+        }
+        else if (positional == 0)
+        {
+            N = static_cast<size_t>(std::stoul(arg));
+            ++positional;
+        }
+        else if (positional == 1)
+        {
+            max_balance = static_cast<int32_t>(std::stoi(arg));
+            ++positional;
+        }
+        else if (positional == 2)
+        {
+            options.port = std::stoi(arg);
+            ++positional;
+        }
+        else
+        {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    // Файл банка сам хранит состояние: журнал и восстановление из снимка к нему не применяются
+    if (!file_path.empty() && (!wal_path.empty() || !restore_path.empty()))
+    {
+        std::cerr << "--file cannot be combined with --wal or --restore\n";
+        return 1;
+    }
 
-    if (argc >= 2)
+    // Шарды держат счета в куче своих нитей: журнал, снимки и файл банка работают только с Bank
+    if (shards > 0 && (!wal_path.empty() || !restore_path.empty() || !snapshot_path.empty() ||
+                       !file_path.empty() || layout == AccountLayout::Columns))
     {
-        N = static_cast<size_t>(std::stoul(argv[1]));
+        std::cerr << "--shards cannot be combined with --wal, --restore, --snapshot, --file"
+                     " or --layout=columns\n";
+        return 1;
     }
-    if (argc >= 3)
+
+    if (options.workers == 0 || options.max_connections == 0)
     {
-        max_balance = static_cast<int32_t>(std::stoi(argv[2]));
+        std::cerr << "--workers and --max-connections must be positive\n";
+        return 1;
     }
-    if (argc >= 4)
+    if ((shards > 0 || ledger) && options.mode != ServerOptions::Mode::Threads)
     {
-        port = std::stoi(argv[3]);
+        std::cerr << (ledger ? "--ledger" : "--shards") << " requires --mode=threads\n";
+        return 1;
+    }
+    // Нить ledger пишет без мьютексов полос — файл банка меняют и другие процессы
+    if (ledger && (shards > 0 || !file_path.empty()))
+    {
+        std::cerr << "--ledger cannot be combined with --shards or --file\n";
+        return 1;
     }
 
-    Account *accounts = new Account[N];
-    for (size_t i = 0; i < N; ++i)
+    // Снимок задаёт число счетов и раскладку вместо аргументов командной строки
+    SnapshotHeader snapshot = SnapshotHeader();
+    std::string error;
+    if (!restore_path.empty())
     {
-        accounts[i].account_id = static_cast<int>(i);
-        accounts[i].balance = 0;
-        accounts[i].min_balance = 0;
-        accounts[i].max_balance = max_balance;
-        accounts[i].frozen = false;
+        if (!readSnapshotHeader(restore_path, snapshot, error))
+        {
+            std::cerr << error << "\n";
+            return 1;
+        }
+        N = static_cast<size_t>(snapshot.account_count);
+        layout = static_cast<AccountLayout>(snapshot.layout);
+    }
+
+    // Существующий файл подключаем как есть (число счетов и раскладка — из заголовка),
+    // иначе создаём по аргументам командной строки
+    SegmentView seg;
+    if (!file_path.empty())
+    {
+        bool exists = access(file_path.c_str(), F_OK) == 0;
+        if (exists ? !attachFileSegment(file_path, seg, error)
+                   : !createFileSegment(file_path, N, N, max_balance, seg, error, layout))
+        {
+            std::cerr << error << "\n";
+            return 1;
+        }
+        N = seg.accountCount();
+        std::cout << (exists ? "Attached " : "Created ") << N << " accounts in " << file_path << "\n";
+    }
+
+    // Хранилище живёт до выхода из main; в раскладке Rows массив не освобождаем, как и раньше
+    ColumnBuffer columns(file_path.empty() && layout == AccountLayout::Columns ? N : 0);
+    AccountStore store = !file_path.empty()                 ? seg.accounts
+                         : layout == AccountLayout::Columns ? columns.store()
+                                                            : AccountStore(new Account[N]);
+    if (!restore_path.empty())
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        if (!loadSnapshot(restore_path, snapshot, store, error))
+        {
+            std::cerr << error << "\n";
+            return 1;
+        }
+        std::cout << "Restored " << N << " accounts from " << restore_path << " in "
+                  << std::chrono::duration<double, std::milli>(
+                         std::chrono::steady_clock::now() - start).count()
+                  << " ms\n";
+    }
+    else if (file_path.empty())
+    {
+        for (size_t i = 0; i < N; ++i)
+        {
+            Account a;
+            a.account_id = static_cast<int>(i);
+            a.balance = 0;
+            a.min_balance = 0;
+            a.max_balance = max_balance;
+            a.frozen = false;
+            store.store(i, a);
+        }
+    }
+
+    if (shards > 0)
+    {
+        ShardedBank sharded(store.rows(), N, shards);
+        std::cout << "Sharded " << sharded.getAccountCount() << " accounts across "
+                  << sharded.shardCount() << " shards\n";
+        return startServer(options, sharded);
+    }
+
+    // Банк в файле делит таблицу блокировок и число счетов с другими процессами
+    std::unique_ptr<Bank> owner(
+        file_path.empty() ? new Bank(store, N)
+                          : new Bank(seg.accounts, N, seg.locks, &seg.header->account_count));
+    Bank &bank = *owner;
+
+    // Балансы восстанавливаются из журнала до того, как сервер примет первое соединение
+    // (записи, уже вошедшие в снимок, пропускаются)
+    TxnLog wal;
+    if (!wal_path.empty())
+    {
+        if (!wal.open(wal_path, bank, wal_options, error, snapshot.log_lsn))
+        {
+            std::cerr << error << "\n";
+            return 1;
+        }
+        std::cout << "Replayed " << wal.replayed() << " log records from " << wal_path << "\n";
+    }
+
+    SnapshotJob snap = {&bank, wal_path.empty() ? nullptr : &wal, snapshot_path,
+                        !file_path.empty()};
+    PeriodicJob snapshots = {snapshot_path.empty() ? 0 : snapshot_interval, runSnapshot, &snap,
+                             pthread_t(), false};
+    PeriodicJob flushes = {file_path.empty() ? 0 : flush_interval, flushSegment, &seg,
+                           pthread_t(), false};
+    startPeriodic(snapshots);
+    startPeriodic(flushes);
+
+    int rc;
+    if (ledger)
+    {
+        // Единственный писатель — на последнем ядре, подальше от нитей соединений
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        Ledger writer(bank, 4096, cpus > 1 ? static_cast<int>(cpus - 1) : -1);
+        rc = startServer(options, writer);
+    }
+    else
+    {
+        rc = startServer(options, bank);
     }
 
-    Bank bank(accounts, N);
-    return startServer(port, bank);
-}
\ No newline at end of file
+    stopPeriodic(snapshots);
+    stopPeriodic(flushes);
+    // Последний снимок при остановке — следующий запуск с --restore не воспроизводит журнал
+    if (!snapshot_path.empty())
+    {
+        takeSnapshot(snap);
+    }
+    // Файл банка сбрасывается на диск при любой остановке, а не только по таймеру
+    if (!file_path.empty())
+    {
+        owner.reset(); // Bank разрушается до отключения сегмента
+        flushSegment(&seg);
+        detachSegment(seg);
+    }
+    return rc;
+}
@@ -0,0 +1,139 @@
+#include "ServerCore.hpp"
+#include "Stats.hpp"
+
+#include <sys/eventfd.h> // eventfd
+#include <sys/socket.h>  // send
+#include <poll.h>        // poll
+#include <unistd.h>      // write
+#include <pthread.h>     // pthread_*
+#include <atomic>        // std::atomic
+#include <cstring>       // strlen
+#include <iostream>      // cout
+
+static std::atomic<bool> shutdownFlag(false);
+static int wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+// Период вывода статистики в журнал сервера
+static const unsigned STATS_PERIOD_SEC = 5;
+
+static void printSummary(const StatsSummary &s)
+{
+    std::cout << "[Stats] Processed " << s.total() << " requests (rejected " << s.totalRejected()
+              << "), latency ns p50 " << s.percentile(0.5) << ", p99 " << s.percentile(0.99)
+              << ", p999 " << s.percentile(0.999) << '\n';
+}
+
+static pthread_t stats_tid;
+static bool stats_running = false;
+
+static void *statsThread(void * /*arg*/)
+{
+    uint64_t last = 0;
+    while (true)
+    {
+        // wake_fd не вычитывается: после остановки poll возвращается сразу
+        pollfd pfd = {wake_fd, POLLIN, 0};
+        int rc = poll(&pfd, wake_fd >= 0 ? 1 : 0, STATS_PERIOD_SEC * 1000);
+        if (shutdownRequested())
+            break;
+        if (rc != 0)
+            continue; // EINTR
+        StatsSummary s;
+        statsCollect(s);
+        const uint64_t total = s.total();
+        if (total == last)
+            continue;
+        last = total;
+        printSummary(s);
+    }
+    return nullptr;
+}
+
+void printStats()
+{
+    StatsSummary s;
+    statsCollect(s);
+    printSummary(s);
+    std::cout << "[Stats] Connections " << s.connections << " (busy " << s.connections_busy
+              << ", idle " << s.connections_idle << ")" << std::endl;
+}
+
+void startStatsThread()
+{
+    stats_running = pthread_create(&stats_tid, nullptr, statsThread, nullptr) == 0;
+}
+
+void stopStatsThread()
+{
+    if (!stats_running)
+        return;
+    requestShutdown();
+    pthread_join(stats_tid, nullptr);
+    stats_running = false;
+}
+
+bool shutdownRequested()
+{
+    return shutdownFlag.load();
+}
+
+void requestShutdown()
+{
+    shutdownFlag.store(true);
+    if (wake_fd >= 0)
+    {
+        uint64_t one = 1;
+        ssize_t rc = write(wake_fd, &one, sizeof(one));
+        (void)rc;
+    }
+}
+
+int wakeFd()
+{
+    return wake_fd;
+}
+
+const char BUSY_REPLY[] = "Error: server busy, try again later\n";
+
+void rejectBusy(int fd)
+{
+    // Только что принятый сокет: строка помещается в буфер отправки целиком
+    ssize_t rc = send(fd, BUSY_REPLY, std::strlen(BUSY_REPLY), MSG_NOSIGNAL | MSG_DONTWAIT);
+    (void)rc;
+    close(fd);
+    statsConnectionBusy();
+}
+
+void appendWelcome(std::string &out)
+{
+    out += "Welcome To TBANK\n";
+    appendHelp(out, SCOPE_SERVER);
+}
+
+static LineResult lineResult(CommandResult r)
+{
+    if (r == CommandResult::Shutdown)
+    {
+        requestShutdown();
+        return LineResult::Shutdown;
+    }
+    return LineResult::Continue;
+}
+
+LineResult executeLine(Bank &bank, const char *begin, const char *end, std::string &out,
+                       AccountListing *listing)
+{
+    return lineResult(executeCommand(bank, begin, end, SCOPE_SERVER, out, listing));
+}
+
+LineResult executeLine(ShardedBank &bank, const char *begin, const char *end, std::string &out,
+                       AccountListing *listing)
+{
+    return lineResult(executeCommand(bank, begin, end, SCOPE_SERVER, out, listing));
+}
+
+LineResult executeLine(Ledger &ledger, const char *begin, const char *end, std::string &out,
+                       AccountListing *listing)
+{
+    return lineResult(executeCommand(ledger, begin, end, SCOPE_SERVER, out, listing));
+}
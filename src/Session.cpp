@@ -0,0 +1,220 @@
+#include "Session.hpp"
+#include "ServerCore.hpp"
+#include "BinaryProtocol.hpp"
+#include "Ledger.hpp"
+#include "ShardedBank.hpp"
+#include "Stats.hpp"
+
+#include <cstring> // memchr
+
+constexpr size_t Session::MAX_LINE;
+constexpr size_t Session::MAX_INPUT;
+constexpr size_t Session::MAX_PENDING_OUT;
+
+Session::Session(Bank &bank) : bank_(&bank), sharded_(nullptr), ledger_(nullptr) {}
+
+Session::Session(ShardedBank &bank) : bank_(nullptr), sharded_(&bank), ledger_(nullptr) {}
+
+Session::Session(Ledger &ledger) : bank_(nullptr), sharded_(nullptr), ledger_(&ledger) {}
+
+void Session::start()
+{
+    appendWelcome(out_);
+}
+
+void Session::executeBuffered(const char *begin, const char *end)
+{
+    LineResult r = sharded_  ? executeLine(*sharded_, begin, end, out_, &listing_)
+                   : ledger_ ? executeLine(*ledger_, begin, end, out_, &listing_)
+                             : executeLine(*bank_, begin, end, out_, &listing_);
+    if (r == LineResult::Shutdown)
+    {
+        closing_ = true;
+    }
+}
+
+void Session::feed(const char *data, size_t n)
+{
+    if (closing_ || n == 0)
+        return;
+    statsBytes(n, 0);
+
+    if (protocol_ == Protocol::Undecided)
+    {
+        if (static_cast<uint8_t>(data[0]) == BIN_HANDSHAKE)
+        {
+            protocol_ = Protocol::Binary;
+            binAppendAck(out_);
+            ++data;
+            --n;
+        }
+        else
+        {
+            protocol_ = Protocol::Text;
+        }
+    }
+
+    if (protocol_ == Protocol::Binary)
+        feedBinary(data, n);
+    else
+        feedText(data, n);
+}
+
+void Session::feedBinary(const char *data, size_t n)
+{
+    in_.append(data, n);
+
+    size_t pos = 0;
+    BinRequest req;
+    BinResponse resp;
+    char frame[BIN_RESPONSE_SIZE];
+    while (in_.size() - pos >= BIN_HEADER_SIZE)
+    {
+        const char *hdr = in_.data() + pos;
+        size_t len = binGet16(hdr);
+        if (len < BIN_HEADER_SIZE || len > BIN_MAX_FRAME)
+        {
+            // Поток рассинхронизирован — дальше разбирать нельзя
+            resp = BinResponse();
+            resp.op = static_cast<BinOp>(hdr[2]);
+            resp.status = BIN_BAD_FRAME;
+            resp.seq = binGet32(hdr + 4);
+            binEncodeResponse(resp, frame);
+            out_.append(frame, sizeof(frame));
+            closing_ = true;
+            break;
+        }
+        if (in_.size() - pos < len)
+            break;
+
+        if (static_cast<BinOp>(hdr[2]) == BinOp::TransferBatch)
+        {
+            if (sharded_)
+                binExecuteBatch(*sharded_, hdr, len, out_);
+            else if (ledger_)
+                binExecuteBatch(*ledger_, hdr, len, out_);
+            else
+                binExecuteBatch(*bank_, hdr, len, out_);
+            pos += len;
+            continue;
+        }
+        if (len != BIN_REQUEST_SIZE)
+        {
+            resp = BinResponse();
+            resp.op = static_cast<BinOp>(hdr[2]);
+            resp.status = BIN_BAD_FRAME;
+            resp.seq = binGet32(hdr + 4);
+        }
+        else
+        {
+            binDecodeRequest(hdr, req);
+            if (sharded_)
+                binExecute(*sharded_, req, resp);
+            else if (ledger_)
+                binExecute(*ledger_, req, resp);
+            else
+                binExecute(*bank_, req, resp);
+        }
+        binEncodeResponse(resp, frame);
+        out_.append(frame, sizeof(frame));
+        pos += len;
+    }
+    in_.erase(0, pos);
+}
+
+void Session::feedText(const char *data, size_t n)
+{
+    // Быстрый путь: буфер пуст — режем строки прямо в принятой порции
+    const char *p = data;
+    const char *end = data + n;
+    if (in_.empty())
+    {
+        const char *nl;
+        while (!closing_ && !listing_.active() &&
+               (nl = static_cast<const char *>(std::memchr(p, '\n', end - p))))
+        {
+            executeBuffered(p, nl);
+            p = nl + 1;
+        }
+        if (!closing_)
+            in_.assign(p, end);
+    }
+    else
+    {
+        in_.append(p, end);
+        resumeText();
+    }
+
+    // Во время листинга в буфере копятся целые команды, а не одна длинная строка
+    if (in_.size() > MAX_LINE && !listing_.active())
+    {
+        out_ += "Error: line too long\n";
+        in_.clear();
+        closing_ = true;
+    }
+    else if (in_.size() > MAX_INPUT)
+    {
+        // Клиент шлёт команды, не читая листинг: строки ошибки посреди
+        // таблицы не будет — соединение закроется, когда листинг допишется
+        if (!listing_.active())
+            out_ += "Error: too much pipelined input\n";
+        in_.clear();
+        closing_ = true;
+    }
+}
+
+void Session::resumeText()
+{
+    size_t start = 0;
+    size_t nl;
+    while (!closing_ && !listing_.active() && (nl = in_.find('\n', start)) != std::string::npos)
+    {
+        executeBuffered(in_.data() + start, in_.data() + nl);
+        start = nl + 1;
+    }
+    in_.erase(0, start);
+
+    if (finished_ && !listing_.active())
+    {
+        if (!closing_ && !draining_ && !in_.empty())
+            executeBuffered(in_.data(), in_.data() + in_.size());
+        in_.clear();
+        closing_ = true;
+    }
+}
+
+void Session::finish()
+{
+    finished_ = true;
+    if (protocol_ == Protocol::Text)
+    {
+        resumeText();
+        return;
+    }
+    in_.clear();
+    closing_ = true;
+}
+
+void Session::drain()
+{
+    draining_ = true;
+    finish();
+}
+
+void Session::consume(size_t n)
+{
+    statsBytes(0, n);
+    out_off_ += n;
+    if (out_off_ >= out_.size())
+    {
+        // Всё отправлено — буфер переиспользуется без перевыделения
+        out_.clear();
+        out_off_ = 0;
+        if (listing_.active())
+        {
+            listing_.fill(out_);
+            if (!listing_.active())
+                resumeText();
+        }
+    }
+}
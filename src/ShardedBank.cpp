@@ -0,0 +1,661 @@
+#include "ShardedBank.hpp"
+#include "AccountIndex.hpp"
+#include "MassUpdate.hpp"
+#include "Trace.hpp"
+
+#include <algorithm>   // std::copy
+#include <cerrno>      // errno, EINTR
+#include <cstring>     // strerror
+#include <sched.h>     // cpu_set_t, CPU_SET
+#include <semaphore.h> // sem_t
+#include <stdexcept>   // std::runtime_error
+#include <unistd.h>    // sysconf
+
+// Заявка шарду; живёт у вызывающего, пока нить шарда не ответит через done
+struct ShardedBank::Op
+{
+    enum Kind : uint8_t
+    {
+        Init,          // Заполнить шард своими счетами из source
+        Transfer,      // Перевод внутри шарда
+        PrepareDebit,  // Фаза 1: резерв списания a со счёта id
+        PrepareCredit, // Фаза 1: резерв зачисления a на счёт id
+        CommitDebit,   // Фаза 2: применить резерв
+        CommitCredit,
+        AbortDebit, // Снять резерв
+        AbortCredit,
+        Freeze,
+        SetLimits,
+        Query,
+        Park, // Барьер: phase1, ожидание release, phase2 при commit
+    };
+
+    Kind kind = Init;
+    bool commit = false;
+    BankStatus status = BankStatus::Ok;
+    int id = 0;
+    int to_id = 0;
+    int32_t a = 0; // Сумма или новый минимум
+    int32_t b = 0; // Новый максимум или флаг заморозки
+    size_t slot = 0;              // Слот резерва: фаза 2 не ищет счёт заново
+    Account account = {};         // Query; SetLimits — баланс при отказе
+    const Account *source = nullptr;
+    size_t source_count = 0;
+    Account *rows = nullptr;      // Park среза: куда копировать счета шарда
+    int64_t sum = 0;              // Park: сумма балансов шарда
+    size_t violator = 0;          // Park massUpdate: слот нарушителя или размер шарда
+    void (*phase1)(Shard &, Op &) = nullptr;
+    void (*phase2)(Shard &, Op &) = nullptr;
+    sem_t done;
+    sem_t release;
+
+    Op()
+    {
+        sem_init(&done, 0, 0);
+        sem_init(&release, 0, 0);
+    }
+    ~Op()
+    {
+        sem_destroy(&done);
+        sem_destroy(&release);
+    }
+    Op(const Op &) = delete;
+    Op &operator=(const Op &) = delete;
+};
+
+struct ShardedBank::Shard
+{
+    size_t number;
+    size_t of; // Всего шардов
+    int cpu;   // -1 — без привязки
+    pthread_t thread;
+
+    // Данные шарда: меняет только его нить (или координатор под барьером)
+    std::vector<Account> accounts;
+    std::vector<int64_t> hold_out; // Зарезервировано к списанию первой фазой
+    std::vector<int64_t> hold_in;  // Зарезервировано к зачислению
+    size_t holds = 0;              // Незавершённых резервов
+    AccountIndex ids;
+
+    pthread_mutex_t mtx;
+    pthread_cond_t cond;
+    std::vector<Op *> queue;
+    bool stop = false;
+
+    Shard(size_t n, size_t k, int c) : number(n), of(k), cpu(c)
+    {
+        pthread_mutex_init(&mtx, nullptr);
+        pthread_cond_init(&cond, nullptr);
+    }
+    ~Shard()
+    {
+        pthread_cond_destroy(&cond);
+        pthread_mutex_destroy(&mtx);
+    }
+};
+
+using Shard = ShardedBank::Shard;
+using Op = ShardedBank::Op;
+
+static void waitSem(sem_t &sem)
+{
+    while (sem_wait(&sem) != 0 && errno == EINTR)
+    {
+    }
+}
+
+static void fill(Shard &s, const Op &op)
+{
+    s.accounts.reserve(op.source_count / s.of + 1);
+    for (size_t i = 0; i < op.source_count; ++i)
+    {
+        if (static_cast<uint32_t>(op.source[i].account_id) % s.of == s.number)
+            s.accounts.push_back(op.source[i]);
+    }
+    s.hold_out.assign(s.accounts.size(), 0);
+    s.hold_in.assign(s.accounts.size(), 0);
+    s.ids.build(AccountStore(s.accounts.data()), s.accounts.size());
+}
+
+/*
+ * Проверка и перенос суммы между слотами (шарды могут совпадать).
+ * Резервы незавершённых переводов сужают лимиты: списанию мешает
+ * hold_out, зачислению — hold_in.
+ */
+static BankStatus moveFunds(Shard &from, size_t fi, Shard &to, size_t ti, int32_t amount) noexcept
+{
+    Account &src = from.accounts[fi];
+    Account &dst = to.accounts[ti];
+    if (src.frozen || dst.frozen)
+        return BankStatus::AccountFrozen;
+    if (int64_t(src.balance) - from.hold_out[fi] - amount < src.min_balance)
+        return BankStatus::InsufficientFunds;
+    if (int64_t(dst.balance) + to.hold_in[ti] + amount > dst.max_balance)
+        return BankStatus::ExceedsMaxBalance;
+    src.balance -= amount;
+    dst.balance += amount;
+    return BankStatus::Ok;
+}
+
+static BankStatus prepare(Shard &s, Op &op, bool debit) noexcept
+{
+    size_t i = s.ids.find(op.id);
+    if (i == AccountIndex::NOT_FOUND)
+        return BankStatus::AccountNotFound;
+    const Account &acc = s.accounts[i];
+    if (acc.frozen)
+        return BankStatus::AccountFrozen;
+    if (debit)
+    {
+        if (int64_t(acc.balance) - s.hold_out[i] - op.a < acc.min_balance)
+            return BankStatus::InsufficientFunds;
+        s.hold_out[i] += op.a;
+    }
+    else
+    {
+        if (int64_t(acc.balance) + s.hold_in[i] + op.a > acc.max_balance)
+            return BankStatus::ExceedsMaxBalance;
+        s.hold_in[i] += op.a;
+    }
+    op.slot = i;
+    ++s.holds;
+    return BankStatus::Ok;
+}
+
+static void finish(Shard &s, const Op &op, bool debit, bool apply) noexcept
+{
+    if (debit)
+    {
+        s.hold_out[op.slot] -= op.a;
+        if (apply)
+            s.accounts[op.slot].balance -= op.a;
+    }
+    else
+    {
+        s.hold_in[op.slot] -= op.a;
+        if (apply)
+            s.accounts[op.slot].balance += op.a;
+    }
+    --s.holds;
+}
+
+static BankStatus setLimits(Shard &s, Op &op) noexcept
+{
+    size_t i = s.ids.find(op.id);
+    if (i == AccountIndex::NOT_FOUND)
+        return BankStatus::AccountNotFound;
+    Account &acc = s.accounts[i];
+    // Новые лимиты должны вместить и баланс после незавершённых переводов
+    if (int64_t(acc.balance) - s.hold_out[i] < op.a || int64_t(acc.balance) + s.hold_in[i] > op.b)
+    {
+        op.account.balance = acc.balance;
+        return BankStatus::InvalidLimits;
+    }
+    acc.min_balance = op.a;
+    acc.max_balance = op.b;
+    return BankStatus::Ok;
+}
+
+static void execute(Shard &s, Op &op)
+{
+    size_t i;
+    switch (op.kind)
+    {
+    case Op::Init:
+        fill(s, op);
+        break;
+    case Op::Transfer:
+    {
+        size_t fi = s.ids.find(op.id), ti = s.ids.find(op.to_id);
+        op.status = fi == AccountIndex::NOT_FOUND || ti == AccountIndex::NOT_FOUND
+                        ? BankStatus::AccountNotFound
+                        : moveFunds(s, fi, s, ti, op.a);
+        break;
+    }
+    case Op::PrepareDebit:
+    case Op::PrepareCredit:
+        op.status = prepare(s, op, op.kind == Op::PrepareDebit);
+        break;
+    case Op::CommitDebit:
+    case Op::CommitCredit:
+        finish(s, op, op.kind == Op::CommitDebit, true);
+        break;
+    case Op::AbortDebit:
+    case Op::AbortCredit:
+        finish(s, op, op.kind == Op::AbortDebit, false);
+        break;
+    case Op::Freeze:
+        i = s.ids.find(op.id);
+        op.status = i == AccountIndex::NOT_FOUND ? BankStatus::AccountNotFound : BankStatus::Ok;
+        if (i != AccountIndex::NOT_FOUND)
+            s.accounts[i].frozen = op.b != 0;
+        break;
+    case Op::SetLimits:
+        op.status = setLimits(s, op);
+        break;
+    case Op::Query:
+        i = s.ids.find(op.id);
+        op.status = i == AccountIndex::NOT_FOUND ? BankStatus::AccountNotFound : BankStatus::Ok;
+        if (i != AccountIndex::NOT_FOUND)
+            op.account = s.accounts[i];
+        break;
+    case Op::Park:
+        if (op.phase1)
+            op.phase1(s, op);
+        sem_post(&op.done);
+        waitSem(op.release);
+        if (op.commit && op.phase2)
+            op.phase2(s, op);
+        break;
+    }
+    // После этого op может быть уже уничтожена вызывающим
+    sem_post(&op.done);
+}
+
+static void *shardMain(void *arg)
+{
+    Shard &s = *static_cast<Shard *>(arg);
+    if (s.cpu >= 0)
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(s.cpu, &set);
+        pthread_setaffinity_np(pthread_self(), sizeof(set), &set); // Не вышло — работаем без привязки
+    }
+
+    // Очередь забирается целиком: одна блокировка на пачку заявок
+    std::vector<Op *> batch;
+    pthread_mutex_lock(&s.mtx);
+    while (true)
+    {
+        while (s.queue.empty() && !s.stop)
+            pthread_cond_wait(&s.cond, &s.mtx);
+        if (s.queue.empty())
+            break;
+        batch.swap(s.queue);
+        pthread_mutex_unlock(&s.mtx);
+        for (Op *op : batch)
+            execute(s, *op);
+        batch.clear();
+        pthread_mutex_lock(&s.mtx);
+    }
+    pthread_mutex_unlock(&s.mtx);
+    return nullptr;
+}
+
+static void stopShard(Shard &s)
+{
+    pthread_mutex_lock(&s.mtx);
+    s.stop = true;
+    pthread_cond_signal(&s.cond);
+    pthread_mutex_unlock(&s.mtx);
+    pthread_join(s.thread, nullptr);
+}
+
+ShardedBank::ShardedBank(const Account *accounts, size_t count, size_t shards, bool pin)
+    : count_(0)
+{
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpus < 1)
+        cpus = 1;
+    if (shards == 0)
+        shards = static_cast<size_t>(cpus);
+
+    pthread_mutex_init(&barrier_mtx_, nullptr);
+    // Писатель (барьер) не должен голодать за потоком фиксаций
+    pthread_rwlockattr_t attr;
+    pthread_rwlockattr_init(&attr);
+    pthread_rwlockattr_setkind_np(&attr, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+    pthread_rwlock_init(&commit_lock_, &attr);
+    pthread_rwlockattr_destroy(&attr);
+
+    for (size_t k = 0; k < shards; ++k)
+    {
+        shards_.emplace_back(new Shard(k, shards, pin ? static_cast<int>(k % cpus) : -1));
+        int rc = pthread_create(&shards_.back()->thread, nullptr, shardMain, shards_.back().get());
+        if (rc != 0)
+        {
+            shards_.pop_back();
+            for (auto &s : shards_)
+                stopShard(*s);
+            shards_.clear();
+            pthread_rwlock_destroy(&commit_lock_);
+            pthread_mutex_destroy(&barrier_mtx_);
+            throw std::runtime_error(std::string("ShardedBank: pthread_create: ") + std::strerror(rc));
+        }
+    }
+
+    // Каждая нить сама раскладывает свои счета — параллельно и в свою память
+    std::unique_ptr<Op[]> ops(new Op[shards]);
+    for (size_t k = 0; k < shards; ++k)
+    {
+        ops[k].source = accounts;
+        ops[k].source_count = count;
+        post(k, ops[k]);
+    }
+    for (size_t k = 0; k < shards; ++k)
+    {
+        waitSem(ops[k].done);
+        count_ += shards_[k]->accounts.size();
+    }
+}
+
+ShardedBank::~ShardedBank()
+{
+    for (auto &s : shards_)
+        stopShard(*s);
+    pthread_rwlock_destroy(&commit_lock_);
+    pthread_mutex_destroy(&barrier_mtx_);
+}
+
+void ShardedBank::post(size_t shard, Op &op)
+{
+    Shard &s = *shards_[shard];
+    pthread_mutex_lock(&s.mtx);
+    s.queue.push_back(&op);
+    // Нить спит, только если очередь была пуста
+    const bool wake = s.queue.size() == 1;
+    pthread_mutex_unlock(&s.mtx);
+    if (wake)
+        pthread_cond_signal(&s.cond);
+}
+
+void ShardedBank::run(size_t shard, Op &op)
+{
+    TraceSpan span(TracePhase::Queue);
+    post(shard, op);
+    waitSem(op.done);
+}
+
+size_t ShardedBank::queueDepth(size_t shard)
+{
+    Shard &s = *shards_[shard];
+    pthread_mutex_lock(&s.mtx);
+    const size_t n = s.queue.size();
+    pthread_mutex_unlock(&s.mtx);
+    return n;
+}
+
+void ShardedBank::parkAll(Op *ops)
+{
+    pthread_mutex_lock(&barrier_mtx_);
+    pthread_rwlock_wrlock(&commit_lock_);
+    for (size_t k = 0; k < shards_.size(); ++k)
+    {
+        ops[k].kind = Op::Park;
+        post(k, ops[k]);
+    }
+    for (size_t k = 0; k < shards_.size(); ++k)
+        waitSem(ops[k].done);
+}
+
+void ShardedBank::releaseAll(Op *ops, bool commit)
+{
+    for (size_t k = 0; k < shards_.size(); ++k)
+    {
+        ops[k].commit = commit;
+        sem_post(&ops[k].release);
+    }
+    for (size_t k = 0; k < shards_.size(); ++k)
+        waitSem(ops[k].done);
+    pthread_rwlock_unlock(&commit_lock_);
+    pthread_mutex_unlock(&barrier_mtx_);
+}
+
+BankStatus ShardedBank::tryTransfer(int from_id, int to_id, int32_t amount)
+{
+    if (amount <= 0)
+        return BankStatus::InvalidAmount;
+
+    const size_t from = shardOf(from_id), to = shardOf(to_id);
+    if (from == to)
+    {
+        Op op;
+        op.kind = Op::Transfer;
+        op.id = from_id;
+        op.to_id = to_id;
+        op.a = amount;
+        run(from, op);
+        return op.status;
+    }
+
+    // Фаза 1: резервы по возрастанию номера шарда
+    Op debit, credit;
+    debit.kind = Op::PrepareDebit;
+    debit.id = from_id;
+    debit.a = amount;
+    credit.kind = Op::PrepareCredit;
+    credit.id = to_id;
+    credit.a = amount;
+    Op &first = from < to ? debit : credit;
+    Op &second = from < to ? credit : debit;
+    const size_t first_shard = std::min(from, to), second_shard = std::max(from, to);
+
+    run(first_shard, first);
+    if (first.status != BankStatus::Ok)
+        return first.status;
+    run(second_shard, second);
+    if (second.status != BankStatus::Ok)
+    {
+        first.kind = &first == &debit ? Op::AbortDebit : Op::AbortCredit;
+        run(first_shard, first);
+        return second.status;
+    }
+
+    // Фаза 2: обе половины сразу; барьер дождётся их целиком
+    debit.kind = Op::CommitDebit;
+    credit.kind = Op::CommitCredit;
+    pthread_rwlock_rdlock(&commit_lock_);
+    post(from, debit);
+    post(to, credit);
+    waitSem(debit.done);
+    waitSem(credit.done);
+    pthread_rwlock_unlock(&commit_lock_);
+    return BankStatus::Ok;
+}
+
+BankStatus ShardedBank::tryFreeze(int id, bool frozen)
+{
+    Op op;
+    op.kind = Op::Freeze;
+    op.id = id;
+    op.b = frozen;
+    run(shardOf(id), op);
+    return op.status;
+}
+
+BankStatus ShardedBank::trySetLimits(size_t id, int32_t newMin, int32_t newMax, int32_t *balance)
+{
+    if (newMin > newMax)
+        return BankStatus::InvalidLimits;
+    Op op;
+    op.kind = Op::SetLimits;
+    op.id = static_cast<int>(id);
+    op.a = newMin;
+    op.b = newMax;
+    run(shardOf(op.id), op);
+    if (op.status == BankStatus::InvalidLimits && balance)
+        *balance = op.account.balance;
+    return op.status;
+}
+
+BankStatus ShardedBank::getAccount(int id, Account &out)
+{
+    Op op;
+    op.kind = Op::Query;
+    op.id = id;
+    run(shardOf(id), op);
+    if (op.status == BankStatus::Ok)
+        out = op.account;
+    return op.status;
+}
+
+// Проверка massUpdate в нити шарда; с резервами — с поправкой на них
+static void massCheck(Shard &s, Op &op)
+{
+    const size_t n = s.accounts.size();
+    if (s.holds == 0)
+    {
+        op.violator = massUpdateCheck(AccountStore(s.accounts.data()), n, op.a, 1);
+        return;
+    }
+    op.violator = n;
+    for (size_t i = 0; i < n; ++i)
+    {
+        const Account &acc = s.accounts[i];
+        const int64_t balance = int64_t(acc.balance) + op.a;
+        if (balance - s.hold_out[i] < acc.min_balance || balance + s.hold_in[i] > acc.max_balance)
+        {
+            op.violator = i;
+            return;
+        }
+    }
+}
+
+static void massApply(Shard &s, Op &op)
+{
+    massUpdateApply(AccountStore(s.accounts.data()), s.accounts.size(), op.a, 1);
+}
+
+BankStatus ShardedBank::tryMassUpdate(int32_t amount, int *violator)
+{
+    std::unique_ptr<Op[]> ops(new Op[shards_.size()]);
+    for (size_t k = 0; k < shards_.size(); ++k)
+    {
+        ops[k].a = amount;
+        ops[k].phase1 = massCheck;
+        ops[k].phase2 = massApply;
+    }
+
+    // Шарды проверяют себя параллельно; применяют, только если прошли все
+    parkAll(ops.get());
+    BankStatus st = BankStatus::Ok;
+    for (size_t k = 0; k < shards_.size(); ++k)
+    {
+        const Shard &s = *shards_[k];
+        if (ops[k].violator < s.accounts.size())
+        {
+            if (violator)
+                *violator = s.accounts[ops[k].violator].account_id;
+            st = BankStatus::LimitViolation;
+            break;
+        }
+    }
+    releaseAll(ops.get(), st == BankStatus::Ok);
+    return st;
+}
+
+size_t ShardedBank::transferBatch(const Transfer *items, size_t count, BankStatus *results, bool atomic)
+{
+    if (!atomic)
+    {
+        size_t applied = 0;
+        for (size_t i = 0; i < count; ++i)
+        {
+            results[i] = tryTransfer(items[i].from_id, items[i].to_id, items[i].amount);
+            applied += results[i] == BankStatus::Ok;
+        }
+        return applied;
+    }
+    if (count == 0)
+        return 0;
+
+    std::unique_ptr<Op[]> ops(new Op[shards_.size()]);
+    parkAll(ops.get());
+
+    // Все нити стоят: координатор работает с шардами напрямую
+    std::vector<size_t> slots(2 * count);
+    bool rejected = false;
+    for (size_t i = 0; i < count; ++i)
+    {
+        const Transfer &t = items[i];
+        slots[2 * i] = shards_[shardOf(t.from_id)]->ids.find(t.from_id);
+        slots[2 * i + 1] = shards_[shardOf(t.to_id)]->ids.find(t.to_id);
+        if (t.amount <= 0)
+            results[i] = BankStatus::InvalidAmount;
+        else if (slots[2 * i] == AccountIndex::NOT_FOUND || slots[2 * i + 1] == AccountIndex::NOT_FOUND)
+            results[i] = BankStatus::AccountNotFound;
+        else
+        {
+            results[i] = BankStatus::Ok;
+            continue;
+        }
+        rejected = true;
+    }
+
+    size_t applied = 0;
+    for (size_t i = 0; i < count && !rejected; ++i)
+    {
+        const Transfer &t = items[i];
+        results[i] = moveFunds(*shards_[shardOf(t.from_id)], slots[2 * i], *shards_[shardOf(t.to_id)],
+                               slots[2 * i + 1], t.amount);
+        if (results[i] == BankStatus::Ok)
+        {
+            ++applied;
+            continue;
+        }
+        // Откат в обратном порядке возвращает в точности прежние балансы
+        for (size_t j = i; j-- > 0;)
+        {
+            shards_[shardOf(items[j].from_id)]->accounts[slots[2 * j]].balance += items[j].amount;
+            shards_[shardOf(items[j].to_id)]->accounts[slots[2 * j + 1]].balance -= items[j].amount;
+        }
+        applied = 0;
+        rejected = true;
+    }
+    if (rejected)
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            if (results[i] == BankStatus::Ok)
+                results[i] = BankStatus::BatchAborted;
+        }
+    }
+    releaseAll(ops.get(), false);
+    return applied;
+}
+
+// Копия (если задано куда) и сумма балансов шарда
+static void copyRows(Shard &s, Op &op)
+{
+    int64_t sum = 0;
+    for (const Account &acc : s.accounts)
+        sum += acc.balance;
+    op.sum = sum;
+    if (op.rows)
+        std::copy(s.accounts.begin(), s.accounts.end(), op.rows);
+}
+
+int64_t ShardedBank::snapshot(std::vector<Account> &out)
+{
+    out.resize(count_);
+    std::unique_ptr<Op[]> ops(new Op[shards_.size()]);
+    size_t offset = 0;
+    for (size_t k = 0; k < shards_.size(); ++k)
+    {
+        ops[k].rows = out.data() + offset;
+        ops[k].phase1 = copyRows;
+        offset += shards_[k]->accounts.size();
+    }
+    parkAll(ops.get());
+    releaseAll(ops.get(), false);
+
+    int64_t total = 0;
+    for (size_t k = 0; k < shards_.size(); ++k)
+        total += ops[k].sum;
+    return total;
+}
+
+int64_t ShardedBank::totalBalance()
+{
+    std::unique_ptr<Op[]> ops(new Op[shards_.size()]);
+    for (size_t k = 0; k < shards_.size(); ++k)
+        ops[k].phase1 = copyRows;
+    parkAll(ops.get());
+    releaseAll(ops.get(), false);
+
+    int64_t total = 0;
+    for (size_t k = 0; k < shards_.size(); ++k)
+        total += ops[k].sum;
+    return total;
+}
@@ -0,0 +1,339 @@
+#include "Snapshot.hpp"
+#include "TxnLog.hpp"
+
+#include <cerrno>     // errno, EINTR
+#include <chrono>     // std::chrono::steady_clock
+#include <cstdio>     // rename
+#include <cstring>    // memcpy, memset, strerror
+#include <fcntl.h>    // open
+#include <libgen.h>   // dirname
+#include <sys/mman.h> // mmap, msync, munmap
+#include <sys/stat.h> // fstat
+#include <sys/wait.h> // waitpid
+#include <unistd.h>   // fork, pwrite, fdatasync, ftruncate, _exit
+#include <vector>     // std::vector
+
+using Clock = std::chrono::steady_clock;
+
+static std::string sysError(const char *what)
+{
+    return std::string(what) + ": " + std::strerror(errno);
+}
+
+static double msSince(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+static bool syncParentDir(const std::string &path)
+{
+    std::vector<char> copy(path.begin(), path.end());
+    copy.push_back('\0');
+    int dfd = ::open(dirname(copy.data()), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dfd < 0)
+        return false;
+    bool ok = fsync(dfd) == 0;
+    ::close(dfd);
+    return ok;
+}
+
+/*
+ * Кусок образа: data — память хранилища, offset — смещение в образе.
+ * Для Rows кусок один, для Columns — четыре колонки и битовая карта;
+ * шаг колонок хранилища (по его ёмкости) может отличаться от шага образа.
+ */
+struct ImagePart
+{
+    char *data;
+    size_t bytes;
+    size_t offset;
+};
+
+static size_t imageParts(const AccountStore &store, size_t count, ImagePart parts[5]) noexcept
+{
+    if (store.layout() == AccountLayout::Rows)
+    {
+        parts[0] = {reinterpret_cast<char *>(store.rows()), count * sizeof(Account), 0};
+        return 1;
+    }
+    const AccountColumns &c = store.columns();
+    const size_t stride = columnStride(count);
+    const size_t column = count * sizeof(int32_t);
+    parts[0] = {reinterpret_cast<char *>(c.ids), column, 0};
+    parts[1] = {reinterpret_cast<char *>(c.balances), column, stride};
+    parts[2] = {reinterpret_cast<char *>(c.min_balances), column, 2 * stride};
+    parts[3] = {reinterpret_cast<char *>(c.max_balances), column, 3 * stride};
+    parts[4] = {reinterpret_cast<char *>(c.frozen), (count + 63) / 64 * sizeof(uint64_t), 4 * stride};
+    return 5;
+}
+
+size_t snapshotPayloadBytes(AccountLayout layout, size_t count) noexcept
+{
+    return layout == AccountLayout::Columns ? columnsBytes(count) : count * sizeof(Account);
+}
+
+static SnapshotHeader makeHeader(const Bank &bank, size_t count, uint64_t log_lsn) noexcept
+{
+    SnapshotHeader h;
+    std::memset(&h, 0, sizeof(h));
+    h.magic = SNAPSHOT_MAGIC;
+    h.version = SNAPSHOT_VERSION;
+    h.layout = static_cast<uint32_t>(bank.layout());
+    h.record_stride = bank.layout() == AccountLayout::Rows ? sizeof(Account) : 0;
+    h.account_count = count;
+    h.log_lsn = log_lsn;
+    h.payload_bytes = snapshotPayloadBytes(bank.layout(), count);
+    return h;
+}
+
+// Только async-signal-safe вызовы: выполняется в потомке многопоточного процесса
+static bool pwriteAll(int fd, const char *data, size_t n, off_t off)
+{
+    while (n > 0)
+    {
+        ssize_t w = pwrite(fd, data, n, off);
+        if (w < 0 && errno == EINTR)
+            continue;
+        if (w <= 0)
+            return false;
+        data += w;
+        n -= static_cast<size_t>(w);
+        off += w;
+    }
+    return true;
+}
+
+// Переименовать готовый временный файл в снимок и закрепить запись в каталоге
+static bool publish(const std::string &tmp, const std::string &path, std::string &error)
+{
+    if (std::rename(tmp.c_str(), path.c_str()) != 0)
+    {
+        error = sysError("snapshot: rename");
+        unlink(tmp.c_str());
+        return false;
+    }
+    if (!syncParentDir(path))
+    {
+        error = sysError("snapshot: fsync directory");
+        return false;
+    }
+    return true;
+}
+
+bool forkSnapshot(Bank &bank, const std::string &path, TxnLog *log, std::string &error,
+                  SnapshotTiming *timing)
+{
+    // Всё, что нужно потомку, готовим до fork: после него — никаких аллокаций
+    const std::string tmp = path + ".tmp";
+    ImagePart parts[5];
+    SnapshotHeader header;
+    size_t nparts = 0;
+    uint64_t lsn = 0;
+    pid_t pid;
+
+    Clock::time_point start = Clock::now();
+    bank.lockAllStripes();
+    {
+        const size_t count = bank.getAccountCount();
+        lsn = log ? log->lastLsn() : 0;
+        header = makeHeader(bank, count, lsn);
+        nparts = imageParts(bank.store(), count, parts);
+        pid = fork();
+        if (pid == 0)
+        {
+            int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+            bool ok = fd >= 0 &&
+                      ftruncate(fd, sizeof(SnapshotHeader) + header.payload_bytes) == 0;
+            for (size_t i = 0; ok && i < nparts; ++i)
+                ok = pwriteAll(fd, parts[i].data, parts[i].bytes,
+                               sizeof(SnapshotHeader) + parts[i].offset);
+            // Заголовок последним: файл без заголовка не загрузится
+            ok = ok && fdatasync(fd) == 0 &&
+                 pwriteAll(fd, reinterpret_cast<const char *>(&header), sizeof(header), 0) &&
+                 fdatasync(fd) == 0;
+            _exit(ok ? 0 : 1);
+        }
+    }
+    bank.unlockAllStripes();
+    if (timing)
+        timing->pause_ms = msSince(start);
+
+    if (pid < 0)
+    {
+        error = sysError("snapshot: fork");
+        return false;
+    }
+    int status = 0;
+    while (waitpid(pid, &status, 0) < 0)
+    {
+        if (errno != EINTR)
+        {
+            error = sysError("snapshot: waitpid");
+            return false;
+        }
+    }
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+    {
+        error = "snapshot: writer process failed for " + tmp;
+        unlink(tmp.c_str());
+        return false;
+    }
+
+    if (log)
+    {
+        // Снимок не должен опережать журнал: иначе после сбоя он содержал бы
+        // операции, которых журнал не знает, и номера новых записей совпали бы
+        try
+        {
+            log->waitDurable(lsn);
+        }
+        catch (const std::exception &ex)
+        {
+            error = std::string("snapshot: ") + ex.what();
+            unlink(tmp.c_str());
+            return false;
+        }
+    }
+    bool ok = publish(tmp, path, error);
+    if (timing)
+        timing->total_ms = msSince(start);
+    return ok;
+}
+
+bool dumpSnapshot(Bank &bank, const std::string &path, std::string &error,
+                  SnapshotTiming *timing)
+{
+    const std::string tmp = path + ".tmp";
+    Clock::time_point start = Clock::now();
+
+    int fd = ::open(tmp.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0)
+    {
+        error = sysError("snapshot: open");
+        return false;
+    }
+
+    // Число счетов фиксируется под полосами: другой процесс может дописывать их
+    SnapshotHeader header;
+    char *map = nullptr;
+    size_t map_bytes = 0;
+    bank.lockAllStripes();
+    {
+        const size_t count = bank.getAccountCount();
+        header = makeHeader(bank, count, 0);
+        map_bytes = sizeof(SnapshotHeader) + header.payload_bytes;
+        if (ftruncate(fd, map_bytes) == 0)
+        {
+            void *mem = mmap(nullptr, map_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            map = mem == MAP_FAILED ? nullptr : static_cast<char *>(mem);
+        }
+        if (map)
+        {
+            ImagePart parts[5];
+            size_t nparts = imageParts(bank.store(), count, parts);
+            for (size_t i = 0; i < nparts; ++i)
+                std::memcpy(map + sizeof(SnapshotHeader) + parts[i].offset, parts[i].data,
+                            parts[i].bytes);
+        }
+    }
+    bank.unlockAllStripes();
+    if (timing)
+        timing->pause_ms = msSince(start);
+
+    if (!map)
+    {
+        error = sysError("snapshot: map file");
+        ::close(fd);
+        unlink(tmp.c_str());
+        return false;
+    }
+    bool ok = msync(map, map_bytes, MS_SYNC) == 0;
+    std::memcpy(map, &header, sizeof(header));
+    ok = ok && msync(map, sizeof(header), MS_SYNC) == 0 && fsync(fd) == 0;
+    munmap(map, map_bytes);
+    ::close(fd);
+    if (!ok)
+    {
+        error = sysError("snapshot: write");
+        unlink(tmp.c_str());
+        return false;
+    }
+    ok = publish(tmp, path, error);
+    if (timing)
+        timing->total_ms = msSince(start);
+    return ok;
+}
+
+bool readSnapshotHeader(const std::string &path, SnapshotHeader &header, std::string &error)
+{
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        error = sysError(path.c_str());
+        return false;
+    }
+    struct stat st;
+    bool read_ok = fstat(fd, &st) == 0 &&
+                   pread(fd, &header, sizeof(header), 0) == static_cast<ssize_t>(sizeof(header));
+    ::close(fd);
+
+    if (!read_ok || header.magic != SNAPSHOT_MAGIC)
+    {
+        error = path + ": not a bank snapshot";
+        return false;
+    }
+    if (header.version != SNAPSHOT_VERSION)
+    {
+        error = path + ": unsupported snapshot version " + std::to_string(header.version);
+        return false;
+    }
+    const bool columnar = header.layout == static_cast<uint32_t>(AccountLayout::Columns);
+    if ((!columnar && header.layout != static_cast<uint32_t>(AccountLayout::Rows)) ||
+        header.record_stride != (columnar ? 0 : sizeof(Account)))
+    {
+        error = path + ": incompatible account layout";
+        return false;
+    }
+    const AccountLayout layout = columnar ? AccountLayout::Columns : AccountLayout::Rows;
+    if (header.account_count == 0 ||
+        header.payload_bytes != snapshotPayloadBytes(layout, header.account_count) ||
+        static_cast<uint64_t>(st.st_size) != sizeof(SnapshotHeader) + header.payload_bytes)
+    {
+        error = path + ": truncated or corrupted snapshot";
+        return false;
+    }
+    return true;
+}
+
+bool loadSnapshot(const std::string &path, const SnapshotHeader &header,
+                  const AccountStore &dst, std::string &error)
+{
+    if (static_cast<uint32_t>(dst.layout()) != header.layout)
+    {
+        error = path + ": snapshot layout differs from the target storage";
+        return false;
+    }
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        error = sysError(path.c_str());
+        return false;
+    }
+    const size_t bytes = sizeof(SnapshotHeader) + header.payload_bytes;
+    void *mem = mmap(nullptr, bytes, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+    ::close(fd);
+    if (mem == MAP_FAILED)
+    {
+        error = sysError("snapshot: mmap");
+        return false;
+    }
+    madvise(mem, bytes, MADV_SEQUENTIAL);
+
+    const char *image = static_cast<const char *>(mem) + sizeof(SnapshotHeader);
+    ImagePart parts[5];
+    size_t nparts = imageParts(dst, header.account_count, parts);
+    for (size_t i = 0; i < nparts; ++i)
+        std::memcpy(parts[i].data, image + parts[i].offset, parts[i].bytes);
+    munmap(mem, bytes);
+    return true;
+}
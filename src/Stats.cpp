@@ -0,0 +1,293 @@
+#include "Stats.hpp"
+#include "Commands.hpp"
+
+#include <atomic>    // std::atomic
+#include <cstdlib>   // posix_memalign
+#include <cstring>   // memset
+#include <new>       // placement new, std::bad_alloc
+#include <pthread.h> // pthread_mutex_*
+#include <vector>    // std::vector
+
+// Слот одной нити. Пишет только владелец (load + store, без RMW), читают все
+struct alignas(64) ThreadStats
+{
+    std::atomic<uint64_t> ok[STATS_KINDS];
+    std::atomic<uint64_t> rejected[STATS_KINDS];
+    std::atomic<uint64_t> buckets[STATS_BUCKETS];
+    std::atomic<uint64_t> reasons[STATS_REASONS];
+    std::atomic<uint64_t> latency_ns;
+    std::atomic<uint64_t> bytes_in;
+    std::atomic<uint64_t> bytes_out;
+};
+
+static pthread_mutex_t registry_mtx = PTHREAD_MUTEX_INITIALIZER;
+static std::vector<ThreadStats *> registry;   // Все слоты; не освобождаются
+static std::vector<ThreadStats *> free_slots; // Слоты завершившихся нитей
+static std::atomic<uint64_t> connections{0};
+static std::atomic<uint64_t> connections_closed{0};
+static std::atomic<uint64_t> connections_busy{0};
+static std::atomic<uint64_t> connections_idle{0};
+
+static ThreadStats *acquireSlot()
+{
+    pthread_mutex_lock(&registry_mtx);
+    ThreadStats *slot = nullptr;
+    if (!free_slots.empty())
+    {
+        slot = free_slots.back();
+        free_slots.pop_back();
+    }
+    else
+    {
+        void *mem = nullptr;
+        // new не обязан выравнивать по 64 до C++17
+        if (posix_memalign(&mem, alignof(ThreadStats), sizeof(ThreadStats)) == 0)
+        {
+            std::memset(mem, 0, sizeof(ThreadStats));
+            slot = new (mem) ThreadStats;
+            registry.push_back(slot);
+        }
+    }
+    pthread_mutex_unlock(&registry_mtx);
+    return slot;
+}
+
+// Возвращает слот при завершении нити; счётчики остаются в сумме
+struct SlotOwner
+{
+    ThreadStats *slot = nullptr;
+    ~SlotOwner()
+    {
+        if (!slot)
+            return;
+        pthread_mutex_lock(&registry_mtx);
+        free_slots.push_back(slot);
+        pthread_mutex_unlock(&registry_mtx);
+    }
+};
+
+static thread_local SlotOwner owner;
+
+static void bump(std::atomic<uint64_t> &c, uint64_t by = 1) noexcept
+{
+    c.store(c.load(std::memory_order_relaxed) + by, std::memory_order_relaxed);
+}
+
+// Слот текущей нити; nullptr — не хватило памяти, и учёт пропускается
+static ThreadStats *slot() noexcept
+{
+    ThreadStats *s = owner.slot;
+    if (s)
+        return s;
+    try
+    {
+        s = owner.slot = acquireSlot();
+    }
+    catch (const std::bad_alloc &)
+    {
+    }
+    return s;
+}
+
+size_t statsBucket(uint64_t ns) noexcept
+{
+    if (ns < 16)
+        return static_cast<size_t>(ns);
+    const unsigned e = 63 - __builtin_clzll(ns); // ≥ 4
+    return 16 + (e - 4) * 8 + ((ns >> (e - 3)) & 7);
+}
+
+uint64_t statsBucketLimit(size_t bucket) noexcept
+{
+    if (bucket < 16)
+        return bucket;
+    const unsigned e = static_cast<unsigned>((bucket - 16) / 8 + 4);
+    const uint64_t sub = (bucket - 16) % 8;
+    return ((8 + sub) << (e - 3)) + ((uint64_t(1) << (e - 3)) - 1);
+}
+
+void statsRecord(unsigned kind, unsigned reason, uint64_t ns) noexcept
+{
+    ThreadStats *s = slot();
+    if (!s)
+        return; // Без памяти статистика теряется, запрос — нет
+    if (kind >= STATS_KINDS)
+        kind = 0;
+    if (reason == STATS_OK)
+    {
+        bump(s->ok[kind]);
+    }
+    else
+    {
+        bump(s->rejected[kind]);
+        bump(s->reasons[reason < STATS_REASONS ? reason : STATS_INTERNAL]);
+    }
+    bump(s->buckets[statsBucket(ns)]);
+    bump(s->latency_ns, ns);
+}
+
+void statsBytes(uint64_t in, uint64_t out) noexcept
+{
+    ThreadStats *s = slot();
+    if (!s)
+        return;
+    if (in)
+        bump(s->bytes_in, in);
+    if (out)
+        bump(s->bytes_out, out);
+}
+
+void statsConnection(bool opened) noexcept
+{
+    (opened ? connections : connections_closed).fetch_add(1);
+}
+
+void statsConnectionBusy() noexcept
+{
+    connections_busy.fetch_add(1);
+}
+
+void statsConnectionIdle() noexcept
+{
+    connections_idle.fetch_add(1);
+}
+
+const char *statsReasonName(unsigned reason) noexcept
+{
+    switch (reason)
+    {
+    case STATS_OK:
+        return "Ok";
+    case STATS_USAGE:
+        return "Usage";
+    case STATS_UNKNOWN:
+        return "UnknownCommand";
+    case STATS_INTERNAL:
+        return "Internal";
+    default:
+        return reason < STATS_USAGE ? bankStatusName(static_cast<BankStatus>(reason)) : "Internal";
+    }
+}
+
+void statsCollect(StatsSummary &out)
+{
+    std::memset(&out, 0, sizeof(out));
+    pthread_mutex_lock(&registry_mtx);
+    for (const ThreadStats *s : registry)
+    {
+        for (size_t k = 0; k < STATS_KINDS; ++k)
+        {
+            out.ok[k] += s->ok[k].load(std::memory_order_relaxed);
+            out.rejected[k] += s->rejected[k].load(std::memory_order_relaxed);
+        }
+        for (size_t b = 0; b < STATS_BUCKETS; ++b)
+            out.buckets[b] += s->buckets[b].load(std::memory_order_relaxed);
+        for (size_t r = 0; r < STATS_REASONS; ++r)
+            out.reasons[r] += s->reasons[r].load(std::memory_order_relaxed);
+        out.latency_ns += s->latency_ns.load(std::memory_order_relaxed);
+        out.bytes_in += s->bytes_in.load(std::memory_order_relaxed);
+        out.bytes_out += s->bytes_out.load(std::memory_order_relaxed);
+    }
+    pthread_mutex_unlock(&registry_mtx);
+    // Закрытия читаем первыми: активных не бывает меньше нуля
+    const uint64_t closed = connections_closed.load();
+    out.connections = connections.load();
+    out.connections_active = out.connections - closed;
+    out.connections_busy = connections_busy.load();
+    out.connections_idle = connections_idle.load();
+}
+
+uint64_t StatsSummary::total() const noexcept
+{
+    uint64_t n = 0;
+    for (size_t k = 0; k < STATS_KINDS; ++k)
+        n += ok[k] + rejected[k];
+    return n;
+}
+
+uint64_t StatsSummary::totalRejected() const noexcept
+{
+    uint64_t n = 0;
+    for (size_t k = 0; k < STATS_KINDS; ++k)
+        n += rejected[k];
+    return n;
+}
+
+uint64_t StatsSummary::percentile(double q) const noexcept
+{
+    uint64_t count = 0;
+    for (size_t b = 0; b < STATS_BUCKETS; ++b)
+        count += buckets[b];
+    if (count == 0)
+        return 0;
+    uint64_t target = static_cast<uint64_t>(q * count);
+    if (target < 1)
+        target = 1;
+    uint64_t seen = 0;
+    for (size_t b = 0; b < STATS_BUCKETS; ++b)
+    {
+        seen += buckets[b];
+        if (seen >= target)
+            return statsBucketLimit(b);
+    }
+    return statsBucketLimit(STATS_BUCKETS - 1);
+}
+
+// "<prefix>N (ok X, rejected Y)\n"
+static void appendCounts(std::string &out, const char *prefix, uint64_t ok, uint64_t rejected)
+{
+    out += prefix;
+    appendInt(out, static_cast<int64_t>(ok + rejected));
+    out += " (ok ";
+    appendInt(out, static_cast<int64_t>(ok));
+    out += ", rejected ";
+    appendInt(out, static_cast<int64_t>(rejected));
+    out += ")\n";
+}
+
+void appendStats(std::string &out)
+{
+    StatsSummary s;
+    statsCollect(s);
+    const uint64_t rejected = s.totalRejected();
+    appendCounts(out, "Requests: ", s.total() - rejected, rejected);
+    out += "Latency ns: p50 ";
+    appendInt(out, static_cast<int64_t>(s.percentile(0.5)));
+    out += ", p99 ";
+    appendInt(out, static_cast<int64_t>(s.percentile(0.99)));
+    out += ", p999 ";
+    appendInt(out, static_cast<int64_t>(s.percentile(0.999)));
+    out += '\n';
+    for (size_t k = 0; k < STATS_KINDS; ++k)
+    {
+        if (s.ok[k] + s.rejected[k] == 0)
+            continue;
+        std::string prefix = "  ";
+        prefix += k == 0 || k > COMMAND_COUNT ? "unknown" : COMMANDS[k - 1].name;
+        prefix += ": ";
+        appendCounts(out, prefix.c_str(), s.ok[k], s.rejected[k]);
+    }
+    for (size_t r = 1; r < STATS_REASONS; ++r)
+    {
+        if (s.reasons[r] == 0)
+            continue;
+        out += "  rejected ";
+        out += statsReasonName(static_cast<unsigned>(r));
+        out += ": ";
+        appendInt(out, static_cast<int64_t>(s.reasons[r]));
+        out += '\n';
+    }
+    out += "Connections: active ";
+    appendInt(out, static_cast<int64_t>(s.connections_active));
+    out += ", total ";
+    appendInt(out, static_cast<int64_t>(s.connections));
+    out += ", busy ";
+    appendInt(out, static_cast<int64_t>(s.connections_busy));
+    out += ", idle ";
+    appendInt(out, static_cast<int64_t>(s.connections_idle));
+    out += "; bytes in ";
+    appendInt(out, static_cast<int64_t>(s.bytes_in));
+    out += ", out ";
+    appendInt(out, static_cast<int64_t>(s.bytes_out));
+    out += '\n';
+}
@@ -0,0 +1,207 @@
+#include "Trace.hpp"
+#include "Commands.hpp"
+
+#include <cerrno>    // errno
+#include <chrono>    // steady_clock
+#include <cstdio>    // fopen, fwrite, snprintf
+#include <cstring>   // strerror
+#include <memory>    // std::unique_ptr
+#include <new>       // std::bad_alloc
+#include <pthread.h> // pthread_mutex_*
+#include <vector>    // std::vector
+
+std::atomic<bool> trace_enabled{false};
+
+namespace
+{
+
+struct TraceEvent
+{
+    std::atomic<uint64_t> start;
+    std::atomic<uint64_t> info; // Длительность (40 бит) | фаза << 40 | команда << 48
+    std::atomic<uint64_t> req;
+};
+
+// Кольцо одной нити: пишет только владелец, читает traceDump
+struct TraceRing
+{
+    uint32_t tid;
+    size_t mask;
+    std::unique_ptr<TraceEvent[]> events;
+    std::atomic<uint64_t> head{0}; // Событий записано за всё время
+};
+
+pthread_mutex_t registry_mtx = PTHREAD_MUTEX_INITIALIZER;
+std::vector<TraceRing *> registry;   // Все кольца; не освобождаются
+std::vector<TraceRing *> free_rings; // Кольца завершившихся нитей
+size_t ring_events = 0;
+
+// Возвращает кольцо при завершении нити
+struct RingOwner
+{
+    TraceRing *ring = nullptr;
+    ~RingOwner()
+    {
+        if (!ring)
+            return;
+        pthread_mutex_lock(&registry_mtx);
+        free_rings.push_back(ring);
+        pthread_mutex_unlock(&registry_mtx);
+    }
+};
+
+thread_local RingOwner owner;
+thread_local uint64_t current_req = 0;
+thread_local unsigned current_kind = 0;
+
+const uint64_t DURATION_MASK = (uint64_t(1) << 40) - 1;
+
+TraceRing *acquireRing()
+{
+    pthread_mutex_lock(&registry_mtx);
+    TraceRing *ring = nullptr;
+    if (!free_rings.empty())
+    {
+        ring = free_rings.back();
+        free_rings.pop_back();
+    }
+    else
+    {
+        ring = new TraceRing;
+        ring->tid = static_cast<uint32_t>(registry.size() + 1);
+        ring->mask = ring_events - 1;
+        ring->events.reset(new TraceEvent[ring_events]());
+        registry.push_back(ring);
+    }
+    pthread_mutex_unlock(&registry_mtx);
+    return ring;
+}
+
+const char *phaseName(unsigned phase) noexcept
+{
+    static const char *const NAMES[] = {"parse", "lock", "queue", "apply", "send"};
+    return phase < sizeof(NAMES) / sizeof(NAMES[0]) ? NAMES[phase] : "other";
+}
+
+// Наносекунды как микросекунды с тремя знаками: формат ts/dur Chrome trace
+void appendMicros(std::string &out, uint64_t ns)
+{
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%llu.%03u", static_cast<unsigned long long>(ns / 1000),
+                  static_cast<unsigned>(ns % 1000));
+    out += buf;
+}
+
+} // namespace
+
+void traceEnable(size_t events)
+{
+    pthread_mutex_lock(&registry_mtx);
+    if (ring_events == 0)
+    {
+        size_t n = 2;
+        while (n < events)
+            n <<= 1;
+        ring_events = n;
+    }
+    pthread_mutex_unlock(&registry_mtx);
+    trace_enabled.store(true, std::memory_order_relaxed);
+}
+
+void traceBeginRequest(unsigned kind) noexcept
+{
+    ++current_req;
+    current_kind = kind;
+}
+
+uint64_t traceNow() noexcept
+{
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                     std::chrono::steady_clock::now().time_since_epoch())
+                                     .count());
+}
+
+void traceRecord(TracePhase phase, uint64_t start, uint64_t ns) noexcept
+{
+    if (!traceEnabled())
+        return;
+    TraceRing *ring = owner.ring;
+    if (!ring)
+    {
+        try
+        {
+            ring = owner.ring = acquireRing();
+        }
+        catch (const std::bad_alloc &)
+        {
+            return; // Без памяти событие теряется, запрос — нет
+        }
+    }
+    const uint64_t pos = ring->head.load(std::memory_order_relaxed);
+    TraceEvent &e = ring->events[pos & ring->mask];
+    e.start.store(start, std::memory_order_relaxed);
+    e.info.store((ns < DURATION_MASK ? ns : DURATION_MASK) |
+                     (uint64_t(static_cast<uint8_t>(phase)) << 40) |
+                     (uint64_t(current_kind & 0xff) << 48),
+                 std::memory_order_relaxed);
+    e.req.store(current_req, std::memory_order_relaxed);
+    ring->head.store(pos + 1, std::memory_order_release);
+}
+
+void traceDump(std::string &out)
+{
+    out += "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    bool first = true;
+    pthread_mutex_lock(&registry_mtx);
+    for (const TraceRing *ring : registry)
+    {
+        const uint64_t head = ring->head.load(std::memory_order_acquire);
+        const uint64_t size = ring->mask + 1;
+        for (uint64_t pos = head > size ? head - size : 0; pos < head; ++pos)
+        {
+            const TraceEvent &e = ring->events[pos & ring->mask];
+            const uint64_t start = e.start.load(std::memory_order_relaxed);
+            const uint64_t info = e.info.load(std::memory_order_relaxed);
+            const uint64_t req = e.req.load(std::memory_order_relaxed);
+            if (start == 0)
+                continue;
+            const unsigned kind = static_cast<unsigned>(info >> 48);
+            out += first ? "\n" : ",\n";
+            first = false;
+            out += "{\"name\":\"";
+            out += phaseName(static_cast<unsigned>((info >> 40) & 0xff));
+            out += "\",\"cat\":\"";
+            out += kind == 0 || kind > COMMAND_COUNT ? "other" : COMMANDS[kind - 1].name;
+            out += "\",\"ph\":\"X\",\"pid\":1,\"tid\":";
+            appendInt(out, ring->tid);
+            out += ",\"ts\":";
+            appendMicros(out, start);
+            out += ",\"dur\":";
+            appendMicros(out, info & DURATION_MASK);
+            out += ",\"args\":{\"req\":";
+            appendInt(out, static_cast<int64_t>(req));
+            out += "}}";
+        }
+    }
+    pthread_mutex_unlock(&registry_mtx);
+    out += "\n]}\n";
+}
+
+bool traceWrite(const std::string &path, std::string &error)
+{
+    std::string json;
+    traceDump(json);
+    std::FILE *f = std::fopen(path.c_str(), "w");
+    if (!f)
+    {
+        error = "trace: cannot open " + path + ": " + std::strerror(errno);
+        return false;
+    }
+    const bool ok = std::fwrite(json.data(), 1, json.size(), f) == json.size();
+    if (std::fclose(f) != 0 || !ok)
+    {
+        error = "trace: cannot write " + path + ": " + std::strerror(errno);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,424 @@
+#include "TxnLog.hpp"
+
+#include <cerrno>    // errno, EINTR
+#include <cstring>   // memset, memcpy, strerror
+#include <fcntl.h>   // open
+#include <libgen.h>  // dirname
+#include <stdexcept> // std::runtime_error
+#include <sys/stat.h> // fstat
+#include <unistd.h>  // pread, write, fdatasync, ftruncate, close, usleep
+#include <vector>    // std::vector
+
+static std::string sysError(const char *what)
+{
+    return std::string(what) + ": " + std::strerror(errno);
+}
+
+static uint32_t crc32(const void *data, size_t n) noexcept
+{
+    static const struct Table
+    {
+        uint32_t v[256];
+        Table()
+        {
+            for (uint32_t i = 0; i < 256; ++i)
+            {
+                uint32_t c = i;
+                for (int k = 0; k < 8; ++k)
+                    c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                v[i] = c;
+            }
+        }
+    } table;
+
+    const unsigned char *p = static_cast<const unsigned char *>(data);
+    uint32_t c = 0xFFFFFFFFu;
+    for (size_t i = 0; i < n; ++i)
+        c = table.v[(c ^ p[i]) & 0xFF] ^ (c >> 8);
+    return c ^ 0xFFFFFFFFu;
+}
+
+static uint32_t recordCrc(const TxnRecord &r) noexcept
+{
+    return crc32(&r, offsetof(TxnRecord, crc));
+}
+
+static bool writeAll(int fd, const char *data, size_t n)
+{
+    while (n > 0)
+    {
+        ssize_t w = ::write(fd, data, n);
+        if (w < 0 && errno == EINTR)
+            continue;
+        if (w <= 0)
+            return false;
+        data += w;
+        n -= static_cast<size_t>(w);
+    }
+    return true;
+}
+
+// Новый файл долговечен, только когда долговечна запись о нём в каталоге
+static bool syncParentDir(const std::string &path)
+{
+    std::vector<char> copy(path.begin(), path.end());
+    copy.push_back('\0');
+    int dfd = ::open(dirname(copy.data()), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dfd < 0)
+        return false;
+    bool ok = fsync(dfd) == 0;
+    ::close(dfd);
+    return ok;
+}
+
+// Применить запись журнала к Bank (бросает, если операция не проходит)
+static void applyRecord(Bank &bank, const TxnRecord &r)
+{
+    switch (static_cast<TxnOp>(r.op))
+    {
+    case TxnOp::Transfer:
+        bank.transferFunds(r.a, r.b, r.c);
+        return;
+    case TxnOp::Freeze:
+        bank.freezeAccount(r.a);
+        return;
+    case TxnOp::Unfreeze:
+        bank.unfreezeAccount(r.a);
+        return;
+    case TxnOp::MassUpdate:
+        bank.massUpdate(r.a);
+        return;
+    case TxnOp::SetLimits:
+        bank.setLimits(static_cast<size_t>(r.a), r.b, r.c);
+        return;
+    }
+    throw std::runtime_error("unknown operation " + std::to_string(r.op));
+}
+
+TxnLog::TxnLog()
+    : fd_(-1), bank_(nullptr), replayed_(0), next_lsn_(0), durable_lsn_(0),
+      stop_(false), failed_(false), writer_(), writer_started_(false)
+{
+    pthread_mutex_init(&mtx_, nullptr);
+    pthread_cond_init(&work_cond_, nullptr);
+    pthread_cond_init(&durable_cond_, nullptr);
+}
+
+TxnLog::~TxnLog()
+{
+    close();
+    pthread_cond_destroy(&durable_cond_);
+    pthread_cond_destroy(&work_cond_);
+    pthread_mutex_destroy(&mtx_);
+}
+
+bool TxnLog::open(const std::string &path, Bank &bank, const TxnLogOptions &options,
+                  std::string &error, uint64_t applied_lsn)
+{
+    if (fd_ >= 0)
+    {
+        error = "TxnLog: already open";
+        return false;
+    }
+
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0)
+    {
+        error = sysError("open");
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+        error = sysError("fstat");
+        ::close(fd);
+        return false;
+    }
+
+    const uint64_t accounts = bank.getAccountCount();
+    uint64_t lsn = 0;
+    if (st.st_size == 0)
+    {
+        TxnLogHeader h;
+        std::memset(&h, 0, sizeof(h));
+        h.magic = TXN_LOG_MAGIC;
+        h.version = TXN_LOG_VERSION;
+        h.record_bytes = sizeof(TxnRecord);
+        h.account_count = accounts;
+        if (!writeAll(fd, reinterpret_cast<const char *>(&h), sizeof(h)) ||
+            fdatasync(fd) != 0 || !syncParentDir(path))
+        {
+            error = sysError("TxnLog: failed to create log");
+            ::close(fd);
+            return false;
+        }
+    }
+    else
+    {
+        TxnLogHeader h;
+        if (pread(fd, &h, sizeof(h), 0) != static_cast<ssize_t>(sizeof(h)) ||
+            h.magic != TXN_LOG_MAGIC)
+        {
+            error = "TxnLog: " + path + " is not a transaction log";
+            ::close(fd);
+            return false;
+        }
+        if (h.version != TXN_LOG_VERSION || h.record_bytes != sizeof(TxnRecord))
+        {
+            error = "TxnLog: unsupported log version " + std::to_string(h.version);
+            ::close(fd);
+            return false;
+        }
+        if (h.account_count != accounts)
+        {
+            error = "TxnLog: log was written for " + std::to_string(h.account_count) +
+                    " accounts, bank has " + std::to_string(accounts);
+            ::close(fd);
+            return false;
+        }
+
+        // Читаем крупными кусками; первая битая запись — конец журнала
+        std::vector<TxnRecord> chunk(32768);
+        off_t off = sizeof(TxnLogHeader);
+        bool torn = false;
+        while (!torn)
+        {
+            ssize_t n = pread(fd, chunk.data(), chunk.size() * sizeof(TxnRecord), off);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n < 0)
+            {
+                error = sysError("TxnLog: read");
+                ::close(fd);
+                return false;
+            }
+            size_t records = static_cast<size_t>(n) / sizeof(TxnRecord);
+            if (records == 0)
+                break;
+            for (size_t i = 0; i < records; ++i)
+            {
+                const TxnRecord &r = chunk[i];
+                if (r.lsn != lsn + 1 || r.crc != recordCrc(r))
+                {
+                    torn = true;
+                    break;
+                }
+                try
+                {
+                    if (r.lsn > applied_lsn)
+                        applyRecord(bank, r);
+                }
+                catch (const std::exception &ex)
+                {
+                    error = "TxnLog: replay failed at record " + std::to_string(r.lsn) +
+                            ": " + ex.what();
+                    ::close(fd);
+                    return false;
+                }
+                ++lsn;
+                off += sizeof(TxnRecord);
+            }
+        }
+
+        if (off < st.st_size && (ftruncate(fd, off) != 0 || fdatasync(fd) != 0))
+        {
+            error = sysError("TxnLog: failed to cut torn tail");
+            ::close(fd);
+            return false;
+        }
+    }
+    if (lsn < applied_lsn)
+    {
+        // Новые записи получили бы номера, которые снимок считает применёнными
+        error = "TxnLog: log ends at record " + std::to_string(lsn) +
+                ", older than the snapshot (record " + std::to_string(applied_lsn) + ")";
+        ::close(fd);
+        return false;
+    }
+
+    fd_ = fd;
+    bank_ = &bank;
+    options_ = options;
+    replayed_ = lsn - applied_lsn;
+    next_lsn_ = lsn;
+    durable_lsn_ = lsn;
+    stop_ = false;
+    failed_ = false;
+    failure_.clear();
+
+    if (options_.group_commit)
+    {
+        if (pthread_create(&writer_, nullptr, writerMain, this) != 0)
+        {
+            error = "TxnLog: failed to start writer thread";
+            ::close(fd_);
+            fd_ = -1;
+            bank_ = nullptr;
+            return false;
+        }
+        writer_started_ = true;
+    }
+    bank.setTxnLog(this);
+    return true;
+}
+
+void TxnLog::close()
+{
+    if (fd_ < 0)
+        return;
+    if (bank_)
+    {
+        bank_->setTxnLog(nullptr);
+        bank_ = nullptr;
+    }
+
+    pthread_mutex_lock(&mtx_);
+    stop_ = true;
+    pthread_cond_signal(&work_cond_);
+    pthread_mutex_unlock(&mtx_);
+    if (writer_started_)
+    {
+        pthread_join(writer_, nullptr);
+        writer_started_ = false;
+    }
+
+    ::close(fd_);
+    fd_ = -1;
+}
+
+uint64_t TxnLog::lastLsn()
+{
+    pthread_mutex_lock(&mtx_);
+    uint64_t lsn = next_lsn_;
+    pthread_mutex_unlock(&mtx_);
+    return lsn;
+}
+
+void TxnLog::appendLocked(TxnOp op, int32_t a, int32_t b, int32_t c)
+{
+    TxnRecord r;
+    std::memset(&r, 0, sizeof(r));
+    r.lsn = ++next_lsn_;
+    r.op = static_cast<uint8_t>(op);
+    r.a = a;
+    r.b = b;
+    r.c = c;
+    r.crc = recordCrc(r);
+    buf_.append(reinterpret_cast<const char *>(&r), sizeof(r));
+}
+
+// Режим без групповой фиксации: запись и fdatasync прямо в вызывающей нити
+bool TxnLog::flushLocked()
+{
+    if (failed_)
+        return false;
+    if (!writeAll(fd_, buf_.data(), buf_.size()) || fdatasync(fd_) != 0)
+    {
+        failed_ = true;
+        failure_ = sysError("write-ahead log");
+        return false;
+    }
+    buf_.clear();
+    durable_lsn_ = next_lsn_;
+    return true;
+}
+
+uint64_t TxnLog::append(TxnOp op, int32_t a, int32_t b, int32_t c)
+{
+    pthread_mutex_lock(&mtx_);
+    appendLocked(op, a, b, c);
+    uint64_t lsn = next_lsn_;
+    if (options_.group_commit)
+        pthread_cond_signal(&work_cond_);
+    else
+        flushLocked();
+    pthread_mutex_unlock(&mtx_);
+    return lsn;
+}
+
+uint64_t TxnLog::appendTransfers(const Transfer *items, const BankStatus *results, size_t count)
+{
+    pthread_mutex_lock(&mtx_);
+    uint64_t first = next_lsn_;
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (results[i] == BankStatus::Ok)
+            appendLocked(TxnOp::Transfer, items[i].from_id, items[i].to_id, items[i].amount);
+    }
+    uint64_t lsn = next_lsn_ != first ? next_lsn_ : 0;
+    if (lsn)
+    {
+        if (options_.group_commit)
+            pthread_cond_signal(&work_cond_);
+        else
+            flushLocked();
+    }
+    pthread_mutex_unlock(&mtx_);
+    return lsn;
+}
+
+void TxnLog::waitDurable(uint64_t lsn)
+{
+    pthread_mutex_lock(&mtx_);
+    while (durable_lsn_ < lsn && !failed_)
+    {
+        pthread_cond_wait(&durable_cond_, &mtx_);
+    }
+    bool durable = durable_lsn_ >= lsn;
+    std::string failure = failure_;
+    pthread_mutex_unlock(&mtx_);
+    if (!durable)
+    {
+        throw std::runtime_error("TxnLog: operation applied but not logged: " + failure);
+    }
+}
+
+void *TxnLog::writerMain(void *arg)
+{
+    static_cast<TxnLog *>(arg)->writerLoop();
+    return nullptr;
+}
+
+void TxnLog::writerLoop()
+{
+    std::string batch;
+    pthread_mutex_lock(&mtx_);
+    while (!failed_)
+    {
+        while (buf_.empty() && !stop_)
+        {
+            pthread_cond_wait(&work_cond_, &mtx_);
+        }
+        if (buf_.empty())
+            break; // stop_ и всё записано
+
+        if (options_.window_us && !stop_)
+        {
+            // Даём набраться попутчикам: одна пачка — один fdatasync
+            pthread_mutex_unlock(&mtx_);
+            usleep(options_.window_us);
+            pthread_mutex_lock(&mtx_);
+        }
+
+        batch.swap(buf_);
+        uint64_t upto = next_lsn_;
+        pthread_mutex_unlock(&mtx_);
+
+        bool ok = writeAll(fd_, batch.data(), batch.size()) && fdatasync(fd_) == 0;
+        std::string failure = ok ? std::string() : sysError("write-ahead log");
+        batch.clear();
+
+        pthread_mutex_lock(&mtx_);
+        if (ok)
+        {
+            durable_lsn_ = upto;
+        }
+        else
+        {
+            failed_ = true;
+            failure_ = failure;
+        }
+        pthread_cond_broadcast(&durable_cond_);
+    }
+    pthread_mutex_unlock(&mtx_);
+}
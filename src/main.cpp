@@ -1,58 +1,55 @@
 // main.cpp
 #include "Client.hpp"
 #include "Bank.hpp"
+#include "Segment.hpp"
 
-#include <sys/mman.h>   // mmap, PROT_*, MAP_*
-#include <fcntl.h>      // shm_open, O_CREAT, O_RDWR
-#include <unistd.h>     // close
 #include <iostream>
 #include <string>
 #include <cstdlib>      // std::stoul
-#include <cerrno>
-#include <cstring>
 
 int main(int argc, char** argv) {
-    if (argc < 3) {
-        std::cerr << "Usage: " << argv[0] << " <shm_name> <account_count>\n";
+    // --file: банк в обычном файле (initializer --file) вместо shared memory
+    bool file = argc >= 2 && std::string(argv[1]) == "--file";
+    if (file) {
+        --argc;
+        ++argv;
+    }
+    if (argc < 2) {
+        std::cerr << "Usage: client [--file] <shm_name|path> [account_count]\n";
         return 1;
     }
 
     std::string shm_name = argv[1];
-    size_t      N        = std::stoul(argv[2]);
 
-    // 1. Открываем сегмент shared memory
-    int shm_fd = shm_open(shm_name.c_str(), O_RDWR, 0666);
-    if (shm_fd < 0) {
-        std::cerr << "shm_open: " << std::strerror(errno) << "\n";
+    // 1. Подключаемся к сегменту: размеры и раскладка — из его заголовка
+    SegmentView seg;
+    std::string error;
+    if (!(file ? attachFileSegment(shm_name, seg, error)
+               : attachShmSegment(shm_name, seg, error))) {
+        std::cerr << shm_name << ": " << error << "\n";
         return 1;
     }
 
-    // 2. Мапим массив Account[N] из общего сегмента
-    void* ptr = mmap(nullptr,
-                     N * sizeof(Account),
-                     PROT_READ | PROT_WRITE,
-                     MAP_SHARED,
-                     shm_fd,
-                     0);
-    close(shm_fd);  // дескриптор больше не нужен
-
-    if (ptr == MAP_FAILED) {
-        std::cerr << "mmap: " << std::strerror(errno) << "\n";
+    // 2. Явно указанное число счетов — только для проверки совместимости
+    size_t N = seg.accountCount();
+    if (argc >= 3 && std::stoul(argv[2]) != N) {
+        std::cerr << shm_name << ": segment holds " << N
+                  << " accounts, expected " << argv[2] << "\n";
+        detachSegment(seg);
         return 1;
     }
 
-    // 3. Строим объект Bank на этом массиве
-    Account* accounts = static_cast<Account*>(ptr);
-    Bank bank(accounts, N);
-
-    // 4. Запускаем CLI
-    Client cli(bank);
-    cli.run();
-
-    // 5. Отмэпим память перед выходом
-    if (munmap(ptr, N * sizeof(Account)) < 0) {
-        std::cerr << "munmap: " << std::strerror(errno) << "\n";
+    // 3. Строим Bank на массиве и общей таблице блокировок и запускаем CLI
+    //    (Bank должен быть разрушен до отключения сегмента)
+    {
+        Bank bank(seg.accounts, N, seg.locks, &seg.header->account_count);
+        Client cli(bank);
+        cli.run();
     }
 
+    // 4. Сбрасываем файл на диск и отключаемся от сегмента перед выходом
+    if (file && !syncSegment(seg, error))
+        std::cerr << shm_name << ": " << error << "\n";
+    detachSegment(seg);
     return 0;
 }
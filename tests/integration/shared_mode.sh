@@ -16,7 +16,7 @@ MAX=1000
 "$BUILD_DIR/initializer" "$SHM_NAME" "$N" "$MAX"
 
 # 3) Прогоняем client (shared-memory) и сохраняем вывод
-"$BUILD_DIR/client" "$SHM_NAME" "$N" <<EOF > shared_out.txt
+"$BUILD_DIR/client" "$SHM_NAME" <<EOF > shared_out.txt
 show_account_list
 transfer 0 1 500
 show_balance 0
@@ -3,6 +3,20 @@
 #include <iostream>
 #include <stdexcept>
 #include <vector>
+#include <thread>
+#include <atomic>
+#include <random>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <cstdlib>
+#include "Segment.hpp"
+#include "MassUpdate.hpp"
+#include "TxnLog.hpp"
+#include "Snapshot.hpp"
+#include "ShardedBank.hpp"
+#include "Ledger.hpp"
 
 #define ASSERT_THROW(stmt, ex_type)      \
     do {                                 \
@@ -111,6 +125,155 @@ void test_mass_update() {
     delete[] accounts;
 }
 
+void test_mass_update_atomic() {
+    // Нарушитель в самом конце: ни один баланс не должен измениться
+    const size_t N = 1003;
+    std::vector<Account> accounts(N);
+    for (size_t i = 0; i < N; ++i) {
+        accounts[i].account_id  = static_cast<int>(i);
+        accounts[i].balance     = 100;
+        accounts[i].min_balance = 0;
+        accounts[i].max_balance = 1000;
+        accounts[i].frozen      = false;
+    }
+    accounts[N - 1].max_balance = 120;
+    Bank bank(accounts.data(), N);
+
+    ASSERT_THROW(bank.massUpdate(50), BankError);
+    for (size_t i = 0; i < N; ++i) {
+        assert(bank.getAccount(i).balance == 100);
+    }
+    bank.massUpdate(20);
+    for (size_t i = 0; i < N; ++i) {
+        assert(bank.getAccount(i).balance == 120);
+    }
+
+    // Переполнение int32 — тоже нарушение, а не заворот
+    for (size_t i = 0; i < N; ++i) {
+        accounts[i].max_balance = INT32_MAX;
+    }
+    accounts[7].balance = INT32_MAX - 5;
+    ASSERT_THROW(bank.massUpdate(INT32_MAX), BankError);
+    assert(bank.getAccount(7).balance == INT32_MAX - 5);
+}
+
+void test_mass_update_kernels() {
+    // Скалярный, AVX2 и многопоточный пути дают один и тот же ответ
+    const size_t N = 4099;
+    std::vector<Account> accounts(N);
+    std::mt19937 rng(7);
+    std::uniform_int_distribution<int32_t> dist(-1000, 1000);
+    for (size_t i = 0; i < N; ++i) {
+        int32_t a = dist(rng), b = dist(rng);
+        accounts[i].account_id  = static_cast<int>(i);
+        accounts[i].min_balance = std::min(a, b) - 2000;
+        accounts[i].max_balance = std::max(a, b) + 2000;
+        accounts[i].balance     = a;
+        accounts[i].frozen      = false;
+    }
+    const int32_t amounts[] = {0, 1, -1, 500, -500, 2500, -2500, INT32_MAX, INT32_MIN};
+    for (int32_t amount : amounts) {
+        size_t expect = massUpdateCheckScalar(accounts.data(), N, amount);
+        assert(massUpdateCheck(AccountStore(accounts.data()), N, amount, 1) == expect);
+        assert(massUpdateCheck(AccountStore(accounts.data()), N, amount, 4) == expect);
+        if (massUpdateHasAvx2()) {
+            assert(massUpdateCheckAvx2(accounts.data(), N, amount) == expect);
+        }
+    }
+
+    // Те же счета в колонках
+    ColumnBuffer columns(N);
+    for (size_t i = 0; i < N; ++i) {
+        columns.store().store(i, accounts[i]);
+    }
+    for (int32_t amount : amounts) {
+        size_t expect = massUpdateCheckScalar(accounts.data(), N, amount);
+        assert(massUpdateCheckScalar(columns.columns(), N, amount) == expect);
+        assert(massUpdateCheck(columns.store(), N, amount, 4) == expect);
+        if (massUpdateHasAvx2()) {
+            assert(massUpdateCheckAvx2(columns.columns(), N, amount) == expect);
+        }
+    }
+
+    // Баланс ниже минимума, который amount возвращает в лимиты, — не нарушение
+    {
+        std::vector<Account> out(16);
+        for (size_t i = 0; i < out.size(); ++i) {
+            out[i].account_id  = static_cast<int>(i);
+            out[i].min_balance = 0;
+            out[i].max_balance = 1000;
+            out[i].balance     = 0;
+        }
+        out[3].balance = -200;
+        ColumnBuffer out_columns(out.size());
+        for (size_t i = 0; i < out.size(); ++i) {
+            out_columns.store().store(i, out[i]);
+        }
+        assert(massUpdateCheckScalar(out.data(), out.size(), 300) == out.size());
+        assert(massUpdateCheckScalar(out_columns.columns(), out.size(), 300) == out.size());
+        if (massUpdateHasAvx2()) {
+            assert(massUpdateCheckAvx2(out.data(), out.size(), 300) == out.size());
+            assert(massUpdateCheckAvx2(out_columns.columns(), out.size(), 300) == out.size());
+        }
+        out[9].balance = 800; // Настоящий нарушитель во втором куске
+        assert(massUpdateCheckScalar(out.data(), out.size(), 300) == 9);
+        if (massUpdateHasAvx2()) {
+            assert(massUpdateCheckAvx2(out.data(), out.size(), 300) == 9);
+        }
+    }
+
+    std::vector<Account> expect = accounts;
+    massUpdateApplyScalar(expect.data(), N, -37);
+    massUpdateApply(AccountStore(accounts.data()), N, -37, 3);
+    massUpdateApply(columns.store(), N, -37, 3);
+    for (size_t i = 0; i < N; ++i) {
+        assert(accounts[i].balance == expect[i].balance);
+        assert(accounts[i].account_id == expect[i].account_id);
+        assert(accounts[i].max_balance == expect[i].max_balance);
+        assert(columns.columns().balances[i] == expect[i].balance);
+    }
+}
+
+void test_columns_layout() {
+    // Тот же API поверх колонок; разреженные ID и заморозка соседей по слову
+    const size_t N = 130;
+    ColumnBuffer columns(N);
+    AccountStore store = columns.store();
+    for (size_t i = 0; i < N; ++i) {
+        Account a;
+        a.account_id  = static_cast<int>(i * 3 + 1);
+        a.balance     = 100;
+        a.min_balance = 0;
+        a.max_balance = 1000;
+        a.frozen      = false;
+        store.store(i, a);
+    }
+    Bank bank(store, N);
+    assert(bank.layout() == AccountLayout::Columns);
+
+    bank.transferFunds(1, 4, 60);
+    assert(bank.getAccount(0).balance == 40 && bank.getAccount(1).balance == 160);
+    ASSERT_THROW(bank.transferFunds(1, 4, 60), BankError);
+    ASSERT_THROW(bank.transferFunds(2, 4, 1), BankError);
+
+    bank.freezeAccount(64 * 3 + 1);
+    bank.freezeAccount(65 * 3 + 1);
+    assert(bank.getAccount(64).frozen && bank.getAccount(65).frozen);
+    assert(!bank.getAccount(63).frozen && !bank.getAccount(66).frozen);
+    bank.unfreezeAccount(64 * 3 + 1);
+    assert(!bank.getAccount(64).frozen && bank.getAccount(65).frozen);
+    ASSERT_THROW(bank.transferFunds(65 * 3 + 1, 1, 1), BankError);
+
+    bank.setLimits(4, 150, 500);
+    assert(bank.getAccount(1).min_balance == 150 && bank.getAccount(1).max_balance == 500);
+
+    ASSERT_THROW(bank.massUpdate(-60), BankError); // счёт 1 упадёт ниже 0
+    assert(bank.getAccount(2).balance == 100);
+    bank.massUpdate(5);
+    assert(bank.getAccount(0).balance == 45 && bank.getAccount(N - 1).balance == 105);
+    assert(bank.getAccount(N - 1).account_id == static_cast<int>((N - 1) * 3 + 1));
+}
+
 void test_set_limits() {
     const size_t N = 2;
     Account* accounts = new Account[N];
@@ -134,13 +297,1022 @@ void test_set_limits() {
     delete[] accounts;
 }
 
+void test_try_operations() {
+    const size_t N = 3;
+    Account* accounts = new Account[N];
+    for (size_t i = 0; i < N; ++i) {
+        accounts[i].account_id  = static_cast<int>(i);
+        accounts[i].balance     = 100;
+        accounts[i].min_balance = 0;
+        accounts[i].max_balance = 250;
+        accounts[i].frozen      = false;
+    }
+    Bank bank(accounts, N);
+
+    // Отказы — кодом, счета не меняются
+    assert(bank.tryTransfer(0, 1, 0) == BankStatus::InvalidAmount);
+    assert(bank.tryTransfer(0, 7, 10) == BankStatus::AccountNotFound);
+    assert(bank.tryTransfer(0, 1, 101) == BankStatus::InsufficientFunds);
+    assert(bank.tryTransfer(0, 1, 100) == BankStatus::Ok);
+    assert(bank.tryTransfer(2, 1, 100) == BankStatus::ExceedsMaxBalance);
+    assert(bank.tryFreeze(9, true) == BankStatus::AccountNotFound);
+    assert(bank.tryFreeze(2, true) == BankStatus::Ok);
+    assert(bank.tryTransfer(2, 0, 1) == BankStatus::AccountFrozen);
+    assert(bank.tryFreeze(2, false) == BankStatus::Ok);
+    assert(bank.getAccount(0).balance == 0 && bank.getAccount(1).balance == 200);
+
+    int violator = -1;
+    assert(bank.tryMassUpdate(-1, &violator) == BankStatus::LimitViolation && violator == 0);
+    assert(bank.tryMassUpdate(50) == BankStatus::Ok);
+    assert(bank.getAccount(2).balance == 150);
+
+    int32_t balance = 0;
+    assert(bank.trySetLimits(1, 10, 5) == BankStatus::InvalidLimits);
+    assert(bank.trySetLimits(1, 0, 100, &balance) == BankStatus::InvalidLimits && balance == 250);
+    assert(bank.trySetLimits(5, 0, 100) == BankStatus::AccountNotFound);
+    assert(bank.trySetLimits(1, 0, 250) == BankStatus::Ok);
+    assert(bank.getAccount(1).max_balance == 250);
+
+    // Бросающие методы — обёртки с тем же кодом
+    try {
+        bank.transferFunds(0, 1, 1000);
+        assert(false);
+    } catch (const BankError& ex) {
+        assert(ex.status() == BankStatus::InsufficientFunds);
+        assert(std::string(ex.what()) == bankStatusMessage(BankStatus::InsufficientFunds));
+    }
+    ASSERT_THROW(bank.massUpdate(-100), BankError);
+    ASSERT_THROW(bank.unfreezeAccount(42), BankError);
+
+    delete[] accounts;
+}
+
+void test_sparse_ids() {
+    const size_t N = 1000;
+    Account* accounts = new Account[N];
+    for (size_t i = 0; i < N; ++i) {
+        // разреженные и не упорядоченные ID
+        accounts[i].account_id  = static_cast<int>((N - i) * 7919);
+        accounts[i].balance     = 100;
+        accounts[i].min_balance = 0;
+        accounts[i].max_balance = 1000;
+        accounts[i].frozen      = false;
+    }
+    Bank bank(accounts, N);
+
+    bank.transferFunds(7919, 2 * 7919, 40);
+    assert(bank.getAccount(N - 1).balance == 60);
+    assert(bank.getAccount(N - 2).balance == 140);
+
+    bank.freezeAccount(static_cast<int>(N * 7919));
+    assert(bank.getAccount(0).frozen);
+
+    ASSERT_THROW(bank.transferFunds(1, 7919, 10), std::runtime_error);
+    ASSERT_THROW(bank.freezeAccount(-7919), std::runtime_error);
+
+    delete[] accounts;
+}
+
+void test_transfer_batch() {
+    const size_t N = 4;
+    Account* accounts = new Account[N];
+    for (size_t i = 0; i < N; ++i) {
+        accounts[i].account_id  = static_cast<int>(i);
+        accounts[i].balance     = 100;
+        accounts[i].min_balance = 0;
+        accounts[i].max_balance = 300;
+        accounts[i].frozen      = false;
+    }
+    Bank bank(accounts, N);
+    bank.freezeAccount(3);
+
+    // Элементы видят результат предыдущих: 1 получает 100 и тут же отдаёт 200
+    Transfer items[] = {
+        {0, 1, 100},
+        {1, 2, 200},
+        {0, 2, 1},    // у 0 больше нет средств
+        {2, 3, 10},   // 3 заморожен
+        {2, 7, 10},   // нет такого счёта
+        {2, 0, -5},   // некорректная сумма
+        {2, 0, 50},
+    };
+    const size_t K = sizeof(items) / sizeof(items[0]);
+    BankStatus results[K];
+    assert(bank.transferBatch(items, K, results) == 3);
+    assert(results[0] == BankStatus::Ok && results[1] == BankStatus::Ok);
+    assert(results[2] == BankStatus::InsufficientFunds);
+    assert(results[3] == BankStatus::AccountFrozen);
+    assert(results[4] == BankStatus::AccountNotFound);
+    assert(results[5] == BankStatus::InvalidAmount);
+    assert(results[6] == BankStatus::Ok);
+    assert(bank.getAccount(0).balance == 50);
+    assert(bank.getAccount(1).balance == 0);
+    assert(bank.getAccount(2).balance == 250);
+
+    // Атомарный пакет: ошибка в середине откатывает уже применённое
+    Transfer atomic_items[] = {{2, 0, 100}, {0, 1, 120}, {1, 2, 500}};
+    BankStatus atomic_results[3];
+    assert(bank.transferBatch(atomic_items, 3, atomic_results, true) == 0);
+    assert(atomic_results[0] == BankStatus::BatchAborted);
+    assert(atomic_results[1] == BankStatus::BatchAborted);
+    assert(atomic_results[2] == BankStatus::InsufficientFunds);
+    assert(bank.getAccount(0).balance == 50);
+    assert(bank.getAccount(1).balance == 0);
+    assert(bank.getAccount(2).balance == 250);
+
+    atomic_items[2].amount = 20;
+    assert(bank.transferBatch(atomic_items, 3, atomic_results, true) == 3);
+    assert(bank.getAccount(0).balance == 30);
+    assert(bank.getAccount(1).balance == 100);
+    assert(bank.getAccount(2).balance == 170);
+
+    delete[] accounts;
+}
+
+void test_concurrent_transfers() {
+    const size_t N = 64;
+    const int THREADS = 16;
+    const int OPS_PER_THREAD = 20000;
+    Account* accounts = new Account[N];
+    for (size_t i = 0; i < N; ++i) {
+        accounts[i].account_id  = static_cast<int>(i);
+        accounts[i].balance     = 1000;
+        accounts[i].min_balance = 0;
+        accounts[i].max_balance = 1000000;
+        accounts[i].frozen      = false;
+    }
+    const int64_t expected_total = static_cast<int64_t>(N) * 1000;
+    // Мало полос, чтобы переводы часто попадали в одну и ту же полосу
+    Bank bank(accounts, N, 8);
+
+    std::vector<std::thread> workers;
+    for (int t = 0; t < THREADS; ++t) {
+        workers.emplace_back([&bank, t]() {
+            std::mt19937 rng(static_cast<unsigned>(t) * 7919u + 1u);
+            std::uniform_int_distribution<int> pick(0, static_cast<int>(N) - 1);
+            std::uniform_int_distribution<int32_t> amount(1, 300);
+            for (int i = 0; i < OPS_PER_THREAD; ++i) {
+                int from = pick(rng);
+                int to = pick(rng);
+                try {
+                    bank.transferFunds(from, to, amount(rng));
+                } catch (const std::runtime_error&) {
+                    // нехватка средств — ожидаемый исход части переводов
+                }
+            }
+        });
+    }
+    for (auto& w : workers) w.join();
+
+    int64_t total = 0;
+    for (size_t i = 0; i < N; ++i) {
+        const Account& a = bank.getAccount(i);
+        assert(a.balance >= a.min_balance && a.balance <= a.max_balance);
+        total += a.balance;
+    }
+    assert(total == expected_total && "sum of balances is preserved");
+
+    delete[] accounts;
+}
+
+void test_seqlock_reads() {
+    // Писатель меняет лимиты счёта между двумя парами; читатель без
+    // блокировок не должен увидеть их смесь или баланс вне лимитов
+    for (AccountLayout layout : {AccountLayout::Rows, AccountLayout::Columns}) {
+        const size_t N = 64;
+        std::vector<Account> rows(N);
+        ColumnBuffer columns(N);
+        AccountStore store = layout == AccountLayout::Rows ? AccountStore(rows.data())
+                                                           : columns.store();
+        for (size_t i = 0; i < N; ++i) {
+            store.store(i, Account{static_cast<int>(i), 550, 0, 1000, false});
+        }
+        Bank bank(store, N);
+
+        std::atomic<bool> stop{false};
+        std::thread limits([&]() {
+            for (int i = 0; !stop.load(std::memory_order_relaxed); ++i) {
+                if (i % 2)
+                    bank.setLimits(0, 0, 1000);
+                else
+                    bank.setLimits(0, 500, 600);
+            }
+        });
+        std::thread transfers([&]() {
+            while (!stop.load(std::memory_order_relaxed)) {
+                bank.transferFunds(1, 2, 1);
+                bank.transferFunds(2, 1, 1);
+            }
+        });
+        for (int i = 0; i < 1000000; ++i) {
+            Account a = bank.getAccount(0);
+            assert((a.min_balance == 0 && a.max_balance == 1000) ||
+                   (a.min_balance == 500 && a.max_balance == 600));
+            assert(a.balance == 550 && a.account_id == 0);
+            Account b = bank.getAccount(1);
+            assert(b.balance == 550 || b.balance == 549);
+        }
+        stop = true;
+        limits.join();
+        transfers.join();
+    }
+}
+
+void test_shared_lock_recovery() {
+    const size_t N = 4;
+    const size_t bytes = segmentBytes(N);
+    void* mem = mmap(nullptr, bytes, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    assert(mem != MAP_FAILED);
+    SegmentView seg;
+    std::string error;
+    assert(formatSegment(mem, bytes, N, N, 1000, error));
+    assert(bindSegment(mem, bytes, seg, error));
+    LockTable* locks = seg.locks;
+    Account* accounts = seg.accounts.rows();
+    for (size_t i = 0; i < N; ++i) {
+        accounts[i].balance = 100;
+    }
+
+    // Дочерний процесс начинает перевод 0 -> 1 и погибает, успев
+    // списать деньги, но не зачислив их и не зафиксировав транзакцию
+    pid_t pid = fork();
+    assert(pid >= 0);
+    if (pid == 0) {
+        LockStripe* st = locks->stripes();
+        pthread_mutex_lock(&st[0].mtx);
+        pthread_mutex_lock(&st[1].mtx);
+        TxnUndo rec = {};
+        rec.lo_stripe = 0;
+        rec.txn = ++st[0].txn_seq;
+        rec.slot[0] = 0;
+        rec.slot[1] = 1;
+        rec.old_balance[0] = accounts[0].balance;
+        rec.old_balance[1] = accounts[1].balance;
+        rec.state = TxnUndo::PENDING;
+        st[0].undo = rec;
+        st[1].undo = rec;
+        ++st[0].seq; // Секции записи seqlock так и остаются открытыми
+        ++st[1].seq;
+        accounts[0].balance -= 70;
+        _exit(0);
+    }
+    int status = 0;
+    waitpid(pid, &status, 0);
+
+    {
+        Bank bank(accounts, N, locks);
+        // Читатель не зависает на нечётном seq: берёт мьютекс и запускает откат
+        assert(bank.getAccount(0).balance == 100);
+        // Захват полосы 1 получает EOWNERDEAD и откатывает перевод целиком
+        bank.freezeAccount(1);
+        assert(bank.getAccount(0).balance == 100 && "debit rolled back");
+        assert(bank.getAccount(1).balance == 100);
+        bank.unfreezeAccount(1);
+
+        // Полоса 0 тоже восстановлена и снова пригодна к работе
+        bank.transferFunds(0, 1, 30);
+        assert(bank.getAccount(0).balance == 70);
+        assert(bank.getAccount(1).balance == 130);
+
+        // Атомарный пакет журнал не откатит целиком — он отклоняется,
+        // обычный пакет журналирует каждый перевод и выполняется
+        Transfer items[] = {{0, 2, 10}, {3, 1, 10}};
+        BankStatus results[2];
+        assert(bank.transferBatch(items, 2, results, true) == 0);
+        assert(results[0] == BankStatus::Unsupported && results[1] == BankStatus::Unsupported);
+        assert(bank.getAccount(0).balance == 70 && bank.getAccount(2).balance == 100);
+        assert(bank.transferBatch(items, 2, results, false) == 2);
+        assert(bank.getAccount(0).balance == 60 && bank.getAccount(1).balance == 140);
+
+        // Общую таблицу меняют и другие процессы — единственным писателем не стать
+        ASSERT_THROW(Ledger ledger(bank), std::invalid_argument);
+    }
+
+    lockTableDestroy(locks);
+    munmap(mem, bytes);
+}
+
+void test_batch_lock_failure() {
+    const size_t N = 4;
+    const size_t bytes = segmentBytes(N);
+    void* mem = mmap(nullptr, bytes, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    assert(mem != MAP_FAILED);
+    SegmentView seg;
+    std::string error;
+    assert(formatSegment(mem, bytes, N, N, 1000, error));
+    assert(bindSegment(mem, bytes, seg, error));
+    LockStripe* st = seg.locks->stripes();
+    Account* accounts = seg.accounts.rows();
+    for (size_t i = 0; i < N; ++i) {
+        accounts[i].balance = 100;
+    }
+
+    // Владелец полосы 1 погибает, а следующий владелец не объявляет её
+    // согласованной: мьютекс навсегда ENOTRECOVERABLE
+    pid_t pid = fork();
+    assert(pid >= 0);
+    if (pid == 0) {
+        pthread_mutex_lock(&st[1].mtx);
+        _exit(0);
+    }
+    int status = 0;
+    waitpid(pid, &status, 0);
+    assert(pthread_mutex_lock(&st[1].mtx) == EOWNERDEAD);
+    pthread_mutex_unlock(&st[1].mtx);
+
+    {
+        Bank bank(accounts, N, seg.locks);
+        // Полосы 0 и 1 в одном слове: 0 захвачена, на 1 — исключение
+        Transfer items[] = {{0, 2, 10}, {1, 3, 10}};
+        BankStatus results[2];
+        ASSERT_THROW(bank.transferBatch(items, 2, results, false), std::runtime_error);
+        // Захваченная полоса 0 отпущена
+        assert(pthread_mutex_trylock(&st[0].mtx) == 0);
+        pthread_mutex_unlock(&st[0].mtx);
+        assert(bank.getAccount(0).balance == 100);
+    }
+
+    lockTableDestroy(seg.locks);
+    munmap(mem, bytes);
+}
+
+void test_segment_header() {
+    const size_t N = 3, CAP = 8;
+    const size_t bytes = segmentBytes(CAP);
+    void* mem = mmap(nullptr, bytes, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    assert(mem != MAP_FAILED);
+    std::string error;
+    SegmentView seg;
+    assert(formatSegment(mem, bytes, N, CAP, 500, error));
+    assert(bindSegment(mem, bytes, seg, error));
+    assert(seg.accountCount() == N && seg.header->capacity == CAP);
+
+    {
+        Bank bank(seg.accounts, seg.accountCount(), seg.locks, &seg.header->account_count);
+        ASSERT_THROW(bank.freezeAccount(4), std::runtime_error);
+
+        // Добавление счетов в резерв видно уже работающему Bank
+        assert(appendAccounts(seg, 2, 500, error));
+        bank.freezeAccount(4);
+        assert(bank.getAccountCount() == 5);
+        assert(bank.getAccount(4).frozen);
+
+        assert(!appendAccounts(seg, 4, 500, error) && "capacity exceeded");
+        assert(seg.accountCount() == 5);
+    }
+
+    // Несовместимые сегменты отклоняются
+    SegmentView other;
+    seg.header->record_stride += 4;
+    assert(!bindSegment(mem, bytes, other, error));
+    seg.header->record_stride -= 4;
+    seg.header->version = SEGMENT_VERSION + 1;
+    assert(!bindSegment(mem, bytes, other, error));
+    seg.header->version = SEGMENT_VERSION;
+    seg.header->magic = 0;
+    assert(!bindSegment(mem, bytes, other, error));
+
+    munmap(mem, bytes);
+
+    // Колоночный сегмент: флаг в заголовке, тот же Bank поверх
+    const size_t cbytes = segmentBytes(CAP, AccountLayout::Columns);
+    mem = mmap(nullptr, cbytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    assert(mem != MAP_FAILED);
+    assert(formatSegment(mem, cbytes, N, CAP, 500, error, AccountLayout::Columns));
+    assert(bindSegment(mem, cbytes, seg, error));
+    assert(seg.header->flags & SEGMENT_COLUMNAR);
+    assert(seg.accounts.layout() == AccountLayout::Columns);
+    {
+        Bank bank(seg.accounts, seg.accountCount(), seg.locks, &seg.header->account_count);
+        assert(appendAccounts(seg, 5, 500, error));
+        bank.freezeAccount(7);
+        assert(bank.getAccountCount() == CAP);
+        assert(bank.getAccount(7).frozen && bank.getAccount(7).max_balance == 500);
+    }
+    munmap(mem, cbytes);
+}
+
+void test_txn_log() {
+    const size_t N = 4;
+    char path[] = "/tmp/tbank_wal_XXXXXX";
+    int tmp = mkstemp(path);
+    assert(tmp >= 0);
+    close(tmp);
+
+    auto fresh = [](std::vector<Account>& accounts) {
+        for (size_t i = 0; i < accounts.size(); ++i) {
+            accounts[i].account_id  = static_cast<int>(i);
+            accounts[i].balance     = 100;
+            accounts[i].min_balance = 0;
+            accounts[i].max_balance = 1000;
+            accounts[i].frozen      = false;
+        }
+    };
+    std::string error;
+
+    // Групповая фиксация: 7 успешных операций, неудачные в журнал не попадают
+    {
+        std::vector<Account> accounts(N);
+        fresh(accounts);
+        Bank bank(accounts.data(), N);
+        TxnLog log;
+        assert(log.open(path, bank, TxnLogOptions(), error));
+        assert(log.replayed() == 0);
+
+        bank.transferFunds(0, 1, 30);
+        ASSERT_THROW(bank.transferFunds(0, 1, 500), BankError);
+        bank.freezeAccount(2);
+        bank.unfreezeAccount(2);
+        bank.freezeAccount(3);
+        bank.massUpdate(5);
+        bank.setLimits(1, 10, 900);
+        Transfer batch[] = {{1, 2, 20}, {3, 0, 1}};
+        BankStatus results[2];
+        assert(bank.transferBatch(batch, 2, results) == 1); // счёт 3 заморожен
+    }
+
+    // Воспроизведение и дозапись с fdatasync на каждую операцию
+    {
+        std::vector<Account> accounts(N);
+        fresh(accounts);
+        Bank bank(accounts.data(), N);
+        TxnLog log;
+        TxnLogOptions options;
+        options.group_commit = false;
+        assert(log.open(path, bank, options, error));
+        assert(log.replayed() == 7);
+        assert(accounts[0].balance == 75 && accounts[1].balance == 115);
+        assert(accounts[2].balance == 125 && accounts[3].balance == 105);
+        assert(accounts[3].frozen && !accounts[2].frozen);
+        assert(accounts[1].min_balance == 10 && accounts[1].max_balance == 900);
+        bank.unfreezeAccount(3);
+    }
+
+    // Обрыв посреди записи отрезается, целые записи воспроизводятся
+    int fd = open(path, O_WRONLY | O_APPEND);
+    assert(fd >= 0);
+    const char garbage[13] = {1, 2, 3};
+    assert(write(fd, garbage, sizeof(garbage)) == static_cast<ssize_t>(sizeof(garbage)));
+    close(fd);
+    {
+        std::vector<Account> accounts(N);
+        fresh(accounts);
+        Bank bank(accounts.data(), N);
+        TxnLog log;
+        assert(log.open(path, bank, TxnLogOptions(), error));
+        assert(log.replayed() == 8);
+        assert(!accounts[3].frozen && accounts[2].balance == 125);
+        bank.transferFunds(3, 0, 5);
+        log.close();
+        assert(log.replayed() == 8);
+    }
+    {
+        std::vector<Account> accounts(N);
+        fresh(accounts);
+        Bank bank(accounts.data(), N);
+        TxnLog log;
+        assert(log.open(path, bank, TxnLogOptions(), error));
+        assert(log.replayed() == 9 && accounts[0].balance == 80);
+    }
+
+    // Журнал банка другого размера не подходит
+    {
+        std::vector<Account> accounts(N + 1);
+        fresh(accounts);
+        Bank bank(accounts.data(), N + 1);
+        TxnLog log;
+        assert(!log.open(path, bank, TxnLogOptions(), error));
+    }
+    unlink(path);
+}
+
+void test_snapshot() {
+    const size_t N = 100;
+    char wal[] = "/tmp/tbank_snap_wal_XXXXXX";
+    char snap[] = "/tmp/tbank_snap_XXXXXX";
+    int tmp = mkstemp(wal);
+    assert(tmp >= 0);
+    close(tmp);
+    tmp = mkstemp(snap);
+    assert(tmp >= 0);
+    close(tmp);
+
+    auto fresh = [](std::vector<Account>& accounts) {
+        for (size_t i = 0; i < accounts.size(); ++i) {
+            accounts[i].account_id  = static_cast<int>(i);
+            accounts[i].balance     = 100;
+            accounts[i].min_balance = 0;
+            accounts[i].max_balance = 1000;
+            accounts[i].frozen      = false;
+        }
+    };
+    std::string error;
+    SnapshotHeader header;
+    assert(!readSnapshotHeader(snap, header, error) && "empty file is not a snapshot");
+
+    // Снимок через fork посреди журнала: при восстановлении журнал догоняет снимок
+    std::vector<Account> expect(N);
+    {
+        std::vector<Account> accounts(N);
+        fresh(accounts);
+        Bank bank(accounts.data(), N);
+        TxnLog log;
+        assert(log.open(wal, bank, TxnLogOptions(), error));
+        bank.transferFunds(0, 1, 40);
+        bank.freezeAccount(7);
+        SnapshotTiming timing;
+        assert(forkSnapshot(bank, snap, &log, error, &timing));
+        assert(timing.total_ms >= timing.pause_ms);
+        bank.transferFunds(1, 2, 15);
+        bank.massUpdate(3);
+        bank.unfreezeAccount(7);
+        expect = accounts;
+    }
+    assert(readSnapshotHeader(snap, header, error));
+    assert(header.account_count == N && header.log_lsn == 2);
+    {
+        std::vector<Account> accounts(N);
+        assert(loadSnapshot(snap, header, AccountStore(accounts.data()), error));
+        assert(accounts[0].balance == 60 && accounts[1].balance == 140 && accounts[7].frozen);
+        Bank bank(accounts.data(), N);
+        TxnLog log;
+        assert(log.open(wal, bank, TxnLogOptions(), error, header.log_lsn));
+        assert(log.replayed() == 3);
+        for (size_t i = 0; i < N; ++i) {
+            assert(accounts[i].balance == expect[i].balance);
+            assert(accounts[i].frozen == expect[i].frozen);
+        }
+    }
+    {
+        // Журнал короче снимка — его дозапись выдала бы уже занятые номера
+        std::vector<Account> accounts(N);
+        fresh(accounts);
+        Bank bank(accounts.data(), N);
+        unlink(wal);
+        TxnLog log;
+        assert(!log.open(wal, bank, TxnLogOptions(), error, header.log_lsn));
+    }
+
+    // Сегмент в колонках с запасом ёмкости: снимок копируется прямо из общей памяти
+    const size_t CAP = 160;
+    const size_t bytes = segmentBytes(CAP, AccountLayout::Columns);
+    void* mem = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    assert(mem != MAP_FAILED);
+    SegmentView seg;
+    assert(formatSegment(mem, bytes, N, CAP, 500, error, AccountLayout::Columns));
+    assert(bindSegment(mem, bytes, seg, error));
+    {
+        Bank bank(seg.accounts, seg.accountCount(), seg.locks, &seg.header->account_count);
+        bank.massUpdate(10);
+        bank.transferFunds(99, 64, 5);
+        bank.freezeAccount(65);
+        assert(dumpSnapshot(bank, snap, error));
+    }
+    munmap(mem, bytes);
+
+    assert(readSnapshotHeader(snap, header, error));
+    assert(header.layout == static_cast<uint32_t>(AccountLayout::Columns));
+    std::vector<Account> rows(N);
+    assert(!loadSnapshot(snap, header, AccountStore(rows.data()), error) && "layout mismatch");
+    ColumnBuffer columns(N);
+    assert(loadSnapshot(snap, header, columns.store(), error));
+    {
+        Bank bank(columns.store(), N);
+        assert(bank.getAccount(64).balance == 15 && bank.getAccount(99).balance == 5);
+        assert(bank.getAccount(65).frozen && !bank.getAccount(64).frozen);
+        assert(bank.getAccount(42).balance == 10 && bank.getAccount(42).max_balance == 500);
+    }
+
+    // Обрезанный файл отклоняется
+    assert(truncate(snap, sizeof(SnapshotHeader) + header.payload_bytes - 1) == 0);
+    assert(!readSnapshotHeader(snap, header, error));
+    unlink(snap);
+    unlink(wal);
+}
+
+void test_file_segment() {
+    char path[] = "/tmp/tbank_file_XXXXXX";
+    int tmp = mkstemp(path);
+    assert(tmp >= 0);
+    close(tmp);
+
+    std::string error;
+    SegmentView seg;
+    assert(createFileSegment(path, 4, 8, 1000, seg, error));
+    assert(seg.fd >= 0 && seg.header->capacity == 8);
+    {
+        Bank bank(seg.accounts, seg.accountCount(), seg.locks, &seg.header->account_count);
+        bank.massUpdate(100);
+        bank.transferFunds(0, 1, 40);
+        bank.freezeAccount(3);
+    }
+    assert(appendAccounts(seg, 2, 1000, error));
+
+    // Пока файл подключён, другой процесс подключается, но пересоздать его не может
+    pid_t pid = fork();
+    assert(pid >= 0);
+    if (pid == 0) {
+        SegmentView other;
+        std::string err;
+        bool ok = attachFileSegment(path, other, err) && other.accountCount() == 6 &&
+                  !createFileSegment(path, 4, 4, 10, seg, err);
+        _exit(ok ? 0 : 1);
+    }
+    int status = 0;
+    waitpid(pid, &status, 0);
+    assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    assert(syncSegment(seg, error));
+    detachSegment(seg);
+    assert(seg.fd == -1 && seg.base == nullptr);
+
+    // Процесс погибает посреди перевода 0 -> 1, держа мьютексы полос
+    pid = fork();
+    assert(pid >= 0);
+    if (pid == 0) {
+        SegmentView crashed;
+        std::string err;
+        if (!attachFileSegment(path, crashed, err))
+            _exit(1);
+        LockStripe* st = crashed.locks->stripes();
+        pthread_mutex_lock(&st[0].mtx);
+        pthread_mutex_lock(&st[1].mtx);
+        TxnUndo rec = {};
+        rec.lo_stripe = 0;
+        rec.txn = ++st[0].txn_seq;
+        rec.slot[0] = 0;
+        rec.slot[1] = 1;
+        rec.old_balance[0] = crashed.accounts.balance(0);
+        rec.old_balance[1] = crashed.accounts.balance(1);
+        rec.state = TxnUndo::PENDING;
+        st[0].undo = rec;
+        st[1].undo = rec;
+        crashed.accounts.balance(0) -= 50;
+        _exit(0);
+    }
+    waitpid(pid, &status, 0);
+    assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+    // Холодный старт: состояние взято из файла, перевод откатан, блокировки новые
+    assert(attachFileSegment(path, seg, error));
+    assert(seg.accountCount() == 6);
+    {
+        Bank bank(seg.accounts, seg.accountCount(), seg.locks, &seg.header->account_count);
+        assert(bank.getAccount(0).balance == 60 && "debit rolled back");
+        assert(bank.getAccount(1).balance == 140);
+        assert(bank.getAccount(3).frozen);
+        assert(bank.getAccount(5).balance == 0);
+        bank.transferFunds(1, 5, 40);
+        assert(bank.getAccount(5).balance == 40);
+    }
+    detachSegment(seg);
+
+    unlink(path);
+    assert(!attachFileSegment(path, seg, error) && "missing file");
+}
+
+void test_read_view() {
+    const size_t N = 8;
+    std::vector<Account> accounts(N);
+    for (size_t i = 0; i < N; ++i) {
+        accounts[i] = Account{static_cast<int>(i), 100, 0, 1000, false};
+    }
+    Bank bank(accounts.data(), N);
+    {
+        // Изменения после открытия среза в нём не видны
+        Bank::ReadView view(bank);
+        bank.transferFunds(0, 1, 30);
+        bank.freezeAccount(2);
+        bank.setLimits(3, 50, 500);
+        bank.massUpdate(5);
+        assert(view.count() == N && view.totalBalance() == 800);
+        assert(view.get(0).balance == 100 && view.get(1).balance == 100);
+        assert(!view.get(2).frozen && view.get(3).max_balance == 1000);
+        assert(bank.getAccount(0).balance == 75 && bank.getAccount(2).frozen);
+
+        std::vector<Account> page;
+        assert(view.page(6, 10, page) == 2 && page[1].account_id == 7);
+        assert(view.page(N, 10, page) == 0 && page.size() == 2);
+        ASSERT_THROW(view.get(N), std::out_of_range);
+
+        Bank::ReadView later(bank);
+        assert(later.totalBalance() == 840 && later.get(1).balance == 135);
+    }
+
+    // Переводы не меняют сумму: каждый срез под нагрузкой видит ровно её
+    std::atomic<bool> stop{false};
+    std::thread writer([&]() {
+        std::mt19937 rng(7);
+        std::uniform_int_distribution<int> pick(0, static_cast<int>(N - 1));
+        while (!stop.load(std::memory_order_relaxed)) {
+            try {
+                bank.transferFunds(pick(rng), pick(rng), 7);
+            } catch (const BankError&) {
+            }
+        }
+    });
+    for (int i = 0; i < 2000; ++i) {
+        Bank::ReadView view(bank);
+        assert(view.totalBalance() == 840);
+    }
+    stop = true;
+    writer.join();
+
+    // Срез диапазона слотов: страницы сохранённых значений — по первому изменению
+    {
+        const size_t M = 3 * Bank::ReadView::PAGE;
+        std::vector<Account> many(M);
+        for (size_t i = 0; i < M; ++i) {
+            many[i] = Account{static_cast<int>(i), 100, 0, 1000, false};
+        }
+        Bank wide(many.data(), M);
+        const size_t first = Bank::ReadView::PAGE - 24;
+        Bank::ReadView range(wide, first, Bank::ReadView::PAGE + 48);
+        assert(range.first() == first && range.count() == Bank::ReadView::PAGE + 48);
+        wide.transferFunds(static_cast<int>(first), 0, 40);
+        wide.transferFunds(static_cast<int>(first + range.count() - 1), 1, 60);
+        wide.transferFunds(2, 3, 10);
+        assert(range.get(first).balance == 100 && range.get(first + range.count() - 1).balance == 100);
+        assert(range.totalBalance() == 100 * static_cast<int64_t>(range.count()));
+        ASSERT_THROW(range.get(first - 1), std::out_of_range);
+        ASSERT_THROW(range.get(first + range.count()), std::out_of_range);
+        std::vector<Account> page;
+        assert(range.page(0, 10, page) == 0 && range.page(first + range.count() - 2, 10, page) == 2);
+
+        Bank::ReadView tail(wide, M - 5, 100);
+        assert(tail.count() == 5);
+        Bank::ReadView none(wide, M + 10);
+        assert(none.count() == 0 && none.totalBalance() == 0);
+    }
+
+    // Общая таблица полос: срез копирует счета сразу
+    const size_t bytes = segmentBytes(N);
+    void* mem = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    assert(mem != MAP_FAILED);
+    SegmentView seg;
+    std::string error;
+    assert(formatSegment(mem, bytes, N, N, 1000, error) && bindSegment(mem, bytes, seg, error));
+    {
+        Bank shared(seg.accounts, N, seg.locks, &seg.header->account_count);
+        shared.massUpdate(10);
+        Bank::ReadView view(shared);
+        shared.transferFunds(0, 1, 10);
+        assert(view.get(0).balance == 10 && view.totalBalance() == 80);
+        Bank::ReadView part(shared, 1, 3);
+        assert(part.count() == 3 && part.get(1).balance == 20 && part.totalBalance() == 40);
+    }
+    lockTableDestroy(seg.locks);
+    munmap(mem, bytes);
+}
+
+void test_sharded_bank() {
+    const size_t N = 12;
+    std::vector<Account> init(N);
+    for (size_t i = 0; i < N; ++i) {
+        init[i].account_id  = static_cast<int>(i);
+        init[i].balance     = 100;
+        init[i].min_balance = 0;
+        init[i].max_balance = 200;
+        init[i].frozen      = false;
+    }
+    // Без привязки к ядрам: тест не должен зависеть от числа CPU
+    ShardedBank bank(init.data(), N, 3, false);
+    assert(bank.shardCount() == 3 && bank.getAccountCount() == N);
+    assert(bank.shardOf(4) == 1 && bank.shardOf(7) == 1 && bank.shardOf(5) == 2);
+
+    Account a;
+    // Внутри шарда (1 → 4) и между шардами (0 → 5) — те же коды, что у Bank
+    assert(bank.tryTransfer(1, 4, 0) == BankStatus::InvalidAmount);
+    assert(bank.tryTransfer(1, 4, 30) == BankStatus::Ok);
+    assert(bank.tryTransfer(0, 5, 40) == BankStatus::Ok);
+    assert(bank.getAccount(0, a) == BankStatus::Ok && a.balance == 60);
+    assert(bank.getAccount(5, a) == BankStatus::Ok && a.balance == 140);
+    assert(bank.getAccount(42, a) == BankStatus::AccountNotFound);
+    assert(bank.tryTransfer(0, 42, 1) == BankStatus::AccountNotFound);
+    assert(bank.tryTransfer(42, 0, 1) == BankStatus::AccountNotFound);
+    assert(bank.tryTransfer(0, 5, 61) == BankStatus::InsufficientFunds);
+    assert(bank.tryTransfer(3, 5, 61) == BankStatus::ExceedsMaxBalance);
+    // Отказ второго шарда снимает резерв первого: сумма снова доступна целиком
+    assert(bank.tryTransfer(3, 8, 100) == BankStatus::Ok);
+    assert(bank.tryFreeze(5, true) == BankStatus::Ok);
+    assert(bank.tryTransfer(0, 5, 1) == BankStatus::AccountFrozen);
+    assert(bank.tryFreeze(5, false) == BankStatus::Ok);
+    assert(bank.getAccount(3, a) == BankStatus::Ok && a.balance == 0);
+
+    int32_t balance = 0;
+    assert(bank.trySetLimits(1, 10, 5) == BankStatus::InvalidLimits);
+    assert(bank.trySetLimits(1, 0, 50, &balance) == BankStatus::InvalidLimits && balance == 70);
+    assert(bank.trySetLimits(1, 0, 300) == BankStatus::Ok);
+
+    int violator = -1;
+    assert(bank.tryMassUpdate(-1, &violator) == BankStatus::LimitViolation && violator == 3);
+    assert(bank.tryMassUpdate(10, &violator) == BankStatus::LimitViolation && violator == 8);
+    assert(bank.tryTransfer(8, 3, 50) == BankStatus::Ok);
+    assert(bank.tryMassUpdate(10) == BankStatus::Ok);
+    std::vector<Account> rows;
+    assert(bank.snapshot(rows) == static_cast<int64_t>(N) * 100 + static_cast<int64_t>(N) * 10);
+    assert(rows.size() == N);
+
+    // Атомарный пакет через шарды: отказ последнего элемента откатывает всё
+    Transfer items[3] = {{1, 2, 5}, {2, 3, 5}, {3, 4, 1000}};
+    BankStatus results[3];
+    assert(bank.transferBatch(items, 3, results, true) == 0);
+    assert(results[0] == BankStatus::BatchAborted && results[2] == BankStatus::InsufficientFunds);
+    assert(bank.getAccount(1, a) == BankStatus::Ok && a.balance == 80);
+    items[2].amount = 5;
+    assert(bank.transferBatch(items, 3, results, true) == 3);
+    assert(bank.getAccount(1, a) == BankStatus::Ok && a.balance == 75);
+    assert(bank.getAccount(4, a) == BankStatus::Ok && a.balance == 145);
+}
+
+void test_sharded_concurrent_transfers() {
+    const size_t N = 64;
+    const int THREADS = 8;
+    const int OPS_PER_THREAD = 5000;
+    std::vector<Account> init(N);
+    for (size_t i = 0; i < N; ++i) {
+        init[i].account_id  = static_cast<int>(i);
+        init[i].balance     = 1000;
+        init[i].min_balance = 0;
+        init[i].max_balance = 2000;
+        init[i].frozen      = false;
+    }
+    const int64_t expected_total = static_cast<int64_t>(N) * 1000;
+    ShardedBank bank(init.data(), N, 4, false);
+
+    // Переводы (в основном между шардами) идут вперемешку с согласованными
+    // суммами и massUpdate: ни один срез не видит перевод наполовину
+    std::atomic<bool> done{false};
+    std::thread reader([&]() {
+        while (!done.load()) {
+            int64_t total = bank.totalBalance();
+            assert((total - expected_total) % static_cast<int64_t>(N) == 0);
+        }
+    });
+    std::vector<std::thread> workers;
+    for (int t = 0; t < THREADS; ++t) {
+        workers.emplace_back([&bank, t]() {
+            std::mt19937 rng(static_cast<unsigned>(t) * 7919u + 1u);
+            std::uniform_int_distribution<int> pick(0, static_cast<int>(N) - 1);
+            std::uniform_int_distribution<int32_t> amount(1, 500);
+            for (int i = 0; i < OPS_PER_THREAD; ++i) {
+                BankStatus st = bank.tryTransfer(pick(rng), pick(rng), amount(rng));
+                assert(st == BankStatus::Ok || st == BankStatus::InsufficientFunds ||
+                       st == BankStatus::ExceedsMaxBalance);
+                if (t == 0 && i % 1000 == 0) {
+                    // +1 и -1 по очереди: сумма возвращается к исходной
+                    bank.tryMassUpdate(i % 2000 == 0 ? 1 : -1);
+                }
+            }
+        });
+    }
+    for (auto& w : workers) w.join();
+    done = true;
+    reader.join();
+
+    std::vector<Account> rows;
+    int64_t total = bank.snapshot(rows);
+    for (const Account& a : rows)
+        assert(a.balance >= a.min_balance && a.balance <= a.max_balance);
+    assert((total - expected_total) % static_cast<int64_t>(N) == 0 && "sum of balances is preserved");
+}
+
+void test_ledger() {
+    const size_t N = 16;
+    const int THREADS = 8;
+    const int OPS_PER_THREAD = 5000;
+    Account* accounts = new Account[N];
+    for (size_t i = 0; i < N; ++i) {
+        accounts[i].account_id  = static_cast<int>(i);
+        accounts[i].balance     = 1000;
+        accounts[i].min_balance = 0;
+        accounts[i].max_balance = 1000000;
+        accounts[i].frozen      = false;
+    }
+    Bank bank(accounts, N);
+    {
+        // Маленькое кольцо: производители упираются в полную очередь
+        Ledger ledger(bank, 8);
+
+        // Коды отказа — как у Bank
+        assert(ledger.tryTransfer(0, 1, 0) == BankStatus::InvalidAmount);
+        assert(ledger.tryTransfer(0, 99, 1) == BankStatus::AccountNotFound);
+        assert(ledger.tryTransfer(0, 1, 5000) == BankStatus::InsufficientFunds);
+        assert(ledger.tryFreeze(1, true) == BankStatus::Ok);
+        assert(ledger.tryTransfer(0, 1, 1) == BankStatus::AccountFrozen);
+        assert(ledger.tryFreeze(1, false) == BankStatus::Ok);
+        int violator = -1;
+        assert(ledger.tryMassUpdate(-1001, &violator) == BankStatus::LimitViolation && violator == 0);
+        int32_t balance = 0;
+        assert(ledger.trySetLimits(2, 0, 10, &balance) == BankStatus::InvalidLimits && balance == 1000);
+        Transfer items[2] = {{2, 3, 10}, {3, 2, 5000}};
+        BankStatus results[2];
+        assert(ledger.transferBatch(items, 2, results, true) == 0);
+        assert(results[0] == BankStatus::BatchAborted && results[1] == BankStatus::InsufficientFunds);
+        const uint64_t before = ledger.applied();
+        assert(before == 9);
+
+        // Все переводят на счёт 0: ни одного потерянного или лишнего перевода
+        std::vector<std::thread> workers;
+        for (int t = 0; t < THREADS; ++t) {
+            workers.emplace_back([&ledger, t]() {
+                const int from = 1 + t;
+                for (int i = 0; i < OPS_PER_THREAD; ++i)
+                    assert(ledger.tryTransfer(from, 0, i < 1000 ? 1 : 0) ==
+                           (i < 1000 ? BankStatus::Ok : BankStatus::InvalidAmount));
+            });
+        }
+        for (auto& w : workers) w.join();
+        assert(ledger.applied() == before + static_cast<uint64_t>(THREADS) * OPS_PER_THREAD);
+    }
+    assert(bank.getAccount(0).balance == 1000 + THREADS * 1000);
+    for (int t = 0; t < THREADS; ++t)
+        assert(bank.getAccount(static_cast<size_t>(1 + t)).balance == 0);
+
+    // С журналом: записи в порядке применения, fdatasync ждут вызывающие.
+    // Срезы останавливают писателя между заявками и видят неизменную сумму
+    char path[] = "/tmp/tbank_ledger_XXXXXX";
+    int tmp = mkstemp(path);
+    assert(tmp >= 0);
+    close(tmp);
+    const int LOGGED_OPS = 300;
+    std::vector<Account> logged(accounts, accounts + N);
+    for (Account& a : logged) a.balance = 1000;
+    std::vector<Account> replayed = logged;
+    std::string error;
+    {
+        Bank wal_bank(logged.data(), N);
+        TxnLog log;
+        assert(log.open(path, wal_bank, TxnLogOptions(), error));
+        {
+            Ledger ledger(wal_bank, 8);
+            std::atomic<bool> stop{false};
+            std::thread auditor([&]() {
+                while (!stop.load()) {
+                    Bank::ReadView view(wal_bank);
+                    assert(view.totalBalance() == 1000 * static_cast<int64_t>(N));
+                }
+            });
+            std::vector<std::thread> writers;
+            for (int t = 0; t < THREADS; ++t) {
+                writers.emplace_back([&ledger, t]() {
+                    for (int i = 0; i < LOGGED_OPS; ++i)
+                        assert(ledger.tryTransfer(1 + t, (i % 2) ? 0 : 15, 1) == BankStatus::Ok);
+                });
+            }
+            for (auto& w : writers) w.join();
+            stop = true;
+            auditor.join();
+            assert(ledger.tryMassUpdate(1) == BankStatus::Ok);
+            assert(ledger.tryFreeze(3, true) == BankStatus::Ok);
+            assert(ledger.trySetLimits(2, 0, 5000) == BankStatus::Ok);
+        }
+        log.close();
+    }
+    {
+        Bank again(replayed.data(), N);
+        TxnLog log;
+        assert(log.open(path, again, TxnLogOptions(), error));
+        assert(log.replayed() == static_cast<uint64_t>(THREADS) * LOGGED_OPS + 3);
+        for (size_t i = 0; i < N; ++i) {
+            assert(replayed[i].balance == logged[i].balance);
+            assert(replayed[i].frozen == logged[i].frozen);
+            assert(replayed[i].max_balance == logged[i].max_balance);
+        }
+        assert(logged[0].balance == 1000 + THREADS * LOGGED_OPS / 2 + 1 && logged[3].frozen);
+    }
+    unlink(path);
+
+    delete[] accounts;
+}
+
 int main() {
     std::cout << "Running Bank unit tests...\n";
     test_initialization();
     test_transfer_and_limits();
     test_freeze();
     test_mass_update();
+    test_mass_update_atomic();
+    test_mass_update_kernels();
+    test_columns_layout();
     test_set_limits();
+    test_try_operations();
+    test_sparse_ids();
+    test_transfer_batch();
+    test_concurrent_transfers();
+    test_seqlock_reads();
+    test_read_view();
+    test_sharded_bank();
+    test_sharded_concurrent_transfers();
+    test_ledger();
+    test_shared_lock_recovery();
+    test_batch_lock_failure();
+    test_segment_header();
+    test_file_segment();
+    test_txn_log();
+    test_snapshot();
     std::cout << "All tests passed successfully.\n";
     return 0;
 }
@@ -0,0 +1,684 @@
+#include "Session.hpp"
+#include "BinaryProtocol.hpp"
+#include "Commands.hpp"
+#include "ShardedBank.hpp"
+#include "Ledger.hpp"
+#include "Stats.hpp"
+#include "Metrics.hpp"
+#include "Trace.hpp"
+#include "ServerCore.hpp"
+#include "EventLoop.hpp"
+#include <arpa/inet.h>
+#include <cassert>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+static std::string drain(Session& s) {
+    std::string out(s.outData(), s.outSize());
+    s.consume(s.outSize());
+    return out;
+}
+
+static void feedStr(Session& s, const char* str) {
+    s.feed(str, std::strlen(str));
+}
+
+static void initAccounts(Account* accounts, size_t N) {
+    for (size_t i = 0; i < N; ++i) {
+        accounts[i].account_id  = static_cast<int>(i);
+        accounts[i].balance     = 100;
+        accounts[i].min_balance = 0;
+        accounts[i].max_balance = 1000;
+        accounts[i].frozen      = false;
+    }
+}
+
+void test_pipelined_commands() {
+    Account accounts[3];
+    initAccounts(accounts, 3);
+    Bank bank(accounts, 3);
+    Session s(bank);
+
+    s.start();
+    assert(drain(s).compare(0, 16, "Welcome To TBANK") == 0);
+
+    // Несколько команд в одной порции — каждая получает свой ответ
+    feedStr(s, "transfer 0 1 10\nshow_balance 0\r\nshow_balance 1\n");
+    assert(drain(s) == "OK: transferred 10\n"
+                       "Account 0 balance: 90\n"
+                       "Account 1 balance: 110\n");
+}
+
+void test_transfer_batch_command() {
+    Account accounts[3];
+    initAccounts(accounts, 3);
+    Bank bank(accounts, 3);
+    Session s(bank);
+
+    feedStr(s, "transfer_batch 0 1 50 1 2 500 2 0 30\n");
+    assert(drain(s) == "OK: batch applied 2 of 3\n"
+                       "  #1: InsufficientFunds\n");
+
+    feedStr(s, "transfer_batch atomic 0 1 10 1 2 5000\n");
+    assert(drain(s) == "OK: batch applied 0 of 2\n"
+                       "  #0: BatchAborted\n"
+                       "  #1: InsufficientFunds\n");
+
+    feedStr(s, "transfer_batch 0 1\n");
+    assert(drain(s).compare(0, 6, "Usage:") == 0);
+}
+
+void test_split_command() {
+    Account accounts[2];
+    initAccounts(accounts, 2);
+    Bank bank(accounts, 2);
+    Session s(bank);
+
+    // Команда, разрезанная между порциями, выполняется один раз целиком
+    feedStr(s, "free");
+    assert(s.outSize() == 0);
+    feedStr(s, "ze 1\nshow_bal");
+    assert(drain(s) == "OK: account 1 frozen\n");
+    feedStr(s, "ance 1\n");
+    assert(drain(s) == "Account 1 balance: 100\n");
+
+    // Хвост без '\n' выполняется при закрытии соединения
+    feedStr(s, "unfreeze 1");
+    assert(s.outSize() == 0);
+    s.finish();
+    assert(drain(s) == "OK: account 1 unfrozen\n");
+    assert(s.closing());
+}
+
+void test_set_limits_command() {
+    Account accounts[2];
+    initAccounts(accounts, 2);
+    Bank bank(accounts, 2);
+    Session s(bank);
+
+    // Отказ по коду, но текст — подробный, как у Bank::setLimits
+    feedStr(s, "set_limits 1 10 5\nset_limits 1 0 50\nset_limits 7 0 50\nset_limits 1 50 500\n");
+    assert(drain(s) == "Error: setLimits: newMin (10) cannot be greater than newMax (5)\n"
+                       "Error: setLimits: current balance (100) is outside the new limits [0,50]\n"
+                       "Error: Bank: account ID not found\n"
+                       "OK: limits set for account 1\n");
+    assert(bank.getAccount(1).min_balance == 50);
+}
+
+void test_session_drain() {
+    Account accounts[2];
+    initAccounts(accounts, 2);
+    Bank bank(accounts, 2);
+    Session s(bank);
+
+    // При остановке сервера дочитанная строка выполняется, оборванная — нет
+    feedStr(s, "transfer 0 1 10\ntransfer 0 1 5");
+    s.drain();
+    assert(s.closing());
+    assert(drain(s).compare(0, 3, "OK:") == 0);
+    assert(bank.getAccount(0).balance == 90);
+    assert(bank.getAccount(1).balance == 110);
+}
+
+void test_overlong_line() {
+    Account accounts[1];
+    initAccounts(accounts, 1);
+    Bank bank(accounts, 1);
+    Session s(bank);
+
+    std::string junk(Session::MAX_LINE + 1, 'x');
+    s.feed(junk.data(), junk.size());
+    assert(s.closing());
+    assert(drain(s) == "Error: line too long\n");
+}
+
+void test_input_bound() {
+    const size_t N = 20000;
+    std::vector<Account> accounts(N);
+    initAccounts(accounts.data(), N);
+    Bank bank(accounts.data(), N);
+
+    // Пока листинг не отправлен, ввод не нужен; после — снова нужен
+    Session s(bank);
+    assert(s.wantsInput());
+    feedStr(s, "show_account_list\n");
+    assert(!s.wantsInput());
+    while (s.outSize() > 0)
+        drain(s);
+    assert(s.wantsInput() && !s.closing());
+
+    // Клиент шлёт команды, не читая листинг: буфер не растёт сверх MAX_INPUT
+    feedStr(s, "show_account_list\n");
+    const std::string cmd = "show_balance 1\n";
+    std::string flood;
+    while (flood.size() < Session::MAX_LINE / 2)
+        flood += cmd;
+    for (size_t fed = 0; fed <= Session::MAX_INPUT && !s.closing(); fed += flood.size())
+        s.feed(flood.data(), flood.size());
+    assert(s.closing());
+    std::string out;
+    while (s.outSize() > 0)
+        out += drain(s);
+    assert(out.find("19999 |         100 |") != std::string::npos);
+    assert(out.find("Account 1 balance") == std::string::npos);
+
+    // Неотправленные ответы сверх MAX_PENDING_OUT тоже останавливают ввод
+    Session t(bank);
+    while (t.wantsInput())
+        t.feed(flood.data(), flood.size());
+    assert(!t.closing() && t.outSize() > Session::MAX_PENDING_OUT);
+    drain(t);
+    assert(t.wantsInput());
+}
+
+void test_binary_protocol() {
+    Account accounts[2];
+    initAccounts(accounts, 2);
+    Bank bank(accounts, 2);
+    Session s(bank);
+    s.start();
+    drain(s); // текстовое приветствие уже ушло до выбора протокола
+
+    // Рукопожатие и два запроса в одной порции, второй — разрезан
+    char wire[1 + 2 * BIN_REQUEST_SIZE];
+    wire[0] = static_cast<char>(BIN_HANDSHAKE);
+    BinRequest transfer = {BinOp::Transfer, 7, 0, 1, 30};
+    BinRequest overdraft = {BinOp::Transfer, 8, 0, 1, 500};
+    binEncodeRequest(transfer, wire + 1);
+    binEncodeRequest(overdraft, wire + 1 + BIN_REQUEST_SIZE);
+    s.feed(wire, 1 + BIN_REQUEST_SIZE + 5);
+    s.feed(wire + 1 + BIN_REQUEST_SIZE + 5, BIN_REQUEST_SIZE - 5);
+
+    std::string out = drain(s);
+    assert(out.size() == BIN_ACK_SIZE + 2 * BIN_RESPONSE_SIZE);
+    assert(out.compare(0, 4, std::string(BIN_ACK_MAGIC, 4)) == 0);
+
+    BinResponse r;
+    binDecodeResponse(out.data() + BIN_ACK_SIZE, r);
+    assert(r.seq == 7 && r.status == static_cast<uint8_t>(BankStatus::Ok));
+    binDecodeResponse(out.data() + BIN_ACK_SIZE + BIN_RESPONSE_SIZE, r);
+    assert(r.seq == 8 && r.status == static_cast<uint8_t>(BankStatus::InsufficientFunds));
+
+    // Пакетный перевод одним кадром
+    std::string batch;
+    Transfer items[] = {{1, 0, 10}, {0, 1, 1000}};
+    binEncodeBatch(11, items, 2, false, batch);
+    s.feed(batch.data(), batch.size());
+    out = drain(s);
+    assert(out.size() == BIN_BATCH_HEADER_SIZE + 2);
+    assert(binGet32(out.data() + 4) == 11);
+    assert(binGet32(out.data() + 8) == 1);
+    assert(out[BIN_BATCH_HEADER_SIZE] == static_cast<char>(BankStatus::Ok));
+    assert(out[BIN_BATCH_HEADER_SIZE + 1] == static_cast<char>(BankStatus::InsufficientFunds));
+
+    // Запрос состояния счёта и неизвестный ID
+    char req[BIN_REQUEST_SIZE];
+    BinRequest query = {BinOp::Query, 9, 1, 0, 0};
+    binEncodeRequest(query, req);
+    s.feed(req, sizeof(req));
+    out = drain(s);
+    binDecodeResponse(out.data(), r);
+    assert(r.status == 0 && r.balance == 120 && r.max_balance == 1000 && r.frozen == 0);
+
+    query.a = 42;
+    binEncodeRequest(query, req);
+    s.feed(req, sizeof(req));
+    out = drain(s);
+    binDecodeResponse(out.data(), r);
+    assert(r.status == static_cast<uint8_t>(BankStatus::AccountNotFound));
+
+    // Кадр с испорченной длиной закрывает соединение
+    binPut16(req, 3);
+    s.feed(req, sizeof(req));
+    out = drain(s);
+    binDecodeResponse(out.data(), r);
+    assert(r.status == BIN_BAD_FRAME);
+    assert(s.closing());
+}
+
+void test_query_by_id() {
+    // show_* и бинарный Query адресуют счёт по ID, а не по номеру слота
+    Account accounts[3];
+    initAccounts(accounts, 3);
+    for (size_t i = 0; i < 3; ++i)
+        accounts[i].account_id = static_cast<int>(i * 10 + 5);
+    accounts[1].balance = 70;
+    Bank bank(accounts, 3);
+    Session s(bank);
+
+    feedStr(s, "show_balance 15\nshow_max 25\nshow_balance 1\n");
+    assert(drain(s) == "Account 15 balance: 70\n"
+                       "Account 25 max balance: 1000\n"
+                       "Error: Bank: account ID not found\n");
+
+    BinResponse r;
+    BinRequest query = {BinOp::Query, 1, 15, 0, 0};
+    binExecute(bank, query, r);
+    assert(r.status == static_cast<uint8_t>(BankStatus::Ok) && r.balance == 70);
+    query.a = 2;
+    binExecute(bank, query, r);
+    assert(r.status == static_cast<uint8_t>(BankStatus::AccountNotFound));
+}
+
+void test_account_list_paging() {
+    Account accounts[4];
+    initAccounts(accounts, 4);
+    Bank bank(accounts, 4);
+    Session s(bank);
+
+    feedStr(s, "show_account_list 1 2\n");
+    assert(drain(s) == " ID |   Balance   |    Min    |    Max    | Frozen\n"
+                       "----+-------------+-----------+-----------+--------\n"
+                       "  1 |         100 |         0 |      1000 | false\n"
+                       "  2 |         100 |         0 |      1000 | false\n"
+                       "Listed 2 of 4 accounts from 1, total balance: 400\n");
+
+    feedStr(s, "show_account_list 10\ntotal_balance\n");
+    std::string out = drain(s);
+    assert(out.find("Listed 0 of 4 accounts from 10") != std::string::npos);
+    assert(out.find("Total balance: 400 (4 accounts)\n") != std::string::npos);
+}
+
+void test_account_list_streaming() {
+    const size_t N = 20000;
+    std::vector<Account> accounts(N);
+    initAccounts(accounts.data(), N);
+    Bank bank(accounts.data(), N);
+    Session s(bank);
+
+    // Листинг приходит порциями; команда за ним ждёт его конца
+    feedStr(s, "show_account_list\nshow_balance 7\n");
+    std::string out;
+    size_t chunks = 0;
+    while (s.outSize() > 0) {
+        assert(s.outSize() < AccountListing::CHUNK + 4096);
+        out += drain(s);
+        ++chunks;
+    }
+    assert(chunks > 1);
+    // Без аргументов — только таблица, как и раньше
+    const size_t last = out.find("19999 |         100 |");
+    assert(last != std::string::npos && out.find("Listed") == std::string::npos);
+    assert(out.find("Account 7 balance: 100\n") > last);
+
+    // С аргументами — итоговая строка
+    feedStr(s, "show_account_list 0\n");
+    out.clear();
+    while (s.outSize() > 0)
+        out += drain(s);
+    assert(out.find("Listed 20000 of 20000 accounts from 0, total balance: 2000000\n") != std::string::npos);
+
+    // Фильтры, затем offset/limit по прошедшим фильтр строкам
+    bank.freezeAccount(3);
+    bank.freezeAccount(5);
+    bank.transferFunds(9, 8, 50);
+    feedStr(s, "show_account_list 1 5 frozen\n");
+    out = drain(s);
+    assert(out.find("  5 |         100 |         0 |      1000 | true\n") != std::string::npos);
+    assert(out.find("  3 |") == std::string::npos);
+    assert(out.find("Listed 1 of 20000 accounts from 1") != std::string::npos);
+
+    feedStr(s, "show_account_list balance 120 1000\n");
+    out = drain(s);
+    assert(out.find("  8 |         150 |") != std::string::npos);
+    assert(out.find("Listed 1 of 20000") != std::string::npos);
+
+    feedStr(s, "show_account_list 1 2 3\nshow_account_list balance 5 1\n");
+    out = drain(s);
+    assert(out == "Usage: show_account_list [offset [limit]] [frozen] [balance <lo> <hi>]\n"
+                  "Usage: show_account_list [offset [limit]] [frozen] [balance <lo> <hi>]\n");
+
+    // Клиент закрыл поток посреди листинга: хвост выполняется после него
+    feedStr(s, "show_account_list\nshow_balance 8");
+    s.finish();
+    assert(!s.closing());
+    out.clear();
+    while (s.outSize() > 0)
+        out += drain(s);
+    assert(s.closing());
+    assert(out.find("Account 8 balance: 150\n") > out.find("19999 |"));
+}
+
+void test_sharded_session() {
+    Account accounts[5];
+    initAccounts(accounts, 5);
+    ShardedBank bank(accounts, 5, 2, false);
+    Session s(bank);
+
+    // Те же команды и ответы, что над Bank; перевод 0 → 1 идёт между шардами
+    feedStr(s, "transfer 0 1 10\nshow_balance 1\nshow_balance 9\nmass_update -91\n"
+               "show_account_list 3\ntotal_balance\n");
+    assert(drain(s) == "OK: transferred 10\n"
+                       "Account 1 balance: 110\n"
+                       "Error: Bank: account ID not found\n"
+                       "Error: massUpdate: balance of account 0 would violate limits\n"
+                       " ID |   Balance   |    Min    |    Max    | Frozen\n"
+                       "----+-------------+-----------+-----------+--------\n"
+                       "  3 |         100 |         0 |      1000 | false\n"
+                       "  4 |         100 |         0 |      1000 | false\n"
+                       "Listed 2 of 5 accounts from 3, total balance: 500\n"
+                       "Total balance: 500 (5 accounts)\n");
+
+    // Бинарный Query адресует счёт по ID
+    char wire[1 + BIN_REQUEST_SIZE];
+    wire[0] = static_cast<char>(BIN_HANDSHAKE);
+    BinRequest query = {BinOp::Query, 3, 0, 0, 0};
+    binEncodeRequest(query, wire + 1);
+    Session b(bank);
+    b.feed(wire, sizeof(wire));
+    std::string out = drain(b);
+    BinResponse r;
+    binDecodeResponse(out.data() + BIN_ACK_SIZE, r);
+    assert(r.seq == 3 && r.status == 0 && r.balance == 90);
+}
+
+void test_ledger_session() {
+    Account accounts[3];
+    initAccounts(accounts, 3);
+    Bank bank(accounts, 3);
+    Ledger ledger(bank);
+    Session s(ledger);
+
+    // Изменения идут через нить ledger, чтения — прямо из Bank
+    feedStr(s, "transfer 0 1 10\nfreeze 2\ntransfer 1 2 5\nshow_balance 1\ntotal_balance\n");
+    assert(drain(s) == "OK: transferred 10\n"
+                       "OK: account 2 frozen\n"
+                       "Error: transferFunds: one of the accounts is frozen\n"
+                       "Account 1 balance: 110\n"
+                       "Total balance: 300 (3 accounts)\n");
+    assert(ledger.applied() == 3);
+}
+
+void test_stats_command() {
+    Account accounts[3];
+    initAccounts(accounts, 3);
+    Bank bank(accounts, 3);
+    Session s(bank);
+
+    // Счётчики общие на процесс — сверяем приращения
+    StatsSummary before, after;
+    statsCollect(before);
+    feedStr(s, "transfer 0 1 10\ntransfer 0 1 5000\nbogus\nshow_balance 0\nshow_min\n");
+    drain(s);
+    BinRequest req = BinRequest();
+    BinResponse resp;
+    req.op = BinOp::Query;
+    req.a = 1;
+    binExecute(bank, req, resp);
+    req.op = BinOp::Ping;
+    binExecute(bank, req, resp);
+    statsCollect(after);
+
+    const size_t transfer = static_cast<size_t>(CommandId::Transfer);
+    const size_t show = static_cast<size_t>(CommandId::ShowBalance);
+    const size_t show_min = static_cast<size_t>(CommandId::ShowMin);
+    assert(after.ok[transfer] - before.ok[transfer] == 1);
+    assert(after.rejected[transfer] - before.rejected[transfer] == 1);
+    assert(after.rejected[0] - before.rejected[0] == 1);
+    assert(after.ok[show] - before.ok[show] == 2); // текстовый и бинарный
+    assert(after.rejected[show_min] - before.rejected[show_min] == 1); // Usage
+    const size_t funds = static_cast<size_t>(BankStatus::InsufficientFunds);
+    assert(after.reasons[funds] - before.reasons[funds] == 1);
+    assert(after.reasons[STATS_USAGE] - before.reasons[STATS_USAGE] == 1);
+    assert(after.reasons[STATS_UNKNOWN] - before.reasons[STATS_UNKNOWN] == 1);
+    assert(after.bytes_in - before.bytes_in == 64);
+    assert(after.total() - before.total() == 6);   // Ping не учитывается
+    assert(after.percentile(0.5) <= after.percentile(0.99));
+    assert(after.percentile(0.99) <= after.percentile(0.999));
+
+    feedStr(s, "stats\n");
+    std::string out = drain(s);
+    assert(out.compare(0, 10, "Requests: ") == 0);
+    assert(out.find("\nLatency ns: p50 ") != std::string::npos);
+    assert(out.find("\n  transfer: ") != std::string::npos);
+    assert(out.find("\n  unknown: ") != std::string::npos);
+    assert(out.find("\n  rejected InsufficientFunds: ") != std::string::npos);
+    assert(out.find("\nConnections: active ") != std::string::npos);
+}
+
+void test_metrics_page() {
+    Account accounts[3];
+    initAccounts(accounts, 3);
+    Bank bank(accounts, 3);
+    Ledger ledger(bank);
+    Session s(ledger);
+    feedStr(s, "transfer 0 1 10\nfreeze 9\n");
+    drain(s);
+
+    MetricsSources sources;
+    sources.ledger = &ledger;
+    std::string page;
+    appendMetrics(page, sources);
+    assert(page.compare(0, 7, "# HELP ") == 0);
+    assert(page.find("\ntbank_requests_total{command=\"transfer\",result=\"ok\"} ") != std::string::npos);
+    assert(page.find("\ntbank_rejections_total{reason=\"AccountNotFound\"} ") != std::string::npos);
+    assert(page.find("\ntbank_request_duration_seconds_bucket{le=\"+Inf\"} ") != std::string::npos);
+    assert(page.find("\ntbank_queue_depth{queue=\"ledger\"} 0\n") != std::string::npos);
+    assert(page.find("\ntbank_ledger_applied_total 2\n") != std::string::npos);
+    assert(page[page.size() - 1] == '\n');
+}
+
+void test_trace_dump() {
+    Account accounts[3];
+    initAccounts(accounts, 3);
+    Bank bank(accounts, 3);
+    Session s(bank);
+
+    traceEnable(16);
+    feedStr(s, "transfer 0 1 10\n");
+    drain(s);
+    trace_enabled.store(false);
+
+    std::string json;
+    traceDump(json);
+    assert(json.compare(0, 2, "{\"") == 0 && json.compare(json.size() - 4, 4, "\n]}\n") == 0);
+    assert(json.find("{\"name\":\"parse\",\"cat\":\"transfer\",\"ph\":\"X\"") != std::string::npos);
+    assert(json.find("{\"name\":\"lock\",") != std::string::npos);
+    assert(json.find("{\"name\":\"apply\",\"cat\":\"transfer\"") != std::string::npos);
+
+    // Выключенная трассировка не пишет ничего
+    std::string again;
+    feedStr(s, "transfer 0 1 10\n");
+    drain(s);
+    traceDump(again);
+    assert(again == json);
+}
+
+void test_stats_buckets() {
+    // Точные корзины до 16 нс, дальше погрешность не больше 1/8
+    for (uint64_t v = 0; v < 16; ++v)
+        assert(statsBucketLimit(statsBucket(v)) == v);
+    size_t prev = 0;
+    for (uint64_t v = 16; v < (uint64_t(1) << 40); v += v / 7 + 1) {
+        size_t b = statsBucket(v);
+        assert(b >= prev && b < STATS_BUCKETS);
+        assert(statsBucketLimit(b) >= v && statsBucketLimit(b) <= v + v / 8);
+        assert(b == 16 || statsBucketLimit(b - 1) < v);
+        prev = b;
+    }
+    assert(statsBucket(UINT64_MAX) == STATS_BUCKETS - 1);
+    assert(statsBucketLimit(STATS_BUCKETS - 1) == UINT64_MAX);
+}
+
+static Token tok(const char* s) {
+    Token t;
+    t.data = s;
+    t.size = std::strlen(s);
+    return t;
+}
+
+void test_reject_busy() {
+    StatsSummary before;
+    statsCollect(before);
+
+    int fds[2];
+    assert(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+    rejectBusy(fds[0]); // Закрывает свой конец
+    char buf[128];
+    ssize_t n = recv(fds[1], buf, sizeof(buf), 0);
+    assert(n == static_cast<ssize_t>(std::strlen(BUSY_REPLY)));
+    assert(std::string(buf, static_cast<size_t>(n)) == BUSY_REPLY);
+    assert(recv(fds[1], buf, sizeof(buf), 0) == 0);
+    close(fds[1]);
+
+    StatsSummary after;
+    statsCollect(after);
+    assert(after.connections_busy - before.connections_busy == 1);
+    assert(after.connections == before.connections); // В открытые не входит
+
+    std::string page;
+    appendMetrics(page, MetricsSources());
+    assert(page.find("tbank_connections_rejected_total{reason=\"busy\"} ") != std::string::npos);
+    std::string stats;
+    appendStats(stats);
+    assert(stats.find(", busy ") != std::string::npos);
+}
+
+void test_command_parser() {
+    int32_t v = 0;
+    assert(parseInt32(tok("123"), v) && v == 123);
+    assert(parseInt32(tok("-5"), v) && v == -5);
+    assert(parseInt32(tok("+7"), v) && v == 7);
+    assert(parseInt32(tok("2147483647"), v) && v == INT32_MAX);
+    assert(parseInt32(tok("-2147483648"), v) && v == INT32_MIN);
+    assert(!parseInt32(tok("2147483648"), v));
+    assert(!parseInt32(tok("-2147483649"), v));
+    assert(!parseInt32(tok("99999999999999999999"), v));
+    assert(!parseInt32(tok("12a"), v));
+    assert(!parseInt32(tok("-"), v));
+    assert(!parseInt32(tok(""), v));
+    size_t n = 0;
+    assert(parseCount(tok("18446744073"), n) && n == 18446744073ull);
+    assert(!parseCount(tok("-1"), n) && !parseCount(tok("+1"), n));
+
+    const char* line = "  transfer\t1  -2 3\r";
+    Tokenizer words(line, line + std::strlen(line));
+    Token t;
+    int32_t a = 0, b = 0, c = 0;
+    assert(words.next(t) && t == "transfer" && t != "transfe");
+    assert(words.nextInt(a) && words.nextInt(b) && words.nextInt(c));
+    assert(a == 1 && b == -2 && c == 3);
+    assert(!words.next(t));
+
+    // Каждое имя реестра находится, похожие — нет
+    for (size_t i = 0; i < COMMAND_COUNT; ++i)
+        assert(lookupCommand(tok(COMMANDS[i].name)) == COMMANDS[i].id);
+    assert(lookupCommand(tok("show_mix")) == CommandId::Unknown);
+    assert(lookupCommand(tok("helpx")) == CommandId::Unknown);
+    assert(lookupCommand(tok("")) == CommandId::Unknown);
+
+    Account accounts[2];
+    initAccounts(accounts, 2);
+    Bank bank(accounts, 2);
+    std::string out;
+    const char* cmd = "shutdown";
+    assert(executeCommand(bank, cmd, cmd + 8, SCOPE_CLI, out) == CommandResult::Continue);
+    assert(out == "Unknown command: shutdown\n");
+    out.clear();
+    cmd = "exit";
+    assert(executeCommand(bank, cmd, cmd + 4, SCOPE_CLI, out) == CommandResult::Exit);
+    assert(out.empty());
+    assert(executeCommand(bank, cmd, cmd + 4, SCOPE_SERVER, out) == CommandResult::Continue);
+    assert(out == "Unknown command: exit\n");
+
+    // Число — слово целиком: хвост не отбрасывается молча
+    Session s(bank);
+    feedStr(s, "transfer 0 1 5x\nshow_min 1\r\n");
+    assert(drain(s) == "Usage: transfer <from> <to> <amount>\n"
+                       "Account 1 min balance: 0\n");
+}
+
+// Поднимает флаг остановки процесса — вызывается последним
+void test_epoll_wire() {
+    const char *script = "show_balance 0\ntransfer 0 1 10\nfreeze 2\ntransfer 1 2 5\n"
+                         "show_account_list\nbogus\nset_limits 1 0\nshutdown\n";
+
+    Account accounts[3];
+    initAccounts(accounts, 3);
+    Bank bank(accounts, 3);
+    ServerOptions options;
+    options.port = 23457;
+    options.mode = ServerOptions::Mode::Epoll;
+    options.reactors = 1;
+    int rc = -1;
+    startStatsThread();
+    std::thread server([&]() { rc = runEpollServer(options, bank); });
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(static_cast<uint16_t>(options.port));
+    int fd = -1;
+    for (int attempt = 0; attempt < 200 && fd < 0; ++attempt) {
+        fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (connect(fd, (sockaddr *)&addr, sizeof(addr)) != 0) {
+            close(fd);
+            fd = -1;
+            usleep(10000);
+        }
+    }
+    assert(fd >= 0);
+    assert(send(fd, script, std::strlen(script), 0) == static_cast<ssize_t>(std::strlen(script)));
+    // shutdown закрывает соединение и останавливает реактор
+    std::string got;
+    char buf[4096];
+    ssize_t n;
+    while ((n = recv(fd, buf, sizeof(buf), 0)) > 0)
+        got.append(buf, static_cast<size_t>(n));
+    close(fd);
+    server.join();
+    assert(rc == 0);
+    // Нить статистики просыпается по остановке, а не через 5 секунд
+    const auto t0 = std::chrono::steady_clock::now();
+    stopStatsThread();
+    assert(std::chrono::steady_clock::now() - t0 < std::chrono::seconds(2));
+
+    // Режим threads: та же сессия над сокетом, байты — её выходной буфер
+    Account expected_accounts[3];
+    initAccounts(expected_accounts, 3);
+    Bank expected_bank(expected_accounts, 3);
+    Session s(expected_bank);
+    s.start();
+    feedStr(s, script);
+    std::string expected;
+    while (s.outSize() > 0)
+        expected += drain(s); // Листинг досылается по мере отправки
+    assert(s.closing());
+
+    assert(got == expected);
+    assert(got.find("OK: transferred 10\n") != std::string::npos);
+    assert(bank.getAccount(1).balance == 110);
+}
+
+int main() {
+    std::cout << "Running Session unit tests...\n";
+    test_pipelined_commands();
+    test_transfer_batch_command();
+    test_split_command();
+    test_set_limits_command();
+    test_session_drain();
+    test_overlong_line();
+    test_input_bound();
+    test_binary_protocol();
+    test_query_by_id();
+    test_account_list_paging();
+    test_account_list_streaming();
+    test_sharded_session();
+    test_ledger_session();
+    test_stats_command();
+    test_stats_buckets();
+    test_metrics_page();
+    test_trace_dump();
+    test_reject_busy();
+    test_command_parser();
+    test_epoll_wire();
+    std::cout << "All tests passed successfully.\n";
+    return 0;
+}